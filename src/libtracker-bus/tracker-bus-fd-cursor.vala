@@ -18,24 +18,92 @@
  */
 
 class Tracker.Bus.FDCursor : Tracker.Sparql.Cursor {
+	/* Result formats, these need to match Tracker.Steroids in tracker-store */
+	public const int FORMAT_LEGACY = 1;
+	public const int FORMAT_BINARY = 2;
+	public const int FORMAT_STREAM = 3;
+	public const int FORMAT_CONTINUATION = 4;
+
+	internal const uint32 BINARY_MAGIC = 0x52545254;
+	internal const int BINARY_HEADER_SIZE = 16;
+	const int BATCH_HEADER_SIZE = 8;
+
 	internal char* buffer;
 	internal ulong buffer_index;
 	internal ulong buffer_size;
+	internal int format;
 
 	internal int _n_columns;
+	// columns in binary rows, one more with continuations
+	internal int row_columns;
 	internal int* offsets;
 	internal int* types;
 	internal char* data;
 	internal string[] variable_names;
 
-	public FDCursor (char* buffer, ulong buffer_size, string[] variable_names) {
+	// binary format, all pointing into buffer
+	internal uint32 batch_rows_left;
+	internal uint8* row_types;
+	internal char* row_values;
+	internal char* row_strings;
+
+	// integers and doubles converted for get_string, per row
+	internal string[]? converted;
+
+	// stream format, buffer only holds the current batch
+	internal InputStream? input;
+	internal ulong buffer_capacity;
+	internal uint8 batch_header[8];
+
+	// D-Bus reply, arrives once the store wrote the whole result. It is
+	// dispatched in reply_context, the cursor may be read in any thread.
+	internal MainContext? reply_context;
+	Mutex reply_mutex;
+	Cond reply_cond;
+	internal bool reply_received;
+	internal Error? reply_error;
+	// resumes read_batch_async in the context it was called in
+	SourceFunc? reply_callback;
+	MainContext? reply_callback_context;
+
+	public FDCursor (char* buffer, ulong buffer_size, string[] variable_names, int format = FORMAT_LEGACY) {
 		this.buffer = buffer;
 		this.buffer_size = buffer_size;
 		this.variable_names = variable_names;
+		this.format = format;
 		_n_columns = variable_names.length;
+		row_columns = _n_columns;
+
+		if (format == FORMAT_BINARY) {
+			buffer_index = BINARY_HEADER_SIZE;
+		}
+	}
+
+	/* Reads rows from input as they arrive, batch by batch. The header
+	 * has already been read, the reply to the query needs to be passed
+	 * to set_reply once it arrives in the thread default main context.
+	 * With continuations every row ends with an extra string column
+	 * holding the continuation of the row.
+	 */
+	public FDCursor.stream (InputStream input, string[] variable_names, bool continuations = false) {
+		this.input = input;
+		this.variable_names = variable_names;
+		this.format = FORMAT_BINARY;
+		_n_columns = variable_names.length;
+		row_columns = continuations ? _n_columns + 1 : _n_columns;
+
+		reply_context = MainContext.ref_thread_default ();
 	}
 
 	~FDCursor () {
+		if (input != null) {
+			// the store stops writing once the pipe is closed
+			try {
+				input.close ();
+			} catch (Error e) {
+			}
+		}
+
 		free (buffer);
 	}
 
@@ -47,12 +115,53 @@ class Tracker.Bus.FDCursor : Tracker.Sparql.Cursor {
 		return v;
 	}
 
+	internal bool check_header () {
+		if (format == FORMAT_LEGACY) {
+			return true;
+		}
+
+		/* header = [4 bytes magic, 4 bytes format, 4 bytes number of
+		 *           columns, 4 bytes padding] */
+		if (buffer_size < BINARY_HEADER_SIZE) {
+			return false;
+		}
+
+		uint32* header = (uint32*) buffer;
+
+		return (header[0] == BINARY_MAGIC &&
+		        header[1] == FORMAT_BINARY &&
+		        header[2] == _n_columns);
+	}
+
+	static string double_to_string (double value) {
+		char[] buf = new char[double.DTOSTR_BUF_SIZE];
+		string str = value.format (buf, "%.15g");
+
+		// SQLite always adds a decimal point, keep strings identical
+		// to what the legacy format transferred
+		if (value.is_finite () && str.index_of_char ('.') < 0) {
+			int exp = str.index_of_char ('e');
+
+			if (exp < 0) {
+				str += ".0";
+			} else {
+				str = str.substring (0, exp) + ".0" + str.substring (exp);
+			}
+		}
+
+		return str;
+	}
+
 	public override int n_columns {
 		get { return _n_columns; }
 	}
 
 	public override Sparql.ValueType get_value_type (int column)
-	requires (types != null) {
+	requires (types != null || row_types != null) {
+		if (format == FORMAT_BINARY) {
+			return (Sparql.ValueType) row_types[column];
+		}
+
 		/* Cast from int to enum */
 		return (Sparql.ValueType) types[column];
 	}
@@ -62,10 +171,44 @@ class Tracker.Bus.FDCursor : Tracker.Sparql.Cursor {
 		return variable_names[column];
 	}
 
+	unowned string? get_binary_string (int column, out long length) {
+		char* value = row_values + 8 * column;
+
+		switch ((Sparql.ValueType) row_types[column]) {
+		case Sparql.ValueType.UNBOUND:
+			length = 0;
+			return null;
+		case Sparql.ValueType.INTEGER:
+		case Sparql.ValueType.DOUBLE:
+			if (converted == null) {
+				converted = new string[row_columns];
+			}
+
+			if (converted[column] == null) {
+				if (row_types[column] == Sparql.ValueType.INTEGER) {
+					converted[column] = (*((int64*) value)).to_string ();
+				} else {
+					converted[column] = double_to_string (*((double*) value));
+				}
+			}
+
+			length = converted[column].length;
+			return converted[column];
+		default:
+			/* [4 bytes offset in the row strings, 4 bytes length] */
+			length = ((uint32*) value)[1];
+			return (string) (row_strings + ((uint32*) value)[0]);
+		}
+	}
+
 	public override unowned string? get_string (int column, out long length = null)
-	requires (column < n_columns && data != null) {
+	requires (column < n_columns && (data != null || row_values != null)) {
 		unowned string str = null;
 
+		if (format == FORMAT_BINARY) {
+			return get_binary_string (column, out length);
+		}
+
 		// return null instead of empty string for unbound values
 		if (types[column] == Sparql.ValueType.UNBOUND) {
 			length = 0;
@@ -83,13 +226,266 @@ class Tracker.Bus.FDCursor : Tracker.Sparql.Cursor {
 		return str;
 	}
 
+	public override string? get_continuation () {
+		if (row_columns == _n_columns || row_values == null) {
+			return null;
+		}
+
+		long length;
+		return get_binary_string (_n_columns, out length);
+	}
+
+	public override int64 get_integer (int column) {
+		if (format == FORMAT_BINARY && row_values != null &&
+		    row_types[column] == Sparql.ValueType.INTEGER) {
+			return *((int64*) (row_values + 8 * column));
+		}
+
+		return base.get_integer (column);
+	}
+
+	public override double get_double (int column) {
+		if (format == FORMAT_BINARY && row_values != null &&
+		    row_types[column] == Sparql.ValueType.DOUBLE) {
+			return *((double*) (row_values + 8 * column));
+		}
+
+		return base.get_double (column);
+	}
+
+	internal void set_reply (Error? error) {
+		reply_mutex.lock ();
+
+		reply_received = true;
+		reply_error = error;
+		reply_cond.broadcast ();
+
+		SourceFunc? callback = (owned) reply_callback;
+		MainContext? callback_context = (owned) reply_callback_context;
+
+		reply_mutex.unlock ();
+
+		if (callback != null) {
+			var source = new IdleSource ();
+			source.set_callback ((owned) callback);
+			source.attach (callback_context);
+		}
+	}
+
+	void wait_for_reply () {
+		reply_mutex.lock ();
+
+		while (!reply_received) {
+			if (reply_context.acquire ()) {
+				// nobody else dispatches the reply, e.g. the
+				// private context of a synchronous query
+				reply_mutex.unlock ();
+				reply_context.iteration (true);
+				reply_context.release ();
+				reply_mutex.lock ();
+			} else {
+				// the owner of the context dispatches it, check
+				// again now and then in case it stops doing so
+				reply_cond.wait_until (reply_mutex, get_monotonic_time () + 100 * TimeSpan.MILLISECOND);
+			}
+		}
+
+		reply_mutex.unlock ();
+	}
+
+	/* Returns the buffer to read a batch of size bytes into, once the
+	 * batch header has been read. Empty for the last batch. */
+	unowned uint8[] prepare_batch (size_t bytes_read) {
+		unowned uint8[] data = (uint8[]) buffer;
+
+		batch_rows_left = bytes_read == BATCH_HEADER_SIZE ? ((uint32*) batch_header)[0] : 0;
+		buffer_index = 0;
+		buffer_size = batch_rows_left > 0 ? ((uint32*) batch_header)[1] : 0;
+
+		if (buffer_size > buffer_capacity) {
+			buffer = realloc (buffer, buffer_size);
+			buffer_capacity = buffer_size;
+			data = (uint8[]) buffer;
+		}
+
+		data.length = (int) buffer_size;
+		return data;
+	}
+
+	void close_stream () {
+		try {
+			input.close ();
+		} catch (Error e) {
+		}
+
+		input = null;
+		batch_rows_left = 0;
+		buffer_index = buffer_size = 0;
+	}
+
+	/* Called after reading the last batch, or when the pipe got closed
+	 * early. Rows were complete if the store replied without error. */
+	bool finish_stream (bool complete) throws Error {
+		close_stream ();
+
+		reply_mutex.lock ();
+		Error? error = reply_error != null ? reply_error.copy () : null;
+		reply_mutex.unlock ();
+
+		if (error != null) {
+			throw error;
+		}
+
+		if (!complete) {
+			throw new Sparql.Error.INTERNAL ("Incomplete query result received");
+		}
+
+		return false;
+	}
+
+	void check_stream (Cancellable? cancellable) throws Error {
+		if (cancellable != null && cancellable.is_cancelled ()) {
+			// closing the pipe stops the query in the store
+			close_stream ();
+			throw new IOError.CANCELLED ("Operation was cancelled");
+		}
+
+		reply_mutex.lock ();
+		bool failed = reply_error != null;
+		reply_mutex.unlock ();
+
+		if (failed) {
+			// the store gave up on the query, do not wait for rows
+			finish_stream (false);
+		}
+	}
+
+	/* Like InputStream.read_all_async, which needs a newer GLib */
+	internal static async size_t read_all_async (InputStream input, uint8[] data, Cancellable? cancellable) throws Error {
+		size_t bytes_read = 0;
+
+		while (bytes_read < data.length) {
+			ssize_t n = yield input.read_async (data[bytes_read:data.length], Priority.DEFAULT, cancellable);
+
+			if (n == 0) {
+				break;
+			}
+
+			bytes_read += n;
+		}
+
+		return bytes_read;
+	}
+
+	bool read_batch (Cancellable? cancellable) throws Error {
+		size_t bytes_read;
+
+		input.read_all (batch_header, out bytes_read, cancellable);
+		unowned uint8[] data = prepare_batch (bytes_read);
+
+		if (batch_rows_left > 0) {
+			input.read_all (data, out bytes_read, cancellable);
+			if (bytes_read == data.length) {
+				return true;
+			}
+		}
+
+		// wait for the reply to report errors of the store
+		wait_for_reply ();
+
+		return finish_stream (batch_rows_left == 0 && bytes_read == BATCH_HEADER_SIZE);
+	}
+
+	async bool read_batch_async (Cancellable? cancellable) throws Error {
+		size_t bytes_read;
+
+		bytes_read = yield read_all_async (input, batch_header, cancellable);
+		unowned uint8[] data = prepare_batch (bytes_read);
+
+		if (batch_rows_left > 0) {
+			bytes_read = yield read_all_async (input, data, cancellable);
+			if (bytes_read == data.length) {
+				return true;
+			}
+		}
+
+		reply_mutex.lock ();
+		bool received = reply_received;
+		if (!received) {
+			reply_callback = read_batch_async.callback;
+			reply_callback_context = MainContext.ref_thread_default ();
+		}
+		reply_mutex.unlock ();
+
+		if (!received) {
+			yield;
+		}
+
+		return finish_stream (batch_rows_left == 0 && bytes_read == BATCH_HEADER_SIZE);
+	}
+
+	bool next_binary_row () {
+		char* row = buffer + buffer_index;
+
+		row_types = (uint8*) (row + 4);
+		row_values = row + ((4 + row_columns + 7) & ~7);
+		row_strings = row_values + 8 * row_columns;
+		converted = null;
+
+		buffer_index += *((uint32*) row);
+		batch_rows_left--;
+
+		return true;
+	}
+
+	bool next_binary () {
+		/* Rows come in batches:
+		 *
+		 * batch = [4 bytes number of rows, 4 bytes size of rows, rows]
+		 * row   = [4 bytes row size, columns x 1 byte value type, padding,
+		 *          columns x 8 bytes value, strings, padding]
+		 *
+		 * Everything is 8 byte aligned so values are read in place.
+		 */
+		while (batch_rows_left == 0) {
+			if (buffer_index + 8 > buffer_size) {
+				return false;
+			}
+
+			batch_rows_left = (uint32) buffer_read_int ();
+			buffer_index += 4;
+
+			if (batch_rows_left == 0) {
+				// end of result
+				buffer_index = buffer_size;
+				return false;
+			}
+		}
+
+		return next_binary_row ();
+	}
+
 	public override bool next (Cancellable? cancellable = null) throws GLib.Error {
 		int last_offset;
 
+		if (input != null) {
+			check_stream (cancellable);
+
+			if (batch_rows_left == 0 && !read_batch (cancellable)) {
+				return false;
+			}
+
+			return next_binary_row ();
+		}
+
 		if (cancellable != null && cancellable.is_cancelled ()) {
 			throw new IOError.CANCELLED ("Operation was cancelled");
 		}
 
+		if (format == FORMAT_BINARY) {
+			return next_binary ();
+		}
+
 		if (buffer_index >= buffer_size) {
 			return false;
 		}
@@ -120,12 +516,36 @@ class Tracker.Bus.FDCursor : Tracker.Sparql.Cursor {
 	}
 
 	public override async bool next_async (Cancellable? cancellable = null) throws GLib.Error {
-		// next never blocks
+		if (input != null && batch_rows_left == 0) {
+			check_stream (cancellable);
+
+			if (!yield read_batch_async (cancellable)) {
+				return false;
+			}
+
+			return next_binary_row ();
+		}
+
+		// next never blocks otherwise
 		return next (cancellable);
 	}
 
 	public override void rewind () {
-		buffer_index = 0;
-		data = buffer;
+		if (reply_context != null) {
+			// streamed rows are gone once read
+			warning ("Streamed query results cannot be rewound");
+			return;
+		}
+
+		if (format == FORMAT_BINARY) {
+			buffer_index = BINARY_HEADER_SIZE;
+			batch_rows_left = 0;
+			row_types = null;
+			row_values = null;
+			converted = null;
+		} else {
+			buffer_index = 0;
+			data = buffer;
+		}
 	}
 }
@@ -20,6 +20,9 @@
 public class Tracker.Bus.Connection : Tracker.Sparql.Connection {
 	DBusConnection bus;
 
+	// set once the store turned out to only know Steroids.Query
+	bool legacy_query;
+
 	public Connection () throws Sparql.Error, IOError, DBusError {
 		bus = GLib.Bus.get_sync (Tracker.IPC.bus ());
 
@@ -50,10 +53,20 @@ public class Tracker.Bus.Connection : Tracker.Sparql.Connection {
 		}
 	}
 
-	void send_query (string sparql, UnixOutputStream output, Cancellable? cancellable, AsyncReadyCallback? callback) throws GLib.IOError, GLib.Error {
-		var message = new DBusMessage.method_call (Tracker.DBUS_SERVICE, Tracker.DBUS_OBJECT_STEROIDS, Tracker.DBUS_INTERFACE_STEROIDS, "Query");
+	void send_query (string sparql, string? continuation, int format, UnixOutputStream output, Cancellable? cancellable, AsyncReadyCallback? callback) throws GLib.IOError, GLib.Error {
+		DBusMessage message;
 		var fd_list = new UnixFDList ();
-		message.set_body (new Variant ("(sh)", sparql, fd_list.append (output.fd)));
+
+		if (format == FDCursor.FORMAT_CONTINUATION) {
+			message = new DBusMessage.method_call (Tracker.DBUS_SERVICE, Tracker.DBUS_OBJECT_STEROIDS, Tracker.DBUS_INTERFACE_STEROIDS, "QueryContinue");
+			message.set_body (new Variant ("(ssh)", sparql, continuation ?? "", fd_list.append (output.fd)));
+		} else if (legacy_query) {
+			message = new DBusMessage.method_call (Tracker.DBUS_SERVICE, Tracker.DBUS_OBJECT_STEROIDS, Tracker.DBUS_INTERFACE_STEROIDS, "Query");
+			message.set_body (new Variant ("(sh)", sparql, fd_list.append (output.fd)));
+		} else {
+			message = new DBusMessage.method_call (Tracker.DBUS_SERVICE, Tracker.DBUS_OBJECT_STEROIDS, Tracker.DBUS_INTERFACE_STEROIDS, "QueryWithFormat");
+			message.set_body (new Variant ("(sih)", sparql, format, fd_list.append (output.fd)));
+		}
 		message.set_unix_fd_list (fd_list);
 
 		bus.send_message_with_reply.begin (message, DBusSendMessageFlags.NONE, int.MAX, null, cancellable, callback);
@@ -74,7 +87,74 @@ public class Tracker.Bus.Connection : Tracker.Sparql.Connection {
 		return query_async.end (async_res);
 	}
 
+	Error? check_query_reply (AsyncResult res) {
+		try {
+			handle_error_reply (bus.send_message_with_reply.end (res));
+		} catch (Error e) {
+			return e;
+		}
+
+		return null;
+	}
+
+	/* Reads the header of a streamed result, returns the variable names
+	 * if the store sent the stream format. Anything else read is passed
+	 * on to mem_stream. */
+	async string[]? read_stream_header (UnixInputStream input, MemoryOutputStream mem_stream, Cancellable? cancellable, out bool continuations) throws GLib.Error {
+		var header = new uint8[FDCursor.BINARY_HEADER_SIZE];
+		size_t bytes_read = yield FDCursor.read_all_async (input, header, cancellable);
+		uint32* values = (uint32*) header;
+
+		continuations = false;
+
+		if (bytes_read < header.length || values[1] < FDCursor.FORMAT_STREAM) {
+			// failed query or older store
+			size_t bytes_written;
+			header.length = (int) bytes_read;
+			mem_stream.write_all (header, out bytes_written);
+			return null;
+		}
+
+		/* header = [4 bytes magic, 4 bytes format, 4 bytes number of
+		 *           columns, 4 bytes size of names, names] */
+		if (values[0] != FDCursor.BINARY_MAGIC ||
+		    (values[1] != FDCursor.FORMAT_STREAM && values[1] != FDCursor.FORMAT_CONTINUATION)) {
+			throw new Sparql.Error.INTERNAL ("Invalid query result received");
+		}
+
+		continuations = (values[1] == FDCursor.FORMAT_CONTINUATION);
+
+		int n_columns = (int) values[2];
+		var names = new uint8[values[3]];
+
+		if ((yield FDCursor.read_all_async (input, names, cancellable)) < names.length ||
+		    (names.length > 0 && names[names.length - 1] != 0)) {
+			throw new Sparql.Error.INTERNAL ("Invalid query result received");
+		}
+
+		var variable_names = new string[n_columns];
+		char* name = (char*) names;
+		char* names_end = name + names.length;
+
+		for (int i = 0; i < n_columns; i++) {
+			if (name >= names_end) {
+				throw new Sparql.Error.INTERNAL ("Invalid query result received");
+			}
+
+			variable_names[i] = (string) name;
+			name += variable_names[i].length + 1;
+		}
+
+		return variable_names;
+	}
+
 	public async override Sparql.Cursor query_async (string sparql, Cancellable? cancellable = null) throws Sparql.Error, GLib.Error, GLib.IOError, DBusError {
+		return yield query_internal_async (sparql, false, null, cancellable);
+	}
+
+	/* Continuable queries always use the stream format, with the
+	 * continuation of every row at its end */
+	async Sparql.Cursor query_internal_async (string sparql, bool continuable, string? continuation, Cancellable? cancellable) throws Sparql.Error, GLib.Error, GLib.IOError, DBusError {
 		UnixInputStream input;
 		UnixOutputStream output;
 		pipe (out input, out output);
@@ -82,18 +162,71 @@ public class Tracker.Bus.Connection : Tracker.Sparql.Connection {
 		// send D-Bus request
 		AsyncResult dbus_res = null;
 		bool received_result = false;
-		send_query (sparql, output, cancellable, (o, res) => {
+		bool streaming = false;
+		// dropping the cursor needs to close the pipe before the reply
+		WeakRef stream_cursor = WeakRef (null);
+		int format;
+		if (continuable) {
+			format = FDCursor.FORMAT_CONTINUATION;
+		} else {
+			format = legacy_query ? FDCursor.FORMAT_LEGACY : FDCursor.FORMAT_STREAM;
+		}
+		send_query (sparql, continuation, format, output, cancellable, (o, res) => {
+			if (streaming) {
+				// rows are already being read
+				var cursor = (FDCursor) stream_cursor.get ();
+				if (cursor != null) {
+					cursor.set_reply (check_query_reply (res));
+				}
+				return;
+			}
+
 			dbus_res = res;
 			if (received_result) {
-				query_async.callback ();
+				query_internal_async.callback ();
 			}
 		});
 
 		output = null;
 
-		// receive query results via FD
 		var mem_stream = new MemoryOutputStream (null, GLib.realloc, GLib.free);
 
+		if (format >= FDCursor.FORMAT_STREAM) {
+			string[]? variable_names = null;
+			bool continuations = false;
+
+			try {
+				variable_names = yield read_stream_header (input, mem_stream, cancellable, out continuations);
+			} catch (Error e) {
+				// closing the pipe makes the store give up on the query
+				input.close ();
+
+				received_result = true;
+				if (dbus_res == null) {
+					yield;
+				}
+
+				throw e;
+			}
+
+			if (variable_names != null) {
+				// rows are read from the pipe as the cursor advances
+				var cursor = new FDCursor.stream (input, variable_names, continuations);
+
+				if (dbus_res != null) {
+					cursor.set_reply (check_query_reply (dbus_res));
+				} else {
+					streaming = true;
+					stream_cursor.set (cursor);
+				}
+
+				return cursor;
+			}
+
+			format = FDCursor.FORMAT_BINARY;
+		}
+
+		// receive query results via FD
 		try {
 			yield mem_stream.splice_async (input, OutputStreamSpliceFlags.CLOSE_SOURCE | OutputStreamSpliceFlags.CLOSE_TARGET, Priority.DEFAULT, cancellable);
 		} finally {
@@ -105,11 +238,50 @@ public class Tracker.Bus.Connection : Tracker.Sparql.Connection {
 		}
 
 		var reply = bus.send_message_with_reply.end (dbus_res);
+
+		if (format != FDCursor.FORMAT_LEGACY &&
+		    reply.get_message_type () == DBusMessageType.ERROR &&
+		    reply.get_error_name () == "org.freedesktop.DBus.Error.UnknownMethod") {
+			if (continuable) {
+				throw new Sparql.Error.UNSUPPORTED ("Query continuations not supported by the store");
+			}
+
+			// older store, retry with the legacy format
+			legacy_query = true;
+			return yield query_async (sparql, cancellable);
+		}
+
 		handle_error_reply (reply);
 
 		string[] variable_names = (string[]) reply.get_body ().get_child_value (0);
 		mem_stream.close ();
-		return new FDCursor (mem_stream.steal_data (), mem_stream.data_size, variable_names);
+
+		var cursor = new FDCursor (mem_stream.steal_data (), mem_stream.data_size, variable_names, format);
+
+		if (!cursor.check_header ()) {
+			throw new Sparql.Error.INTERNAL ("Invalid query result received");
+		}
+
+		return cursor;
+	}
+
+	public override Sparql.Cursor query_continue (string sparql, string? continuation, Cancellable? cancellable) throws Sparql.Error, GLib.Error, GLib.IOError, DBusError {
+		// use separate main context for sync operation
+		var context = new MainContext ();
+		var loop = new MainLoop (context, false);
+		context.push_thread_default ();
+		AsyncResult async_res = null;
+		query_continue_async.begin (sparql, continuation, cancellable, (o, res) => {
+			async_res = res;
+			loop.quit ();
+		});
+		loop.run ();
+		context.pop_thread_default ();
+		return query_continue_async.end (async_res);
+	}
+
+	public async override Sparql.Cursor query_continue_async (string sparql, string? continuation, Cancellable? cancellable = null) throws Sparql.Error, GLib.Error, GLib.IOError, DBusError {
+		return yield query_internal_async (sparql, true, continuation, cancellable);
 	}
 
 	void send_update (string method, UnixInputStream input, Cancellable? cancellable, AsyncReadyCallback? callback) throws GLib.Error, GLib.IOError {
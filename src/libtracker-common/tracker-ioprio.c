@@ -140,6 +140,19 @@ tracker_ioprio_init (void)
 	}
 }
 
+void
+tracker_ioprio_set_thread_idle (gboolean idle)
+{
+	/* A "who" of 0 only changes the calling thread */
+	if (idle) {
+		if (set_io_priority_idle () == -1) {
+			g_debug ("Could not set idle IO priority for thread");
+		}
+	} else if (set_io_priority_best_effort (4) == -1) {
+		g_debug ("Could not set best effort IO priority for thread");
+	}
+}
+
 #else  /* __linux__ */
 
 void
@@ -147,4 +160,9 @@ tracker_ioprio_init (void)
 {
 }
 
+void
+tracker_ioprio_set_thread_idle (gboolean idle)
+{
+}
+
 #endif /* __linux__ */
@@ -29,7 +29,8 @@ G_BEGIN_DECLS
 #error "only <libtracker-common/tracker-common.h> must be included directly."
 #endif
 
-void tracker_ioprio_init (void);
+void tracker_ioprio_init            (void);
+void tracker_ioprio_set_thread_idle (gboolean idle);
 
 G_END_DECLS
 
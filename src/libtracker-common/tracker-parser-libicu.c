@@ -30,6 +30,13 @@
 #include <unicode/ustring.h>
 #include <unicode/uchar.h>
 #include <unicode/unorm.h>
+#include <unicode/uloc.h>
+
+#if defined (__AVX2__)
+#include <immintrin.h>
+#elif defined (__SSE2__)
+#include <emmintrin.h>
+#endif
 
 #include "tracker-parser.h"
 #include "tracker-parser-utils.h"
@@ -44,6 +51,9 @@ typedef enum {
 /* Max possible length of a UChar encoded string (just a safety limit) */
 #define WORD_BUFFER_LENGTH 512
 
+/* Characters joined into a single word by the break iterator in ASCII text */
+#define IS_ASCII_WORD_CHAR(c) (g_ascii_isalnum (c) || (c) == '_')
+
 struct TrackerParser {
 	const gchar           *txt;
 	gint                   txt_size;
@@ -62,6 +72,9 @@ struct TrackerParser {
 	gint                   word_length;
 	guint                  word_position;
 
+	/* Plain ASCII text, tokenized without ICU */
+	gboolean               ascii;
+
 	/* Text as UChars */
 	UChar                 *utxt;
 	gint                   utxt_size;
@@ -253,6 +266,44 @@ convert_UChar_to_utf8 (const UChar *word,
 	return utf8_str;
 }
 
+/* Takes ownership of the normalized UTF-8 word, checks for stop words
+ * and stems it if needed */
+static gchar *
+process_word_utf8 (TrackerParser *parser,
+                   gchar         *utf8_str,
+                   gsize          length,
+                   gboolean      *stop_word)
+{
+	/* Check if stop word */
+	if (parser->ignore_stop_words) {
+		*stop_word = tracker_language_is_stop_word (parser->language,
+		                                            utf8_str);
+	}
+
+	/* Stemming needed? */
+	if (utf8_str &&
+	    parser->enable_stemmer) {
+		gchar *stemmed;
+
+		/* Input for stemmer ALWAYS in UTF-8, as well as output */
+		stemmed = tracker_language_stem_word (parser->language,
+		                                      utf8_str,
+		                                      length);
+
+		/* Log after stemming */
+		tracker_parser_message_hex ("    After stemming",
+		                            stemmed, strlen (stemmed));
+
+		/* If stemmed wanted and succeeded, free previous and return it */
+		if (stemmed) {
+			g_free (utf8_str);
+			return stemmed;
+		}
+	}
+
+	return utf8_str;
+}
+
 static gchar *
 process_word_uchar (TrackerParser         *parser,
                     const UChar           *word,
@@ -355,34 +406,7 @@ process_word_uchar (TrackerParser         *parser,
 	                            utf8_str,
 	                            new_word_length);
 
-	/* Check if stop word */
-	if (parser->ignore_stop_words) {
-		*stop_word = tracker_language_is_stop_word (parser->language,
-		                                            utf8_str);
-	}
-
-	/* Stemming needed? */
-	if (utf8_str &&
-	    parser->enable_stemmer) {
-		gchar *stemmed;
-
-		/* Input for stemmer ALWAYS in UTF-8, as well as output */
-		stemmed = tracker_language_stem_word (parser->language,
-		                                      utf8_str,
-		                                      new_word_length);
-
-		/* Log after stemming */
-		tracker_parser_message_hex ("    After stemming",
-		                            stemmed, strlen (stemmed));
-
-		/* If stemmed wanted and succeeded, free previous and return it */
-		if (stemmed) {
-			g_free (utf8_str);
-			return stemmed;
-		}
-	}
-
-	return utf8_str;
+	return process_word_utf8 (parser, utf8_str, new_word_length, stop_word);
 }
 
 static gboolean
@@ -566,6 +590,188 @@ parser_next (TrackerParser *parser,
 	return FALSE;
 }
 
+/* Returns TRUE if the text only contains 7-bit ASCII characters */
+static gboolean
+text_is_ascii (const gchar *txt,
+               gsize        txt_size)
+{
+	const guchar *p = (const guchar *) txt;
+	const guchar *end = p + txt_size;
+	guint64 chunk;
+
+#if defined (__AVX2__)
+	while (end - p >= 32) {
+		if (_mm256_movemask_epi8 (_mm256_loadu_si256 ((const __m256i *) p)) != 0) {
+			return FALSE;
+		}
+		p += 32;
+	}
+#elif defined (__SSE2__)
+	while (end - p >= 16) {
+		if (_mm_movemask_epi8 (_mm_loadu_si128 ((const __m128i *) p)) != 0) {
+			return FALSE;
+		}
+		p += 16;
+	}
+#endif
+
+	while (end - p >= (gssize) sizeof (chunk)) {
+		memcpy (&chunk, p, sizeof (chunk));
+		if (chunk & G_GUINT64_CONSTANT (0x8080808080808080)) {
+			return FALSE;
+		}
+		p += sizeof (chunk);
+	}
+
+	while (p < end) {
+		if (*p & 0x80) {
+			return FALSE;
+		}
+		p++;
+	}
+
+	return TRUE;
+}
+
+/* Checks whether the ASCII tokenizer gives the same words the break
+ * iterator would for this text */
+static gboolean
+parser_can_tokenize_ascii (const gchar *txt,
+                           gsize        txt_size)
+{
+	UErrorCode error = U_ZERO_ERROR;
+	gchar language[ULOC_LANG_CAPACITY];
+	const gchar *p, *end;
+
+	if (!text_is_ascii (txt, txt_size)) {
+		return FALSE;
+	}
+
+	/* Turkic locales lowercase 'I' to a dotless i */
+	uloc_getLanguage (NULL, language, sizeof (language), &error);
+	if (U_FAILURE (error) ||
+	    strcmp (language, "tr") == 0 ||
+	    strcmp (language, "az") == 0) {
+		return FALSE;
+	}
+
+	/* Whether a colon between two letters breaks words depends on
+	 * the ICU version and locale, leave those to the break iterator */
+	p = txt;
+	end = txt + txt_size;
+	while ((p = memchr (p, ':', end - p)) != NULL) {
+		if (p > txt && p + 1 < end &&
+		    g_ascii_isalpha (p[-1]) && g_ascii_isalpha (p[1])) {
+			return FALSE;
+		}
+		p++;
+	}
+
+	return TRUE;
+}
+
+/* Returns the end of the word starting at start, following the UAX #29
+ * rules as they apply to ASCII: letters, digits and underscores join, an
+ * apostrophe joins two letters, and an apostrophe, comma or semicolon
+ * joins two digits. Dots are forced word breaks, so are not handled. */
+static gsize
+ascii_word_end (const gchar *txt,
+                gsize        start,
+                gsize        txt_size)
+{
+	gsize i = start + 1;
+
+	while (i < txt_size) {
+		gchar c = txt[i];
+
+		if (IS_ASCII_WORD_CHAR (c)) {
+			i++;
+		} else if (i + 1 < txt_size &&
+		           c == '\'' &&
+		           g_ascii_isalpha (txt[i - 1]) &&
+		           g_ascii_isalpha (txt[i + 1])) {
+			i += 2;
+		} else if (i + 1 < txt_size &&
+		           (c == '\'' || c == ',' || c == ';') &&
+		           g_ascii_isdigit (txt[i - 1]) &&
+		           g_ascii_isdigit (txt[i + 1])) {
+			i += 2;
+		} else {
+			break;
+		}
+	}
+
+	return i;
+}
+
+/* Same as parser_next() for plain ASCII text, the cursor is given in
+ * bytes of the original string */
+static gboolean
+parser_next_ascii (TrackerParser *parser,
+                   gint          *byte_offset_start,
+                   gint          *byte_offset_end,
+                   gboolean      *stop_word)
+{
+	const gchar *txt = parser->txt;
+	gsize txt_size = parser->txt_size;
+
+	*byte_offset_start = 0;
+	*byte_offset_end = 0;
+
+	while (parser->cursor < txt_size) {
+		gchar *processed_word;
+		gsize start, end;
+		gsize word_length;
+
+		/* Whitespace and punctuation never start a word */
+		start = parser->cursor;
+		while (start < txt_size && !IS_ASCII_WORD_CHAR (txt[start])) {
+			start++;
+		}
+
+		if (start == txt_size) {
+			break;
+		}
+
+		end = ascii_word_end (txt, start, txt_size);
+		word_length = end - start;
+		parser->cursor = end;
+
+		/* Ignore the word if longer than the maximum allowed, words
+		 * not fitting in the UChar buffer fail to lowercase in ICU */
+		if (word_length >= parser->max_word_length ||
+		    word_length > WORD_BUFFER_LENGTH) {
+			continue;
+		}
+
+		if (parser->ignore_numbers && g_ascii_isdigit (txt[start])) {
+			continue;
+		}
+
+		if (parser->ignore_reserved_words &&
+		    tracker_parser_is_reserved_word_utf8 (&txt[start], word_length)) {
+			continue;
+		}
+
+		processed_word = process_word_utf8 (parser,
+		                                    g_ascii_strdown (&txt[start], word_length),
+		                                    word_length,
+		                                    stop_word);
+
+		*byte_offset_start = start;
+		*byte_offset_end = end;
+
+		parser->word_length = strlen (processed_word);
+		parser->word = processed_word;
+
+		return TRUE;
+	}
+
+	parser->cursor = txt_size;
+
+	return FALSE;
+}
+
 TrackerParser *
 tracker_parser_new (TrackerLanguage *language)
 {
@@ -651,6 +857,13 @@ tracker_parser_reset (TrackerParser *parser,
 
 	parser->cursor = 0;
 
+	/* ASCII text needs no conversion nor break iterator */
+	parser->ascii = parser_can_tokenize_ascii (txt, txt_size);
+	if (parser->ascii) {
+		parser->utxt_size = 0;
+		return;
+	}
+
 	/* Open converter UTF-8 to UChar */
 	converter = ucnv_open ("UTF-8", &error);
 	if (!converter) {
@@ -731,7 +944,9 @@ tracker_parser_next (TrackerParser *parser,
 
 	*stop_word = FALSE;
 
-	if (parser_next (parser, &byte_start, &byte_end, stop_word)) {
+	if (parser->ascii ?
+	    parser_next_ascii (parser, &byte_start, &byte_end, stop_word) :
+	    parser_next (parser, &byte_start, &byte_end, stop_word)) {
 		str = parser->word;
 	}
 
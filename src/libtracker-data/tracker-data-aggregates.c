@@ -0,0 +1,621 @@
+/*
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ * Boston, MA  02110-1301, USA.
+ */
+
+#include "config.h"
+
+#include <string.h>
+
+#include "tracker-data-aggregates.h"
+#include "tracker-data-update.h"
+#include "tracker-db-interface-sqlite.h"
+#include "tracker-db-manager.h"
+#include "tracker-ontologies.h"
+
+/* An aggregate view keeps the number of instances of a class per value
+ * of a property, the result of
+ *
+ *   SELECT ?v COUNT(?x) WHERE { ?x a C ; P ?v } GROUP BY ?v
+ *
+ * in a table named "Aggregate/C/P" with the columns Value and Count.
+ *
+ * Views are updated incrementally: the first time a subject is touched
+ * in a transaction through P or rdf:type C, its current values are
+ * subtracted, and on commit the values it ended up with are added back.
+ * Both steps run in the update transaction, so readers never see a view
+ * that does not match the data.
+ */
+
+#define AGGREGATE_TABLE_PREFIX "Aggregate/"
+
+typedef struct {
+	TrackerClass    *class;
+	TrackerProperty *property;
+	gchar           *table_name;
+	/* subjects touched in the current transaction */
+	GHashTable      *touched;
+} TrackerAggregateView;
+
+static gchar    **definitions;
+static GPtrArray *views;
+static gboolean   callbacks_added;
+/* first error of the statement callbacks, reported on commit */
+static GError    *pending_error;
+
+static void
+aggregate_view_free (TrackerAggregateView *view)
+{
+	g_object_unref (view->class);
+	g_object_unref (view->property);
+	g_free (view->table_name);
+	g_hash_table_unref (view->touched);
+	g_slice_free (TrackerAggregateView, view);
+}
+
+static TrackerAggregateView *
+aggregate_view_new (TrackerClass    *class,
+                    TrackerProperty *property)
+{
+	TrackerAggregateView *view;
+
+	view = g_slice_new0 (TrackerAggregateView);
+	view->class = g_object_ref (class);
+	view->property = g_object_ref (property);
+	view->table_name = g_strdup_printf (AGGREGATE_TABLE_PREFIX "%s/%s",
+	                                    tracker_class_get_name (class),
+	                                    tracker_property_get_name (property));
+	view->touched = g_hash_table_new (NULL, NULL);
+
+	return view;
+}
+
+static TrackerClass *
+find_class (const gchar *name)
+{
+	TrackerClass **classes;
+	guint i, n_classes;
+
+	classes = tracker_ontologies_get_classes (&n_classes);
+
+	for (i = 0; i < n_classes; i++) {
+		if (g_strcmp0 (tracker_class_get_name (classes[i]), name) == 0) {
+			return classes[i];
+		}
+	}
+
+	return NULL;
+}
+
+static TrackerProperty *
+find_property (const gchar *name)
+{
+	TrackerProperty **properties;
+	guint i, n_properties;
+
+	properties = tracker_ontologies_get_properties (&n_properties);
+
+	for (i = 0; i < n_properties; i++) {
+		if (g_strcmp0 (tracker_property_get_name (properties[i]), name) == 0) {
+			return properties[i];
+		}
+	}
+
+	return NULL;
+}
+
+/* Parses "nfo:Document/nie:mimeType" */
+static TrackerAggregateView *
+parse_definition (const gchar *definition)
+{
+	TrackerClass *class;
+	TrackerProperty *property;
+	gchar **parts;
+
+	parts = g_strsplit (definition, "/", -1);
+
+	if (g_strv_length (parts) != 2) {
+		g_strfreev (parts);
+		return NULL;
+	}
+
+	class = find_class (g_strstrip (parts[0]));
+	property = find_property (g_strstrip (parts[1]));
+	g_strfreev (parts);
+
+	/* xsd classes do not derive from rdfs:Resource and do not use separate tables */
+	if (!class || g_str_has_prefix (tracker_class_get_name (class), "xsd:") || !property) {
+		return NULL;
+	}
+
+	return aggregate_view_new (class, property);
+}
+
+static GPtrArray *
+get_existing_tables (TrackerDBInterface *iface)
+{
+	TrackerDBStatement *stmt;
+	TrackerDBCursor *cursor = NULL;
+	GPtrArray *tables;
+	GError *error = NULL;
+
+	tables = g_ptr_array_new_with_free_func (g_free);
+
+	stmt = tracker_db_interface_create_statement (iface, TRACKER_DB_STATEMENT_CACHE_TYPE_NONE, &error,
+	                                              "SELECT name FROM sqlite_master WHERE type = 'table' AND name LIKE '"
+	                                              AGGREGATE_TABLE_PREFIX "%%'");
+
+	if (stmt) {
+		cursor = tracker_db_statement_start_cursor (stmt, &error);
+		g_object_unref (stmt);
+	}
+
+	if (cursor) {
+		while (tracker_db_cursor_iter_next (cursor, NULL, &error)) {
+			g_ptr_array_add (tables, g_strdup (tracker_db_cursor_get_string (cursor, 0, NULL)));
+		}
+
+		g_object_unref (cursor);
+	}
+
+	if (error) {
+		g_warning ("Could not list aggregate views: %s", error->message);
+		g_error_free (error);
+	}
+
+	return tables;
+}
+
+static gboolean
+has_table (GPtrArray   *tables,
+           const gchar *name)
+{
+	guint i;
+
+	for (i = 0; i < tables->len; i++) {
+		if (g_strcmp0 (g_ptr_array_index (tables, i), name) == 0) {
+			return TRUE;
+		}
+	}
+
+	return FALSE;
+}
+
+static TrackerAggregateView *
+find_view (const gchar *table_name)
+{
+	guint i;
+
+	for (i = 0; views && i < views->len; i++) {
+		TrackerAggregateView *view = g_ptr_array_index (views, i);
+
+		if (g_strcmp0 (view->table_name, table_name) == 0) {
+			return view;
+		}
+	}
+
+	return NULL;
+}
+
+static void
+aggregate_view_rebuild (TrackerAggregateView  *view,
+                        TrackerDBInterface    *iface,
+                        GError               **error)
+{
+	GError *internal_error = NULL;
+	const gchar *sql_type, *collation;
+
+	switch (tracker_property_get_data_type (view->property)) {
+	case TRACKER_PROPERTY_TYPE_STRING:
+		sql_type = "TEXT";
+		break;
+	case TRACKER_PROPERTY_TYPE_DOUBLE:
+		sql_type = "REAL";
+		break;
+	default:
+		sql_type = "INTEGER";
+		break;
+	}
+
+	/* group values the way GROUP BY on the property column does */
+	if (!tracker_property_get_multiple_values (view->property) &&
+	    tracker_property_get_data_type (view->property) == TRACKER_PROPERTY_TYPE_STRING) {
+		collation = " COLLATE " TRACKER_COLLATION_NAME;
+	} else {
+		collation = "";
+	}
+
+	tracker_db_interface_execute_query (iface, &internal_error,
+	                                    "DROP TABLE IF EXISTS \"%s\"",
+	                                    view->table_name);
+
+	if (!internal_error) {
+		tracker_db_interface_execute_query (iface, &internal_error,
+		                                    "CREATE TABLE \"%s\" (Value %s NOT NULL PRIMARY KEY%s, Count INTEGER NOT NULL)",
+		                                    view->table_name, sql_type, collation);
+	}
+
+	if (!internal_error) {
+		tracker_db_interface_execute_query (iface, &internal_error,
+		                                    "INSERT INTO \"%s\" (Value, Count) "
+		                                    "SELECT \"%s\", COUNT(1) FROM \"%s\" "
+		                                    "WHERE \"%s\" IS NOT NULL AND ID IN (SELECT ID FROM \"%s\") "
+		                                    "GROUP BY \"%s\"",
+		                                    view->table_name,
+		                                    tracker_property_get_name (view->property),
+		                                    tracker_property_get_table_name (view->property),
+		                                    tracker_property_get_name (view->property),
+		                                    tracker_class_get_name (view->class),
+		                                    tracker_property_get_name (view->property));
+	}
+
+	if (internal_error) {
+		g_propagate_error (error, internal_error);
+	}
+}
+
+/* Adds delta to the counts of the values of the subject, if it is
+ * an instance of the class */
+static void
+aggregate_view_add_subject (TrackerAggregateView  *view,
+                            TrackerDBInterface    *iface,
+                            gint                   subject_id,
+                            gint                   delta,
+                            GError               **error)
+{
+	TrackerDBStatement *stmt;
+	GError *internal_error = NULL;
+	const gchar *field_name, *table_name, *class_name;
+
+	field_name = tracker_property_get_name (view->property);
+	table_name = tracker_property_get_table_name (view->property);
+	class_name = tracker_class_get_name (view->class);
+
+	if (delta > 0) {
+		stmt = tracker_db_interface_create_statement (iface, TRACKER_DB_STATEMENT_CACHE_TYPE_UPDATE, &internal_error,
+		                                              "INSERT OR IGNORE INTO \"%s\" (Value, Count) "
+		                                              "SELECT \"%s\", 0 FROM \"%s\" "
+		                                              "WHERE ID = ? AND \"%s\" IS NOT NULL "
+		                                              "AND EXISTS (SELECT 1 FROM \"%s\" WHERE ID = ?)",
+		                                              view->table_name,
+		                                              field_name, table_name,
+		                                              field_name,
+		                                              class_name);
+
+		if (stmt) {
+			tracker_db_statement_bind_int (stmt, 0, subject_id);
+			tracker_db_statement_bind_int (stmt, 1, subject_id);
+			tracker_db_statement_execute (stmt, &internal_error);
+			g_object_unref (stmt);
+		}
+
+		if (internal_error) {
+			g_propagate_error (error, internal_error);
+			return;
+		}
+	}
+
+	stmt = tracker_db_interface_create_statement (iface, TRACKER_DB_STATEMENT_CACHE_TYPE_UPDATE, &internal_error,
+	                                              "UPDATE \"%s\" SET Count = Count + ? "
+	                                              "WHERE Value IN (SELECT \"%s\" FROM \"%s\" WHERE ID = ? "
+	                                              "AND EXISTS (SELECT 1 FROM \"%s\" WHERE ID = ?))",
+	                                              view->table_name,
+	                                              field_name, table_name,
+	                                              class_name);
+
+	if (stmt) {
+		tracker_db_statement_bind_int (stmt, 0, delta);
+		tracker_db_statement_bind_int (stmt, 1, subject_id);
+		tracker_db_statement_bind_int (stmt, 2, subject_id);
+		tracker_db_statement_execute (stmt, &internal_error);
+		g_object_unref (stmt);
+	}
+
+	if (internal_error) {
+		g_propagate_error (error, internal_error);
+	}
+}
+
+static void
+statement_cb (gint         graph_id,
+              const gchar *graph,
+              gint         subject_id,
+              const gchar *subject,
+              gint         predicate_id,
+              gint         object_id,
+              const gchar *object,
+              GPtrArray   *rdf_types,
+              gpointer     user_data)
+{
+	TrackerDBInterface *iface;
+	gint rdf_type_id;
+	guint i;
+
+	rdf_type_id = tracker_property_get_id (tracker_ontologies_get_rdf_type ());
+	iface = tracker_db_manager_get_db_interface ();
+
+	for (i = 0; i < views->len; i++) {
+		TrackerAggregateView *view = g_ptr_array_index (views, i);
+
+		if (predicate_id != tracker_property_get_id (view->property) &&
+		    (predicate_id != rdf_type_id || object_id != tracker_class_get_id (view->class))) {
+			continue;
+		}
+
+		if (g_hash_table_contains (view->touched, GINT_TO_POINTER (subject_id))) {
+			continue;
+		}
+
+		g_hash_table_add (view->touched, GINT_TO_POINTER (subject_id));
+
+		/* the update buffer is not flushed yet, the database
+		 * still has the values of the last transaction */
+		if (!pending_error) {
+			aggregate_view_add_subject (view, iface, subject_id, -1, &pending_error);
+		}
+	}
+}
+
+static void
+views_free (void)
+{
+	if (callbacks_added) {
+		tracker_data_remove_insert_statement_callback (statement_cb, NULL);
+		tracker_data_remove_delete_statement_callback (statement_cb, NULL);
+		callbacks_added = FALSE;
+	}
+
+	if (views) {
+		g_ptr_array_unref (views);
+		views = NULL;
+	}
+
+	g_clear_error (&pending_error);
+}
+
+/* Sets the views the writer maintains, each one given as
+ * "class/property" with prefixed names, NULL keeps those in the
+ * database. Takes effect on the next tracker_data_aggregates_init. */
+void
+tracker_data_aggregates_set_definitions (const gchar * const *new_definitions)
+{
+	g_strfreev (definitions);
+	definitions = g_strdupv ((gchar **) new_definitions);
+}
+
+void
+tracker_data_aggregates_init (TrackerDBInterface *iface,
+                              gboolean            read_only,
+                              gboolean            rebuild)
+{
+	GPtrArray *tables;
+	GError *error = NULL;
+	guint i;
+
+	views_free ();
+	views = g_ptr_array_new_with_free_func ((GDestroyNotify) aggregate_view_free);
+
+	tables = get_existing_tables (iface);
+
+	if (definitions && !read_only) {
+		for (i = 0; definitions[i]; i++) {
+			TrackerAggregateView *view;
+
+			view = parse_definition (definitions[i]);
+
+			if (!view) {
+				g_warning ("Ignoring invalid aggregate view '%s', expected class/property", definitions[i]);
+				continue;
+			}
+
+			if (find_view (view->table_name)) {
+				aggregate_view_free (view);
+				continue;
+			}
+
+			g_ptr_array_add (views, view);
+		}
+	} else {
+		for (i = 0; i < tables->len; i++) {
+			TrackerAggregateView *view;
+			const gchar *table_name = g_ptr_array_index (tables, i);
+
+			view = parse_definition (table_name + strlen (AGGREGATE_TABLE_PREFIX));
+
+			if (view) {
+				g_ptr_array_add (views, view);
+			}
+		}
+	}
+
+	if (read_only) {
+		g_ptr_array_unref (tables);
+		return;
+	}
+
+	tracker_db_interface_start_transaction (iface);
+
+	/* views no longer configured or no longer matching the ontology */
+	for (i = 0; i < tables->len && !error; i++) {
+		const gchar *table_name = g_ptr_array_index (tables, i);
+
+		if (!find_view (table_name)) {
+			tracker_db_interface_execute_query (iface, &error, "DROP TABLE \"%s\"", table_name);
+		}
+	}
+
+	/* statement callbacks are not run for journal replay and the
+	 * tables may not match the data after ontology changes */
+	for (i = 0; i < views->len && !error; i++) {
+		TrackerAggregateView *view = g_ptr_array_index (views, i);
+
+		if (rebuild || !has_table (tables, view->table_name)) {
+			g_debug ("Building aggregate view '%s'", view->table_name);
+			aggregate_view_rebuild (view, iface, &error);
+		}
+	}
+
+	if (!error) {
+		tracker_db_interface_end_db_transaction (iface, &error);
+	} else {
+		tracker_db_interface_execute_query (iface, NULL, "ROLLBACK");
+	}
+
+	g_ptr_array_unref (tables);
+
+	if (error) {
+		g_warning ("Could not build aggregate views, disabling them: %s", error->message);
+		g_error_free (error);
+		g_ptr_array_set_size (views, 0);
+		return;
+	}
+
+	if (views->len > 0) {
+		tracker_data_add_insert_statement_callback (statement_cb, NULL);
+		tracker_data_add_delete_statement_callback (statement_cb, NULL);
+		callbacks_added = TRUE;
+	}
+}
+
+void
+tracker_data_aggregates_shutdown (void)
+{
+	views_free ();
+}
+
+gboolean
+tracker_data_aggregates_has_views (void)
+{
+	return views && views->len > 0;
+}
+
+/* Returns the table of the view counting instances of class per
+ * value of property, or NULL */
+const gchar *
+tracker_data_aggregates_lookup (TrackerClass    *class,
+                                TrackerProperty *property)
+{
+	guint i;
+
+	for (i = 0; views && i < views->len; i++) {
+		TrackerAggregateView *view = g_ptr_array_index (views, i);
+
+		if (view->class == class && view->property == property) {
+			return view->table_name;
+		}
+	}
+
+	return NULL;
+}
+
+/* Called before the update transaction is committed, with the update
+ * buffer flushed */
+void
+tracker_data_aggregates_update (GError **error)
+{
+	TrackerDBInterface *iface;
+	GError *internal_error = NULL;
+	guint i;
+
+	if (!callbacks_added) {
+		return;
+	}
+
+	if (pending_error) {
+		g_propagate_error (error, pending_error);
+		pending_error = NULL;
+		tracker_data_aggregates_rollback ();
+		return;
+	}
+
+	iface = tracker_db_manager_get_db_interface ();
+
+	for (i = 0; i < views->len && !internal_error; i++) {
+		TrackerAggregateView *view = g_ptr_array_index (views, i);
+		GHashTableIter iter;
+		gpointer key;
+
+		if (g_hash_table_size (view->touched) == 0) {
+			continue;
+		}
+
+		g_hash_table_iter_init (&iter, view->touched);
+		while (!internal_error && g_hash_table_iter_next (&iter, &key, NULL)) {
+			aggregate_view_add_subject (view, iface, GPOINTER_TO_INT (key), 1, &internal_error);
+		}
+
+		if (!internal_error) {
+			tracker_db_interface_execute_query (iface, &internal_error,
+			                                    "DELETE FROM \"%s\" WHERE Count <= 0",
+			                                    view->table_name);
+		}
+	}
+
+	tracker_data_aggregates_rollback ();
+
+	if (internal_error) {
+		g_propagate_error (error, internal_error);
+	}
+}
+
+/* Recomputes all views from the data, for changes made without
+ * statement callbacks (bulk loads) */
+void
+tracker_data_aggregates_rebuild (GError **error)
+{
+	TrackerDBInterface *iface;
+	GError *internal_error = NULL;
+	guint i;
+
+	if (!callbacks_added) {
+		return;
+	}
+
+	iface = tracker_db_manager_get_db_interface ();
+	tracker_db_interface_start_transaction (iface);
+
+	for (i = 0; i < views->len && !internal_error; i++) {
+		TrackerAggregateView *view = g_ptr_array_index (views, i);
+
+		g_debug ("Rebuilding aggregate view '%s'", view->table_name);
+		aggregate_view_rebuild (view, iface, &internal_error);
+	}
+
+	if (!internal_error) {
+		tracker_db_interface_end_db_transaction (iface, &internal_error);
+	} else {
+		tracker_db_interface_execute_query (iface, NULL, "ROLLBACK");
+	}
+
+	tracker_data_aggregates_rollback ();
+
+	if (internal_error) {
+		g_propagate_error (error, internal_error);
+	}
+}
+
+void
+tracker_data_aggregates_rollback (void)
+{
+	guint i;
+
+	for (i = 0; views && i < views->len; i++) {
+		TrackerAggregateView *view = g_ptr_array_index (views, i);
+
+		g_hash_table_remove_all (view->touched);
+	}
+
+	g_clear_error (&pending_error);
+}
@@ -0,0 +1,47 @@
+/*
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ * Boston, MA  02110-1301, USA.
+ */
+
+#ifndef __LIBTRACKER_DATA_AGGREGATES_H__
+#define __LIBTRACKER_DATA_AGGREGATES_H__
+
+#include <glib.h>
+
+#include "tracker-class.h"
+#include "tracker-db-interface.h"
+#include "tracker-property.h"
+
+G_BEGIN_DECLS
+
+#if !defined (__LIBTRACKER_DATA_INSIDE__) && !defined (TRACKER_COMPILATION)
+#error "only <libtracker-data/tracker-data.h> must be included directly."
+#endif
+
+void         tracker_data_aggregates_set_definitions (const gchar * const *definitions);
+void         tracker_data_aggregates_init            (TrackerDBInterface  *iface,
+                                                      gboolean             read_only,
+                                                      gboolean             rebuild);
+void         tracker_data_aggregates_shutdown        (void);
+gboolean     tracker_data_aggregates_has_views       (void);
+const gchar *tracker_data_aggregates_lookup          (TrackerClass        *class,
+                                                      TrackerProperty     *property);
+void         tracker_data_aggregates_update          (GError             **error);
+void         tracker_data_aggregates_rebuild         (GError             **error);
+void         tracker_data_aggregates_rollback        (void);
+
+G_END_DECLS
+
+#endif /* __LIBTRACKER_DATA_AGGREGATES_H__ */
@@ -37,6 +37,7 @@
 #include <libtracker-common/tracker-locale.h>
 
 #include "tracker-class.h"
+#include "tracker-data-aggregates.h"
 #include "tracker-data-manager.h"
 #include "tracker-data-update.h"
 #include "tracker-db-interface-sqlite.h"
@@ -520,6 +521,49 @@ check_range_conversion_is_allowed (const gchar  *ontology_path,
 	}
 }
 
+static void
+fix_single_value_indexed (TrackerDBInterface  *iface,
+                          TrackerProperty     *property,
+                          gboolean             recreate,
+                          GError             **error)
+{
+	GError *internal_error = NULL;
+	TrackerProperty *secondary_index;
+	TrackerClass **domain_index_classes;
+	const gchar *service_name;
+	const gchar *field_name;
+
+	field_name = tracker_property_get_name (property);
+	service_name = tracker_class_get_name (tracker_property_get_domain (property));
+
+	secondary_index = tracker_property_get_secondary_index (property);
+	if (secondary_index == NULL) {
+		set_index_for_single_value_property (iface, service_name, field_name,
+		                                     recreate && tracker_property_get_indexed (property),
+		                                     &internal_error);
+	} else {
+		set_secondary_index_for_single_value_property (iface, service_name, field_name,
+		                                               tracker_property_get_name (secondary_index),
+		                                               recreate && tracker_property_get_indexed (property),
+		                                               &internal_error);
+	}
+
+	/* single-valued properties may also have domain-specific indexes */
+	domain_index_classes = tracker_property_get_domain_indexes (property);
+	while (!internal_error && domain_index_classes && *domain_index_classes) {
+		set_index_for_single_value_property (iface,
+		                                     tracker_class_get_name (*domain_index_classes),
+		                                     field_name,
+		                                     recreate,
+		                                     &internal_error);
+		domain_index_classes++;
+	}
+
+	if (internal_error) {
+		g_propagate_error (error, internal_error);
+	}
+}
+
 static void
 fix_indexed (TrackerProperty  *property,
              gboolean          recreate,
@@ -543,31 +587,7 @@ fix_indexed (TrackerProperty  *property,
 		                                    recreate,
 		                                    &internal_error);
 	} else {
-		TrackerProperty *secondary_index;
-		TrackerClass **domain_index_classes;
-
-		secondary_index = tracker_property_get_secondary_index (property);
-		if (secondary_index == NULL) {
-			set_index_for_single_value_property (iface, service_name, field_name,
-			                                     recreate && tracker_property_get_indexed (property),
-			                                     &internal_error);
-		} else {
-			set_secondary_index_for_single_value_property (iface, service_name, field_name,
-			                                               tracker_property_get_name (secondary_index),
-			                                               recreate && tracker_property_get_indexed (property),
-			                                               &internal_error);
-		}
-
-		/* single-valued properties may also have domain-specific indexes */
-		domain_index_classes = tracker_property_get_domain_indexes (property);
-		while (!internal_error && domain_index_classes && *domain_index_classes) {
-			set_index_for_single_value_property (iface,
-			                                     tracker_class_get_name (*domain_index_classes),
-			                                     field_name,
-			                                     recreate,
-			                                     &internal_error);
-			domain_index_classes++;
-		}
+		fix_single_value_indexed (iface, property, recreate, &internal_error);
 	}
 
 	if (internal_error) {
@@ -3660,6 +3680,53 @@ ontology_get_fts_properties (gboolean     only_new,
 }
 #endif
 
+/* The indexes on single-valued properties only serve queries, loading
+ * lots of data is faster without them, creating them once afterwards.
+ * Multi-valued property tables keep their indexes, they enforce unique
+ * values. Should the indexes never get enabled again, the missing locale
+ * file makes the next start recreate them.
+ */
+void
+tracker_data_manager_set_value_indexes (gboolean   enabled,
+                                        GError   **error)
+{
+	GError *internal_error = NULL;
+	TrackerDBInterface *iface;
+	TrackerProperty **properties;
+	guint n_properties;
+	guint i;
+
+	properties = tracker_ontologies_get_properties (&n_properties);
+	if (!properties) {
+		return;
+	}
+
+	iface = tracker_db_manager_get_db_interface ();
+
+	if (!enabled) {
+		tracker_db_manager_unset_current_locale ();
+	}
+
+	g_debug ("%s indexes of single-valued properties...", enabled ? "Creating" : "Dropping");
+
+	for (i = 0; i < n_properties; i++) {
+		if (tracker_property_get_multiple_values (properties[i])) {
+			continue;
+		}
+
+		fix_single_value_indexed (iface, properties[i], enabled, &internal_error);
+
+		if (internal_error) {
+			g_propagate_error (error, internal_error);
+			return;
+		}
+	}
+
+	if (enabled) {
+		tracker_db_manager_set_current_locale ();
+	}
+}
+
 gboolean
 tracker_data_manager_init_fts (TrackerDBInterface *iface,
                                gboolean            create)
@@ -3679,18 +3746,55 @@ tracker_data_manager_init_fts (TrackerDBInterface *iface,
 #endif
 }
 
+/* Rebuilds the full-text index using the current tokenizer settings,
+ * queries keep using the old index until the new one replaces it.
+ */
 gboolean
-tracker_data_manager_init (TrackerDBManagerFlags   flags,
-                           const gchar           **test_schemas,
-                           gboolean               *first_time,
-                           gboolean                journal_check,
-                           gboolean                restoring_backup,
-                           guint                   select_cache_size,
-                           guint                   update_cache_size,
-                           TrackerBusyCallback     busy_callback,
-                           gpointer                busy_user_data,
-                           const gchar            *busy_operation,
-                           GError                **error)
+tracker_data_manager_rebuild_fts (GError **error)
+{
+#if HAVE_TRACKER_FTS
+	GHashTable *fts_props, *multivalued;
+	gboolean success;
+
+	ontology_get_fts_properties (FALSE, &fts_props, &multivalued);
+	success = tracker_db_interface_sqlite_fts_rebuild (tracker_db_manager_get_db_interface (),
+	                                                   fts_props, multivalued,
+	                                                   g_get_num_processors (),
+	                                                   error);
+	g_hash_table_unref (fts_props);
+	g_hash_table_unref (multivalued);
+
+	if (success) {
+		tracker_db_manager_set_current_fts_config ();
+	}
+
+	return success;
+#else
+	return TRUE;
+#endif
+}
+
+/* Caches kept across connections, they must not outlive the database */
+static void
+data_manager_clear_caches (void)
+{
+	tracker_data_query_resource_cache_clear ();
+	tracker_data_query_class_counts_clear ();
+	tracker_sparql_query_clear_plan_cache ();
+}
+
+static gboolean
+data_manager_init (TrackerDBManagerFlags   flags,
+                   const gchar           **test_schemas,
+                   gboolean               *first_time,
+                   gboolean                journal_check,
+                   gboolean                restoring_backup,
+                   guint                   select_cache_size,
+                   guint                   update_cache_size,
+                   TrackerBusyCallback     busy_callback,
+                   gpointer                busy_user_data,
+                   const gchar            *busy_operation,
+                   GError                **error)
 {
 	TrackerDBInterface *iface;
 	gboolean is_first_time_index, check_ontology;
@@ -3704,6 +3808,7 @@ tracker_data_manager_init (TrackerDBManagerFlags   flags,
 	GHashTable *uri_id_map = NULL;
 	gchar *busy_status;
 	GError *internal_error = NULL;
+	gboolean rebuild_aggregates = FALSE;
 #ifndef DISABLE_JOURNAL
 	gboolean read_journal;
 #endif
@@ -4420,6 +4525,8 @@ tracker_data_manager_init (TrackerDBManagerFlags   flags,
 		if (to_reload) {
 			GError *ontology_error = NULL;
 
+			rebuild_aggregates = TRUE;
+
 			tracker_data_ontology_process_changes_pre_db (seen_classes,
 			                                              seen_properties,
 			                                              &ontology_error);
@@ -4552,6 +4659,8 @@ tracker_data_manager_init (TrackerDBManagerFlags   flags,
 		                             &internal_error);
 		g_free (busy_status);
 
+		rebuild_aggregates = TRUE;
+
 		if (internal_error) {
 
 			if (g_error_matches (internal_error, TRACKER_DB_INTERFACE_ERROR, TRACKER_DB_NO_SPACE)) {
@@ -4638,12 +4747,29 @@ tracker_data_manager_init (TrackerDBManagerFlags   flags,
 		}
 
 		tracker_db_manager_set_current_locale ();
+
+		/* text values are grouped by collation */
+		rebuild_aggregates = TRUE;
 	}
 
 	if (!read_only) {
 		tracker_ontologies_sort ();
 	}
 
+	tracker_data_aggregates_init (tracker_db_manager_get_db_interface (),
+	                              read_only,
+	                              rebuild_aggregates);
+
+	/* Before any update can change them, read-only connections go
+	 * without as loading them takes long on large databases */
+	if (!read_only) {
+		tracker_data_query_load_class_counts ();
+	}
+
+	/* Queries translated while the ontology was being loaded or
+	 * changed must not outlive it */
+	tracker_sparql_query_clear_plan_cache ();
+
 	initialized = TRUE;
 
 	g_free (ontologies_dir);
@@ -4656,6 +4782,39 @@ tracker_data_manager_init (TrackerDBManagerFlags   flags,
 	return TRUE;
 }
 
+gboolean
+tracker_data_manager_init (TrackerDBManagerFlags   flags,
+                           const gchar           **test_schemas,
+                           gboolean               *first_time,
+                           gboolean                journal_check,
+                           gboolean                restoring_backup,
+                           guint                   select_cache_size,
+                           guint                   update_cache_size,
+                           TrackerBusyCallback     busy_callback,
+                           gpointer                busy_user_data,
+                           const gchar            *busy_operation,
+                           GError                **error)
+{
+	if (!data_manager_init (flags,
+	                        test_schemas,
+	                        first_time,
+	                        journal_check,
+	                        restoring_backup,
+	                        select_cache_size,
+	                        update_cache_size,
+	                        busy_callback,
+	                        busy_user_data,
+	                        busy_operation,
+	                        error)) {
+		/* Journal replay and ontology changes may have
+		 * committed before failing */
+		data_manager_clear_caches ();
+		return FALSE;
+	}
+
+	return TRUE;
+}
+
 void
 tracker_data_manager_shutdown (void)
 {
@@ -4689,7 +4848,9 @@ tracker_data_manager_shutdown (void)
 	}
 #endif
 
+	tracker_data_aggregates_shutdown ();
 	tracker_data_update_shutdown ();
+	data_manager_clear_caches ();
 
 	initialized = FALSE;
 }
@@ -65,6 +65,9 @@ gboolean tracker_data_manager_reload                 (TrackerBusyCallback     bu
 
 gboolean tracker_data_manager_init_fts               (TrackerDBInterface     *interface,
 						      gboolean                create);
+gboolean tracker_data_manager_rebuild_fts            (GError                **error);
+void     tracker_data_manager_set_value_indexes      (gboolean                enabled,
+                                                      GError                **error);
 
 G_END_DECLS
 
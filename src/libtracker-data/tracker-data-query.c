@@ -33,6 +33,215 @@
 #include "tracker-ontologies.h"
 #include "tracker-sparql-query.h"
 
+/* Number of URIs the resource cache maps to IDs */
+#define RESOURCE_CACHE_SIZE 10000
+
+typedef struct {
+	gchar *uri;
+	gint id;
+} ResourceCacheEntry;
+
+/* Process-wide cache of committed resource IDs, shared by all
+ * connections. IDs are never reused, so an entry only goes away when
+ * the cache is full and it was used least recently.
+ */
+static GMutex resource_cache_mutex;
+static GHashTable *resource_cache;
+static GQueue resource_cache_lru = G_QUEUE_INIT;
+static guint64 resource_cache_hits;
+static guint64 resource_cache_misses;
+
+static GMutex class_counts_mutex;
+static gint class_counts_loaded;
+
+static void
+resource_cache_entry_free (ResourceCacheEntry *entry)
+{
+	g_free (entry->uri);
+	g_slice_free (ResourceCacheEntry, entry);
+}
+
+static gint
+resource_cache_lookup (const gchar *uri)
+{
+	GList *link;
+	gint id = 0;
+
+	g_mutex_lock (&resource_cache_mutex);
+
+	link = resource_cache ? g_hash_table_lookup (resource_cache, uri) : NULL;
+
+	if (link) {
+		/* most recently used goes first */
+		g_queue_unlink (&resource_cache_lru, link);
+		g_queue_push_head_link (&resource_cache_lru, link);
+		id = ((ResourceCacheEntry *) link->data)->id;
+		resource_cache_hits++;
+	} else {
+		resource_cache_misses++;
+	}
+
+	g_mutex_unlock (&resource_cache_mutex);
+
+	return id;
+}
+
+/* Only for resources known to be committed, see
+ * tracker_data_commit_transaction().
+ */
+void
+tracker_data_query_resource_cache_insert (const gchar *uri,
+                                          gint         id)
+{
+	ResourceCacheEntry *entry;
+
+	g_return_if_fail (uri != NULL);
+	g_return_if_fail (id > 0);
+
+	g_mutex_lock (&resource_cache_mutex);
+
+	if (!resource_cache) {
+		resource_cache = g_hash_table_new (g_str_hash, g_str_equal);
+	}
+
+	if (!g_hash_table_contains (resource_cache, uri)) {
+		if (g_hash_table_size (resource_cache) >= RESOURCE_CACHE_SIZE) {
+			entry = g_queue_pop_tail (&resource_cache_lru);
+			g_hash_table_remove (resource_cache, entry->uri);
+			resource_cache_entry_free (entry);
+		}
+
+		entry = g_slice_new (ResourceCacheEntry);
+		entry->uri = g_strdup (uri);
+		entry->id = id;
+
+		g_queue_push_head (&resource_cache_lru, entry);
+		g_hash_table_insert (resource_cache, entry->uri, resource_cache_lru.head);
+	}
+
+	g_mutex_unlock (&resource_cache_mutex);
+}
+
+/* IDs are only stable within the same database */
+void
+tracker_data_query_resource_cache_clear (void)
+{
+	g_mutex_lock (&resource_cache_mutex);
+
+	if (resource_cache) {
+		g_hash_table_remove_all (resource_cache);
+	}
+
+	g_queue_foreach (&resource_cache_lru, (GFunc) resource_cache_entry_free, NULL);
+	g_queue_clear (&resource_cache_lru);
+
+	g_mutex_unlock (&resource_cache_mutex);
+}
+
+void
+tracker_data_query_resource_cache_get_stats (guint64 *hits,
+                                             guint64 *misses,
+                                             guint   *size)
+{
+	g_mutex_lock (&resource_cache_mutex);
+
+	if (hits) {
+		*hits = resource_cache_hits;
+	}
+
+	if (misses) {
+		*misses = resource_cache_misses;
+	}
+
+	if (size) {
+		*size = resource_cache_lru.length;
+	}
+
+	g_mutex_unlock (&resource_cache_mutex);
+}
+
+/* Instance counts are kept up to date by updates once loaded, they are
+ * used for statistics and to estimate the cost of queries. They are
+ * loaded when the database is opened for writing, as updates coming in
+ * meanwhile would be lost.
+ */
+void
+tracker_data_query_load_class_counts (void)
+{
+	TrackerDBInterface *iface;
+	TrackerClass **classes;
+	guint i, n_classes;
+
+	g_mutex_lock (&class_counts_mutex);
+
+	if (g_atomic_int_get (&class_counts_loaded)) {
+		g_mutex_unlock (&class_counts_mutex);
+		return;
+	}
+
+	iface = tracker_db_manager_get_db_interface ();
+	classes = tracker_ontologies_get_classes (&n_classes);
+
+	for (i = 0; i < n_classes; i++) {
+		TrackerDBStatement *stmt;
+		TrackerDBCursor *cursor = NULL;
+		const gchar *name;
+		GError *error = NULL;
+
+		name = tracker_class_get_name (classes[i]);
+
+		/* xsd classes do not derive from rdfs:Resource and do not use separate tables */
+		if (g_str_has_prefix (name, "xsd:")) {
+			continue;
+		}
+
+		stmt = tracker_db_interface_create_statement (iface, TRACKER_DB_STATEMENT_CACHE_TYPE_NONE, &error,
+		                                              "SELECT COUNT(1) FROM \"%s\"",
+		                                              name);
+
+		if (stmt) {
+			cursor = tracker_db_statement_start_cursor (stmt, &error);
+			g_object_unref (stmt);
+		}
+
+		if (cursor) {
+			if (tracker_db_cursor_iter_next (cursor, NULL, &error)) {
+				tracker_class_set_count (classes[i], tracker_db_cursor_get_int (cursor, 0));
+			}
+
+			g_object_unref (cursor);
+		}
+
+		if (error) {
+			g_warning ("Unable to query instance count for class %s: %s",
+			           name, error->message);
+			g_error_free (error);
+		}
+	}
+
+	g_atomic_int_set (&class_counts_loaded, TRUE);
+
+	g_mutex_unlock (&class_counts_mutex);
+}
+
+/* Whether class counts can be used, they are not available to
+ * read-only connections */
+gboolean
+tracker_data_query_class_counts_loaded (void)
+{
+	return g_atomic_int_get (&class_counts_loaded);
+}
+
+/* Counts belong to the ontology classes, they need to be loaded again
+ * after the ontology was reloaded */
+void
+tracker_data_query_class_counts_clear (void)
+{
+	g_mutex_lock (&class_counts_mutex);
+	g_atomic_int_set (&class_counts_loaded, FALSE);
+	g_mutex_unlock (&class_counts_mutex);
+}
+
 GPtrArray*
 tracker_data_query_rdf_type (gint id)
 {
@@ -101,10 +310,16 @@ tracker_data_query_resource_id (const gchar *uri)
 
 	g_return_val_if_fail (uri != NULL, 0);
 
+	id = resource_cache_lookup (uri);
+
+	if (id != 0) {
+		return id;
+	}
+
 	iface = tracker_db_manager_get_db_interface ();
 
-	stmt = tracker_db_interface_create_statement (iface, TRACKER_DB_STATEMENT_CACHE_TYPE_SELECT, &error,
-	                                              "SELECT ID FROM Resource WHERE Uri = ?");
+	stmt = tracker_db_interface_create_keyed_statement (iface, TRACKER_DB_STATEMENT_CACHE_TYPE_SELECT, NULL, &error,
+	                                                    "SELECT ID FROM Resource WHERE Uri = ?");
 
 	if (stmt) {
 		tracker_db_statement_bind_text (stmt, 0, uri);
@@ -125,6 +340,12 @@ tracker_data_query_resource_id (const gchar *uri)
 		g_error_free (error);
 	}
 
+	/* the resource might still be rolled back along with the
+	 * ongoing transaction, it gets cached once committed */
+	if (id != 0 && !tracker_db_interface_sqlite_in_transaction (iface)) {
+		tracker_data_query_resource_cache_insert (uri, id);
+	}
+
 	return id;
 }
 
@@ -147,3 +368,44 @@ tracker_data_query_sparql_cursor (const gchar  *query,
 	return cursor;
 }
 
+/* Like tracker_data_query_sparql_cursor() but the cursor provides a
+ * continuation for every row, pass one to resume after that row. */
+TrackerDBCursor *
+tracker_data_query_sparql_cursor_continue (const gchar  *query,
+                                           const gchar  *continuation,
+                                           GError      **error)
+{
+	TrackerSparqlQuery *sparql_query;
+	TrackerDBCursor *cursor;
+
+	g_return_val_if_fail (query != NULL, NULL);
+
+	sparql_query = tracker_sparql_query_new (query);
+	tracker_sparql_query_set_continuable (sparql_query, TRUE);
+	tracker_sparql_query_set_continuation (sparql_query, continuation);
+
+	cursor = tracker_sparql_query_execute_cursor (sparql_query, FALSE, error);
+
+	g_object_unref (sparql_query);
+
+	return cursor;
+}
+
+gchar *
+tracker_data_query_explain (const gchar  *query,
+                            GError      **error)
+{
+	TrackerSparqlQuery *sparql_query;
+	gchar *result;
+
+	g_return_val_if_fail (query != NULL, NULL);
+
+	sparql_query = tracker_sparql_query_new (query);
+
+	result = tracker_sparql_query_explain (sparql_query, error);
+
+	g_object_unref (sparql_query);
+
+	return result;
+}
+
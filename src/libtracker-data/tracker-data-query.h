@@ -34,8 +34,22 @@ G_BEGIN_DECLS
 #endif
 
 gint                 tracker_data_query_resource_id   (const gchar  *uri);
+void                 tracker_data_query_resource_cache_insert    (const gchar *uri,
+                                                                  gint         id);
+void                 tracker_data_query_resource_cache_clear     (void);
+void                 tracker_data_query_resource_cache_get_stats (guint64     *hits,
+                                                                  guint64     *misses,
+                                                                  guint       *size);
+void                 tracker_data_query_load_class_counts        (void);
+gboolean             tracker_data_query_class_counts_loaded      (void);
+void                 tracker_data_query_class_counts_clear       (void);
 TrackerDBCursor     *tracker_data_query_sparql_cursor (const gchar  *query,
                                                        GError      **error);
+TrackerDBCursor     *tracker_data_query_sparql_cursor_continue (const gchar  *query,
+                                                                const gchar  *continuation,
+                                                                GError      **error);
+gchar               *tracker_data_query_explain       (const gchar  *query,
+                                                       GError      **error);
 
 GPtrArray*           tracker_data_query_rdf_type      (gint          id);
 
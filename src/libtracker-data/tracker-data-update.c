@@ -29,6 +29,7 @@
 #include <libtracker-sparql/tracker-sparql.h>
 
 #include "tracker-class.h"
+#include "tracker-data-aggregates.h"
 #include "tracker-data-manager.h"
 #include "tracker-data-update.h"
 #include "tracker-data-query.h"
@@ -39,6 +40,14 @@
 #include "tracker-property.h"
 #include "tracker-sparql-query.h"
 
+/* Statements loaded per database and journal transaction, resources
+ * buffered before writing them out, and statements read ahead to group
+ * them by subject when bulk loading Turtle files.
+ */
+#define BULK_LOAD_TRANSACTION_SIZE 100000
+#define BULK_LOAD_BUFFER_SIZE      10000
+#define BULK_LOAD_GROUP_SIZE       4096
+
 typedef struct _TrackerDataUpdateBuffer TrackerDataUpdateBuffer;
 typedef struct _TrackerDataUpdateBufferResource TrackerDataUpdateBufferResource;
 typedef struct _TrackerDataUpdateBufferPredicate TrackerDataUpdateBufferPredicate;
@@ -59,9 +68,16 @@ struct _TrackerDataUpdateBuffer {
 	/* the following two fields are valid per sqlite transaction, not just for same subject */
 	/* TrackerClass -> integer */
 	GHashTable *class_counts;
+	/* TrackerClass -> integer, the part of class_counts since the
+	 * savepoint of the journal transaction being replayed */
+	GHashTable *savepoint_class_counts;
+	gboolean in_savepoint;
 
 #if HAVE_TRACKER_FTS
 	gboolean fts_ever_updated;
+	/* resource ID -> whether it was created in this transaction, the
+	 * text of these is indexed once right before the commit */
+	GHashTable *fts_pending;
 #endif
 };
 
@@ -137,6 +153,7 @@ typedef struct {
 static gboolean in_transaction = FALSE;
 static gboolean in_ontology_transaction = FALSE;
 static gboolean in_journal_replay = FALSE;
+static gboolean in_bulk_load = FALSE;
 static TrackerDataUpdateBuffer update_buffer;
 /* current resource */
 static TrackerDataUpdateBufferResource *resource_buffer;
@@ -145,6 +162,13 @@ static time_t resource_time = 0;
 static gint transaction_modseq = 0;
 static gboolean has_persistent = TRUE;
 
+#if HAVE_TRACKER_FTS
+/* full-text indexing statistics */
+static guint64 n_fts_indexed = 0;
+static guint64 n_fts_coalesced = 0;
+static gint64 fts_index_time = 0;
+#endif
+
 static GPtrArray *insert_callbacks = NULL;
 static GPtrArray *delete_callbacks = NULL;
 static GPtrArray *commit_callbacks = NULL;
@@ -641,8 +665,8 @@ ensure_resource_id (const gchar *uri,
 		iface = tracker_db_manager_get_db_interface ();
 
 		id = tracker_data_update_get_new_service_id ();
-		stmt = tracker_db_interface_create_statement (iface, TRACKER_DB_STATEMENT_CACHE_TYPE_UPDATE, &error,
-		                                              "INSERT INTO Resource (ID, Uri) VALUES (?, ?)");
+		stmt = tracker_db_interface_create_keyed_statement (iface, TRACKER_DB_STATEMENT_CACHE_TYPE_UPDATE, NULL, &error,
+		                                                    "INSERT INTO Resource (ID, Uri) VALUES (?, ?)");
 
 		if (stmt) {
 			tracker_db_statement_bind_int (stmt, 0, id);
@@ -699,21 +723,33 @@ statement_bind_gvalue (TrackerDBStatement *stmt,
 }
 
 static void
-add_class_count (TrackerClass *class,
-                 gint          count)
+class_counts_add (GHashTable   **class_counts,
+                  TrackerClass  *class,
+                  gint           count)
 {
 	gint old_count_entry;
 
+	if (!*class_counts) {
+		*class_counts = g_hash_table_new (g_direct_hash, g_direct_equal);
+	}
+
+	old_count_entry = GPOINTER_TO_INT (g_hash_table_lookup (*class_counts, class));
+	g_hash_table_insert (*class_counts, class,
+	                     GINT_TO_POINTER (old_count_entry + count));
+}
+
+static void
+add_class_count (TrackerClass *class,
+                 gint          count)
+{
 	tracker_class_set_count (class, tracker_class_get_count (class) + count);
 
 	/* update class_counts table so that the count change can be reverted in case of rollback */
-	if (!update_buffer.class_counts) {
-		update_buffer.class_counts = g_hash_table_new (g_direct_hash, g_direct_equal);
-	}
+	class_counts_add (&update_buffer.class_counts, class, count);
 
-	old_count_entry = GPOINTER_TO_INT (g_hash_table_lookup (update_buffer.class_counts, class));
-	g_hash_table_insert (update_buffer.class_counts, class,
-	                     GINT_TO_POINTER (old_count_entry + count));
+	if (update_buffer.in_savepoint) {
+		class_counts_add (&update_buffer.savepoint_class_counts, class, count);
+	}
 }
 
 static void
@@ -738,24 +774,27 @@ tracker_data_resource_buffer_flush (GError **error)
 
 				if (table->delete_value) {
 					/* delete rows for multiple value properties */
-					stmt = tracker_db_interface_create_statement (iface, TRACKER_DB_STATEMENT_CACHE_TYPE_UPDATE, &actual_error,
-					                                              "DELETE FROM \"%s\" WHERE ID = ? AND \"%s\" = ?",
-					                                              table_name,
-					                                              property->name);
+					stmt = tracker_db_interface_create_keyed_statement (iface, TRACKER_DB_STATEMENT_CACHE_TYPE_UPDATE,
+					                                                    property->name, &actual_error,
+					                                                    "DELETE FROM \"%s\" WHERE ID = ? AND \"%s\" = ?",
+					                                                    table_name,
+					                                                    property->name);
 				} else if (property->date_time) {
-					stmt = tracker_db_interface_create_statement (iface, TRACKER_DB_STATEMENT_CACHE_TYPE_UPDATE, &actual_error,
-					                                              "INSERT OR IGNORE INTO \"%s\" (ID, \"%s\", \"%s:localDate\", \"%s:localTime\", \"%s:graph\") VALUES (?, ?, ?, ?, ?)",
-					                                              table_name,
-					                                              property->name,
-					                                              property->name,
-					                                              property->name,
-					                                              property->name);
+					stmt = tracker_db_interface_create_keyed_statement (iface, TRACKER_DB_STATEMENT_CACHE_TYPE_UPDATE,
+					                                                    property->name, &actual_error,
+					                                                    "INSERT OR IGNORE INTO \"%s\" (ID, \"%s\", \"%s:localDate\", \"%s:localTime\", \"%s:graph\") VALUES (?, ?, ?, ?, ?)",
+					                                                    table_name,
+					                                                    property->name,
+					                                                    property->name,
+					                                                    property->name,
+					                                                    property->name);
 				} else {
-					stmt = tracker_db_interface_create_statement (iface, TRACKER_DB_STATEMENT_CACHE_TYPE_UPDATE, &actual_error,
-					                                              "INSERT OR IGNORE INTO \"%s\" (ID, \"%s\", \"%s:graph\") VALUES (?, ?, ?)",
-					                                              table_name,
-					                                              property->name,
-					                                              property->name);
+					stmt = tracker_db_interface_create_keyed_statement (iface, TRACKER_DB_STATEMENT_CACHE_TYPE_UPDATE,
+					                                                    property->name, &actual_error,
+					                                                    "INSERT OR IGNORE INTO \"%s\" (ID, \"%s\", \"%s:graph\") VALUES (?, ?, ?)",
+					                                                    table_name,
+					                                                    property->name,
+					                                                    property->name);
 				}
 
 				if (actual_error) {
@@ -787,8 +826,8 @@ tracker_data_resource_buffer_flush (GError **error)
 
 			if (table->delete_row) {
 				/* remove entry from rdf:type table */
-				stmt = tracker_db_interface_create_statement (iface, TRACKER_DB_STATEMENT_CACHE_TYPE_UPDATE, &actual_error,
-				                                              "DELETE FROM \"rdfs:Resource_rdf:type\" WHERE ID = ? AND \"rdf:type\" = ?");
+				stmt = tracker_db_interface_create_keyed_statement (iface, TRACKER_DB_STATEMENT_CACHE_TYPE_UPDATE, NULL, &actual_error,
+				                                                    "DELETE FROM \"rdfs:Resource_rdf:type\" WHERE ID = ? AND \"rdf:type\" = ?");
 
 				if (stmt) {
 					tracker_db_statement_bind_int (stmt, 0, resource_buffer->id);
@@ -807,8 +846,9 @@ tracker_data_resource_buffer_flush (GError **error)
 				}
 
 				/* remove row from class table */
-				stmt = tracker_db_interface_create_statement (iface, TRACKER_DB_STATEMENT_CACHE_TYPE_UPDATE, &actual_error,
-				                                              "DELETE FROM \"%s\" WHERE ID = ?", table_name);
+				stmt = tracker_db_interface_create_keyed_statement (iface, TRACKER_DB_STATEMENT_CACHE_TYPE_UPDATE,
+				                                                    table->class, &actual_error,
+				                                                    "DELETE FROM \"%s\" WHERE ID = ?", table_name);
 
 				if (stmt) {
 					tracker_db_statement_bind_int (stmt, 0, resource_buffer->id);
@@ -947,46 +987,14 @@ tracker_data_resource_buffer_flush (GError **error)
 
 #if HAVE_TRACKER_FTS
 	if (resource_buffer->fts_updated) {
-		TrackerProperty *prop;
-		GArray *values;
-		gboolean create = resource_buffer->create;
-		GPtrArray *properties, *text;
-
-		properties = text = NULL;
-		g_hash_table_iter_init (&iter, resource_buffer->predicates);
-		while (g_hash_table_iter_next (&iter, (gpointer*) &prop, (gpointer*) &values)) {
-			if (tracker_property_get_fulltext_indexed (prop)) {
-				GString *fts;
-
-				fts = g_string_new ("");
-				for (i = 0; i < values->len; i++) {
-					GValue *v = &g_array_index (values, GValue, i);
-					g_string_append (fts, g_value_get_string (v));
-					g_string_append_c (fts, ' ');
-				}
-
-				if (!properties && !text) {
-					properties = g_ptr_array_new ();
-					text = g_ptr_array_new_with_free_func ((GDestroyNotify) g_free);
-				}
-
-				g_ptr_array_add (properties, (gpointer) tracker_property_get_name (prop));
-				g_ptr_array_add (text, g_string_free (fts, FALSE));
-			}
-		}
-
-		if (properties && text) {
-			g_ptr_array_add (properties, NULL);
-			g_ptr_array_add (text, NULL);
-
-			tracker_db_interface_sqlite_fts_update_text (iface,
-			                                             resource_buffer->id,
-			                                             (const gchar **) properties->pdata,
-			                                             (const gchar **) text->pdata,
-			                                             create);
-			update_buffer.fts_ever_updated = TRUE;
-			g_ptr_array_free (properties, TRUE);
-			g_ptr_array_free (text, TRUE);
+		/* indexed once per transaction, see fts_index_pending() */
+		if (g_hash_table_contains (update_buffer.fts_pending,
+		                           GINT_TO_POINTER (resource_buffer->id))) {
+			n_fts_coalesced++;
+		} else {
+			g_hash_table_insert (update_buffer.fts_pending,
+			                     GINT_TO_POINTER (resource_buffer->id),
+			                     GINT_TO_POINTER (resource_buffer->create));
 		}
 	}
 #endif
@@ -1039,15 +1047,17 @@ tracker_data_update_buffer_flush (GError **error)
 void
 tracker_data_update_buffer_might_flush (GError **error)
 {
-	/* avoid high memory usage by update buffer */
+	/* avoid high memory usage by update buffer, bulk loads trade
+	 * some for writing tables in larger batches */
 	if (g_hash_table_size (update_buffer.resources) +
-	    g_hash_table_size (update_buffer.resources_by_id) >= 1000) {
+	    g_hash_table_size (update_buffer.resources_by_id) >= (in_bulk_load ? BULK_LOAD_BUFFER_SIZE : 1000)) {
 		tracker_data_update_buffer_flush (error);
 	}
 }
 
+/* Drops the buffered changes, but not the class count changes */
 static void
-tracker_data_update_buffer_clear (void)
+update_buffer_clear_resources (void)
 {
 	g_hash_table_remove_all (update_buffer.resources);
 	g_hash_table_remove_all (update_buffer.resources_by_id);
@@ -1056,7 +1066,22 @@ tracker_data_update_buffer_clear (void)
 
 #if HAVE_TRACKER_FTS
 	update_buffer.fts_ever_updated = FALSE;
+
+	if (update_buffer.fts_pending) {
+		g_hash_table_remove_all (update_buffer.fts_pending);
+	}
 #endif
+}
+
+static void
+tracker_data_update_buffer_clear (void)
+{
+	update_buffer_clear_resources ();
+
+	update_buffer.in_savepoint = FALSE;
+	if (update_buffer.savepoint_class_counts) {
+		g_hash_table_remove_all (update_buffer.savepoint_class_counts);
+	}
 
 	if (update_buffer.class_counts) {
 		/* revert class count changes */
@@ -1380,9 +1405,10 @@ get_property_values (TrackerProperty *property)
 
 		iface = tracker_db_manager_get_db_interface ();
 
-		stmt = tracker_db_interface_create_statement (iface, TRACKER_DB_STATEMENT_CACHE_TYPE_SELECT, &error,
-		                                              "SELECT \"%s\" FROM \"%s\" WHERE ID = ?",
-		                                              field_name, table_name);
+		stmt = tracker_db_interface_create_keyed_statement (iface, TRACKER_DB_STATEMENT_CACHE_TYPE_SELECT,
+		                                                    property, &error,
+		                                                    "SELECT \"%s\" FROM \"%s\" WHERE ID = ?",
+		                                                    field_name, table_name);
 
 		if (stmt) {
 			tracker_db_statement_bind_int (stmt, 0, resource_buffer->id);
@@ -1450,7 +1476,13 @@ get_old_property_values (TrackerProperty  *property,
 
 			iface = tracker_db_manager_get_db_interface ();
 
-			if (!resource_buffer->fts_updated && !resource_buffer->create) {
+			if (!resource_buffer->fts_updated && !resource_buffer->create &&
+			    g_hash_table_contains (update_buffer.fts_pending,
+			                           GINT_TO_POINTER (resource_buffer->id))) {
+				/* still waiting to be indexed, the old text never
+				 * made it into the index or got removed already */
+				old_values = get_property_values (property);
+			} else if (!resource_buffer->fts_updated && !resource_buffer->create) {
 				guint i, n_props;
 				TrackerProperty   **properties, *prop;
 
@@ -2033,9 +2065,11 @@ db_delete_row (TrackerDBInterface *iface,
 	TrackerDBStatement *stmt;
 	GError *error = NULL;
 
-	stmt = tracker_db_interface_create_statement (iface, TRACKER_DB_STATEMENT_CACHE_TYPE_UPDATE, &error,
-	                                              "DELETE FROM \"%s\" WHERE ID = ?",
-	                                              table_name);
+	/* table names are owned by the ontology, the pointer is a valid key */
+	stmt = tracker_db_interface_create_keyed_statement (iface, TRACKER_DB_STATEMENT_CACHE_TYPE_UPDATE,
+	                                                    table_name, &error,
+	                                                    "DELETE FROM \"%s\" WHERE ID = ?",
+	                                                    table_name);
 
 	if (stmt) {
 		tracker_db_statement_bind_int (stmt, 0, id);
@@ -2135,8 +2169,10 @@ cache_delete_resource_type_full (TrackerClass *class,
 	}
 
 	/* bypass buffer if possible
-	   we need old property values with FTS */
-	direct_delete = (!HAVE_TRACKER_FTS && g_hash_table_size (resource_buffer->tables) == 0);
+	   we need old property values with FTS, aggregate views
+	   need them until the delete callbacks ran */
+	direct_delete = (!HAVE_TRACKER_FTS && g_hash_table_size (resource_buffer->tables) == 0 &&
+	                 !tracker_data_aggregates_has_views ());
 
 	/* delete all property values */
 
@@ -2216,8 +2252,8 @@ cache_delete_resource_type_full (TrackerClass *class,
 			/* delete row from rdfs:Resource_rdf:type table */
 			/* this is not necessary when deleting the whole resource
 			   as all property values are deleted implicitly */
-			stmt = tracker_db_interface_create_statement (iface, TRACKER_DB_STATEMENT_CACHE_TYPE_UPDATE, &error,
-						                      "DELETE FROM \"rdfs:Resource_rdf:type\" WHERE ID = ? AND \"rdf:type\" = ?");
+			stmt = tracker_db_interface_create_keyed_statement (iface, TRACKER_DB_STATEMENT_CACHE_TYPE_UPDATE, NULL, &error,
+			                                                    "DELETE FROM \"rdfs:Resource_rdf:type\" WHERE ID = ? AND \"rdf:type\" = ?");
 
 			if (stmt) {
 				tracker_db_statement_bind_int (stmt, 0, resource_buffer->id);
@@ -2731,7 +2767,7 @@ tracker_data_insert_statement_with_uri (const gchar            *graph,
 			final_prop_id = (prop_id != 0) ? prop_id : tracker_data_query_resource_id (predicate);
 			object_id = query_resource_id (object);
 
-			if (insert_callbacks) {
+			if (insert_callbacks && !in_bulk_load) {
 				guint n;
 				for (n = 0; n < insert_callbacks->len; n++) {
 					TrackerStatementDelegate *delegate;
@@ -2813,7 +2849,7 @@ tracker_data_insert_statement_with_string (const gchar            *graph,
 		return;
 	}
 
-	if (insert_callbacks && change) {
+	if (insert_callbacks && change && !in_bulk_load) {
 		guint n;
 
 		graph_id = (graph != NULL ? query_resource_id (graph) : 0);
@@ -3259,6 +3295,114 @@ tracker_data_update_statement (const gchar            *graph,
 	}
 }
 
+#if HAVE_TRACKER_FTS
+static gint
+fts_pending_compare (gconstpointer a,
+                     gconstpointer b)
+{
+	gint id_a = GPOINTER_TO_INT (*(gpointer *) a);
+	gint id_b = GPOINTER_TO_INT (*(gpointer *) b);
+
+	return (id_a > id_b) - (id_a < id_b);
+}
+
+/* The text is read back from the tables, so each resource is tokenized
+ * and written to the index once per transaction, no matter how often it
+ * was modified. Going through them in ID order keeps the reads local.
+ */
+static void
+fts_index_pending (void)
+{
+	TrackerDBInterface *iface;
+	GPtrArray *ids;
+	GHashTableIter iter;
+	gpointer id, create;
+	gint64 start;
+	guint i;
+
+	if (g_hash_table_size (update_buffer.fts_pending) == 0) {
+		return;
+	}
+
+	start = g_get_monotonic_time ();
+	iface = tracker_db_manager_get_db_interface ();
+
+	ids = g_ptr_array_sized_new (g_hash_table_size (update_buffer.fts_pending));
+	g_hash_table_iter_init (&iter, update_buffer.fts_pending);
+	while (g_hash_table_iter_next (&iter, &id, NULL)) {
+		g_ptr_array_add (ids, id);
+	}
+
+	g_ptr_array_sort (ids, fts_pending_compare);
+
+	for (i = 0; i < ids->len; i++) {
+		id = g_ptr_array_index (ids, i);
+		create = g_hash_table_lookup (update_buffer.fts_pending, id);
+
+		tracker_db_interface_sqlite_fts_update_text (iface,
+		                                             GPOINTER_TO_INT (id),
+		                                             NULL, NULL,
+		                                             GPOINTER_TO_INT (create));
+	}
+
+	update_buffer.fts_ever_updated = TRUE;
+	n_fts_indexed += ids->len;
+	fts_index_time += g_get_monotonic_time () - start;
+
+	g_ptr_array_free (ids, TRUE);
+	g_hash_table_remove_all (update_buffer.fts_pending);
+}
+#endif
+
+void
+tracker_data_get_fts_stats (guint64 *indexed,
+                            guint64 *coalesced,
+                            gint64  *index_time)
+{
+#if HAVE_TRACKER_FTS
+	if (indexed) {
+		*indexed = n_fts_indexed;
+	}
+
+	if (coalesced) {
+		*coalesced = n_fts_coalesced;
+	}
+
+	if (index_time) {
+		*index_time = fts_index_time;
+	}
+#else
+	if (indexed) {
+		*indexed = 0;
+	}
+
+	if (coalesced) {
+		*coalesced = 0;
+	}
+
+	if (index_time) {
+		*index_time = 0;
+	}
+#endif
+}
+
+/* Runs one step of incremental segment merging, n_pages is roughly the
+ * amount of work done. Returns FALSE once there is nothing left to merge.
+ */
+gboolean
+tracker_data_fts_merge (gint     n_pages,
+                        GError **error)
+{
+	g_return_val_if_fail (!in_transaction, FALSE);
+
+#if HAVE_TRACKER_FTS
+	return tracker_db_interface_sqlite_fts_merge (tracker_db_manager_get_db_interface (),
+	                                              n_pages, error);
+#else
+	return FALSE;
+#endif
+}
+
 void
 tracker_data_begin_transaction (GError **error)
 {
@@ -3282,6 +3426,9 @@ tracker_data_begin_transaction (GError **error)
 		update_buffer.resources = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, (GDestroyNotify) resource_buffer_free);
 		/* used for journal replay */
 		update_buffer.resources_by_id = g_hash_table_new_full (g_direct_hash, g_direct_equal, NULL, (GDestroyNotify) resource_buffer_free);
+#if HAVE_TRACKER_FTS
+		update_buffer.fts_pending = g_hash_table_new (NULL, NULL);
+#endif
 	}
 
 	resource_buffer = NULL;
@@ -3339,6 +3486,8 @@ tracker_data_commit_transaction (GError **error)
 {
 	TrackerDBInterface *iface;
 	GError *actual_error = NULL;
+	GHashTableIter iter;
+	gpointer key, value;
 
 	g_return_if_fail (in_transaction);
 
@@ -3351,6 +3500,17 @@ tracker_data_commit_transaction (GError **error)
 		return;
 	}
 
+#if HAVE_TRACKER_FTS
+	fts_index_pending ();
+#endif
+
+	tracker_data_aggregates_update (&actual_error);
+	if (actual_error) {
+		tracker_data_rollback_transaction ();
+		g_propagate_error (error, actual_error);
+		return;
+	}
+
 	tracker_db_interface_end_db_transaction (iface,
 	                                         &actual_error);
 
@@ -3404,6 +3564,13 @@ tracker_data_commit_transaction (GError **error)
 
 	g_hash_table_remove_all (update_buffer.resources);
 	g_hash_table_remove_all (update_buffer.resources_by_id);
+
+	/* committed now, share them with other connections */
+	g_hash_table_iter_init (&iter, update_buffer.resource_cache);
+	while (g_hash_table_iter_next (&iter, &key, &value)) {
+		tracker_data_query_resource_cache_insert (key, GPOINTER_TO_INT (value));
+	}
+
 	g_hash_table_remove_all (update_buffer.resource_cache);
 
 	in_journal_replay = FALSE;
@@ -3436,6 +3603,7 @@ tracker_data_rollback_transaction (void)
 	iface = tracker_db_manager_get_db_interface ();
 
 	tracker_data_update_buffer_clear ();
+	tracker_data_aggregates_rollback ();
 
 	tracker_db_interface_execute_query (iface, &ignorable, "ROLLBACK");
 
@@ -3535,280 +3703,747 @@ tracker_data_load_turtle_file (GFile   *file,
 	g_free (path);
 }
 
-void
-tracker_data_sync (void)
+typedef struct {
+	gchar *graph;
+	gchar *subject;
+	gchar *predicate;
+	gchar *object;
+	gboolean object_is_uri;
+	guint index;
+} BulkStatement;
+
+static void
+bulk_statement_clear (BulkStatement *statement)
 {
-#ifndef DISABLE_JOURNAL
-	tracker_db_journal_fsync ();
-#endif
+	g_free (statement->graph);
+	g_free (statement->subject);
+	g_free (statement->predicate);
+	g_free (statement->object);
 }
 
-#ifndef DISABLE_JOURNAL
-
-void
-tracker_data_replay_journal (TrackerBusyCallback   busy_callback,
-                             gpointer              busy_user_data,
-                             const gchar          *busy_status,
-                             GError              **error)
+static gint
+bulk_statement_compare (gconstpointer a,
+                        gconstpointer b)
 {
-	GError *journal_error = NULL;
-	TrackerProperty *rdf_type = NULL;
-	gint last_operation_type = 0;
-	const gchar *uri;
-	GError *n_error = NULL;
+	const BulkStatement *sa = a, *sb = b;
+	gboolean type_a, type_b;
+	gint result;
 
+	result = strcmp (sa->subject, sb->subject);
+	if (result != 0) {
+		return result;
+	}
 
-	rdf_type = tracker_ontologies_get_rdf_type ();
+	/* types first, properties are checked against them */
+	type_a = strcmp (sa->predicate, TRACKER_PREFIX_RDF "type") == 0;
+	type_b = strcmp (sb->predicate, TRACKER_PREFIX_RDF "type") == 0;
+	if (type_a != type_b) {
+		return type_a ? -1 : 1;
+	}
 
-	tracker_db_journal_reader_init (NULL, &n_error);
-	if (n_error) {
-		/* This is fatal (doesn't happen when file doesn't exist, does happen
-		 * when for some other reason the reader can't be created) */
-		g_propagate_error (error, n_error);
-		return;
+	return (sa->index > sb->index) - (sa->index < sb->index);
+}
+
+static void
+bulk_load_insert (BulkStatement  *statement,
+                  GError        **error)
+{
+	if (statement->object_is_uri) {
+		tracker_data_insert_statement_with_uri (statement->graph, statement->subject,
+		                                        statement->predicate, statement->object,
+		                                        error);
+	} else {
+		tracker_data_insert_statement_with_string (statement->graph, statement->subject,
+		                                           statement->predicate, statement->object,
+		                                           error);
 	}
+}
 
-	while (tracker_db_journal_reader_next (&journal_error)) {
-		TrackerDBJournalEntryType type;
-		const gchar *object;
-		gint graph_id, subject_id, predicate_id, object_id;
+static void
+bulk_load_insert_group (GArray  *group,
+                        GError **error)
+{
+	GError *actual_error = NULL;
+	guint i;
 
-		type = tracker_db_journal_reader_get_type ();
-		if (type == TRACKER_DB_JOURNAL_RESOURCE) {
-			GError *new_error = NULL;
-			TrackerDBInterface *iface;
-			TrackerDBStatement *stmt;
-			gint id;
+	/* one resource buffer switch per subject */
+	g_array_sort (group, bulk_statement_compare);
 
-			tracker_db_journal_reader_get_resource (&id, &uri);
+	for (i = 0; i < group->len && !actual_error; i++) {
+		bulk_load_insert (&g_array_index (group, BulkStatement, i), &actual_error);
+	}
 
-			iface = tracker_db_manager_get_db_interface ();
+	g_array_set_size (group, 0);
 
-			stmt = tracker_db_interface_create_statement (iface, TRACKER_DB_STATEMENT_CACHE_TYPE_UPDATE, &new_error,
-			                                              "INSERT INTO Resource (ID, Uri) VALUES (?, ?)");
+	if (!actual_error) {
+		tracker_data_update_buffer_might_flush (&actual_error);
+	}
 
-			if (stmt) {
-				tracker_db_statement_bind_int (stmt, 0, id);
-				tracker_db_statement_bind_text (stmt, 1, uri);
-				tracker_db_statement_execute (stmt, &new_error);
-				g_object_unref (stmt);
-			}
+	if (actual_error) {
+		g_propagate_error (error, actual_error);
+	}
+}
 
-			if (new_error) {
-				g_warning ("Journal replay error: '%s'", new_error->message);
-				g_error_free (new_error);
-			}
 
-		} else if (type == TRACKER_DB_JOURNAL_START_TRANSACTION) {
-			tracker_data_begin_transaction_for_replay (tracker_db_journal_reader_get_time (), NULL);
-		} else if (type == TRACKER_DB_JOURNAL_END_TRANSACTION) {
-			GError *new_error = NULL;
-			tracker_data_update_buffer_might_flush (&new_error);
+static void
+bulk_load_commit_transaction (GError **error)
+{
+	GError *actual_error = NULL;
 
-			tracker_data_commit_transaction (&new_error);
-			if (new_error) {
-				/* Out of disk is an unrecoverable fatal error */
-				if (g_error_matches (new_error, TRACKER_DB_INTERFACE_ERROR, TRACKER_DB_NO_SPACE)) {
-					g_propagate_error (error, new_error);
-					return;
-				} else {
-					g_warning ("Journal replay error: '%s'", new_error->message);
-					g_clear_error (&new_error);
-				}
-			}
-		} else if (type == TRACKER_DB_JOURNAL_INSERT_STATEMENT ||
-		           type == TRACKER_DB_JOURNAL_UPDATE_STATEMENT) {
-			GError *new_error = NULL;
-			TrackerProperty *property = NULL;
+	tracker_data_update_buffer_flush (&actual_error);
+	if (actual_error) {
+		tracker_data_rollback_transaction ();
+		g_propagate_error (error, actual_error);
+		return;
+	}
 
-			tracker_db_journal_reader_get_statement (&graph_id, &subject_id, &predicate_id, &object);
+	tracker_data_commit_transaction (error);
+}
 
-			if (last_operation_type == -1) {
-				tracker_data_update_buffer_flush (&new_error);
-				if (new_error) {
-					g_warning ("Journal replay error: '%s'", new_error->message);
-					g_clear_error (&new_error);
-				}
-			}
-			last_operation_type = 1;
+/* Like tracker_data_load_turtle_file(), for files too big to load in a
+ * single transaction. Statements are grouped by subject and committed in
+ * batches, each of them a consistent journal transaction. Statement
+ * callbacks are not called, full-text indexing is done at the end of each
+ * batch, and the indexes of single-valued properties and the aggregate
+ * views are only rebuilt once everything is loaded. If loading fails, the
+ * batches committed so far stay in the database.
+ */
+void
+tracker_data_load_turtle_file_bulk (GFile                *file,
+                                    TrackerBusyCallback   busy_callback,
+                                    gpointer              busy_user_data,
+                                    const gchar          *busy_status,
+                                    GError              **error)
+{
+	TrackerTurtleReader *reader;
+	GArray *group;
+	GError *actual_error = NULL;
+	GError *index_error = NULL;
+	GError *aggregates_error = NULL;
+	guint n_statements = 0;
+	gchar *path;
 
-			uri = tracker_ontologies_get_uri_by_id (predicate_id);
-			if (uri) {
-				property = tracker_ontologies_get_property_by_uri (uri);
-			}
+	g_return_if_fail (G_IS_FILE (file) && g_file_is_native (file));
+	g_return_if_fail (!in_transaction);
 
-			if (property) {
-				resource_buffer_switch (NULL, graph_id, NULL, subject_id);
+	path = g_file_get_path (file);
+	reader = tracker_turtle_reader_new (path, &actual_error);
+	g_free (path);
 
-				if (type == TRACKER_DB_JOURNAL_UPDATE_STATEMENT) {
-					cache_update_metadata_decomposed (property, object, 0, NULL, graph_id, &new_error);
-				} else {
-					cache_insert_metadata_decomposed (property, object, 0, NULL, graph_id, &new_error);
-				}
-				if (new_error) {
-					g_warning ("Journal replay error: '%s'", new_error->message);
-					g_clear_error (&new_error);
-				}
+	if (actual_error) {
+		g_propagate_error (error, actual_error);
+		return;
+	}
 
-			} else {
-				g_warning ("Journal replay error: 'property with ID %d doesn't exist'", predicate_id);
-			}
+	tracker_data_manager_set_value_indexes (FALSE, &actual_error);
 
-		} else if (type == TRACKER_DB_JOURNAL_INSERT_STATEMENT_ID ||
-		           type == TRACKER_DB_JOURNAL_UPDATE_STATEMENT_ID) {
-			GError *new_error = NULL;
-			TrackerClass *class = NULL;
-			TrackerProperty *property = NULL;
+	if (actual_error) {
+		g_object_unref (reader);
+		g_propagate_error (error, actual_error);
+		return;
+	}
 
-			tracker_db_journal_reader_get_statement_id (&graph_id, &subject_id, &predicate_id, &object_id);
+	group = g_array_sized_new (FALSE, FALSE, sizeof (BulkStatement), BULK_LOAD_GROUP_SIZE);
+	g_array_set_clear_func (group, (GDestroyNotify) bulk_statement_clear);
 
-			if (last_operation_type == -1) {
-				tracker_data_update_buffer_flush (&new_error);
-				if (new_error) {
-					g_warning ("Journal replay error: '%s'", new_error->message);
-					g_clear_error (&new_error);
-				}
-			}
-			last_operation_type = 1;
+	in_bulk_load = TRUE;
 
-			uri = tracker_ontologies_get_uri_by_id (predicate_id);
-			if (uri) {
-				property = tracker_ontologies_get_property_by_uri (uri);
-			}
+	tracker_data_begin_transaction (&actual_error);
 
-			if (property) {
-				if (tracker_property_get_data_type (property) != TRACKER_PROPERTY_TYPE_RESOURCE) {
-					g_warning ("Journal replay error: 'property with ID %d does not account URIs'", predicate_id);
-				} else {
-					resource_buffer_switch (NULL, graph_id, NULL, subject_id);
+	while (!actual_error && tracker_turtle_reader_next (reader, &actual_error)) {
+		BulkStatement statement;
 
-					if (property == rdf_type) {
-						uri = tracker_ontologies_get_uri_by_id (object_id);
-						if (uri) {
-							class = tracker_ontologies_get_class_by_uri (uri);
-						}
-						if (class) {
-							cache_create_service_decomposed (class, NULL, graph_id);
-						} else {
-							g_warning ("Journal replay error: 'class with ID %d not found in the ontology'", object_id);
-						}
-					} else {
-						GError *new_error = NULL;
+		statement.graph = g_strdup (tracker_turtle_reader_get_graph (reader));
+		statement.subject = g_strdup (tracker_turtle_reader_get_subject (reader));
+		statement.predicate = g_strdup (tracker_turtle_reader_get_predicate (reader));
+		statement.object = g_strdup (tracker_turtle_reader_get_object (reader));
+		statement.object_is_uri = tracker_turtle_reader_get_object_is_uri (reader);
+		statement.index = group->len;
 
-						/* add value to metadata database */
-						if (type == TRACKER_DB_JOURNAL_UPDATE_STATEMENT_ID) {
-							cache_update_metadata_decomposed (property, NULL, object_id, NULL, graph_id, &new_error);
-						} else {
-							cache_insert_metadata_decomposed (property, NULL, object_id, NULL, graph_id, &new_error);
-						}
+		if (g_str_has_prefix (statement.subject, ":") ||
+		    g_str_has_prefix (statement.object, ":")) {
+			/* anonymous blank nodes depend on statement order */
+			bulk_load_insert_group (group, &actual_error);
 
-						if (new_error) {
-							g_warning ("Journal replay error: '%s'", new_error->message);
-							g_error_free (new_error);
-						}
-					}
-				}
-			} else {
-				g_warning ("Journal replay error: 'property with ID %d doesn't exist'", predicate_id);
+			if (!actual_error) {
+				bulk_load_insert (&statement, &actual_error);
 			}
 
-		} else if (type == TRACKER_DB_JOURNAL_DELETE_STATEMENT) {
-			GError *new_error = NULL;
-			TrackerProperty *property = NULL;
+			bulk_statement_clear (&statement);
+		} else {
+			g_array_append_val (group, statement);
+
+			if (group->len >= BULK_LOAD_GROUP_SIZE) {
+				bulk_load_insert_group (group, &actual_error);
+			}
+		}
 
-			tracker_db_journal_reader_get_statement (&graph_id, &subject_id, &predicate_id, &object);
+		n_statements++;
 
-			if (last_operation_type == 1) {
-				tracker_data_update_buffer_flush (&new_error);
-				if (new_error) {
-					g_warning ("Journal replay error: '%s'", new_error->message);
-					g_clear_error (&new_error);
-				}
+		/* don't commit halfway through a blank node */
+		if (!actual_error &&
+		    n_statements >= BULK_LOAD_TRANSACTION_SIZE &&
+		    blank_buffer.subject == NULL) {
+			bulk_load_insert_group (group, &actual_error);
+
+			if (!actual_error) {
+				bulk_load_commit_transaction (&actual_error);
 			}
-			last_operation_type = -1;
 
-			resource_buffer_switch (NULL, graph_id, NULL, subject_id);
+			if (!actual_error) {
+				tracker_data_begin_transaction (&actual_error);
+			}
 
-			uri = tracker_ontologies_get_uri_by_id (predicate_id);
-			if (uri) {
-				property = tracker_ontologies_get_property_by_uri (uri);
+			if (busy_callback) {
+				busy_callback (busy_status,
+				               tracker_turtle_reader_get_progress (reader),
+				               busy_user_data);
 			}
 
-			if (property) {
-				GError *new_error = NULL;
+			n_statements = 0;
+		}
+	}
 
-				if (object && rdf_type == property) {
-					TrackerClass *class = NULL;
+	if (!actual_error) {
+		bulk_load_insert_group (group, &actual_error);
+	}
 
-					uri = tracker_ontologies_get_uri_by_id (object_id);
-					if (uri) {
-						class = tracker_ontologies_get_class_by_uri (uri);
-					}
-					if (class != NULL) {
-						cache_delete_resource_type (class, NULL, graph_id);
-					} else {
-						g_warning ("Journal replay error: 'class with '%s' not found in the ontology'", object);
-					}
-				} else {
-					delete_metadata_decomposed (property, object, 0, &new_error);
-				}
+	if (!actual_error) {
+		bulk_load_commit_transaction (&actual_error);
+	} else if (in_transaction) {
+		tracker_data_rollback_transaction ();
+	}
 
-				if (new_error) {
-					g_warning ("Journal replay error: '%s'", new_error->message);
-					g_error_free (new_error);
-				}
+	in_bulk_load = FALSE;
 
-			} else {
-				g_warning ("Journal replay error: 'property with ID %d doesn't exist'", predicate_id);
+	g_array_unref (group);
+	g_object_unref (reader);
+
+	/* whatever made it into the database needs them */
+	tracker_data_manager_set_value_indexes (TRUE, &index_error);
+
+	if (index_error) {
+		g_critical ("Could not create indexes after bulk load: %s", index_error->message);
+		g_error_free (index_error);
+	}
+
+	/* statement callbacks didn't keep the counts up to date */
+	tracker_data_aggregates_rebuild (&aggregates_error);
+
+	if (aggregates_error) {
+		g_critical ("Could not rebuild aggregate views after bulk load: %s", aggregates_error->message);
+		g_error_free (aggregates_error);
+	}
+
+	if (busy_callback) {
+		busy_callback ("Idle", 1, busy_user_data);
+	}
+
+	if (actual_error) {
+		g_propagate_error (error, actual_error);
+	}
+}
+
+void
+tracker_data_sync (void)
+{
+#ifndef DISABLE_JOURNAL
+	tracker_db_journal_fsync ();
+#endif
+}
+
+#ifndef DISABLE_JOURNAL
+
+/* Number of journal transactions replayed within one database
+ * transaction, committing each of them separately dominates replay
+ * time otherwise.
+ */
+#define REPLAY_GROUP_SIZE 256
+
+/* A journal entry kept until the database transaction of its group is
+ * committed, see replay_commit_group()
+ */
+typedef struct {
+	TrackerDBJournalEntryType type;
+	gint64 time;
+	gint graph_id;
+	gint subject_id;
+	gint predicate_id;
+	gint object_id;
+	gchar *object;
+} ReplayEntry;
+
+static void
+replay_entry_clear (ReplayEntry *entry)
+{
+	g_free (entry->object);
+}
+
+static void
+replay_entry_read (ReplayEntry *entry)
+{
+	const gchar *str = NULL;
+
+	memset (entry, 0, sizeof (ReplayEntry));
+	entry->type = tracker_db_journal_reader_get_type ();
+
+	switch (entry->type) {
+	case TRACKER_DB_JOURNAL_RESOURCE:
+		tracker_db_journal_reader_get_resource (&entry->subject_id, &str);
+		break;
+	case TRACKER_DB_JOURNAL_START_TRANSACTION:
+		entry->time = tracker_db_journal_reader_get_time ();
+		break;
+	case TRACKER_DB_JOURNAL_INSERT_STATEMENT:
+	case TRACKER_DB_JOURNAL_UPDATE_STATEMENT:
+	case TRACKER_DB_JOURNAL_DELETE_STATEMENT:
+		tracker_db_journal_reader_get_statement (&entry->graph_id, &entry->subject_id,
+		                                         &entry->predicate_id, &str);
+		break;
+	case TRACKER_DB_JOURNAL_INSERT_STATEMENT_ID:
+	case TRACKER_DB_JOURNAL_UPDATE_STATEMENT_ID:
+	case TRACKER_DB_JOURNAL_DELETE_STATEMENT_ID:
+		tracker_db_journal_reader_get_statement_id (&entry->graph_id, &entry->subject_id,
+		                                            &entry->predicate_id, &entry->object_id);
+		break;
+	default:
+		break;
+	}
+
+	entry->object = g_strdup (str);
+}
+
+static void
+replay_begin_journal_transaction (time_t time)
+{
+	TrackerDBInterface *iface;
+
+	if (!in_transaction) {
+		tracker_data_begin_transaction_for_replay (time, NULL);
+	} else {
+		/* continue the database transaction of the previous
+		 * journal transaction */
+		resource_time = time;
+	}
+
+	/* allows dropping a journal transaction that turns out to be
+	 * damaged without losing the rest of the group */
+	iface = tracker_db_manager_get_db_interface ();
+	tracker_db_interface_execute_query (iface, NULL, "SAVEPOINT replay");
+	update_buffer.in_savepoint = TRUE;
+}
+
+static void
+replay_release_savepoint (void)
+{
+	update_buffer.in_savepoint = FALSE;
+
+	/* the count changes stay in class_counts until the group is
+	 * committed or rolled back */
+	if (update_buffer.savepoint_class_counts) {
+		g_hash_table_remove_all (update_buffer.savepoint_class_counts);
+	}
+}
+
+static void
+replay_drop_journal_transaction (void)
+{
+	TrackerDBInterface *iface;
+
+	update_buffer_clear_resources ();
+
+	if (update_buffer.savepoint_class_counts) {
+		GHashTableIter iter;
+		TrackerClass *class;
+		gpointer count_ptr;
+
+		/* revert the count changes of this journal transaction only */
+		g_hash_table_iter_init (&iter, update_buffer.savepoint_class_counts);
+		while (g_hash_table_iter_next (&iter, (gpointer*) &class, &count_ptr)) {
+			gint count;
+
+			count = GPOINTER_TO_INT (count_ptr);
+			tracker_class_set_count (class, tracker_class_get_count (class) - count);
+			class_counts_add (&update_buffer.class_counts, class, -count);
+		}
+	}
+
+	replay_release_savepoint ();
+
+	iface = tracker_db_manager_get_db_interface ();
+	tracker_db_interface_execute_query (iface, NULL, "ROLLBACK TO replay");
+	tracker_db_interface_execute_query (iface, NULL, "RELEASE replay");
+}
+
+static void
+replay_end_journal_transaction (GError **error)
+{
+	TrackerDBInterface *iface;
+	GError *actual_error = NULL;
+
+	/* Like tracker_data_commit_transaction() without ending the
+	 * database transaction, every journal transaction still gets
+	 * its own modseq and time */
+	tracker_data_update_buffer_flush (&actual_error);
+
+	if (actual_error) {
+		/* partially written, keep the rest of the group */
+		replay_drop_journal_transaction ();
+		has_persistent = FALSE;
+		g_propagate_error (error, actual_error);
+		return;
+	}
+
+#if HAVE_TRACKER_FTS
+	/* within the savepoint, dropping a later journal transaction of
+	 * the group must not lose the text of this one */
+	fts_index_pending ();
+#endif
+
+	iface = tracker_db_manager_get_db_interface ();
+	tracker_db_interface_execute_query (iface, NULL, "RELEASE replay");
+	replay_release_savepoint ();
+
+	get_transaction_modseq ();
+	if (has_persistent) {
+		transaction_modseq++;
+	}
+	has_persistent = FALSE;
+
+	g_hash_table_remove_all (update_buffer.resource_cache);
+}
+
+static void
+replay_journal_entry (ReplayEntry     *entry,
+                      TrackerProperty *rdf_type,
+                      gint            *last_operation_type)
+{
+	const gchar *uri;
+
+	if (entry->type == TRACKER_DB_JOURNAL_RESOURCE) {
+		GError *new_error = NULL;
+		TrackerDBInterface *iface;
+		TrackerDBStatement *stmt;
+
+		iface = tracker_db_manager_get_db_interface ();
+
+		stmt = tracker_db_interface_create_statement (iface, TRACKER_DB_STATEMENT_CACHE_TYPE_UPDATE, &new_error,
+		                                              "INSERT INTO Resource (ID, Uri) VALUES (?, ?)");
+
+		if (stmt) {
+			tracker_db_statement_bind_int (stmt, 0, entry->subject_id);
+			tracker_db_statement_bind_text (stmt, 1, entry->object);
+			tracker_db_statement_execute (stmt, &new_error);
+			g_object_unref (stmt);
+		}
+
+		if (new_error) {
+			g_warning ("Journal replay error: '%s'", new_error->message);
+			g_error_free (new_error);
+		}
+
+	} else if (entry->type == TRACKER_DB_JOURNAL_START_TRANSACTION) {
+		replay_begin_journal_transaction (entry->time);
+	} else if (entry->type == TRACKER_DB_JOURNAL_END_TRANSACTION) {
+		GError *new_error = NULL;
+
+		replay_end_journal_transaction (&new_error);
+
+		if (new_error) {
+			g_warning ("Journal replay error: '%s'", new_error->message);
+			g_clear_error (&new_error);
+		}
+	} else if (entry->type == TRACKER_DB_JOURNAL_INSERT_STATEMENT ||
+	           entry->type == TRACKER_DB_JOURNAL_UPDATE_STATEMENT) {
+		GError *new_error = NULL;
+		TrackerProperty *property = NULL;
+
+		if (*last_operation_type == -1) {
+			tracker_data_update_buffer_flush (&new_error);
+			if (new_error) {
+				g_warning ("Journal replay error: '%s'", new_error->message);
+				g_clear_error (&new_error);
 			}
+		}
+		*last_operation_type = 1;
 
-		} else if (type == TRACKER_DB_JOURNAL_DELETE_STATEMENT_ID) {
-			GError *new_error = NULL;
-			TrackerClass *class = NULL;
-			TrackerProperty *property = NULL;
+		uri = tracker_ontologies_get_uri_by_id (entry->predicate_id);
+		if (uri) {
+			property = tracker_ontologies_get_property_by_uri (uri);
+		}
 
-			tracker_db_journal_reader_get_statement_id (&graph_id, &subject_id, &predicate_id, &object_id);
+		if (property) {
+			resource_buffer_switch (NULL, entry->graph_id, NULL, entry->subject_id);
 
-			if (last_operation_type == 1) {
-				tracker_data_update_buffer_flush (&new_error);
-				if (new_error) {
-					g_warning ("Journal replay error: '%s'", new_error->message);
-					g_clear_error (&new_error);
-				}
+			if (entry->type == TRACKER_DB_JOURNAL_UPDATE_STATEMENT) {
+				cache_update_metadata_decomposed (property, entry->object, 0, NULL, entry->graph_id, &new_error);
+			} else {
+				cache_insert_metadata_decomposed (property, entry->object, 0, NULL, entry->graph_id, &new_error);
 			}
-			last_operation_type = -1;
+			if (new_error) {
+				g_warning ("Journal replay error: '%s'", new_error->message);
+				g_clear_error (&new_error);
+			}
+
+		} else {
+			g_warning ("Journal replay error: 'property with ID %d doesn't exist'", entry->predicate_id);
+		}
+
+	} else if (entry->type == TRACKER_DB_JOURNAL_INSERT_STATEMENT_ID ||
+	           entry->type == TRACKER_DB_JOURNAL_UPDATE_STATEMENT_ID) {
+		GError *new_error = NULL;
+		TrackerClass *class = NULL;
+		TrackerProperty *property = NULL;
 
-			uri = tracker_ontologies_get_uri_by_id (predicate_id);
-			if (uri) {
-				property = tracker_ontologies_get_property_by_uri (uri);
+		if (*last_operation_type == -1) {
+			tracker_data_update_buffer_flush (&new_error);
+			if (new_error) {
+				g_warning ("Journal replay error: '%s'", new_error->message);
+				g_clear_error (&new_error);
 			}
+		}
+		*last_operation_type = 1;
 
-			if (property) {
+		uri = tracker_ontologies_get_uri_by_id (entry->predicate_id);
+		if (uri) {
+			property = tracker_ontologies_get_property_by_uri (uri);
+		}
 
-				resource_buffer_switch (NULL, graph_id, NULL, subject_id);
+		if (property) {
+			if (tracker_property_get_data_type (property) != TRACKER_PROPERTY_TYPE_RESOURCE) {
+				g_warning ("Journal replay error: 'property with ID %d does not account URIs'", entry->predicate_id);
+			} else {
+				resource_buffer_switch (NULL, entry->graph_id, NULL, entry->subject_id);
 
 				if (property == rdf_type) {
-					uri = tracker_ontologies_get_uri_by_id (object_id);
+					uri = tracker_ontologies_get_uri_by_id (entry->object_id);
 					if (uri) {
 						class = tracker_ontologies_get_class_by_uri (uri);
 					}
 					if (class) {
-						cache_delete_resource_type (class, NULL, graph_id);
+						cache_create_service_decomposed (class, NULL, entry->graph_id);
 					} else {
-						g_warning ("Journal replay error: 'class with ID %d not found in the ontology'", object_id);
+						g_warning ("Journal replay error: 'class with ID %d not found in the ontology'", entry->object_id);
 					}
 				} else {
-					GError *new_error = NULL;
-
-					delete_metadata_decomposed (property, NULL, object_id, &new_error);
+					/* add value to metadata database */
+					if (entry->type == TRACKER_DB_JOURNAL_UPDATE_STATEMENT_ID) {
+						cache_update_metadata_decomposed (property, NULL, entry->object_id, NULL, entry->graph_id, &new_error);
+					} else {
+						cache_insert_metadata_decomposed (property, NULL, entry->object_id, NULL, entry->graph_id, &new_error);
+					}
 
 					if (new_error) {
 						g_warning ("Journal replay error: '%s'", new_error->message);
 						g_error_free (new_error);
 					}
 				}
+			}
+		} else {
+			g_warning ("Journal replay error: 'property with ID %d doesn't exist'", entry->predicate_id);
+		}
+
+	} else if (entry->type == TRACKER_DB_JOURNAL_DELETE_STATEMENT) {
+		GError *new_error = NULL;
+		TrackerProperty *property = NULL;
+
+		if (*last_operation_type == 1) {
+			tracker_data_update_buffer_flush (&new_error);
+			if (new_error) {
+				g_warning ("Journal replay error: '%s'", new_error->message);
+				g_clear_error (&new_error);
+			}
+		}
+		*last_operation_type = -1;
+
+		resource_buffer_switch (NULL, entry->graph_id, NULL, entry->subject_id);
+
+		uri = tracker_ontologies_get_uri_by_id (entry->predicate_id);
+		if (uri) {
+			property = tracker_ontologies_get_property_by_uri (uri);
+		}
+
+		if (property) {
+			if (entry->object && rdf_type == property) {
+				TrackerClass *class = NULL;
+
+				uri = tracker_ontologies_get_uri_by_id (entry->object_id);
+				if (uri) {
+					class = tracker_ontologies_get_class_by_uri (uri);
+				}
+				if (class != NULL) {
+					cache_delete_resource_type (class, NULL, entry->graph_id);
+				} else {
+					g_warning ("Journal replay error: 'class with '%s' not found in the ontology'", entry->object);
+				}
+			} else {
+				delete_metadata_decomposed (property, entry->object, 0, &new_error);
+			}
+
+			if (new_error) {
+				g_warning ("Journal replay error: '%s'", new_error->message);
+				g_error_free (new_error);
+			}
+
+		} else {
+			g_warning ("Journal replay error: 'property with ID %d doesn't exist'", entry->predicate_id);
+		}
+
+	} else if (entry->type == TRACKER_DB_JOURNAL_DELETE_STATEMENT_ID) {
+		TrackerClass *class = NULL;
+		TrackerProperty *property = NULL;
+		GError *new_error = NULL;
+
+		if (*last_operation_type == 1) {
+			tracker_data_update_buffer_flush (&new_error);
+			if (new_error) {
+				g_warning ("Journal replay error: '%s'", new_error->message);
+				g_clear_error (&new_error);
+			}
+		}
+		*last_operation_type = -1;
+
+		uri = tracker_ontologies_get_uri_by_id (entry->predicate_id);
+		if (uri) {
+			property = tracker_ontologies_get_property_by_uri (uri);
+		}
+
+		if (property) {
+
+			resource_buffer_switch (NULL, entry->graph_id, NULL, entry->subject_id);
+
+			if (property == rdf_type) {
+				uri = tracker_ontologies_get_uri_by_id (entry->object_id);
+				if (uri) {
+					class = tracker_ontologies_get_class_by_uri (uri);
+				}
+				if (class) {
+					cache_delete_resource_type (class, NULL, entry->graph_id);
+				} else {
+					g_warning ("Journal replay error: 'class with ID %d not found in the ontology'", entry->object_id);
+				}
 			} else {
-				g_warning ("Journal replay error: 'property with ID %d doesn't exist'", predicate_id);
+				delete_metadata_decomposed (property, NULL, entry->object_id, &new_error);
+
+				if (new_error) {
+					g_warning ("Journal replay error: '%s'", new_error->message);
+					g_error_free (new_error);
+				}
+			}
+		} else {
+			g_warning ("Journal replay error: 'property with ID %d doesn't exist'", entry->predicate_id);
+		}
+	}
+}
+
+/* Commits the database transaction of the replayed group. If that fails,
+ * the group is replayed once more with a database transaction per journal
+ * transaction, so that only the ones that fail on their own are lost.
+ * Returns FALSE if replay can't continue.
+ */
+static gboolean
+replay_commit_group (GArray           *group,
+                     guint             n_entries,
+                     TrackerProperty  *rdf_type,
+                     GError          **error)
+{
+	GError *new_error = NULL;
+	gint last_operation_type = 0;
+	guint i;
+
+	tracker_data_commit_transaction (&new_error);
+
+	if (!new_error) {
+		return TRUE;
+	}
+
+	/* Out of disk is an unrecoverable fatal error */
+	if (g_error_matches (new_error, TRACKER_DB_INTERFACE_ERROR, TRACKER_DB_NO_SPACE)) {
+		g_propagate_error (error, new_error);
+		return FALSE;
+	}
+
+	g_warning ("Journal replay error: '%s', replaying transactions one by one", new_error->message);
+	g_clear_error (&new_error);
+
+	for (i = 0; i < n_entries; i++) {
+		ReplayEntry *entry = &g_array_index (group, ReplayEntry, i);
+
+		replay_journal_entry (entry, rdf_type, &last_operation_type);
+
+		if (entry->type != TRACKER_DB_JOURNAL_END_TRANSACTION) {
+			continue;
+		}
+
+		tracker_data_commit_transaction (&new_error);
+		if (new_error) {
+			if (g_error_matches (new_error, TRACKER_DB_INTERFACE_ERROR, TRACKER_DB_NO_SPACE)) {
+				g_propagate_error (error, new_error);
+				return FALSE;
+			}
+
+			g_warning ("Journal replay error: '%s'", new_error->message);
+			g_clear_error (&new_error);
+		}
+	}
+
+	return TRUE;
+}
+
+void
+tracker_data_replay_journal (TrackerBusyCallback   busy_callback,
+                             gpointer              busy_user_data,
+                             const gchar          *busy_status,
+                             GError              **error)
+{
+	GError *journal_error = NULL;
+	TrackerProperty *rdf_type = NULL;
+	gint last_operation_type = 0;
+	GError *n_error = NULL;
+	gboolean in_journal_transaction = FALSE;
+	guint n_grouped = 0;
+	GArray *group;
+	guint group_end = 0;
+
+
+	rdf_type = tracker_ontologies_get_rdf_type ();
+
+	tracker_db_journal_reader_init (NULL, &n_error);
+	if (n_error) {
+		/* This is fatal (doesn't happen when file doesn't exist, does happen
+		 * when for some other reason the reader can't be created) */
+		g_propagate_error (error, n_error);
+		return;
+	}
+
+	/* entries since the last commit, in case it fails */
+	group = g_array_new (FALSE, FALSE, sizeof (ReplayEntry));
+	g_array_set_clear_func (group, (GDestroyNotify) replay_entry_clear);
+
+	while (tracker_db_journal_reader_next (&journal_error)) {
+		ReplayEntry entry;
+
+		replay_entry_read (&entry);
+		g_array_append_val (group, entry);
+
+		replay_journal_entry (&entry, rdf_type, &last_operation_type);
+
+		if (entry.type == TRACKER_DB_JOURNAL_START_TRANSACTION) {
+			in_journal_transaction = TRUE;
+		} else if (entry.type == TRACKER_DB_JOURNAL_END_TRANSACTION) {
+			in_journal_transaction = FALSE;
+			group_end = group->len;
+
+			if (++n_grouped >= REPLAY_GROUP_SIZE) {
+				n_grouped = 0;
+
+				if (!replay_commit_group (group, group_end, rdf_type, error)) {
+					g_array_unref (group);
+					return;
+				}
+
+				g_array_set_size (group, 0);
+				group_end = 0;
 			}
 		}
 
@@ -3819,6 +4454,25 @@ tracker_data_replay_journal (TrackerBusyCallback   busy_callback,
 		}
 	}
 
+	if (in_journal_transaction) {
+		/* the journal ended in the middle of a transaction, which
+		 * gets truncated below */
+		replay_drop_journal_transaction ();
+	}
+
+	if (in_transaction) {
+		GError *new_error = NULL;
+
+		if (!replay_commit_group (group, group_end, rdf_type, &new_error)) {
+			tracker_db_journal_reader_shutdown ();
+			g_clear_error (&journal_error);
+			g_array_unref (group);
+			g_propagate_error (error, new_error);
+			return;
+		}
+	}
+
+	g_array_unref (group);
 
 	if (journal_error) {
 		GError *n_error = NULL;
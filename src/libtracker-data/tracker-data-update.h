@@ -96,6 +96,16 @@ void     tracker_data_update_buffer_flush           (GError                   **
 void     tracker_data_update_buffer_might_flush     (GError                   **error);
 void     tracker_data_load_turtle_file              (GFile                     *file,
                                                      GError                   **error);
+void     tracker_data_load_turtle_file_bulk         (GFile                     *file,
+                                                     TrackerBusyCallback        busy_callback,
+                                                     gpointer                   busy_user_data,
+                                                     const gchar               *busy_status,
+                                                     GError                   **error);
+gboolean tracker_data_fts_merge                     (gint                       n_pages,
+                                                     GError                   **error);
+void     tracker_data_get_fts_stats                 (guint64                   *indexed,
+                                                     guint64                   *coalesced,
+                                                     gint64                    *index_time);
 
 void     tracker_data_sync                          (void);
 void     tracker_data_replay_journal                (TrackerBusyCallback        busy_callback,
@@ -27,6 +27,7 @@
 #define __LIBTRACKER_DATA_INSIDE__
 
 #include "tracker-class.h"
+#include "tracker-data-aggregates.h"
 #include "tracker-data-backup.h"
 #include "tracker-data-manager.h"
 #include "tracker-data-query.h"
@@ -63,6 +63,11 @@ typedef struct {
 	guint max;
 } TrackerDBStatementLru;
 
+typedef struct {
+	gconstpointer query;
+	gconstpointer object;
+} TrackerDBStatementKey;
+
 struct TrackerDBInterface {
 	GObject parent_instance;
 
@@ -70,6 +75,9 @@ struct TrackerDBInterface {
 	sqlite3 *db;
 
 	GHashTable *dynamic_statements;
+	/* TrackerDBStatementKey -> TrackerDBStatement, entries are
+	 * owned by dynamic_statements */
+	GHashTable *keyed_statements;
 
 	GSList *function_data;
 
@@ -80,6 +88,10 @@ struct TrackerDBInterface {
 	/* Number of active cursors */
 	gint n_active_cursors;
 
+	/* Serializes threadsafe cursors, the connection itself is
+	 * opened without SQLite mutexes */
+	GMutex mutex;
+
 	guint ro : 1;
 	GCancellable *cancellable;
 
@@ -107,6 +119,10 @@ struct TrackerDBCursor {
 	gchar **variable_names;
 	gint n_variable_names;
 
+	/* ORDER BY keys selected after the variables, see
+	 * tracker_db_cursor_get_continuation() */
+	gint n_keys;
+
 	/* used for direct access as libtracker-sparql is thread-safe and
 	   uses a single shared connection with SQLite mutex disabled */
 	gboolean threadsafe;
@@ -123,6 +139,9 @@ struct TrackerDBStatement {
 	gboolean stmt_is_sunk;
 	TrackerDBStatement *next;
 	TrackerDBStatement *prev;
+	/* Owned by keyed_statements, a statement is found by at
+	 * most one key so it can be dropped along with it */
+	TrackerDBStatementKey *key;
 };
 
 struct TrackerDBStatementClass {
@@ -1084,6 +1103,11 @@ close_database (TrackerDBInterface *db_interface)
 {
 	gint rc;
 
+	if (db_interface->keyed_statements) {
+		g_hash_table_unref (db_interface->keyed_statements);
+		db_interface->keyed_statements = NULL;
+	}
+
 	if (db_interface->dynamic_statements) {
 		g_hash_table_unref (db_interface->dynamic_statements);
 		db_interface->dynamic_statements = NULL;
@@ -1287,6 +1311,43 @@ tracker_db_interface_sqlite_fts_delete_text (TrackerDBInterface *db_interface,
 	return TRUE;
 }
 
+gboolean
+tracker_db_interface_sqlite_fts_rebuild (TrackerDBInterface  *db_interface,
+                                         GHashTable          *properties,
+                                         GHashTable          *multivalued,
+                                         gint                 n_threads,
+                                         GError             **error)
+{
+	if (!tracker_fts_rebuild_table (db_interface->db, db_interface->filename, "fts",
+	                                properties, multivalued, n_threads)) {
+		g_set_error (error,
+		             TRACKER_DB_INTERFACE_ERROR,
+		             TRACKER_DB_QUERY_ERROR,
+		             "Could not rebuild full-text index");
+		return FALSE;
+	}
+
+	return TRUE;
+}
+
+gboolean
+tracker_db_interface_sqlite_fts_merge (TrackerDBInterface  *db_interface,
+                                       gint                 n_pages,
+                                       GError             **error)
+{
+	gint changes;
+
+	changes = sqlite3_total_changes (db_interface->db);
+
+	/* merge=X,Y merges about X pages from levels with at least Y
+	 * segments, changes only go up if anything was merged */
+	tracker_db_interface_execute_query (db_interface, error,
+	                                    "INSERT INTO fts(fts) VALUES('merge=%d,8')",
+	                                    n_pages);
+
+	return sqlite3_total_changes (db_interface->db) - changes >= 2;
+}
+
 #endif
 
 void
@@ -1325,6 +1386,30 @@ tracker_db_interface_sqlite_wal_hook (TrackerDBInterface   *interface,
 	sqlite3_wal_hook (interface->db, wal_hook, callback);
 }
 
+gboolean
+tracker_db_interface_sqlite_in_transaction (TrackerDBInterface *interface)
+{
+	return !sqlite3_get_autocommit (interface->db);
+}
+
+void
+tracker_db_interface_sqlite_lock (TrackerDBInterface *interface)
+{
+	g_mutex_lock (&interface->mutex);
+}
+
+gboolean
+tracker_db_interface_sqlite_trylock (TrackerDBInterface *interface)
+{
+	return g_mutex_trylock (&interface->mutex);
+}
+
+void
+tracker_db_interface_sqlite_unlock (TrackerDBInterface *interface)
+{
+	g_mutex_unlock (&interface->mutex);
+}
+
 
 static void
 tracker_db_interface_sqlite_finalize (GObject *object)
@@ -1341,6 +1426,8 @@ tracker_db_interface_sqlite_finalize (GObject *object)
 	g_free (db_interface->filename);
 	g_free (db_interface->busy_status);
 
+	g_mutex_clear (&db_interface->mutex);
+
 	G_OBJECT_CLASS (tracker_db_interface_parent_class)->finalize (object);
 }
 
@@ -1370,18 +1457,47 @@ tracker_db_interface_class_init (TrackerDBInterfaceClass *class)
 	                                                       G_PARAM_READWRITE | G_PARAM_CONSTRUCT_ONLY));
 }
 
+static guint
+statement_key_hash (gconstpointer key)
+{
+	const TrackerDBStatementKey *stmt_key = key;
+
+	return g_direct_hash (stmt_key->query) * 31 + g_direct_hash (stmt_key->object);
+}
+
+static gboolean
+statement_key_equal (gconstpointer a,
+                     gconstpointer b)
+{
+	const TrackerDBStatementKey *key_a = a;
+	const TrackerDBStatementKey *key_b = b;
+
+	return key_a->query == key_b->query && key_a->object == key_b->object;
+}
+
+static void
+statement_key_free (TrackerDBStatementKey *key)
+{
+	g_slice_free (TrackerDBStatementKey, key);
+}
+
 static void
 prepare_database (TrackerDBInterface *db_interface)
 {
 	db_interface->dynamic_statements = g_hash_table_new_full (g_str_hash, g_str_equal,
 	                                                          NULL,
 	                                                          (GDestroyNotify) g_object_unref);
+	db_interface->keyed_statements = g_hash_table_new_full (statement_key_hash,
+	                                                        statement_key_equal,
+	                                                        (GDestroyNotify) statement_key_free,
+	                                                        NULL);
 }
 
 static void
 tracker_db_interface_init (TrackerDBInterface *db_interface)
 {
 	db_interface->ro = FALSE;
+	g_mutex_init (&db_interface->mutex);
 
 	prepare_database (db_interface);
 }
@@ -1427,23 +1543,47 @@ tracker_db_interface_set_busy_handler (TrackerDBInterface  *db_interface,
 	}
 }
 
-TrackerDBStatement *
-tracker_db_interface_create_statement (TrackerDBInterface           *db_interface,
-                                       TrackerDBStatementCacheType   cache_type,
-                                       GError                      **error,
-                                       const gchar                  *query,
-                                       ...)
+static void
+stmt_lru_touch (TrackerDBStatementLru *stmt_lru,
+                TrackerDBStatement    *stmt)
 {
-	TrackerDBStatementLru *stmt_lru = NULL;
-	TrackerDBStatement *stmt;
-	va_list args;
-	gchar *full_query;
+	if (stmt == stmt_lru->head) {
 
-	g_return_val_if_fail (TRACKER_IS_DB_INTERFACE (db_interface), NULL);
+		/* Current stmt is least recently used, shift head and tail
+		 * of the ring to efficiently make it most recently used. */
 
-	va_start (args, query);
-	full_query = g_strdup_vprintf (query, args);
-	va_end (args);
+		stmt_lru->head = stmt_lru->head->next;
+		stmt_lru->tail = stmt_lru->tail->next;
+	} else if (stmt != stmt_lru->tail) {
+
+		/* Current statement isn't most recently used, make it most
+		 * recently used now (less efficient way than above). */
+
+		/* Take stmt out of the list and close the ring */
+		stmt->prev->next = stmt->next;
+		stmt->next->prev = stmt->prev;
+
+		/* Put stmt as tail (most recent used) */
+		stmt->next = stmt_lru->head;
+		stmt_lru->head->prev = stmt;
+		stmt->prev = stmt_lru->tail;
+		stmt_lru->tail->next = stmt;
+		stmt_lru->tail = stmt;
+	}
+
+	/* if (stmt == tail), it's already the most recently used in the
+	 * ring, so in this case we do nothing of course */
+}
+
+/* Takes ownership of full_query */
+static TrackerDBStatement *
+db_interface_create_statement (TrackerDBInterface           *db_interface,
+                               TrackerDBStatementCacheType   cache_type,
+                               gchar                        *full_query,
+                               GError                      **error)
+{
+	TrackerDBStatementLru *stmt_lru = NULL;
+	TrackerDBStatement *stmt;
 
 	/* There are three kinds of queries:
 	 * a) Cached queries: SELECT and UPDATE ones (cache_type)
@@ -1533,6 +1673,10 @@ tracker_db_interface_create_statement (TrackerDBInterface           *db_interfac
 				 * Then we assign head->next as new head. */
 
 				new_head = stmt_lru->head->next;
+				if (stmt_lru->head->key) {
+					g_hash_table_remove (db_interface->keyed_statements,
+					                     stmt_lru->head->key);
+				}
 				g_hash_table_remove (db_interface->dynamic_statements,
 				                     (gpointer) sqlite3_sql (stmt_lru->head->stmt));
 				stmt_lru->size--;
@@ -1560,38 +1704,109 @@ tracker_db_interface_create_statement (TrackerDBInterface           *db_interfac
 		tracker_db_statement_sqlite_reset (stmt);
 
 		if (cache_type != TRACKER_DB_STATEMENT_CACHE_TYPE_NONE) {
-			if (stmt == stmt_lru->head) {
+			stmt_lru_touch (stmt_lru, stmt);
+		}
+	}
 
-				/* Current stmt is least recently used, shift head and tail
-				 * of the ring to efficiently make it most recently used. */
+	g_free (full_query);
 
-				stmt_lru->head = stmt_lru->head->next;
-				stmt_lru->tail = stmt_lru->tail->next;
-			} else if (stmt != stmt_lru->tail) {
+	return (cache_type != TRACKER_DB_STATEMENT_CACHE_TYPE_NONE) ? g_object_ref (stmt) : stmt;
+}
 
-				/* Current statement isn't most recently used, make it most
-				 * recently used now (less efficient way than above). */
+TrackerDBStatement *
+tracker_db_interface_create_statement (TrackerDBInterface           *db_interface,
+                                       TrackerDBStatementCacheType   cache_type,
+                                       GError                      **error,
+                                       const gchar                  *query,
+                                       ...)
+{
+	va_list args;
+	gchar *full_query;
 
-				/* Take stmt out of the list and close the ring */
-				stmt->prev->next = stmt->next;
-				stmt->next->prev = stmt->prev;
+	g_return_val_if_fail (TRACKER_IS_DB_INTERFACE (db_interface), NULL);
 
-				/* Put stmt as tail (most recent used) */
-				stmt->next = stmt_lru->head;
-				stmt_lru->head->prev = stmt;
-				stmt->prev = stmt_lru->tail;
-				stmt_lru->tail->next = stmt;
-				stmt_lru->tail = stmt;
-			}
+	va_start (args, query);
+	full_query = g_strdup_vprintf (query, args);
+	va_end (args);
 
-			/* if (stmt == tail), it's already the most recently used in the
-			 * ring, so in this case we do nothing of course */
-		}
+	return db_interface_create_statement (db_interface, cache_type, full_query, error);
+}
+
+/**
+ * tracker_db_interface_create_keyed_statement:
+ * @db_interface: a #TrackerDBInterface
+ * @cache_type: the statement cache to use, must not be
+ *   %TRACKER_DB_STATEMENT_CACHE_TYPE_NONE
+ * @object: the object the query is formatted for, or %NULL
+ * @error: return location for errors
+ * @query: printf-style query template
+ *
+ * Like tracker_db_interface_create_statement(), but cached statements
+ * are looked up by the (@query, @object) pointer pair, so @query is
+ * only formatted when the statement is not in the cache yet. The
+ * caller must make sure the formatted query only depends on @query
+ * and @object, e.g. @object being the #TrackerClass or property name
+ * that the table names are taken from, and that @query is a string
+ * literal.
+ *
+ * Returns: a new reference to a #TrackerDBStatement, or %NULL on error.
+ **/
+TrackerDBStatement *
+tracker_db_interface_create_keyed_statement (TrackerDBInterface           *db_interface,
+                                             TrackerDBStatementCacheType   cache_type,
+                                             gconstpointer                 object,
+                                             GError                      **error,
+                                             const gchar                  *query,
+                                             ...)
+{
+	TrackerDBStatementKey key, *new_key;
+	TrackerDBStatement *stmt;
+	va_list args;
+	gchar *full_query;
+
+	g_return_val_if_fail (TRACKER_IS_DB_INTERFACE (db_interface), NULL);
+	g_return_val_if_fail (cache_type != TRACKER_DB_STATEMENT_CACHE_TYPE_NONE, NULL);
+
+	key.query = query;
+	key.object = object;
+
+	stmt = g_hash_table_lookup (db_interface->keyed_statements, &key);
+
+	if (stmt && !stmt->stmt_is_sunk) {
+		tracker_db_statement_sqlite_reset (stmt);
+		stmt_lru_touch (cache_type == TRACKER_DB_STATEMENT_CACHE_TYPE_UPDATE ?
+		                &db_interface->update_stmt_lru :
+		                &db_interface->select_stmt_lru,
+		                stmt);
+
+		return g_object_ref (stmt);
 	}
 
-	g_free (full_query);
+	va_start (args, query);
+	full_query = g_strdup_vprintf (query, args);
+	va_end (args);
 
-	return (cache_type != TRACKER_DB_STATEMENT_CACHE_TYPE_NONE) ? g_object_ref (stmt) : stmt;
+	if (stmt) {
+		/* statement is in use, let the regular path create
+		 * an uncached one */
+		return db_interface_create_statement (db_interface, cache_type, full_query, error);
+	}
+
+	stmt = db_interface_create_statement (db_interface, cache_type, full_query, error);
+
+	if (stmt && g_hash_table_lookup (db_interface->dynamic_statements, sqlite3_sql (stmt->stmt)) == stmt) {
+		if (stmt->key) {
+			/* the same SQL was created for another key */
+			g_hash_table_remove (db_interface->keyed_statements, stmt->key);
+		}
+
+		new_key = g_slice_new (TrackerDBStatementKey);
+		*new_key = key;
+		g_hash_table_insert (db_interface->keyed_statements, new_key, stmt);
+		stmt->key = new_key;
+	}
+
+	return stmt;
 }
 
 static void
@@ -1850,7 +2065,7 @@ tracker_db_cursor_close (TrackerDBCursor *cursor)
 	}
 
 	if (cursor->threadsafe) {
-		tracker_db_manager_lock ();
+		g_mutex_lock (&iface->mutex);
 	}
 
 	cursor->ref_stmt->stmt_is_sunk = FALSE;
@@ -1859,8 +2074,10 @@ tracker_db_cursor_close (TrackerDBCursor *cursor)
 	cursor->ref_stmt = NULL;
 
 	if (cursor->threadsafe) {
-		tracker_db_manager_unlock ();
+		g_mutex_unlock (&iface->mutex);
 	}
+
+	g_object_unref (iface);
 }
 
 static void
@@ -1960,6 +2177,7 @@ tracker_db_cursor_class_init (TrackerDBCursorClass *class)
 	sparql_cursor_class->next_finish = (gboolean (*) (TrackerSparqlCursor *, GAsyncResult *, GError **)) tracker_db_cursor_iter_next_finish;
 	sparql_cursor_class->rewind = (void (*) (TrackerSparqlCursor *)) tracker_db_cursor_rewind;
 	sparql_cursor_class->close = (void (*) (TrackerSparqlCursor *)) tracker_db_cursor_close;
+	sparql_cursor_class->get_continuation = (gchar * (*) (TrackerSparqlCursor *)) tracker_db_cursor_get_continuation;
 
 	sparql_cursor_class->get_integer = (gint64 (*) (TrackerSparqlCursor *, gint)) tracker_db_cursor_get_int;
 	sparql_cursor_class->get_double = (gdouble (*) (TrackerSparqlCursor *, gint)) tracker_db_cursor_get_double;
@@ -1993,13 +2211,17 @@ tracker_db_cursor_sqlite_new (sqlite3_stmt        *sqlite_stmt,
 	cursor->finished = FALSE;
 
 	/* used for direct access as libtracker-sparql is thread-safe and
-	   uses a single shared connection with SQLite mutex disabled */
+	   cursors may be used from another thread than the one owning the
+	   connection, which has SQLite mutex disabled */
 	cursor->threadsafe = threadsafe;
 
 	cursor->stmt = sqlite_stmt;
 	ref_stmt->stmt_is_sunk = TRUE;
 	cursor->ref_stmt = g_object_ref (ref_stmt);
 
+	/* keep the connection open even if its thread exits */
+	g_object_ref (iface);
+
 	if (types) {
 		gint i;
 
@@ -2076,14 +2298,14 @@ tracker_db_cursor_rewind (TrackerDBCursor *cursor)
 	g_return_if_fail (TRACKER_IS_DB_CURSOR (cursor));
 
 	if (cursor->threadsafe) {
-		tracker_db_manager_lock ();
+		tracker_db_interface_sqlite_lock (cursor->ref_stmt->db_interface);
 	}
 
 	sqlite3_reset (cursor->stmt);
 	cursor->finished = FALSE;
 
 	if (cursor->threadsafe) {
-		tracker_db_manager_unlock ();
+		tracker_db_interface_sqlite_unlock (cursor->ref_stmt->db_interface);
 	}
 }
 
@@ -2112,7 +2334,7 @@ db_cursor_iter_next (TrackerDBCursor *cursor,
 		guint result;
 
 		if (cursor->threadsafe) {
-			tracker_db_manager_lock ();
+			tracker_db_interface_sqlite_lock (iface);
 		}
 
 		if (g_cancellable_is_cancelled (cancellable)) {
@@ -2140,7 +2362,7 @@ db_cursor_iter_next (TrackerDBCursor *cursor,
 		cursor->finished = (result != SQLITE_ROW);
 
 		if (cursor->threadsafe) {
-			tracker_db_manager_unlock ();
+			tracker_db_interface_sqlite_unlock (iface);
 		}
 	}
 
@@ -2150,7 +2372,68 @@ db_cursor_iter_next (TrackerDBCursor *cursor,
 guint
 tracker_db_cursor_get_n_columns (TrackerDBCursor *cursor)
 {
-	return sqlite3_column_count (cursor->stmt);
+	return sqlite3_column_count (cursor->stmt) - cursor->n_keys;
+}
+
+void
+tracker_db_cursor_set_n_keys (TrackerDBCursor *cursor,
+                              gint             n_keys)
+{
+	cursor->n_keys = n_keys;
+}
+
+/* The continuation is the text form of an "av" GVariant with the ORDER BY
+ * keys of the current row, () stands for NULL. */
+gchar *
+tracker_db_cursor_get_continuation (TrackerDBCursor *cursor)
+{
+	GVariantBuilder builder;
+	GVariant *keys;
+	gchar *result;
+	gint n_columns, i;
+
+	if (cursor->n_keys == 0 || cursor->finished) {
+		return NULL;
+	}
+
+	g_variant_builder_init (&builder, G_VARIANT_TYPE ("av"));
+
+	if (cursor->threadsafe) {
+		tracker_db_interface_sqlite_lock (cursor->ref_stmt->db_interface);
+	}
+
+	n_columns = sqlite3_column_count (cursor->stmt);
+
+	for (i = n_columns - cursor->n_keys; i < n_columns; i++) {
+		GVariant *value;
+
+		switch (sqlite3_column_type (cursor->stmt, i)) {
+		case SQLITE_INTEGER:
+			value = g_variant_new_int64 (sqlite3_column_int64 (cursor->stmt, i));
+			break;
+		case SQLITE_FLOAT:
+			value = g_variant_new_double (sqlite3_column_double (cursor->stmt, i));
+			break;
+		case SQLITE_NULL:
+			value = g_variant_new_tuple (NULL, 0);
+			break;
+		default:
+			value = g_variant_new_string ((const gchar *) sqlite3_column_text (cursor->stmt, i));
+			break;
+		}
+
+		g_variant_builder_add (&builder, "v", value);
+	}
+
+	if (cursor->threadsafe) {
+		tracker_db_interface_sqlite_unlock (cursor->ref_stmt->db_interface);
+	}
+
+	keys = g_variant_ref_sink (g_variant_builder_end (&builder));
+	result = g_variant_print (keys, TRUE);
+	g_variant_unref (keys);
+
+	return result;
 }
 
 void
@@ -2191,13 +2474,13 @@ tracker_db_cursor_get_int (TrackerDBCursor *cursor,
 	gint64 result;
 
 	if (cursor->threadsafe) {
-		tracker_db_manager_lock ();
+		tracker_db_interface_sqlite_lock (cursor->ref_stmt->db_interface);
 	}
 
 	result = (gint64) sqlite3_column_int64 (cursor->stmt, column);
 
 	if (cursor->threadsafe) {
-		tracker_db_manager_unlock ();
+		tracker_db_interface_sqlite_unlock (cursor->ref_stmt->db_interface);
 	}
 
 	return result;
@@ -2210,13 +2493,13 @@ tracker_db_cursor_get_double (TrackerDBCursor *cursor,
 	gdouble result;
 
 	if (cursor->threadsafe) {
-		tracker_db_manager_lock ();
+		tracker_db_interface_sqlite_lock (cursor->ref_stmt->db_interface);
 	}
 
 	result = (gdouble) sqlite3_column_double (cursor->stmt, column);
 
 	if (cursor->threadsafe) {
-		tracker_db_manager_unlock ();
+		tracker_db_interface_sqlite_unlock (cursor->ref_stmt->db_interface);
 	}
 
 	return result;
@@ -2240,13 +2523,13 @@ tracker_db_cursor_get_value_type (TrackerDBCursor *cursor,
 	g_return_val_if_fail (column < n_columns, TRACKER_SPARQL_VALUE_TYPE_UNBOUND);
 
 	if (cursor->threadsafe) {
-		tracker_db_manager_lock ();
+		tracker_db_interface_sqlite_lock (cursor->ref_stmt->db_interface);
 	}
 
 	column_type = sqlite3_column_type (cursor->stmt, column);
 
 	if (cursor->threadsafe) {
-		tracker_db_manager_unlock ();
+		tracker_db_interface_sqlite_unlock (cursor->ref_stmt->db_interface);
 	}
 
 	if (column_type == SQLITE_NULL) {
@@ -2278,7 +2561,7 @@ tracker_db_cursor_get_variable_name (TrackerDBCursor *cursor,
 	const gchar *result;
 
 	if (cursor->threadsafe) {
-		tracker_db_manager_lock ();
+		tracker_db_interface_sqlite_lock (cursor->ref_stmt->db_interface);
 	}
 
 	if (column < cursor->n_variable_names) {
@@ -2288,7 +2571,7 @@ tracker_db_cursor_get_variable_name (TrackerDBCursor *cursor,
 	}
 
 	if (cursor->threadsafe) {
-		tracker_db_manager_unlock ();
+		tracker_db_interface_sqlite_unlock (cursor->ref_stmt->db_interface);
 	}
 
 	return result;
@@ -2302,7 +2585,7 @@ tracker_db_cursor_get_string (TrackerDBCursor *cursor,
 	const gchar *result;
 
 	if (cursor->threadsafe) {
-		tracker_db_manager_lock ();
+		tracker_db_interface_sqlite_lock (cursor->ref_stmt->db_interface);
 	}
 
 	if (length) {
@@ -2315,7 +2598,7 @@ tracker_db_cursor_get_string (TrackerDBCursor *cursor,
 	}
 
 	if (cursor->threadsafe) {
-		tracker_db_manager_unlock ();
+		tracker_db_interface_sqlite_unlock (cursor->ref_stmt->db_interface);
 	}
 
 	return result;
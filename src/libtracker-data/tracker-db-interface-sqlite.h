@@ -47,6 +47,10 @@ void                tracker_db_interface_sqlite_fts_init               (TrackerD
 void                tracker_db_interface_sqlite_reset_collator         (TrackerDBInterface       *interface);
 void                tracker_db_interface_sqlite_wal_hook               (TrackerDBInterface       *interface,
                                                                         TrackerDBWalCallback      callback);
+gboolean            tracker_db_interface_sqlite_in_transaction         (TrackerDBInterface       *interface);
+void                tracker_db_interface_sqlite_lock                   (TrackerDBInterface       *interface);
+gboolean            tracker_db_interface_sqlite_trylock                (TrackerDBInterface       *interface);
+void                tracker_db_interface_sqlite_unlock                 (TrackerDBInterface       *interface);
 
 #if HAVE_TRACKER_FTS
 void                tracker_db_interface_sqlite_fts_alter_table        (TrackerDBInterface       *interface,
@@ -61,6 +65,14 @@ int                 tracker_db_interface_sqlite_fts_update_text        (TrackerD
 gboolean            tracker_db_interface_sqlite_fts_delete_text        (TrackerDBInterface       *db_interface,
 									int                       id,
 									const gchar              *property);
+gboolean            tracker_db_interface_sqlite_fts_rebuild            (TrackerDBInterface       *interface,
+                                                                        GHashTable               *properties,
+                                                                        GHashTable               *multivalued,
+                                                                        gint                      n_threads,
+                                                                        GError                  **error);
+gboolean            tracker_db_interface_sqlite_fts_merge              (TrackerDBInterface       *interface,
+                                                                        gint                      n_pages,
+                                                                        GError                  **error);
 void                tracker_db_interface_sqlite_fts_update_commit      (TrackerDBInterface       *interface);
 void                tracker_db_interface_sqlite_fts_update_rollback    (TrackerDBInterface       *interface);
 #endif
@@ -97,6 +97,12 @@ TrackerDBStatement *    tracker_db_interface_create_statement        (TrackerDBI
                                                                       GError                     **error,
                                                                       const gchar                 *query,
                                                                       ...) G_GNUC_PRINTF (4, 5);
+TrackerDBStatement *    tracker_db_interface_create_keyed_statement  (TrackerDBInterface          *interface,
+                                                                      TrackerDBStatementCacheType  cache_type,
+                                                                      gconstpointer                object,
+                                                                      GError                     **error,
+                                                                      const gchar                 *query,
+                                                                      ...) G_GNUC_PRINTF (5, 6);
 void                    tracker_db_interface_execute_vquery          (TrackerDBInterface          *interface,
                                                                       GError                     **error,
                                                                       const gchar                 *query,
@@ -142,6 +148,9 @@ gboolean                tracker_db_cursor_iter_next                  (TrackerDBC
                                                                       GCancellable               *cancellable,
                                                                       GError                    **error);
 guint                   tracker_db_cursor_get_n_columns              (TrackerDBCursor            *cursor);
+void                    tracker_db_cursor_set_n_keys                 (TrackerDBCursor            *cursor,
+                                                                      gint                        n_keys);
+gchar *                 tracker_db_cursor_get_continuation           (TrackerDBCursor            *cursor);
 const gchar*            tracker_db_cursor_get_variable_name          (TrackerDBCursor            *cursor,
                                                                       guint                       column);
 TrackerSparqlValueType  tracker_db_cursor_get_value_type             (TrackerDBCursor            *cursor,
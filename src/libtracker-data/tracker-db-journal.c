@@ -33,6 +33,8 @@
 
 #include <glib/gstdio.h>
 
+#include <zlib.h>
+
 #ifndef O_LARGEFILE
 # define O_LARGEFILE 0
 #endif
@@ -44,6 +46,34 @@
 
 #define MIN_BLOCK_SIZE    1024
 
+/* Mapped journal files at least this big get the checksums of all
+ * their transactions verified upfront, in parallel.
+ */
+#define PARALLEL_VERIFY_MIN_SIZE    (4 * 1024 * 1024)
+#define PARALLEL_VERIFY_MAX_THREADS 8
+
+/*
+ * Rotated chunks are compressed as a series of gzip members, each of
+ * them holding up to BLOCK_SIZE bytes of the journal:
+ *
+ * [
+ *  [block
+ *   [gzip header with a "TJ" extra subfield holding the block size]
+ *   [deflate data]
+ *   [crc32]
+ *   [uncompressed size]
+ *  ]
+ *  [block...]
+ * ]
+ *
+ * The block sizes let the reader find all blocks without inflating
+ * them first, and inflate them in parallel. All numbers are little
+ * endian as in any gzip file, which this still is.
+ */
+#define BLOCK_SIZE           (1024 * 1024)
+#define BLOCK_HEADER_SIZE    20
+#define BLOCK_TRAILER_SIZE   8
+
 /*
  * data_format:
  * #... 0000 0000 (total size is 4 bytes)
@@ -80,6 +110,8 @@ typedef struct {
 	const gchar *entry_end;
 	const gchar *last_success;
 	const gchar *start;
+	const gchar *verified_end;
+	gchar *buffer;
 	guint32 amount_of_triples;
 	gint64 time;
 	TrackerDBJournalEntryType type;
@@ -104,6 +136,38 @@ typedef struct {
 	guint cur_pos;
 } JournalWriter;
 
+typedef struct {
+	const gchar **entries;
+	guint n_entries;
+	guint first_damaged;
+} VerifyRange;
+
+typedef struct {
+	const guint8 *data;
+	gsize size;
+	gchar *dest;
+	gsize dest_size;
+	gboolean damaged;
+} CompressedBlock;
+
+typedef struct {
+	CompressedBlock *blocks;
+	guint n_blocks;
+	guint first;
+	guint stride;
+} InflateRange;
+
+static const guint8 block_header[BLOCK_HEADER_SIZE - 4] = {
+	0x1f, 0x8b,     /* gzip magic */
+	8,              /* deflate */
+	4,              /* FEXTRA */
+	0, 0, 0, 0,     /* no modification time */
+	0,              /* extra flags */
+	255,            /* unknown OS */
+	8, 0,           /* extra field length */
+	'T', 'J', 4, 0  /* block size subfield, followed by the size */
+};
+
 static struct {
 	gsize chunk_size;
 	gboolean do_rotating;
@@ -117,7 +181,11 @@ static JournalWriter ontology_writer = {0};
 
 static TransactionFormat current_transaction_format;
 
+/* compresses the last rotated chunk, see tracker_db_journal_rotate() */
+static GThread *compress_thread = NULL;
+
 static gboolean tracker_db_journal_rotate (GError **error);
+static void     journal_wait_for_compression (void);
 
 #ifndef HAVE_STRNLEN
 
@@ -278,6 +346,252 @@ journal_read_string (JournalReader  *jreader,
 	return result;
 }
 
+static gpointer
+verify_range_thread (gpointer data)
+{
+	VerifyRange *range = data;
+	guint i;
+
+	range->first_damaged = range->n_entries;
+
+	for (i = 0; i < range->n_entries; i++) {
+		const guint8 *entry = (const guint8 *) range->entries[i];
+		guint32 entry_size, crc_check;
+
+		entry_size = read_uint32 (entry);
+		crc_check = read_uint32 (entry + 2 * sizeof (guint32));
+
+		if (tracker_crc32 (entry + (sizeof (guint32) * 3), entry_size - (sizeof (guint32) * 3)) != crc_check) {
+			range->first_damaged = i;
+			break;
+		}
+	}
+
+	return NULL;
+}
+
+static void
+journal_verify_entries (JournalReader *jreader)
+{
+	VerifyRange ranges[PARALLEL_VERIFY_MAX_THREADS];
+	GThread *threads[PARALLEL_VERIFY_MAX_THREADS];
+	GPtrArray *index;
+	const gchar *entry;
+	guint n_threads, per_thread, i;
+
+	/* Entries before verified_end have been checked already and
+	 * are read without calculating their checksum again */
+	jreader->verified_end = jreader->current;
+
+	if (jreader->end - jreader->current < PARALLEL_VERIFY_MIN_SIZE) {
+		return;
+	}
+
+	/* Index the transactions, an entry has its size at both its
+	 * begin and its end. Everything after the first inconsistency
+	 * is left to the regular checks in db_journal_reader_next(). */
+	index = g_ptr_array_new ();
+	entry = jreader->current;
+
+	while (jreader->end - entry >= 5 * sizeof (guint32)) {
+		guint32 entry_size;
+
+		entry_size = read_uint32 ((const guint8 *) entry);
+
+		if (entry_size < 5 * sizeof (guint32) ||
+		    (gint64) entry_size > (gint64) (jreader->end - entry) ||
+		    read_uint32 ((const guint8 *) entry + entry_size - 4) != entry_size) {
+			break;
+		}
+
+		g_ptr_array_add (index, (gpointer) entry);
+		entry += entry_size;
+	}
+
+	if (index->len == 0) {
+		g_ptr_array_unref (index);
+		return;
+	}
+
+	n_threads = CLAMP (g_get_num_processors (), 1, PARALLEL_VERIFY_MAX_THREADS);
+	per_thread = (index->len + n_threads - 1) / n_threads;
+	n_threads = (index->len + per_thread - 1) / per_thread;
+
+	for (i = 0; i < n_threads; i++) {
+		ranges[i].entries = (const gchar **) index->pdata + i * per_thread;
+		ranges[i].n_entries = MIN (per_thread, index->len - i * per_thread);
+		threads[i] = g_thread_new ("journal-verify", verify_range_thread, &ranges[i]);
+	}
+
+	for (i = 0; i < n_threads; i++) {
+		g_thread_join (threads[i]);
+	}
+
+	jreader->verified_end = entry;
+
+	for (i = 0; i < n_threads; i++) {
+		if (ranges[i].first_damaged < ranges[i].n_entries) {
+			/* the reader reports the error once it gets there */
+			jreader->verified_end = ranges[i].entries[ranges[i].first_damaged];
+			break;
+		}
+	}
+
+	g_ptr_array_unref (index);
+}
+
+static guint32
+read_le32 (const guint8 *data)
+{
+	return data[3] << 24 |
+	       data[2] << 16 |
+	       data[1] << 8 |
+	       data[0];
+}
+
+static void
+write_le32 (guint8  *dest,
+            guint32  val)
+{
+	dest[0] = val >>  0 & 0xff;
+	dest[1] = val >>  8 & 0xff;
+	dest[2] = val >> 16 & 0xff;
+	dest[3] = val >> 24 & 0xff;
+}
+
+static gpointer
+inflate_range_thread (gpointer data)
+{
+	InflateRange *range = data;
+	guint i;
+
+	for (i = range->first; i < range->n_blocks; i += range->stride) {
+		CompressedBlock *block = &range->blocks[i];
+		z_stream zs = { 0 };
+		gint ret;
+
+		/* raw inflate, the gzip framing was checked already */
+		if (inflateInit2 (&zs, -MAX_WBITS) != Z_OK) {
+			block->damaged = TRUE;
+			continue;
+		}
+
+		zs.next_in = (Bytef *) block->data + BLOCK_HEADER_SIZE;
+		zs.avail_in = block->size - BLOCK_HEADER_SIZE - BLOCK_TRAILER_SIZE;
+		zs.next_out = (Bytef *) block->dest;
+		zs.avail_out = block->dest_size;
+
+		ret = inflate (&zs, Z_FINISH);
+		inflateEnd (&zs);
+
+		block->damaged = (ret != Z_STREAM_END ||
+		                  zs.total_out != block->dest_size ||
+		                  crc32 (0, (Bytef *) block->dest, block->dest_size) !=
+		                  read_le32 (block->data + block->size - BLOCK_TRAILER_SIZE));
+	}
+
+	return NULL;
+}
+
+/* Returns the uncompressed contents of a block compressed chunk, or
+ * NULL if the file is not one. Data after a damaged block is dropped,
+ * the reader then finds the journal truncated there. */
+static gchar *
+journal_inflate_chunk (const gchar *filename,
+                       gsize       *length)
+{
+	InflateRange ranges[PARALLEL_VERIFY_MAX_THREADS];
+	GThread *threads[PARALLEL_VERIFY_MAX_THREADS];
+	GMappedFile *file;
+	GArray *blocks;
+	const guint8 *data;
+	gsize size, offset, total;
+	gchar *buffer;
+	guint n_threads, i;
+
+	file = g_mapped_file_new (filename, FALSE, NULL);
+	if (!file) {
+		return NULL;
+	}
+
+	data = (const guint8 *) g_mapped_file_get_contents (file);
+	size = g_mapped_file_get_length (file);
+
+	if (size < BLOCK_HEADER_SIZE + BLOCK_TRAILER_SIZE ||
+	    memcmp (data, block_header, sizeof (block_header)) != 0) {
+		/* compressed as a whole by older versions */
+		g_mapped_file_unref (file);
+		return NULL;
+	}
+
+	blocks = g_array_new (FALSE, TRUE, sizeof (CompressedBlock));
+	offset = total = 0;
+
+	while (size - offset >= BLOCK_HEADER_SIZE + BLOCK_TRAILER_SIZE &&
+	       memcmp (data + offset, block_header, sizeof (block_header)) == 0) {
+		CompressedBlock block = { 0 };
+
+		block.data = data + offset;
+		block.size = read_le32 (block.data + sizeof (block_header));
+
+		if (block.size < BLOCK_HEADER_SIZE + BLOCK_TRAILER_SIZE ||
+		    block.size > size - offset) {
+			break;
+		}
+
+		block.dest_size = read_le32 (block.data + block.size - 4);
+
+		if (block.dest_size > BLOCK_SIZE) {
+			break;
+		}
+
+		g_array_append_val (blocks, block);
+		offset += block.size;
+		total += block.dest_size;
+	}
+
+	buffer = g_malloc (MAX (total, 1));
+
+	for (i = 0, offset = 0; i < blocks->len; i++) {
+		CompressedBlock *block = &g_array_index (blocks, CompressedBlock, i);
+
+		block->dest = buffer + offset;
+		offset += block->dest_size;
+	}
+
+	n_threads = CLAMP (g_get_num_processors (), 1, PARALLEL_VERIFY_MAX_THREADS);
+	n_threads = MAX (1, MIN (n_threads, blocks->len));
+
+	for (i = 0; i < n_threads; i++) {
+		ranges[i].blocks = (CompressedBlock *) blocks->data;
+		ranges[i].n_blocks = blocks->len;
+		ranges[i].first = i;
+		ranges[i].stride = n_threads;
+		threads[i] = g_thread_new ("journal-inflate", inflate_range_thread, &ranges[i]);
+	}
+
+	for (i = 0; i < n_threads; i++) {
+		g_thread_join (threads[i]);
+	}
+
+	*length = total;
+
+	for (i = 0; i < blocks->len; i++) {
+		CompressedBlock *block = &g_array_index (blocks, CompressedBlock, i);
+
+		if (block->damaged) {
+			g_warning ("Damaged block in compressed journal chunk '%s'", filename);
+			*length = block->dest - buffer;
+			break;
+		}
+	}
+
+	g_array_unref (blocks);
+	g_mapped_file_unref (file);
+
+	return buffer;
+}
+
 static gboolean
 journal_verify_header (JournalReader *jreader)
 {
@@ -560,11 +874,42 @@ db_journal_writer_init (JournalWriter  *jwriter,
 	return ret;
 }
 
+/* Removes compressed chunks that were left incomplete when the process
+ * stopped during compression, the uncompressed chunk is still there.
+ */
+static void
+journal_remove_partial_chunks (const gchar *directory)
+{
+	GDir *journal_dir;
+	const gchar *f_name;
+
+	journal_dir = g_dir_open (directory, 0, NULL);
+	if (!journal_dir) {
+		return;
+	}
+
+	while ((f_name = g_dir_read_name (journal_dir)) != NULL) {
+		gchar *fullpath;
+
+		if (!g_str_has_prefix (f_name, TRACKER_DB_JOURNAL_FILENAME ".") ||
+		    !g_str_has_suffix (f_name, ".tmp")) {
+			continue;
+		}
+
+		fullpath = g_build_filename (directory, f_name, NULL);
+		g_unlink (fullpath);
+		g_free (fullpath);
+	}
+
+	g_dir_close (journal_dir);
+}
+
 gboolean
 tracker_db_journal_init (const gchar  *filename,
                          gboolean      truncate,
                          GError      **error)
 {
+	gchar *directory;
 	gboolean ret;
 	const gchar *filename_use;
 	gchar *filename_free = NULL;
@@ -584,6 +929,14 @@ tracker_db_journal_init (const gchar  *filename,
 		filename_use = filename;
 	}
 
+	directory = g_path_get_dirname (filename_use);
+	journal_remove_partial_chunks (directory);
+	g_free (directory);
+
+	if (rotating_settings.rotate_to) {
+		journal_remove_partial_chunks (rotating_settings.rotate_to);
+	}
+
 	ret = db_journal_writer_init (&writer, truncate, TRUE, filename_use, &n_error);
 
 	if (n_error) {
@@ -651,6 +1004,9 @@ tracker_db_journal_shutdown (GError **error)
 	GError *n_error = NULL;
 	gboolean ret;
 
+	/* chunks may get removed or moved once the journal is shut down */
+	journal_wait_for_compression ();
+
 	ret = db_journal_writer_shutdown (&writer, &n_error);
 
 	if (n_error) {
@@ -1292,9 +1648,16 @@ reader_get_next_filepath (JournalReader *jreader)
 static gboolean
 db_journal_reader_init_file (JournalReader  *jreader,
                              const gchar    *filename,
+                             gboolean        verify,
                              GError        **error)
 {
-	if (g_str_has_suffix (filename, ".gz")) {
+	gsize length;
+
+	if (g_str_has_suffix (filename, ".gz") &&
+	    (jreader->buffer = journal_inflate_chunk (filename, &length)) != NULL) {
+		jreader->last_success = jreader->start = jreader->current = jreader->buffer;
+		jreader->end = jreader->current + length;
+	} else if (g_str_has_suffix (filename, ".gz")) {
 		GFile *file;
 		GInputStream *stream, *cstream;
 		GConverter *converter;
@@ -1341,6 +1704,10 @@ db_journal_reader_init_file (JournalReader  *jreader,
 		return FALSE;
 	}
 
+	if (!jreader->stream && verify) {
+		journal_verify_entries (jreader);
+	}
+
 	return TRUE;
 }
 
@@ -1354,7 +1721,7 @@ db_journal_reader_init (JournalReader  *jreader,
 	gchar *filename_open;
 	GError *n_error = NULL;
 
-	g_return_val_if_fail (jreader->file == NULL, FALSE);
+	g_return_val_if_fail (jreader->file == NULL && jreader->buffer == NULL, FALSE);
 
 	/* Used mostly for testing */
 	if (G_UNLIKELY (filename)) {
@@ -1378,7 +1745,7 @@ db_journal_reader_init (JournalReader  *jreader,
 
 	jreader->type = TRACKER_DB_JOURNAL_START;
 
-	if (!db_journal_reader_init_file (jreader, filename_open, &n_error)) {
+	if (!db_journal_reader_init_file (jreader, filename_open, global_reader, &n_error)) {
 		if (!g_error_matches (n_error, G_IO_ERROR, G_IO_ERROR_NOT_FOUND) &&
 		    !g_error_matches (n_error, G_FILE_ERROR, G_FILE_ERROR_NOENT)) {
 			/* Do not set error if the file does not exist, just return FALSE */
@@ -1451,7 +1818,7 @@ tracker_db_journal_reader_ontology_init (const gchar  *filename,
 gsize
 tracker_db_journal_reader_get_size_of_correct (void)
 {
-	g_return_val_if_fail (reader.file != NULL, FALSE);
+	g_return_val_if_fail (reader.start != NULL, FALSE);
 
 	return (gsize) (reader.last_success - reader.start);
 }
@@ -1474,12 +1841,18 @@ reader_next_file (GError **error)
 			reader.underlying_stream_info = NULL;
 		}
 
-	} else {
+	} else if (reader.file) {
 		g_mapped_file_unref (reader.file);
 		reader.file = NULL;
+	} else {
+		g_free (reader.buffer);
+		reader.buffer = NULL;
 	}
 
-	if (!db_journal_reader_init_file (&reader, filename_open, error)) {
+	reader.last_success = reader.start = reader.current = reader.end = NULL;
+	reader.verified_end = NULL;
+
+	if (!db_journal_reader_init_file (&reader, filename_open, TRUE, error)) {
 		g_free (filename_open);
 		tracker_db_journal_reader_shutdown ();
 		return FALSE;
@@ -1511,6 +1884,9 @@ db_journal_reader_shutdown (JournalReader *jreader)
 	} else if (jreader->file) {
 		g_mapped_file_unref (jreader->file);
 		jreader->file = NULL;
+	} else if (jreader->buffer) {
+		g_free (jreader->buffer);
+		jreader->buffer = NULL;
 	}
 
 	g_free (jreader->filename);
@@ -1518,6 +1894,7 @@ db_journal_reader_shutdown (JournalReader *jreader)
 
 	jreader->last_success = NULL;
 	jreader->start = NULL;
+	jreader->verified_end = NULL;
 	jreader->current = NULL;
 	jreader->end = NULL;
 	jreader->entry_begin = NULL;
@@ -1543,7 +1920,7 @@ tracker_db_journal_reader_shutdown (void)
 TrackerDBJournalEntryType
 tracker_db_journal_reader_get_type (void)
 {
-	g_return_val_if_fail (reader.file != NULL || reader.stream != NULL, FALSE);
+	g_return_val_if_fail (reader.start != NULL || reader.stream != NULL, FALSE);
 
 	return reader.type;
 }
@@ -1555,7 +1932,7 @@ db_journal_reader_next (JournalReader *jreader, gboolean global_reader, GError *
 	static gboolean debug_unchecked = TRUE;
 	static gboolean slow_down = FALSE;
 
-	g_return_val_if_fail (jreader->file != NULL || jreader->stream != NULL, FALSE);
+	g_return_val_if_fail (jreader->start != NULL || jreader->stream != NULL, FALSE);
 
 	/* reset struct */
 	g_free (jreader->uri);
@@ -1705,7 +2082,7 @@ db_journal_reader_next (JournalReader *jreader, gboolean global_reader, GError *
 			return FALSE;
 		}
 
-		if (!jreader->stream) {
+		if (!jreader->stream && jreader->entry_begin >= jreader->verified_end) {
 			// Maybe read in whole transaction in one buffer, so we can do CRC even without mmap (when reading compressed journals)
 			// might this be too problematic memory-wise
 
@@ -1910,7 +2287,7 @@ gboolean
 tracker_db_journal_reader_get_resource (gint         *id,
                                         const gchar **uri)
 {
-	g_return_val_if_fail (reader.file != NULL || reader.stream != NULL, FALSE);
+	g_return_val_if_fail (reader.start != NULL || reader.stream != NULL, FALSE);
 	g_return_val_if_fail (reader.type == TRACKER_DB_JOURNAL_RESOURCE, FALSE);
 
 	*id = reader.s_id;
@@ -1925,7 +2302,7 @@ tracker_db_journal_reader_get_statement (gint         *g_id,
                                          gint         *p_id,
                                          const gchar **object)
 {
-	g_return_val_if_fail (reader.file != NULL || reader.stream != NULL, FALSE);
+	g_return_val_if_fail (reader.start != NULL || reader.stream != NULL, FALSE);
 	g_return_val_if_fail (reader.type == TRACKER_DB_JOURNAL_INSERT_STATEMENT ||
 	                      reader.type == TRACKER_DB_JOURNAL_DELETE_STATEMENT ||
 	                      reader.type == TRACKER_DB_JOURNAL_UPDATE_STATEMENT,
@@ -1947,7 +2324,7 @@ tracker_db_journal_reader_get_statement_id (gint *g_id,
                                             gint *p_id,
                                             gint *o_id)
 {
-	g_return_val_if_fail (reader.file != NULL || reader.stream != NULL, FALSE);
+	g_return_val_if_fail (reader.start != NULL || reader.stream != NULL, FALSE);
 	g_return_val_if_fail (reader.type == TRACKER_DB_JOURNAL_INSERT_STATEMENT_ID ||
 	                      reader.type == TRACKER_DB_JOURNAL_DELETE_STATEMENT_ID ||
 	                      reader.type == TRACKER_DB_JOURNAL_UPDATE_STATEMENT_ID,
@@ -2051,26 +2428,137 @@ tracker_db_journal_reader_get_progress (void)
 	return ret;
 }
 
-static void
-on_chunk_copied_delete (GObject      *source_object,
-                        GAsyncResult *res,
-                        gpointer      user_data)
-{
-	GOutputStream *ostream = G_OUTPUT_STREAM (source_object);
-	GError *error = NULL;
-	GFile *source = G_FILE (user_data);
+static gboolean
+journal_compress_chunk (const gchar  *source_path,
+                        const gchar  *dest_path,
+                        GError      **error)
+{
+	GMappedFile *source;
+	const gchar *data;
+	gsize length, offset, block_alloc;
+	gchar *tmp_path;
+	guint8 *block;
+	gboolean ret = TRUE;
+	int fd;
+
+	source = g_mapped_file_new (source_path, FALSE, error);
+	if (!source) {
+		return FALSE;
+	}
+
+	data = g_mapped_file_get_contents (source);
+	length = g_mapped_file_get_length (source);
 
-	g_output_stream_splice_finish (ostream, res, &error);
-	if (!error) {
-		g_file_delete (G_FILE (source), NULL, &error);
+	/* only visible under its final name once complete */
+	tmp_path = g_strconcat (dest_path, ".tmp", NULL);
+	fd = g_open (tmp_path, O_WRONLY | O_CREAT | O_TRUNC | O_LARGEFILE, 0600);
+
+	if (fd < 0) {
+		g_set_error (error, TRACKER_DB_JOURNAL_ERROR,
+		             TRACKER_DB_JOURNAL_ERROR_COULD_NOT_WRITE,
+		             "Could not open compressed journal chunk '%s', %s",
+		             tmp_path,
+		             g_strerror (errno));
+		g_mapped_file_unref (source);
+		g_free (tmp_path);
+		return FALSE;
 	}
 
-	g_object_unref (source);
+	block_alloc = BLOCK_HEADER_SIZE + compressBound (BLOCK_SIZE) + BLOCK_TRAILER_SIZE;
+	block = g_malloc (block_alloc);
+
+	for (offset = 0; ret && offset < length; offset += BLOCK_SIZE) {
+		gsize raw_size = MIN (BLOCK_SIZE, length - offset);
+		gsize block_size;
+		z_stream zs = { 0 };
+
+		/* raw deflate, the gzip framing is written here */
+		if (deflateInit2 (&zs, Z_BEST_SPEED, Z_DEFLATED, -MAX_WBITS, 8, Z_DEFAULT_STRATEGY) != Z_OK) {
+			g_set_error (error, TRACKER_DB_JOURNAL_ERROR,
+			             TRACKER_DB_JOURNAL_ERROR_COULD_NOT_WRITE,
+			             "Could not compress journal chunk '%s'",
+			             source_path);
+			ret = FALSE;
+			break;
+		}
+
+		zs.next_in = (Bytef *) data + offset;
+		zs.avail_in = raw_size;
+		zs.next_out = block + BLOCK_HEADER_SIZE;
+		zs.avail_out = block_alloc - BLOCK_HEADER_SIZE - BLOCK_TRAILER_SIZE;
 
-	if (error) {
+		/* the output buffer is big enough for a single call */
+		deflate (&zs, Z_FINISH);
+		block_size = BLOCK_HEADER_SIZE + zs.total_out + BLOCK_TRAILER_SIZE;
+		deflateEnd (&zs);
+
+		memcpy (block, block_header, sizeof (block_header));
+		write_le32 (block + sizeof (block_header), block_size);
+		write_le32 (block + block_size - 8, crc32 (0, (Bytef *) data + offset, raw_size));
+		write_le32 (block + block_size - 4, raw_size);
+
+		ret = write_all_data (fd, (gchar *) block, block_size, error);
+	}
+
+	g_free (block);
+	g_mapped_file_unref (source);
+
+	if (ret && fsync (fd) != 0) {
+		g_set_error (error, TRACKER_DB_JOURNAL_ERROR,
+		             TRACKER_DB_JOURNAL_ERROR_COULD_NOT_WRITE,
+		             "Could not write compressed journal chunk '%s', %s",
+		             tmp_path,
+		             g_strerror (errno));
+		ret = FALSE;
+	}
+
+	close (fd);
+
+	if (ret && g_rename (tmp_path, dest_path) != 0) {
+		g_set_error (error, TRACKER_DB_JOURNAL_ERROR,
+		             TRACKER_DB_JOURNAL_ERROR_COULD_NOT_WRITE,
+		             "Could not rename compressed journal chunk to '%s', %s",
+		             dest_path,
+		             g_strerror (errno));
+		ret = FALSE;
+	}
+
+	if (!ret) {
+		g_unlink (tmp_path);
+	}
+
+	g_free (tmp_path);
+
+	return ret;
+}
+
+static gpointer
+compress_chunk_thread (gpointer data)
+{
+	gchar **paths = data;
+	GError *error = NULL;
+
+	/* the reader keeps using the uncompressed chunk until it is
+	 * deleted here */
+	if (journal_compress_chunk (paths[0], paths[1], &error)) {
+		g_unlink (paths[0]);
+	} else {
 		g_critical ("Error compressing rotated journal chunk: '%s'", error->message);
 		g_error_free (error);
 	}
+
+	g_strfreev (paths);
+
+	return NULL;
+}
+
+static void
+journal_wait_for_compression (void)
+{
+	if (compress_thread) {
+		g_thread_join (compress_thread);
+		compress_thread = NULL;
+	}
 }
 
 static gboolean
@@ -2080,9 +2568,7 @@ tracker_db_journal_rotate (GError **error)
 	GFile *dest_dir;
 	gchar *filename, *gzfilename;
 	gchar *fullpath;
-	GConverter *converter;
-	GInputStream *istream;
-	GOutputStream *ostream, *cstream;
+	gchar **paths;
 	static gint max = 0;
 	GError *n_error = NULL;
 	gboolean ret;
@@ -2155,16 +2641,15 @@ tracker_db_journal_rotate (GError **error)
 	g_free (filename);
 	g_free (gzfilename);
 
-	istream = G_INPUT_STREAM (g_file_read (source, NULL, NULL));
-	ostream = G_OUTPUT_STREAM (g_file_create (destination, 0, NULL, NULL));
-	converter = G_CONVERTER (g_zlib_compressor_new (G_ZLIB_COMPRESSOR_FORMAT_GZIP, -1));
-	cstream = g_converter_output_stream_new (ostream, converter);
-	g_output_stream_splice_async (cstream, istream, 0, 0, NULL, on_chunk_copied_delete, source);
-	g_object_unref (istream);
-	g_object_unref (ostream);
-	g_object_unref (converter);
-	g_object_unref (cstream);
+	paths = g_new0 (gchar *, 3);
+	paths[0] = g_file_get_path (source);
+	paths[1] = g_file_get_path (destination);
 
+	/* one chunk at a time, rotating faster than compressing is rare */
+	journal_wait_for_compression ();
+	compress_thread = g_thread_new ("journal-compress", compress_chunk_thread, paths);
+
+	g_object_unref (source);
 	g_object_unref (destination);
 
 	g_free (fullpath);
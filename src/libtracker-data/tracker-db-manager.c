@@ -58,6 +58,7 @@
 #define TRACKER_DB_VERSION_NOW        TRACKER_DB_VERSION_0_15_2
 #define TRACKER_DB_VERSION_FILE       "db-version.txt"
 #define TRACKER_DB_LOCALE_FILE        "db-locale.txt"
+#define TRACKER_DB_FTS_CONFIG_FILE    "db-fts-config.txt"
 
 #define IN_USE_FILENAME               ".meta.isrunning"
 
@@ -159,12 +160,41 @@ static TrackerDBManagerFlags old_flags = 0;
 static guint                 s_cache_size;
 static guint                 u_cache_size;
 
-static GPrivate              interface_data_key = G_PRIVATE_INIT ((GDestroyNotify)g_object_unref);
+typedef struct {
+	TrackerDBInterface *iface;
+	/* connections opened before the last shutdown are stale */
+	guint generation;
+} ThreadInterface;
+
+static void                  thread_interface_free (ThreadInterface *data);
+
+static GPrivate              interface_data_key = G_PRIVATE_INIT ((GDestroyNotify) thread_interface_free);
+static guint                 interface_generation;
 
-/* mutex used by singleton connection in libtracker-direct, not used by tracker-store */
+/* mutex used by libtracker-direct connection setup, not used by tracker-store */
 static GMutex                global_mutex;
 
-static TrackerDBInterface   *global_iface;
+static void
+thread_interface_free (ThreadInterface *data)
+{
+	g_object_unref (data->iface);
+	g_slice_free (ThreadInterface, data);
+}
+
+/* Takes ownership of iface */
+static void
+thread_interface_set (TrackerDBInterface *iface)
+{
+	ThreadInterface *data = NULL;
+
+	if (iface) {
+		data = g_slice_new (ThreadInterface);
+		data->iface = iface;
+		data->generation = interface_generation;
+	}
+
+	g_private_replace (&interface_data_key, data);
+}
 
 static const gchar *
 location_to_directory (TrackerDBLocation location)
@@ -500,8 +530,9 @@ db_manager_remove_all (gboolean rm_journal)
 		tracker_db_manager_remove_version_file ();
 	}
 
-	/* Remove locale file also */
+	/* Remove locale and FTS config files also */
 	db_remove_locale_file ();
+	db_remove_fts_config_file ();
 }
 
 static TrackerDBVersion
@@ -587,6 +618,17 @@ db_remove_locale_file (void)
 	g_free (filename);
 }
 
+static void
+db_remove_fts_config_file (void)
+{
+	gchar *filename;
+
+	filename = g_build_filename (data_dir, TRACKER_DB_FTS_CONFIG_FILE, NULL);
+	g_message ("  Removing db-fts-config file:'%s'", filename);
+	g_unlink (filename);
+	g_free (filename);
+}
+
 static gchar *
 db_get_locale (void)
 {
@@ -694,6 +736,83 @@ tracker_db_manager_set_current_locale (void)
 	g_free (current_locale);
 }
 
+/* Without a locale file, indexes are recreated on the next start */
+void
+tracker_db_manager_unset_current_locale (void)
+{
+	db_remove_locale_file ();
+}
+
+/* Databases without a FTS config file are assumed to be indexed with
+ * the current tokenizer settings, they were either just created or
+ * indexed by an older version. Otherwise the full-text index needs to
+ * be rebuilt if the settings differ.
+ */
+gboolean
+tracker_db_manager_fts_config_changed (void)
+{
+#if HAVE_TRACKER_FTS
+	gchar *db_config;
+	gchar *current_config;
+	gchar *filename;
+	gboolean changed;
+
+	if (!locations_initialized) {
+		tracker_db_manager_init_locations ();
+	}
+
+	filename = g_build_filename (data_dir, TRACKER_DB_FTS_CONFIG_FILE, NULL);
+
+	if (!g_file_get_contents (filename, &db_config, NULL, NULL)) {
+		g_free (filename);
+		tracker_db_manager_set_current_fts_config ();
+		return FALSE;
+	}
+
+	g_free (filename);
+
+	current_config = tracker_fts_get_tokenizer_config ();
+
+	if (g_strcmp0 (db_config, current_config) != 0) {
+		g_message ("FTS config change detected from '%s' to '%s'...",
+		           db_config, current_config);
+		changed = TRUE;
+	} else {
+		changed = FALSE;
+	}
+
+	g_free (db_config);
+	g_free (current_config);
+
+	return changed;
+#else
+	return FALSE;
+#endif
+}
+
+void
+tracker_db_manager_set_current_fts_config (void)
+{
+#if HAVE_TRACKER_FTS
+	GError *error = NULL;
+	gchar *current_config;
+	gchar *filename;
+
+	current_config = tracker_fts_get_tokenizer_config ();
+	filename = g_build_filename (data_dir, TRACKER_DB_FTS_CONFIG_FILE, NULL);
+	g_message ("  Creating FTS config file '%s'", filename);
+
+	if (!g_file_set_contents (filename, current_config, -1, &error)) {
+		g_message ("  Could not set file contents, %s",
+		           error ? error->message : "no error given");
+		g_clear_error (&error);
+	}
+
+	g_free (filename);
+	g_free (current_config);
+#endif
+}
+
 static void
 db_manager_analyze (TrackerDB           db,
                     TrackerDBInterface *iface)
@@ -1195,8 +1314,6 @@ tracker_db_manager_init (TrackerDBManagerFlags   flags,
 	if (flags & TRACKER_DB_MANAGER_READONLY) {
 		resources_iface = tracker_db_manager_get_db_interfaces_ro (&internal_error, 1,
 		                                                           TRACKER_DB_METADATA);
-		/* libtracker-direct does not use per-thread interfaces */
-		global_iface = resources_iface;
 	} else {
 		resources_iface = tracker_db_manager_get_db_interfaces (&internal_error, 1,
 		                                                        TRACKER_DB_METADATA);
@@ -1235,8 +1352,7 @@ tracker_db_manager_init (TrackerDBManagerFlags   flags,
 	s_cache_size = select_cache_size;
 	u_cache_size = update_cache_size;
 
-	if ((flags & TRACKER_DB_MANAGER_READONLY) == 0)
-		g_private_replace (&interface_data_key, resources_iface);
+	thread_interface_set (resources_iface);
 
 	return TRUE;
 }
@@ -1267,14 +1383,10 @@ tracker_db_manager_shutdown (void)
 	g_free (user_data_dir);
 	user_data_dir = NULL;
 
-	if (global_iface) {
-		/* libtracker-direct */
-		g_object_unref (global_iface);
-		global_iface = NULL;
-	}
-
-	/* shutdown db interface in all threads */
-	g_private_replace (&interface_data_key, NULL);
+	/* shutdown db interface in all threads, others get closed
+	 * when their thread exits or asks for a new one */
+	interface_generation++;
+	thread_interface_set (NULL);
 
 	/* Since we don't reference this enum anywhere, we do
 	 * it here to make sure it exists when we call
@@ -1476,40 +1588,76 @@ tracker_db_manager_get_db_interface (void)
 {
 	GError *internal_error = NULL;
 	TrackerDBInterface *interface;
+	ThreadInterface *data;
 
 	g_return_val_if_fail (initialized != FALSE, NULL);
 
-	if (global_iface) {
-		/* libtracker-direct */
-		return global_iface;
-	}
+	data = g_private_get (&interface_data_key);
 
-	interface = g_private_get (&interface_data_key);
+	if (data && data->generation == interface_generation) {
+		return data->iface;
+	}
 
 	/* Ensure the interface is there */
-	if (!interface) {
+	if (old_flags & TRACKER_DB_MANAGER_READONLY) {
+		/* libtracker-direct, every thread reads through its
+		 * own connection and WAL snapshot */
+		interface = tracker_db_manager_get_db_interfaces_ro (&internal_error, 1,
+		                                                     TRACKER_DB_METADATA);
+	} else {
 		interface = tracker_db_manager_get_db_interfaces (&internal_error, 1,
 		                                                  TRACKER_DB_METADATA);
+	}
 
-		if (internal_error) {
-			g_critical ("Error opening database: %s", internal_error->message);
-			g_error_free (internal_error);
-			return NULL;
-		}
+	if (internal_error) {
+		g_critical ("Error opening database: %s", internal_error->message);
+		g_error_free (internal_error);
+		return NULL;
+	}
 
-		tracker_data_manager_init_fts (interface, FALSE);
+	tracker_data_manager_init_fts (interface, FALSE);
 
-		tracker_db_interface_set_max_stmt_cache_size (interface,
-		                                              TRACKER_DB_STATEMENT_CACHE_TYPE_SELECT,
-		                                              s_cache_size);
+	tracker_db_interface_set_max_stmt_cache_size (interface,
+	                                              TRACKER_DB_STATEMENT_CACHE_TYPE_SELECT,
+	                                              s_cache_size);
 
-		tracker_db_interface_set_max_stmt_cache_size (interface,
-		                                              TRACKER_DB_STATEMENT_CACHE_TYPE_UPDATE,
-		                                              u_cache_size);
+	tracker_db_interface_set_max_stmt_cache_size (interface,
+	                                              TRACKER_DB_STATEMENT_CACHE_TYPE_UPDATE,
+	                                              u_cache_size);
+
+	thread_interface_set (interface);
+
+	return interface;
+}
 
-		g_private_set (&interface_data_key, interface);
+/**
+ * tracker_db_manager_detach_db_interface:
+ *
+ * Detaches the database connection of the current thread, the next
+ * call to tracker_db_manager_get_db_interface() in this thread will
+ * open a new one. This allows a cursor that is still in use to be
+ * handed over to another thread.
+ *
+ * returns: (caller-owns): the detached connection, or %NULL if there
+ * was none.
+ **/
+TrackerDBInterface *
+tracker_db_manager_detach_db_interface (void)
+{
+	TrackerDBInterface *interface;
+	ThreadInterface *data;
+
+	g_return_val_if_fail (initialized != FALSE, NULL);
+
+	data = g_private_get (&interface_data_key);
+
+	if (!data || data->generation != interface_generation) {
+		return NULL;
 	}
 
+	interface = g_object_ref (data->iface);
+	thread_interface_set (NULL);
+
 	return interface;
 }
 
@@ -66,6 +66,7 @@ void                tracker_db_manager_remove_all             (gboolean
 void                tracker_db_manager_optimize               (void);
 const gchar *       tracker_db_manager_get_file               (TrackerDB              db);
 TrackerDBInterface *tracker_db_manager_get_db_interface       (void);
+TrackerDBInterface *tracker_db_manager_detach_db_interface    (void);
 void                tracker_db_manager_init_locations         (void);
 gboolean            tracker_db_manager_has_enough_space       (void);
 void                tracker_db_manager_create_version_file    (void);
@@ -89,6 +90,9 @@ void                tracker_db_manager_set_need_mtime_check   (gboolean needed);
 
 gboolean            tracker_db_manager_locale_changed         (void);
 void                tracker_db_manager_set_current_locale     (void);
+void                tracker_db_manager_unset_current_locale   (void);
+gboolean            tracker_db_manager_fts_config_changed     (void);
+void                tracker_db_manager_set_current_fts_config (void);
 
 G_END_DECLS
 
@@ -241,16 +241,16 @@ class Tracker.Sparql.Expression : Object {
 		}
 	}
 
-	internal void translate_order_condition (StringBuilder sql) throws Sparql.Error {
+	// Translates the expression of an order condition without its
+	// direction, returns true for descending order
+	internal bool translate_order_key (StringBuilder sql) throws Sparql.Error {
+		bool descending = false;
 		if (accept (SparqlTokenType.ASC)) {
-			translate_expression_as_order_condition (sql);
-			sql.append (" ASC");
 		} else if (accept (SparqlTokenType.DESC)) {
-			translate_expression_as_order_condition (sql);
-			sql.append (" DESC");
-		} else {
-			translate_expression_as_order_condition (sql);
+			descending = true;
 		}
+		translate_expression_as_order_condition (sql);
+		return descending;
 	}
 
 	void translate_bound_call (StringBuilder sql) throws Sparql.Error {
@@ -947,6 +947,18 @@ class Tracker.Sparql.Expression : Object {
 		type = PropertyType.STRING;
 
 		next ();
+		string result = get_last_string_literal ();
+
+		if (accept (SparqlTokenType.DOUBLE_CIRCUMFLEX)) {
+			// typed literal
+			type = parse_type_uri ();
+		}
+
+		return result;
+	}
+
+	// value of the string literal token that was just consumed
+	internal string get_last_string_literal () throws Sparql.Error {
 		switch (last ()) {
 		case SparqlTokenType.STRING_LITERAL1:
 		case SparqlTokenType.STRING_LITERAL2:
@@ -995,22 +1007,10 @@ class Tracker.Sparql.Expression : Object {
 				}
 			}
 
-			if (accept (SparqlTokenType.DOUBLE_CIRCUMFLEX)) {
-				// typed literal
-				type = parse_type_uri ();
-			}
-
 			return sb.str;
 		case SparqlTokenType.STRING_LITERAL_LONG1:
 		case SparqlTokenType.STRING_LITERAL_LONG2:
-			string result = get_last_string (3);
-
-			if (accept (SparqlTokenType.DOUBLE_CIRCUMFLEX)) {
-				// typed literal
-				type = parse_type_uri ();
-			}
-
-			return result;
+			return get_last_string (3);
 		default:
 			throw get_error ("expected string literal");
 		}
@@ -1052,6 +1052,7 @@ class Tracker.Sparql.Expression : Object {
 
 				var binding = new LiteralBinding ();
 				binding.literal = get_last_string ();
+				query.lift_literal (binding, query.last_literal);
 				query.bindings.append (binding);
 			}
 
@@ -1104,6 +1105,7 @@ class Tracker.Sparql.Expression : Object {
 					var binding = new LiteralBinding ();
 					binding.literal = literal;
 					binding.data_type = type;
+					query.lift_literal (binding, query.last_literal);
 					query.bindings.append (binding);
 					sql.append ("?");
 				}
@@ -1114,6 +1116,7 @@ class Tracker.Sparql.Expression : Object {
 				} else {
 					var binding = new LiteralBinding ();
 					binding.literal = literal;
+					query.lift_literal (binding, query.last_literal);
 					query.bindings.append (binding);
 					sql.append ("?");
 				}
@@ -1131,6 +1134,7 @@ class Tracker.Sparql.Expression : Object {
 				var binding = new LiteralBinding ();
 				binding.literal = get_last_string ();
 				binding.data_type = PropertyType.INTEGER;
+				query.lift_literal (binding, query.last_literal);
 				query.bindings.append (binding);
 			}
 
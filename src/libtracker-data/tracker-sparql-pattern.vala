@@ -32,6 +32,9 @@ namespace Tracker.Sparql {
 
 				if (subject != null) {
 					// single subject
+					// the SQL depends on the types of the subject, not only on the query
+					query.cache_plan = false;
+
 					var subject_id = Data.query_resource_id (subject);
 
 					DBCursor cursor = null;
@@ -83,6 +86,8 @@ namespace Tracker.Sparql {
 					}
 				} else if (object != null) {
 					// single object
+					query.cache_plan = false;
+
 					var object_id = Data.query_resource_id (object);
 
 					var iface = DBManager.get_db_interface ();
@@ -156,6 +161,15 @@ namespace Tracker.Sparql {
 }
 
 class Tracker.Sparql.Pattern : Object {
+	const string RDFS_RESOURCE = "http://www.w3.org/2000/01/rdf-schema#Resource";
+
+	// fraction of rows assumed to match a literal in a column that is not unique
+	const double LITERAL_SELECTIVITY = 0.1;
+	// fraction of resources assumed to match a full-text search
+	const double FTS_MATCH_SELECTIVITY = 0.01;
+	// instances assumed for every class without class counts
+	const double UNKNOWN_CLASS_ROWS = 1000;
+
 	weak Query query;
 	weak Expression expression;
 
@@ -174,6 +188,13 @@ class Tracker.Sparql.Pattern : Object {
 	internal StringBuilder? match_str;
 	public bool queries_fts_data = false;
 
+	// describes translation decisions when set, see Query.explain
+	internal StringBuilder? explain;
+
+	// FILTERs of the current group graph pattern, see push_down_filters
+	SourceLocation[] group_filters;
+	bool[] group_filters_pushed;
+
 	public Pattern (Query query) {
 		this.query = query;
 		this.expression = query.expression;
@@ -259,8 +280,10 @@ class Tracker.Sparql.Pattern : Object {
 
 		expect (SparqlTokenType.SELECT);
 
+		bool distinct = false;
 		if (accept (SparqlTokenType.DISTINCT)) {
 			sql.append ("DISTINCT ");
+			distinct = true;
 		} else if (accept (SparqlTokenType.REDUCED)) {
 		}
 
@@ -360,6 +383,9 @@ class Tracker.Sparql.Pattern : Object {
 			sql.append ("NULL");
 		}
 
+		// ORDER BY keys of continuable queries are selected here
+		long select_end = sql.len;
+
 		// select from results of WHERE clause
 		sql.append (" FROM (");
 		sql.append (pattern_sql.str);
@@ -367,8 +393,10 @@ class Tracker.Sparql.Pattern : Object {
 
 		set_location (after_where);
 
+		bool grouped = false;
 		if (accept (SparqlTokenType.GROUP)) {
 			expect (SparqlTokenType.BY);
+			grouped = true;
 			sql.append (" GROUP BY ");
 			bool first_group = true;
 			do {
@@ -386,9 +414,15 @@ class Tracker.Sparql.Pattern : Object {
 			}
 		}
 
+		var order_keys = new GenericArray<string> ();
+		bool[] order_descending = {};
+		bool has_order_bindings = false;
+		long order_start = sql.len;
+
 		if (accept (SparqlTokenType.ORDER)) {
 			expect (SparqlTokenType.BY);
 			sql.append (" ORDER BY ");
+			uint n_bindings = query.bindings.length ();
 			bool first_order = true;
 			do {
 				if (first_order) {
@@ -396,26 +430,355 @@ class Tracker.Sparql.Pattern : Object {
 				} else {
 					sql.append (", ");
 				}
-				expression.translate_order_condition (sql);
+				var key = new StringBuilder ();
+				bool descending = expression.translate_order_key (key);
+				sql.append (key.str);
+				if (descending) {
+					sql.append (" DESC");
+				}
+				order_keys.add (key.str);
+				order_descending += descending;
 			} while (current () != SparqlTokenType.LIMIT && current () != SparqlTokenType.OFFSET && current () != SparqlTokenType.CLOSE_BRACE && current () != SparqlTokenType.CLOSE_PARENS && current () != SparqlTokenType.EOF);
+			has_order_bindings = query.bindings.length () != n_bindings;
+		}
+
+		if (!subquery && query.continuable) {
+			// keys are repeated in the SQL, they must not take parameters
+			if (order_keys.length > 0 && !distinct && !grouped && !has_order_bindings &&
+			    !(queries_fts_data && fts_subject != null)) {
+				add_continuation_keys (sql, select_end, order_start, order_keys, ref order_descending);
+				result.n_keys = order_keys.length;
+			} else if (query.continuation != null) {
+				throw new Sparql.Error.UNSUPPORTED ("Only queries with ORDER BY and without DISTINCT, GROUP BY or full text search can be continued");
+			}
+		}
+
+		translate_limit_offset (sql);
+
+		if (queries_fts_data && match_str != null && fts_subject != null) {
+			var str = new StringBuilder ("SELECT ");
+			first = true;
+
+			foreach (var fts_var in fts_variables) {
+				if (!first) {
+					str.append (", ");
+				} else {
+					first = false;
+				}
+
+				str.append (fts_var);
+			}
+
+			str.append (" FROM fts JOIN (");
+			sql.prepend (str.str);
+			sql.append_printf (") AS ranks USING (docid) WHERE fts %s".printf (match_str.str));
 		}
 
+		context = context.parent_context;
+
+		result.type = type;
+		match_str = null;
+		fts_subject = null;
+
+		return result;
+	}
+
+	// Answers SELECT ?v COUNT(?x) WHERE { ?x a C ; P ?v } GROUP BY ?v
+	// and its variations from the aggregate view of C and P instead of
+	// scanning the class, see tracker-data-aggregates.c. Returns null and
+	// leaves the query where it was if there is no matching view.
+	internal SelectContext? translate_aggregate_select (StringBuilder sql) throws Sparql.Error {
+		if (query.continuable) {
+			return null;
+		}
+
+		var begin = get_location ();
+		var result = match_aggregate_select (sql);
+		if (result == null) {
+			set_location (begin);
+		}
+
+		return result;
+	}
+
+	// Literal tokens are never consumed before the query is known to
+	// match, so that the plan cache sees each literal once
+	SelectContext? match_aggregate_select (StringBuilder sql) throws Sparql.Error {
+		expect (SparqlTokenType.SELECT);
+		accept (SparqlTokenType.DISTINCT);
+
+		// select variables, null for counts
+		string?[] items = {};
+		string[] names = {};
+		string[] counted = {};
+		bool[] counted_distinct = {};
+
+		while (current () != SparqlTokenType.WHERE && current () != SparqlTokenType.OPEN_BRACE) {
+			string count_variable;
+			bool distinct;
+
+			if (accept (SparqlTokenType.VAR)) {
+				items += get_last_string ().substring (1);
+				names += get_last_string ().substring (1);
+				continue;
+			}
+
+			bool parens = accept (SparqlTokenType.OPEN_PARENS);
+			if (!accept_count (out count_variable, out distinct)) {
+				return null;
+			}
+
+			if (accept (SparqlTokenType.AS)) {
+				if (!accept (SparqlTokenType.VAR)) {
+					return null;
+				}
+				names += get_last_string ().substring (1);
+			} else if (parens) {
+				return null;
+			} else {
+				names += "var%d".printf (items.length + 1);
+			}
+
+			if (parens && !accept (SparqlTokenType.CLOSE_PARENS)) {
+				return null;
+			}
+
+			items += null;
+			counted += count_variable;
+			counted_distinct += distinct;
+		}
+
+		if (items.length == 0) {
+			return null;
+		}
+
+		accept (SparqlTokenType.WHERE);
+
+		// { ?x a C ; P ?v }, in any order
+		string subject = null;
+		string value = null;
+		Class cl = null;
+		Property prop = null;
+
+		if (!accept (SparqlTokenType.OPEN_BRACE)) {
+			return null;
+		}
+
+		while (!accept (SparqlTokenType.CLOSE_BRACE)) {
+			if (!accept (SparqlTokenType.VAR) || (subject != null && get_last_string ().substring (1) != subject)) {
+				return null;
+			}
+			subject = get_last_string ().substring (1);
+
+			while (true) {
+				string predicate = accept_aggregate_iri ();
+				if (predicate == null) {
+					return null;
+				}
+
+				if (predicate == "http://www.w3.org/1999/02/22-rdf-syntax-ns#type") {
+					string object = accept_aggregate_iri ();
+					if (cl != null || object == null) {
+						return null;
+					}
+					cl = Ontologies.get_class_by_uri (object);
+					if (cl == null) {
+						return null;
+					}
+				} else {
+					if (prop != null || !accept (SparqlTokenType.VAR)) {
+						return null;
+					}
+					prop = Ontologies.get_property_by_uri (predicate);
+					value = get_last_string ().substring (1);
+					if (prop == null) {
+						return null;
+					}
+				}
+
+				if (!accept (SparqlTokenType.SEMICOLON) ||
+				    current () == SparqlTokenType.DOT || current () == SparqlTokenType.CLOSE_BRACE) {
+					break;
+				}
+			}
+
+			if (!accept (SparqlTokenType.DOT) && current () != SparqlTokenType.CLOSE_BRACE) {
+				return null;
+			}
+		}
+
+		if (cl == null || prop == null || subject == value) {
+			return null;
+		}
+
+		if (!accept (SparqlTokenType.GROUP) || !accept (SparqlTokenType.BY) ||
+		    !accept (SparqlTokenType.VAR) || get_last_string ().substring (1) != value) {
+			return null;
+		}
+
+		for (int i = 0; i < items.length; i++) {
+			if (items[i] != null && items[i] != value) {
+				return null;
+			}
+		}
+
+		for (int i = 0; i < counted.length; i++) {
+			// every value appears once per group
+			if (counted[i] != "*" && counted[i] != subject && (counted[i] != value || counted_distinct[i])) {
+				return null;
+			}
+		}
+
+		unowned string? view = Data.aggregates_lookup (cl, prop);
+		if (view == null) {
+			return null;
+		}
+
+		string value_key;
+		if (prop.data_type == PropertyType.RESOURCE) {
+			value_key = "(SELECT Uri FROM Resource WHERE ID = Value)";
+		} else {
+			value_key = "Value";
+		}
+
+		var order = new StringBuilder ();
+		if (accept (SparqlTokenType.ORDER)) {
+			if (!accept (SparqlTokenType.BY)) {
+				return null;
+			}
+
+			do {
+				bool descending = false;
+				if (accept (SparqlTokenType.ASC)) {
+				} else if (accept (SparqlTokenType.DESC)) {
+					descending = true;
+				}
+
+				bool parens = accept (SparqlTokenType.OPEN_PARENS);
+
+				string key = null;
+				if (accept (SparqlTokenType.VAR)) {
+					string name = get_last_string ().substring (1);
+					if (name == value) {
+						key = value_key;
+					} else {
+						for (int i = 0; i < items.length; i++) {
+							if (items[i] == null && names[i] == name) {
+								key = "Count";
+							}
+						}
+					}
+				} else {
+					string count_variable;
+					bool distinct;
+					if (accept_count (out count_variable, out distinct) &&
+					    (count_variable == "*" || count_variable == subject)) {
+						key = "Count";
+					}
+				}
+
+				if (key == null || (parens && !accept (SparqlTokenType.CLOSE_PARENS))) {
+					return null;
+				}
+
+				order.append (order.len == 0 ? " ORDER BY " : ", ");
+				order.append (key);
+				if (descending) {
+					order.append (" DESC");
+				}
+			} while (current () != SparqlTokenType.LIMIT && current () != SparqlTokenType.OFFSET && current () != SparqlTokenType.EOF);
+		} else if (current () != SparqlTokenType.LIMIT && current () != SparqlTokenType.OFFSET && current () != SparqlTokenType.EOF) {
+			return null;
+		}
+
+		var result = new SelectContext (query, context);
+
+		sql.append ("SELECT ");
+		for (int i = 0; i < items.length; i++) {
+			if (i > 0) {
+				sql.append (", ");
+			}
+
+			if (items[i] != null) {
+				Expression.append_expression_as_string (sql, "Value", prop.data_type);
+				result.types += prop.data_type;
+			} else {
+				sql.append ("Count");
+				result.types += PropertyType.INTEGER;
+			}
+			result.variable_names += names[i];
+		}
+		sql.append_printf (" FROM \"%s\"", view);
+		sql.append (order.str);
+
+		translate_limit_offset (sql);
+
+		result.type = result.types[result.types.length - 1];
+
+		return result;
+	}
+
+	bool accept_count (out string variable, out bool distinct) throws Sparql.Error {
+		variable = null;
+		distinct = false;
+
+		if (!accept (SparqlTokenType.COUNT) || !accept (SparqlTokenType.OPEN_PARENS)) {
+			return false;
+		}
+
+		distinct = accept (SparqlTokenType.DISTINCT);
+
+		if (accept (SparqlTokenType.STAR)) {
+			variable = "*";
+		} else if (accept (SparqlTokenType.VAR)) {
+			variable = get_last_string ().substring (1);
+		} else {
+			return false;
+		}
+
+		return accept (SparqlTokenType.CLOSE_PARENS);
+	}
+
+	string? accept_aggregate_iri () throws Sparql.Error {
+		if (accept (SparqlTokenType.A)) {
+			return "http://www.w3.org/1999/02/22-rdf-syntax-ns#type";
+		} else if (accept (SparqlTokenType.IRI_REF)) {
+			return get_last_string (1);
+		} else if (accept (SparqlTokenType.PN_PREFIX)) {
+			string ns = get_last_string ();
+			expect (SparqlTokenType.COLON);
+			return query.resolve_prefixed_name (ns, get_last_string ().substring (1));
+		} else if (accept (SparqlTokenType.COLON)) {
+			return query.resolve_prefixed_name ("", get_last_string ().substring (1));
+		}
+
+		return null;
+	}
+
+	void translate_limit_offset (StringBuilder sql) throws Sparql.Error {
 		int limit = -1;
 		int offset = -1;
+		// literal index of LIMIT and OFFSET values, see Query.lift_literal
+		int limit_literal = -1;
+		int offset_literal = -1;
 
 		if (accept (SparqlTokenType.LIMIT)) {
 			expect (SparqlTokenType.INTEGER);
 			limit = int.parse (get_last_string ());
+			limit_literal = query.last_literal;
 			if (accept (SparqlTokenType.OFFSET)) {
 				expect (SparqlTokenType.INTEGER);
 				offset = int.parse (get_last_string ());
+				offset_literal = query.last_literal;
 			}
 		} else if (accept (SparqlTokenType.OFFSET)) {
 			expect (SparqlTokenType.INTEGER);
 			offset = int.parse (get_last_string ());
+			offset_literal = query.last_literal;
 			if (accept (SparqlTokenType.LIMIT)) {
 				expect (SparqlTokenType.INTEGER);
 				limit = int.parse (get_last_string ());
+				limit_literal = query.last_literal;
 			}
 		}
 
@@ -426,6 +789,7 @@ class Tracker.Sparql.Pattern : Object {
 			var binding = new LiteralBinding ();
 			binding.literal = limit.to_string ();
 			binding.data_type = PropertyType.INTEGER;
+			query.lift_literal (binding, limit_literal);
 			query.bindings.append (binding);
 
 			if (offset >= 0) {
@@ -434,6 +798,7 @@ class Tracker.Sparql.Pattern : Object {
 				binding = new LiteralBinding ();
 				binding.literal = offset.to_string ();
 				binding.data_type = PropertyType.INTEGER;
+				query.lift_literal (binding, offset_literal);
 				query.bindings.append (binding);
 			}
 		} else if (offset >= 0) {
@@ -442,35 +807,59 @@ class Tracker.Sparql.Pattern : Object {
 			var binding = new LiteralBinding ();
 			binding.literal = offset.to_string ();
 			binding.data_type = PropertyType.INTEGER;
+			query.lift_literal (binding, offset_literal);
 			query.bindings.append (binding);
 		}
+	}
 
-		if (queries_fts_data && match_str != null && fts_subject != null) {
-			var str = new StringBuilder ("SELECT ");
-			first = true;
+	// Makes the query resumable after any row. The variables are added
+	// to the ORDER BY so that rows are in a total order, all keys are
+	// selected after the variables, and with a continuation only rows
+	// sorting after the one it was taken from are kept.
+	void add_continuation_keys (StringBuilder sql, long select_end, long order_start, GenericArray<string> keys, ref bool[] descending) throws Sparql.Error {
+		var variables = new List<Variable> ();
+		foreach (var variable in context.var_set.get_keys ()) {
+			variables.insert_sorted (variable, (a, b) => strcmp (a.name, b.name));
+		}
+		foreach (var variable in variables) {
+			sql.append_printf (", %s", variable.sql_expression);
+			keys.add (variable.sql_expression);
+			descending += false;
+		}
 
-			foreach (var fts_var in fts_variables) {
-				if (!first) {
-					str.append (", ");
+		if (query.continuation != null) {
+			var values = query.get_continuation_keys (keys.length);
+
+			// rows after the continuation, in lexicographic key order
+			var condition = new StringBuilder (" WHERE ");
+			for (int i = 0; i < keys.length; i++) {
+				if (i > 0) {
+					condition.append (" OR ");
+				}
+				condition.append ("(");
+				for (int j = 0; j < i; j++) {
+					condition.append_printf ("%s IS %s AND ", keys[j], values[j] ?? "NULL");
+				}
+				// SQLite sorts NULL before all other values
+				if (!descending[i] && values[i] == null) {
+					condition.append_printf ("%s IS NOT NULL", keys[i]);
+				} else if (!descending[i]) {
+					condition.append_printf ("%s > %s", keys[i], values[i]);
+				} else if (values[i] == null) {
+					condition.append ("0");
 				} else {
-					first = false;
+					condition.append_printf ("(%s < %s OR %s IS NULL)", keys[i], values[i], keys[i]);
 				}
-
-				str.append (fts_var);
+				condition.append (")");
 			}
-
-			str.append (" FROM fts JOIN (");
-			sql.prepend (str.str);
-			sql.append_printf (") AS ranks USING (docid) WHERE fts %s".printf (match_str.str));
+			sql.insert (order_start, condition.str);
 		}
 
-		context = context.parent_context;
-
-		result.type = type;
-		match_str = null;
-		fts_subject = null;
-
-		return result;
+		var columns = new StringBuilder ();
+		for (int i = 0; i < keys.length; i++) {
+			columns.append_printf (", %s AS \"_key%d\"", keys[i], i);
+		}
+		sql.insert (select_end, columns.str);
 	}
 
 	internal void translate_exists (StringBuilder sql) throws Sparql.Error {
@@ -684,7 +1073,7 @@ class Tracker.Sparql.Pattern : Object {
 
 		sql.append (" FROM ");
 		bool first = true;
-		foreach (DataTable table in triple_context.tables) {
+		foreach (DataTable table in order_tables ()) {
 			if (!first) {
 				sql.append (", ");
 			} else {
@@ -783,6 +1172,11 @@ class Tracker.Sparql.Pattern : Object {
 			}
 		}
 
+		if (!in_group_graph_pattern) {
+			// first triples block of the group graph pattern
+			push_down_filters (sql, ref first_where);
+		}
+
 		if (in_group_graph_pattern) {
 			sql.append (")");
 		}
@@ -795,6 +1189,190 @@ class Tracker.Sparql.Pattern : Object {
 		context = context.parent_context;
 	}
 
+	// Orders the tables of the current triples block for the join. The
+	// table expected to match the fewest rows comes first, followed by
+	// the tables sharing a variable with the tables ordered so far.
+	// SQLite keeps the FROM order for plans it considers equally
+	// expensive, which without ANALYZE statistics is the common case.
+	DataTable[] order_tables () {
+		var remaining = new GenericArray<DataTable> ();
+		foreach (DataTable table in triple_context.tables) {
+			remaining.add (table);
+		}
+
+		var bound_variables = new HashTable<Variable,int>.full (Variable.hash, Variable.equal, g_object_unref, null);
+		DataTable[] result = { };
+
+		while (remaining.length > 0) {
+			int best = -1;
+			bool best_joined = false;
+
+			for (int i = 0; i < remaining.length; i++) {
+				bool joined = is_joined_table (remaining[i], bound_variables);
+
+				// ties keep the order of the query
+				if (best < 0 || (joined && !best_joined) ||
+				    (joined == best_joined && remaining[i].estimated_rows < remaining[best].estimated_rows)) {
+					best = i;
+					best_joined = joined;
+				}
+			}
+
+			var table = remaining[best];
+			remaining.remove_index (best);
+			result += table;
+
+			foreach (var variable in triple_context.variables) {
+				foreach (VariableBinding binding in triple_context.var_bindings.lookup (variable).list) {
+					if (binding.table == table) {
+						bound_variables.insert (variable, 1);
+						break;
+					}
+				}
+			}
+		}
+
+		if (explain != null) {
+			explain.append ("join order:");
+			foreach (var table in result) {
+				explain.append_printf (" %s (~%.0f rows)", table.sql_query_tablename, table.estimated_rows);
+			}
+			explain.append_c ('\n');
+		}
+
+		return result;
+	}
+
+	bool is_joined_table (DataTable table, HashTable<Variable,int> bound_variables) {
+		foreach (var variable in triple_context.variables) {
+			if (!bound_variables.contains (variable)) {
+				continue;
+			}
+			foreach (VariableBinding binding in triple_context.var_bindings.lookup (variable).list) {
+				if (binding.table == table) {
+					return true;
+				}
+			}
+		}
+		return false;
+	}
+
+	// Instances of the specified class, or of all resources for null
+	double get_class_rows (Class? cl) {
+		if (cl == null) {
+			cl = Ontologies.get_class_by_uri (RDFS_RESOURCE);
+		}
+
+		// only loaded by the writer, the query would take too
+		// long and race with updates here
+		if (!Data.query_class_counts_loaded ()) {
+			return UNKNOWN_CLASS_ROWS;
+		}
+
+		return double.max (cl.count, 1);
+	}
+
+	// Returns the top-level FILTERs of the group graph pattern starting
+	// at the current location, the location is left unchanged
+	SourceLocation[] scan_group_filters () {
+		SourceLocation[] filters = { };
+		var begin = get_location ();
+		int n_braces = 0;
+
+		try {
+			while (true) {
+				if (current () == SparqlTokenType.FILTER && n_braces == 0) {
+					filters += get_location ();
+					skip_filter ();
+				} else if (accept (SparqlTokenType.OPEN_BRACE)) {
+					n_braces++;
+				} else if (current () == SparqlTokenType.CLOSE_BRACE && n_braces > 0) {
+					next ();
+					n_braces--;
+				} else if (current () == SparqlTokenType.CLOSE_BRACE || current () == SparqlTokenType.EOF) {
+					break;
+				} else {
+					next ();
+				}
+			}
+		} catch (Sparql.Error e) {
+			// errors are reported when the group is translated
+		}
+
+		set_location (begin);
+		return filters;
+	}
+
+	// Whether the FILTER at the current location only refers to variables
+	// that are bound in all rows of the current triples block
+	bool is_pushable_filter () throws Sparql.Error {
+		expect (SparqlTokenType.FILTER);
+
+		int n_parens = 0;
+		bool seen_parens = false;
+
+		while (!seen_parens || n_parens > 0) {
+			if (accept (SparqlTokenType.OPEN_PARENS)) {
+				n_parens++;
+				seen_parens = true;
+			} else if (accept (SparqlTokenType.CLOSE_PARENS)) {
+				n_parens--;
+			} else if (accept (SparqlTokenType.VAR)) {
+				var variable = context.var_map.lookup (get_last_string ().substring (1));
+				if (variable == null || context.var_set.lookup (variable) != VariableState.BOUND) {
+					return false;
+				}
+			} else if (current () == SparqlTokenType.BOUND ||
+			           current () == SparqlTokenType.OPEN_BRACE ||
+			           current () == SparqlTokenType.EOF) {
+				// BOUND depends on the rest of the group, braces start subqueries
+				return false;
+			} else {
+				next ();
+			}
+		}
+
+		return true;
+	}
+
+	// Applies the FILTERs of the group graph pattern that only refer to
+	// variables of its first triples block within that block. This way
+	// they restrict the rows before OPTIONAL and nested group graph
+	// patterns are joined instead of filtering the joined result.
+	void push_down_filters (StringBuilder sql, ref bool first_where) throws Sparql.Error {
+		if (group_filters.length == 0) {
+			return;
+		}
+
+		var end = get_location ();
+
+		for (int i = 0; i < group_filters.length; i++) {
+			set_location (group_filters[i]);
+			if (!is_pushable_filter ()) {
+				continue;
+			}
+
+			if (!first_where) {
+				sql.append (" AND ");
+			} else {
+				sql.append (" WHERE ");
+				first_where = false;
+			}
+
+			long filter_start = sql.len;
+
+			set_location (group_filters[i]);
+			translate_filter (sql);
+			group_filters_pushed[i] = true;
+
+			if (explain != null) {
+				explain.append_printf ("pushed down filter: %s\n", sql.str.substring (filter_start));
+			}
+		}
+
+		set_location (end);
+	}
+
 	void parse_triples (StringBuilder sql, long group_graph_pattern_start, ref bool in_triples_block, ref bool first_where, ref bool in_group_graph_pattern, bool found_simple_optional) throws Sparql.Error {
 		while (true) {
 			if (current () != SparqlTokenType.VAR &&
@@ -946,6 +1524,11 @@ class Tracker.Sparql.Pattern : Object {
 		var result = new Context (query, context);
 		context = result;
 
+		var old_group_filters = (owned) group_filters;
+		var old_group_filters_pushed = (owned) group_filters_pushed;
+		group_filters = scan_group_filters ();
+		group_filters_pushed = new bool[group_filters.length];
+
 		SourceLocation[] filters = { };
 
 		bool in_triples_block = false;
@@ -1155,6 +1738,10 @@ class Tracker.Sparql.Pattern : Object {
 			var end = get_location ();
 
 			foreach (var filter_location in filters) {
+				if (is_pushed_filter (filter_location)) {
+					continue;
+				}
+
 				if (!first_where) {
 					sql.append (" AND ");
 				} else {
@@ -1169,10 +1756,22 @@ class Tracker.Sparql.Pattern : Object {
 			set_location (end);
 		}
 
+		group_filters = (owned) old_group_filters;
+		group_filters_pushed = (owned) old_group_filters_pushed;
+
 		context = context.parent_context;
 		return result;
 	}
 
+	bool is_pushed_filter (SourceLocation location) {
+		for (int i = 0; i < group_filters.length; i++) {
+			if (group_filters[i].pos == location.pos) {
+				return group_filters_pushed[i];
+			}
+		}
+		return false;
+	}
+
 	void translate_group_or_union_graph_pattern (StringBuilder sql) throws Sparql.Error {
 		Variable[] all_vars = { };
 		HashTable<Variable,int> all_var_set = new HashTable<Variable,int>.full (Variable.hash, Variable.equal, g_object_unref, null);
@@ -1297,7 +1896,9 @@ class Tracker.Sparql.Pattern : Object {
 		long begin_sql_len = sql.len;
 
 		bool object_is_var;
+		bool object_is_literal = Query.is_literal_token (current ());
 		string object = parse_var_or_term (sql, out object_is_var);
+		int object_literal = object_is_literal ? query.last_literal : -1;
 
 		string db_table = null;
 		bool rdftype = false;
@@ -1309,6 +1910,8 @@ class Tracker.Sparql.Pattern : Object {
 		Property prop = null;
 
 		Class subject_type = null;
+		// class of the resources in db_table
+		Class table_class = null;
 
 		if (!current_predicate_is_var) {
 			prop = Ontologies.get_property_by_uri (current_predicate);
@@ -1324,6 +1927,7 @@ class Tracker.Sparql.Pattern : Object {
 				}
 				db_table = cl.name;
 				subject_type = cl;
+				table_class = cl;
 			} else if (prop == null) {
 				if (current_predicate == "http://www.tracker-project.org/ontologies/fts#match") {
 					// fts:match
@@ -1339,6 +1943,9 @@ class Tracker.Sparql.Pattern : Object {
 				    && current_subject_is_var
 				    && !object_is_var) {
 					// rdfs:domain
+					// the class is part of the translation
+					object_literal = -1;
+
 					var domain = Ontologies.get_class_by_uri (object);
 					if (domain == null) {
 						throw new Sparql.Error.UNKNOWN_CLASS ("Unknown class `%s'".printf (object));
@@ -1362,6 +1969,7 @@ class Tracker.Sparql.Pattern : Object {
 							foreach (VariableBinding b in list.list) {
 								if (b.type == cl) {
 									db_table = cl.name;
+									table_class = cl;
 									stop = true;
 									break;
 								}
@@ -1373,8 +1981,10 @@ class Tracker.Sparql.Pattern : Object {
 					}
 				}
 
-				if (db_table == null)
+				if (db_table == null) {
 					db_table = prop.table_name;
+					table_class = prop.domain;
+				}
 
 				if (prop.multiple_values) {
 					// we can never share the table with multiple triples
@@ -1414,6 +2024,14 @@ class Tracker.Sparql.Pattern : Object {
 				}
 			}
 			table = get_table (current_subject, db_table, share_table, out newtable);
+			if (newtable) {
+				if (is_fts_match) {
+					table.estimated_rows = get_class_rows (null) * FTS_MATCH_SELECTIVITY;
+				} else {
+					// multi-valued properties may have more rows, no statistics for them yet
+					table.estimated_rows = get_class_rows (table_class);
+				}
+			}
 		} else {
 			// variable in predicate
 			newtable = true;
@@ -1435,6 +2053,7 @@ class Tracker.Sparql.Pattern : Object {
 				table.predicate_variable.return_graph = true;
 			}
 			table.sql_query_tablename = current_predicate + (++counter).to_string ();
+			table.estimated_rows = get_class_rows (null);
 			triple_context.tables.append (table);
 
 			// add to variable list
@@ -1469,6 +2088,8 @@ class Tracker.Sparql.Pattern : Object {
 				binding.table = table;
 				binding.sql_db_column_name = "ID";
 				triple_context.bindings.append (binding);
+
+				table.estimated_rows = 1;
 			}
 		}
 
@@ -1515,7 +2136,7 @@ class Tracker.Sparql.Pattern : Object {
 
 				sql.append_printf ("\"%s\".\"docid\" AS \"ID\", ",
 				                   binding.table.sql_query_tablename);
-				sql.append_printf ("tracker_rank(matchinfo(\"%s\".\"fts\", 'cl'),fts_column_weights()) " +
+				sql.append_printf ("tracker_rank(matchinfo(\"%s\".\"fts\", 'pcnalx'),fts_column_weights()) " +
 				                   "AS \"%s_u_rank\", ",
 				                   binding.table.sql_query_tablename,
 				                   context.get_variable (current_subject).name);
@@ -1524,6 +2145,7 @@ class Tracker.Sparql.Pattern : Object {
 				binding.literal = object;
 				// binding.data_type = triple.object.type;
 				binding.table = table;
+				query.lift_literal (binding, object_literal);
 				if (prop != null) {
 					binding.data_type = prop.data_type;
 					binding.sql_db_column_name = prop.name;
@@ -1532,6 +2154,12 @@ class Tracker.Sparql.Pattern : Object {
 					binding.sql_db_column_name = "object";
 				}
 				triple_context.bindings.append (binding);
+
+				if (prop != null && prop.is_inverse_functional_property) {
+					table.estimated_rows = 1;
+				} else {
+					table.estimated_rows = double.max (table.estimated_rows * LITERAL_SELECTIVITY, 1);
+				}
 			}
 
 			if (current_graph != null) {
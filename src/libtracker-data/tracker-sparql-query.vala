@@ -29,6 +29,8 @@ namespace Tracker.Sparql {
 		public string sql_db_tablename; // as in db schema
 		public string sql_query_tablename; // temp. name, generated
 		public PredicateVariable predicate_variable;
+		// estimated number of matching rows, used to order joins
+		public double estimated_rows;
 	}
 
 	abstract class DataBinding : Object {
@@ -56,6 +58,8 @@ namespace Tracker.Sparql {
 	class LiteralBinding : DataBinding {
 		public bool is_fts_match;
 		public string literal;
+		// index of the query literal providing the value, see Query.lift_literal
+		public int literal_index = -1;
 	}
 
 	// Represents a mapping of a SPARQL variable to a SQL table and column
@@ -158,6 +162,8 @@ namespace Tracker.Sparql {
 		public PropertyType type;
 		public PropertyType[] types = {};
 		public string[] variable_names = {};
+		// number of hidden ORDER BY key columns after the variables
+		public int n_keys;
 
 		public SelectContext (Query query, Context? parent_context = null) {
 			base (query, parent_context);
@@ -168,6 +174,25 @@ namespace Tracker.Sparql {
 		}
 	}
 
+	// Translated SELECT or ASK query
+	class QueryPlan {
+		public string sql;
+		public PropertyType[] types;
+		public string[] variable_names;
+		public int n_keys;
+		public bool no_cache;
+
+		// literal bindings in statement order
+		public PropertyType[] binding_types;
+		public string[] binding_literals;
+		// index of the query literal providing the value, -1 for constants
+		public int[] binding_literal_index;
+
+		// translation time in microseconds
+		public int64 translate_time;
+		public uint64 last_used;
+	}
+
 	class Solution {
 		public HashTable<string,int> hash;
 		public GenericArray<string> values;
@@ -243,6 +268,41 @@ public class Tracker.Sparql.Query : Object {
 
 	public bool no_cache { get; set; }
 
+	// Adds the ORDER BY keys of every row to the result, so that the
+	// query can later be resumed after any row, see get_continuation
+	public bool continuable { get; set; }
+
+	// Resumes the query after the row the continuation was taken from,
+	// instead of skipping rows with OFFSET
+	public string? continuation { get; set; }
+
+	// Translated queries, keyed by the token stream of the query. Literals
+	// that only end up in bind parameters are replaced by placeholders in
+	// the key, so queries that only differ in those values share a plan.
+	const int PLAN_CACHE_SIZE = 500;
+
+	static Mutex plan_cache_mutex;
+	static HashTable<string,QueryPlan> plan_cache;
+	static uint64 plan_cache_clock;
+	static uint64 plan_cache_hits;
+	static uint64 plan_cache_misses;
+	static int64 plan_cache_saved_time;
+
+	string plan_key;
+	string plan_exact_key;
+	int64 translate_start;
+
+	// false if the SQL depends on stored data
+	internal bool cache_plan = true;
+
+	// literal tokens in source order
+	SourceLocation[] literals;
+	// number of times the value of each literal token was read while
+	// translating, see get_last_string
+	int[] literal_reads;
+	// index of the literal token consumed last
+	internal int last_literal = -1;
+
 	public Query (string query) {
 		no_cache = false; /* Start with false, expression sets it */
 		tokens = new TokenInfo[BUFFER_SIZE];
@@ -309,6 +369,10 @@ public class Tracker.Sparql.Query : Object {
 	}
 
 	internal bool next () throws Sparql.Error {
+		if (size > 0 && literals.length > 0 && is_literal_token (tokens[index].type)) {
+			last_literal = find_literal (tokens[index].begin.pos);
+		}
+
 		index = (index + 1) % BUFFER_SIZE;
 		size--;
 		if (size <= 0) {
@@ -373,9 +437,288 @@ public class Tracker.Sparql.Query : Object {
 
 	internal string get_last_string (int strip = 0) {
 		int last_index = (index + BUFFER_SIZE - 1) % BUFFER_SIZE;
+
+		if (literal_reads != null && is_literal_token (tokens[last_index].type)) {
+			// the value ends up in the SQL unless the caller lifts it
+			// into a binding, skipped and rescanned tokens are not read
+			int literal = find_literal (tokens[last_index].begin.pos);
+			if (literal >= 0) {
+				literal_reads[literal]++;
+			}
+		}
+
 		return ((string) (tokens[last_index].begin.pos + strip)).substring (0, (int) (tokens[last_index].end.pos - tokens[last_index].begin.pos - 2 * strip));
 	}
 
+	internal static bool is_literal_token (SparqlTokenType type) {
+		switch (type) {
+		case SparqlTokenType.STRING_LITERAL1:
+		case SparqlTokenType.STRING_LITERAL2:
+		case SparqlTokenType.STRING_LITERAL_LONG1:
+		case SparqlTokenType.STRING_LITERAL_LONG2:
+		case SparqlTokenType.INTEGER:
+		case SparqlTokenType.DECIMAL:
+		case SparqlTokenType.DOUBLE:
+			return true;
+		default:
+			return false;
+		}
+	}
+
+	int find_literal (char* pos) {
+		int min = 0;
+		int max = literals.length - 1;
+
+		while (min <= max) {
+			int mid = (min + max) / 2;
+
+			if (literals[mid].pos == pos) {
+				return mid;
+			} else if ((long) literals[mid].pos < (long) pos) {
+				min = mid + 1;
+			} else {
+				max = mid - 1;
+			}
+		}
+
+		return -1;
+	}
+
+	// Marks the binding as taking its value only from the given literal
+	// token, so that the plan can be reused for other values
+	internal void lift_literal (LiteralBinding binding, int literal) {
+		binding.literal_index = literal;
+	}
+
+	string get_literal_value (int literal) throws Sparql.Error {
+		set_location (literals[literal]);
+		next ();
+
+		switch (last ()) {
+		case SparqlTokenType.INTEGER:
+		case SparqlTokenType.DECIMAL:
+		case SparqlTokenType.DOUBLE:
+			return get_last_string ();
+		default:
+			return expression.get_last_string_literal ();
+		}
+	}
+
+	// Returns the key values of the continuation as SQL literals, null
+	// for NULL, see Tracker.DBCursor.get_continuation for the format
+	internal string?[] get_continuation_keys (int n_keys) throws Sparql.Error {
+		Variant keys;
+		try {
+			keys = Variant.parse (new VariantType ("av"), continuation);
+		} catch (VariantParseError e) {
+			throw new Sparql.Error.PARSE ("Invalid continuation: %s".printf (e.message));
+		}
+
+		if (keys.n_children () != n_keys) {
+			throw new Sparql.Error.PARSE ("Continuation does not belong to this query");
+		}
+
+		var result = new string?[n_keys];
+		for (int i = 0; i < n_keys; i++) {
+			var value = keys.get_child_value (i).get_variant ();
+			if (value.is_of_type (VariantType.INT64)) {
+				result[i] = value.get_int64 ().to_string ();
+			} else if (value.is_of_type (VariantType.DOUBLE)) {
+				double number = value.get_double ();
+				// SQLite reads overflowing literals as infinity
+				result[i] = number.is_finite () ? number.to_string () : (number > 0 ? "9e999" : "-9e999");
+			} else if (value.is_of_type (VariantType.STRING)) {
+				result[i] = "'%s'".printf (value.get_string ().replace ("'", "''"));
+			} else if (value.is_of_type (VariantType.UNIT)) {
+				result[i] = null;
+			} else {
+				throw new Sparql.Error.PARSE ("Invalid continuation");
+			}
+		}
+
+		return result;
+	}
+
+	QueryPlan? lookup_plan () {
+		var key = new StringBuilder ();
+		var exact_key = new StringBuilder ();
+
+		if (continuable) {
+			// the SQL selects the ORDER BY keys as well
+			key.append ("\\continuable ");
+			exact_key.append ("\\continuable ");
+		}
+
+		scanner = new SparqlScanner ((char*) query_string, (long) query_string.length);
+
+		try {
+			SourceLocation begin, end;
+			SparqlTokenType type;
+
+			while ((type = scanner.read_token (out begin, out end)) != SparqlTokenType.EOF) {
+				if (is_literal_token (type)) {
+					// tokens never start with a backslash
+					key.append_printf ("\\%d ", (int) type);
+					literals += begin;
+				} else {
+					key.append_len ((string) begin.pos, (ssize_t) (end.pos - begin.pos));
+					key.append_c (' ');
+				}
+				exact_key.append_len ((string) begin.pos, (ssize_t) (end.pos - begin.pos));
+				exact_key.append_c (' ');
+			}
+		} catch (Sparql.Error e) {
+			// let the parser report the error
+			literals = null;
+			return null;
+		}
+
+		literal_reads = new int[literals.length];
+		plan_key = (owned) key.str;
+		plan_exact_key = (owned) exact_key.str;
+
+		plan_cache_mutex.lock ();
+
+		QueryPlan plan = null;
+		if (plan_cache != null) {
+			plan = plan_cache.lookup (plan_key) ?? plan_cache.lookup (plan_exact_key);
+		}
+
+		if (plan != null) {
+			plan.last_used = ++plan_cache_clock;
+			plan_cache_hits++;
+			plan_cache_saved_time += plan.translate_time;
+		} else {
+			plan_cache_misses++;
+		}
+
+		plan_cache_mutex.unlock ();
+
+		return plan;
+	}
+
+	void add_plan (string sql, PropertyType[] types, string[] variable_names, int n_keys = 0) {
+		if (plan_key == null || !cache_plan) {
+			return;
+		}
+
+		var plan = new QueryPlan ();
+		plan.sql = sql;
+		plan.types = types;
+		plan.variable_names = variable_names;
+		plan.n_keys = n_keys;
+		plan.no_cache = no_cache;
+
+		int n_bindings = (int) bindings.length ();
+		plan.binding_types = new PropertyType[n_bindings];
+		plan.binding_literals = new string[n_bindings];
+		plan.binding_literal_index = new int[n_bindings];
+
+		var literal_lifts = new int[literals.length];
+
+		int i = 0;
+		foreach (LiteralBinding binding in bindings) {
+			plan.binding_types[i] = binding.data_type;
+			plan.binding_literals[i] = binding.literal;
+			plan.binding_literal_index[i] = binding.literal_index;
+			if (binding.literal_index >= 0) {
+				literal_lifts[binding.literal_index]++;
+			}
+			i++;
+		}
+
+		// a literal whose value was read without being lifted has been
+		// inlined into the SQL, only share the plan if none was
+		bool parameterized = true;
+		for (i = 0; i < literals.length; i++) {
+			if (literal_reads[i] > literal_lifts[i]) {
+				parameterized = false;
+				break;
+			}
+		}
+
+		string key;
+		if (parameterized) {
+			key = plan_key;
+		} else {
+			key = plan_exact_key;
+			for (i = 0; i < n_bindings; i++) {
+				plan.binding_literal_index[i] = -1;
+			}
+		}
+
+		plan.translate_time = get_monotonic_time () - translate_start;
+
+		plan_cache_mutex.lock ();
+
+		if (plan_cache == null) {
+			plan_cache = new HashTable<string,QueryPlan> (str_hash, str_equal);
+		}
+
+		if (plan_cache.size () >= PLAN_CACHE_SIZE) {
+			// evict least recently used plan
+			string lru_key = null;
+			uint64 lru_used = uint64.MAX;
+
+			var iter = HashTableIter<string,QueryPlan> (plan_cache);
+			unowned string iter_key;
+			unowned QueryPlan iter_plan;
+			while (iter.next (out iter_key, out iter_plan)) {
+				if (iter_plan.last_used < lru_used) {
+					lru_key = iter_key;
+					lru_used = iter_plan.last_used;
+				}
+			}
+
+			plan_cache.remove (lru_key);
+		}
+
+		plan.last_used = ++plan_cache_clock;
+		plan_cache.insert (key, plan);
+
+		plan_cache_mutex.unlock ();
+	}
+
+	DBCursor? exec_plan_cursor (QueryPlan plan) throws DBInterfaceError, Sparql.Error, DateError {
+		var stmt = create_sql_statement (plan.sql, plan.no_cache);
+
+		for (int i = 0; i < plan.binding_literals.length; i++) {
+			int literal_index = plan.binding_literal_index[i];
+
+			if (literal_index >= 0) {
+				bind_literal (stmt, i, plan.binding_types[i], get_literal_value (literal_index));
+			} else {
+				bind_literal (stmt, i, plan.binding_types[i], plan.binding_literals[i]);
+			}
+		}
+
+		var cursor = stmt.start_sparql_cursor (plan.types, plan.variable_names, true);
+		cursor.set_n_keys (plan.n_keys);
+		return cursor;
+	}
+
+	// Drops all translated queries, needs to be called when the ontology changes
+	public static void clear_plan_cache () {
+		plan_cache_mutex.lock ();
+
+		if (plan_cache != null) {
+			plan_cache.remove_all ();
+		}
+
+		plan_cache_mutex.unlock ();
+	}
+
+	public static void get_plan_cache_stats (out uint64 hits, out uint64 misses, out int64 saved_time, out uint size) {
+		plan_cache_mutex.lock ();
+
+		hits = plan_cache_hits;
+		misses = plan_cache_misses;
+		saved_time = plan_cache_saved_time;
+		size = plan_cache != null ? plan_cache.size () : 0;
+
+		plan_cache_mutex.unlock ();
+	}
+
 	void parse_prologue () throws Sparql.Error {
 		if (accept (SparqlTokenType.BASE)) {
 			expect (SparqlTokenType.IRI_REF);
@@ -414,6 +757,18 @@ public class Tracker.Sparql.Query : Object {
 
 
 	public DBCursor? execute_cursor (bool threadsafe) throws DBInterfaceError, Sparql.Error, DateError {
+		if (continuation != null) {
+			// the key values of the continuation end up in the SQL
+			continuable = true;
+			no_cache = true;
+		} else {
+			var plan = lookup_plan ();
+			if (plan != null) {
+				return exec_plan_cursor (plan);
+			}
+		}
+
+		translate_start = get_monotonic_time ();
 
 		prepare_execute ();
 
@@ -435,6 +790,40 @@ public class Tracker.Sparql.Query : Object {
 		}
 	}
 
+	// Translates the query without running it and describes the result:
+	// the join order of each triples block, the FILTERs applied early,
+	// the SQL and the plan SQLite chose for it
+	public string explain () throws GLib.Error {
+		prepare_execute ();
+
+		pattern.explain = new StringBuilder ();
+
+		string sql;
+		switch (current ()) {
+		case SparqlTokenType.SELECT:
+			SelectContext context;
+			sql = get_select_query (out context);
+			break;
+		case SparqlTokenType.ASK:
+			sql = get_ask_query ();
+			break;
+		default:
+			throw get_error ("expected SELECT or ASK");
+		}
+
+		var result = (owned) pattern.explain;
+		result.append_printf ("sql: %s\n", sql);
+
+		no_cache = true;
+		var stmt = prepare_for_exec ("EXPLAIN QUERY PLAN " + sql);
+		var cursor = stmt.start_cursor ();
+		while (cursor.next ()) {
+			result.append_printf ("query plan: %s\n", cursor.get_string (3));
+		}
+
+		return result.str;
+	}
+
 	public Variant? execute_update (bool blank) throws GLib.Error {
 		Variant result = null;
 		assert (update_extensions);
@@ -498,34 +887,42 @@ public class Tracker.Sparql.Query : Object {
 		return result;
 	}
 
-	DBStatement prepare_for_exec (string sql) throws DBInterfaceError, Sparql.Error, DateError {
+	DBStatement create_sql_statement (string sql, bool no_cache) throws DBInterfaceError {
 		var iface = DBManager.get_db_interface ();
 		if (iface == null) {
 			throw new DBInterfaceError.OPEN_ERROR ("Error opening database");
 		}
 
-		var stmt = iface.create_statement (no_cache ? DBStatementCacheType.NONE : DBStatementCacheType.SELECT, "%s", sql);
+		return iface.create_statement (no_cache ? DBStatementCacheType.NONE : DBStatementCacheType.SELECT, "%s", sql);
+	}
+
+	void bind_literal (DBStatement stmt, int i, PropertyType data_type, string literal) throws Sparql.Error, DateError {
+		if (data_type == PropertyType.BOOLEAN) {
+			if (literal == "true" || literal == "1") {
+				stmt.bind_int (i, 1);
+			} else if (literal == "false" || literal == "0") {
+				stmt.bind_int (i, 0);
+			} else {
+				throw new Sparql.Error.TYPE ("`%s' is not a valid boolean".printf (literal));
+			}
+		} else if (data_type == PropertyType.DATE) {
+			stmt.bind_int (i, (int) string_to_date (literal + "T00:00:00Z", null));
+		} else if (data_type == PropertyType.DATETIME) {
+			stmt.bind_double (i, string_to_date (literal, null));
+		} else if (data_type == PropertyType.INTEGER) {
+			stmt.bind_int (i, int.parse (literal));
+		} else {
+			stmt.bind_text (i, literal);
+		}
+	}
+
+	DBStatement prepare_for_exec (string sql) throws DBInterfaceError, Sparql.Error, DateError {
+		var stmt = create_sql_statement (sql, no_cache);
 
 		// set literals specified in query
 		int i = 0;
 		foreach (LiteralBinding binding in bindings) {
-			if (binding.data_type == PropertyType.BOOLEAN) {
-				if (binding.literal == "true" || binding.literal == "1") {
-					stmt.bind_int (i, 1);
-				} else if (binding.literal == "false" || binding.literal == "0") {
-					stmt.bind_int (i, 0);
-				} else {
-					throw new Sparql.Error.TYPE ("`%s' is not a valid boolean".printf (binding.literal));
-				}
-			} else if (binding.data_type == PropertyType.DATE) {
-				stmt.bind_int (i, (int) string_to_date (binding.literal + "T00:00:00Z", null));
-			} else if (binding.data_type == PropertyType.DATETIME) {
-				stmt.bind_double (i, string_to_date (binding.literal, null));
-			} else if (binding.data_type == PropertyType.INTEGER) {
-				stmt.bind_int (i, int.parse (binding.literal));
-			} else {
-				stmt.bind_text (i, binding.literal);
-			}
+			bind_literal (stmt, i, binding.data_type, binding.literal);
 			i++;
 		}
 
@@ -543,7 +940,10 @@ public class Tracker.Sparql.Query : Object {
 
 		// build SQL
 		var sql = new StringBuilder ();
-		context = pattern.translate_select (sql);
+		context = pattern.translate_aggregate_select (sql);
+		if (context == null) {
+			context = pattern.translate_select (sql);
+		}
 
 		expect (SparqlTokenType.EOF);
 
@@ -554,7 +954,11 @@ public class Tracker.Sparql.Query : Object {
 		SelectContext context;
 		string sql = get_select_query (out context);
 
-		return exec_sql_cursor (sql, context.types, context.variable_names, true);
+		add_plan (sql, context.types, context.variable_names, context.n_keys);
+
+		var cursor = exec_sql_cursor (sql, context.types, context.variable_names, true);
+		cursor.set_n_keys (context.n_keys);
+		return cursor;
 	}
 
 	string get_ask_query () throws DBInterfaceError, Sparql.Error, DateError {
@@ -589,7 +993,13 @@ public class Tracker.Sparql.Query : Object {
 	}
 
 	DBCursor? execute_ask_cursor (bool threadsafe) throws DBInterfaceError, Sparql.Error, DateError {
-		return exec_sql_cursor (get_ask_query (), new PropertyType[] { PropertyType.BOOLEAN }, new string[] { "result" }, true);
+		string sql = get_ask_query ();
+		var types = new PropertyType[] { PropertyType.BOOLEAN };
+		var variable_names = new string[] { "result" };
+
+		add_plan (sql, types, variable_names);
+
+		return exec_sql_cursor (sql, types, variable_names, true);
 	}
 
 	private void parse_from_or_into_param () throws Sparql.Error {
@@ -75,6 +75,15 @@ public class Tracker.TurtleReader : Object {
 		prefix_map = new HashTable<string,string>.full (str_hash, str_equal, g_free, g_free);
 	}
 
+	// fraction of the file read so far
+	public double get_progress () {
+		if (mapped_file.get_length () == 0) {
+			return 1;
+		}
+
+		return (double) (tokens[index].end.pos - (char*) mapped_file.get_contents ()) / mapped_file.get_length ();
+	}
+
 	string generate_bnodeid (string? user_bnodeid) {
 		// user_bnodeid is NULL for anonymous nodes
 		if (user_bnodeid == null) {
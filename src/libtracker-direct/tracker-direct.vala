@@ -72,9 +72,11 @@ public class Tracker.Direct.Connection : Tracker.Sparql.Connection {
 		}
 	}
 
-	Sparql.Cursor query_unlocked (string sparql, Cancellable? cancellable) throws Sparql.Error, IOError, DBusError {
+	Sparql.Cursor query_unlocked (string sparql, bool continuable, string? continuation, Cancellable? cancellable) throws Sparql.Error, IOError, DBusError {
 		try {
 			var query_object = new Sparql.Query (sparql);
+			query_object.continuable = continuable;
+			query_object.continuation = continuation;
 			var cursor = query_object.execute_cursor (true);
 			cursor.connection = this;
 			return cursor;
@@ -85,17 +87,32 @@ public class Tracker.Direct.Connection : Tracker.Sparql.Connection {
 		}
 	}
 
-	public override Sparql.Cursor query (string sparql, Cancellable? cancellable) throws Sparql.Error, IOError, DBusError {
-		DBManager.lock ();
+	// Every thread queries through its own read-only connection, the
+	// connection lock only guards against cursors of this thread that
+	// are being iterated in another thread
+	unowned DBInterface get_db_interface () throws Sparql.Error {
+		unowned DBInterface iface = DBManager.get_db_interface ();
+		if (iface == null) {
+			throw new Sparql.Error.INTERNAL ("Error opening database");
+		}
+		return iface;
+	}
+
+	Sparql.Cursor query_internal (string sparql, bool continuable, string? continuation, Cancellable? cancellable) throws Sparql.Error, IOError, DBusError {
+		unowned DBInterface iface = get_db_interface ();
+
+		iface.sqlite_lock ();
 		try {
-			return query_unlocked (sparql, cancellable);
+			return query_unlocked (sparql, continuable, continuation, cancellable);
 		} finally {
-			DBManager.unlock ();
+			iface.sqlite_unlock ();
 		}
 	}
 
-	public async override Sparql.Cursor query_async (string sparql, Cancellable? cancellable) throws Sparql.Error, IOError, DBusError {
-		if (!DBManager.trylock ()) {
+	async Sparql.Cursor query_internal_async (string sparql, bool continuable, string? continuation, Cancellable? cancellable) throws Sparql.Error, IOError, DBusError {
+		unowned DBInterface iface = get_db_interface ();
+
+		if (!iface.sqlite_trylock ()) {
 			// run in a separate thread
 			Sparql.Error sparql_error = null;
 			IOError io_error = null;
@@ -105,7 +122,7 @@ public class Tracker.Direct.Connection : Tracker.Sparql.Connection {
 
 			g_io_scheduler_push_job (job => {
 				try {
-					result = query (sparql, cancellable);
+					result = query_internal (sparql, continuable, continuation, cancellable);
 				} catch (IOError e_io) {
 					io_error = e_io;
 				} catch (Sparql.Error e_spql) {
@@ -116,7 +133,7 @@ public class Tracker.Direct.Connection : Tracker.Sparql.Connection {
 
 				var source = new IdleSource ();
 				source.set_callback (() => {
-					query_async.callback ();
+					query_internal_async.callback ();
 					return false;
 				});
 				source.attach (context);
@@ -136,9 +153,25 @@ public class Tracker.Direct.Connection : Tracker.Sparql.Connection {
 			}
 		}
 		try {
-			return query_unlocked (sparql, cancellable);
+			return query_unlocked (sparql, continuable, continuation, cancellable);
 		} finally {
-			DBManager.unlock ();
+			iface.sqlite_unlock ();
 		}
 	}
+
+	public override Sparql.Cursor query (string sparql, Cancellable? cancellable) throws Sparql.Error, IOError, DBusError {
+		return query_internal (sparql, false, null, cancellable);
+	}
+
+	public async override Sparql.Cursor query_async (string sparql, Cancellable? cancellable) throws Sparql.Error, IOError, DBusError {
+		return yield query_internal_async (sparql, false, null, cancellable);
+	}
+
+	public override Sparql.Cursor query_continue (string sparql, string? continuation, Cancellable? cancellable) throws Sparql.Error, IOError, DBusError {
+		return query_internal (sparql, true, continuation, cancellable);
+	}
+
+	public async override Sparql.Cursor query_continue_async (string sparql, string? continuation, Cancellable? cancellable) throws Sparql.Error, IOError, DBusError {
+		return yield query_internal_async (sparql, true, continuation, cancellable);
+	}
 }
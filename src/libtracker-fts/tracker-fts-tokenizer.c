@@ -55,23 +55,11 @@ struct TrackerCursor {
 };
 
 /*
-** Create a new tokenizer instance.
+** Read the settings affecting the tokens from the configuration.
 */
-static int trackerCreate(
-  int argc,                            /* Number of entries in argv[] */
-  const char * const *argv,            /* Tokenizer creation arguments */
-  sqlite3_tokenizer **ppTokenizer      /* OUT: Created tokenizer */
-){
-  TrackerTokenizer *p;
+static void trackerLoadConfig(TrackerTokenizer *p){
   TrackerFTSConfig *config;
 
-  p = (TrackerTokenizer *)sqlite3_malloc(sizeof(TrackerTokenizer));
-  if( !p ){
-    return SQLITE_NOMEM;
-  }
-  memset(p, 0, sizeof(TrackerTokenizer));
-  p->language = tracker_language_new (NULL);
-
   config = tracker_fts_config_new ();
 
   p->max_word_length = tracker_fts_config_get_max_word_length (config);
@@ -87,6 +75,26 @@ static int trackerCreate(
   p->max_words = tracker_fts_config_get_max_words_to_index (config);
 
   g_object_unref (config);
+}
+
+/*
+** Create a new tokenizer instance.
+*/
+static int trackerCreate(
+  int argc,                            /* Number of entries in argv[] */
+  const char * const *argv,            /* Tokenizer creation arguments */
+  sqlite3_tokenizer **ppTokenizer      /* OUT: Created tokenizer */
+){
+  TrackerTokenizer *p;
+
+  p = (TrackerTokenizer *)sqlite3_malloc(sizeof(TrackerTokenizer));
+  if( !p ){
+    return SQLITE_NOMEM;
+  }
+  memset(p, 0, sizeof(TrackerTokenizer));
+  p->language = tracker_language_new (NULL);
+
+  trackerLoadConfig(p);
 
   *ppTokenizer = (sqlite3_tokenizer *)p;
 
@@ -210,6 +218,22 @@ static const sqlite3_tokenizer_module trackerTokenizerModule = {
   trackerNext,                 /* xNext    */
 };
 
+/*
+** Describe the settings affecting the tokens, the full-text index needs
+** to be rebuilt whenever this changes.
+*/
+gchar *tracker_tokenizer_get_config (void) {
+  TrackerTokenizer p;
+
+  memset(&p, 0, sizeof(TrackerTokenizer));
+  trackerLoadConfig(&p);
+
+  return g_strdup_printf ("max-word-length=%d;enable-stemmer=%d;enable-unaccent=%d;"
+                          "ignore-numbers=%d;ignore-stop-words=%d;max-words-to-index=%d",
+                          p.max_word_length, p.enable_stemmer, p.enable_unaccent,
+                          p.ignore_numbers, p.ignore_stop_words, p.max_words);
+}
+
 /*
 ** Set *ppModule to point at the implementation of the tracker tokenizer.
 */
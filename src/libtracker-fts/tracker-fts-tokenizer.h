@@ -27,5 +27,6 @@
 #define __TRACKER_FTS_TOKENIZER_H__
 
 gboolean tracker_tokenizer_initialize (sqlite3 *db);
+gchar *  tracker_tokenizer_get_config (void);
 
 #endif /* __TRACKER_FTS_TOKENIZER_H__ */
@@ -21,6 +21,8 @@
 
 #include "config.h"
 
+#include <math.h>
+
 #include <libtracker-common/tracker-common.h>
 
 #include "tracker-fts-tokenizer.h"
@@ -33,6 +35,10 @@ static gsize      module_initialized = 0;
 
 #endif
 
+/* Okapi BM25 term frequency saturation and length normalization */
+#define BM25_K1 1.2
+#define BM25_B  0.75
+
 static gboolean   initialized = FALSE;
 static GPrivate   property_names_key = G_PRIVATE_INIT ((GDestroyNotify) g_strfreev);
 
@@ -81,9 +87,11 @@ function_rank (sqlite3_context *context,
                int              argc,
                sqlite3_value   *argv[])
 {
-	guint *matchinfo, *weights;
+	const guint *matchinfo, *weights;
+	const guint *avg_lengths, *lengths, *hits;
+	guint n_phrases, n_columns, n_docs, n_weights;
 	gdouble rank = 0;
-	gint i, n_columns;
+	guint i, j;
 
 	if (argc != 2) {
 		sqlite3_result_error(context,
@@ -92,13 +100,53 @@ function_rank (sqlite3_context *context,
 		return;
 	}
 
-	matchinfo = (unsigned int *) sqlite3_value_blob (argv[0]);
-	weights = (unsigned int *) sqlite3_value_blob (argv[1]);
-	n_columns = matchinfo[0];
+	/* matchinfo 'pcnalx' = [phrases, columns, rows,
+	 *                       columns x average length,
+	 *                       columns x length in this row,
+	 *                       phrases x columns x 3 hit counts] */
+	matchinfo = sqlite3_value_blob (argv[0]);
+	weights = sqlite3_value_blob (argv[1]);
+	n_weights = sqlite3_value_bytes (argv[1]) / sizeof (guint);
+
+	if ((gsize) sqlite3_value_bytes (argv[0]) < 3 * sizeof (guint)) {
+		sqlite3_result_error (context, "invalid matchinfo passed to rank()", -1);
+		return;
+	}
+
+	n_phrases = matchinfo[0];
+	n_columns = matchinfo[1];
+	n_docs = matchinfo[2];
+
+	if ((gsize) sqlite3_value_bytes (argv[0]) < (3 + n_columns * (2 + 3 * n_phrases)) * sizeof (guint)) {
+		sqlite3_result_error (context, "invalid matchinfo passed to rank()", -1);
+		return;
+	}
+
+	avg_lengths = &matchinfo[3];
+	lengths = &matchinfo[3 + n_columns];
+	hits = &matchinfo[3 + 2 * n_columns];
+
+	/* BM25 per column, scaled by the property weight. Only columns
+	 * with hits in this row cost anything, which keeps this cheap
+	 * on queries with lots of matches. */
+	for (i = 0; i < n_phrases; i++) {
+		for (j = 0; j < n_columns && j < n_weights; j++) {
+			/* [hits in this row, hits in all rows, rows with hits] */
+			const guint *phrase_hits = &hits[3 * (i * n_columns + j)];
+			gdouble tf, idf, norm;
+
+			if (phrase_hits[0] == 0 || weights[j] == 0) {
+				continue;
+			}
+
+			tf = phrase_hits[0];
+
+			/* never negative, even for phrases in most rows */
+			idf = log (1.0 + (n_docs - phrase_hits[2] + 0.5) / (phrase_hits[2] + 0.5));
+
+			norm = 1.0 - BM25_B + BM25_B * lengths[j] / MAX (avg_lengths[j], 1);
 
-	for (i = 0; i < n_columns; i++) {
-		if (matchinfo[i + 1] != 0) {
-			rank += (gdouble) weights[i];
+			rank += weights[j] * idf * (tf * (BM25_K1 + 1)) / (tf + BM25_K1 * norm);
 		}
 	}
 
@@ -158,6 +206,7 @@ function_weights (sqlite3_context *context,
                   sqlite3_value   *argv[])
 {
 	static guint *weights = NULL;
+	static guint n_weights = 0;
 	static GMutex mutex;
 	int rc = SQLITE_DONE;
 
@@ -171,7 +220,7 @@ function_weights (sqlite3_context *context,
 		weight_array = g_array_new (FALSE, FALSE, sizeof (guint));
 		db = sqlite3_context_db_handle (context);
 		rc = sqlite3_prepare_v2 (db,
-		                         "SELECT \"rdf:Property\".\"tracker:weight\" "
+		                         "SELECT IFNULL(\"rdf:Property\".\"tracker:weight\", 1) "
 		                         "FROM \"rdf:Property\" "
 		                         "WHERE \"rdf:Property\".\"tracker:fulltextIndexed\" = 1 "
 		                         "ORDER BY \"rdf:Property\".ID ",
@@ -190,6 +239,7 @@ function_weights (sqlite3_context *context,
 		sqlite3_finalize (stmt);
 
 		if (rc == SQLITE_DONE) {
+			n_weights = weight_array->len;
 			weights = (guint *) g_array_free (weight_array, FALSE);
 		} else {
 			g_array_free (weight_array, TRUE);
@@ -199,7 +249,7 @@ function_weights (sqlite3_context *context,
 	g_mutex_unlock (&mutex);
 
 	if (rc == SQLITE_DONE)
-		sqlite3_result_blob (context, weights, sizeof (weights), NULL);
+		sqlite3_result_blob (context, weights, n_weights * sizeof (guint), NULL);
 	else
 		sqlite3_result_error_code (context, rc);
 }
@@ -264,29 +314,41 @@ tracker_fts_init_db (sqlite3    *db,
 	return TRUE;
 }
 
-gboolean
-tracker_fts_create_table (sqlite3    *db,
-                          gchar      *table_name,
+/* Appends all FTS columns in the order of the fts4 table, format
+ * gets the column name */
+static void
+fts_append_columns (GString     *str,
+                    GHashTable  *tables,
+                    const gchar *format)
+{
+	GHashTableIter iter;
+	GList *columns;
+
+	g_hash_table_iter_init (&iter, tables);
+	while (g_hash_table_iter_next (&iter, NULL, (gpointer *) &columns)) {
+		while (columns) {
+			g_string_append_printf (str, format, (gchar *) columns->data);
+			columns = columns->next;
+		}
+	}
+}
+
+/* Appends the query behind fts_view, returning the text of all
+ * FTS-indexed properties of each resource */
+static void
+fts_append_content_query (GString    *str,
                           GHashTable *tables,
                           GHashTable *grouped_columns)
 {
-	GString *str, *from, *fts;
+	GString *from;
 	GHashTableIter iter;
 	gchar *index_table;
 	GList *columns;
-	gint rc;
 
-	g_return_val_if_fail (initialized == TRUE, FALSE);
-
-	/* Create view on tables/columns marked as FTS-indexed */
-	g_hash_table_iter_init (&iter, tables);
-	str = g_string_new ("CREATE VIEW fts_view AS SELECT Resource.ID as rowid ");
+	g_string_append (str, "SELECT Resource.ID as rowid ");
 	from = g_string_new ("FROM Resource ");
 
-	fts = g_string_new ("CREATE VIRTUAL TABLE ");
-	g_string_append_printf (fts, "%s USING fts4(content=\"fts_view\", ",
-				table_name);
-
+	g_hash_table_iter_init (&iter, tables);
 	while (g_hash_table_iter_next (&iter, (gpointer *) &index_table,
 				       (gpointer *) &columns)) {
 		while (columns) {
@@ -303,8 +365,6 @@ tracker_fts_create_table (sqlite3    *db,
 
 			g_string_append_printf (str, " AS \"%s\" ",
 						(gchar *) columns->data);
-			g_string_append_printf (fts, "\"%s\", ",
-						(gchar *) columns->data);
 
 			columns = columns->next;
 		}
@@ -316,21 +376,99 @@ tracker_fts_create_table (sqlite3    *db,
 
 	g_string_append (str, from->str);
 	g_string_free (from, TRUE);
+}
+
+static gboolean
+fts_create_view (sqlite3    *db,
+                 GHashTable *tables,
+                 GHashTable *grouped_columns)
+{
+	GString *str;
+	gint rc;
+
+	/* Create view on tables/columns marked as FTS-indexed */
+	str = g_string_new ("CREATE VIEW fts_view AS ");
+	fts_append_content_query (str, tables, grouped_columns);
 
-	rc = sqlite3_exec(db, str->str, NULL, 0, NULL);
+	rc = sqlite3_exec (db, str->str, NULL, 0, NULL);
 	g_string_free (str, TRUE);
 
+	return (rc == SQLITE_OK);
+}
+
+static gchar *
+fts_create_table_query (const gchar *table_name,
+                        const gchar *content,
+                        GHashTable  *tables)
+{
+	GString *fts;
+
+	fts = g_string_new ("CREATE VIRTUAL TABLE ");
+	g_string_append_printf (fts, "%s USING fts4(content=\"%s\", ",
+				table_name, content);
+	fts_append_columns (fts, tables, "\"%s\", ");
+	g_string_append (fts, "tokenize=TrackerTokenizer)");
+
+	return g_string_free (fts, FALSE);
+}
+
+static gboolean
+fts_exec (sqlite3     *db,
+          const gchar *format,
+          ...)
+{
+	va_list args;
+	gchar *query;
+	gint rc;
+
+	va_start (args, format);
+	query = g_strdup_vprintf (format, args);
+	va_end (args);
+
+	rc = sqlite3_exec (db, query, NULL, 0, NULL);
+	g_free (query);
+
 	if (rc != SQLITE_OK) {
+		g_warning ("Could not update full-text index: %s",
+		           sqlite3_errmsg (db));
+	}
+
+	return (rc == SQLITE_OK);
+}
+
+gboolean
+tracker_fts_create_table (sqlite3    *db,
+                          gchar      *table_name,
+                          GHashTable *tables,
+                          GHashTable *grouped_columns)
+{
+	gchar *query;
+	gint rc;
+
+	g_return_val_if_fail (initialized == TRUE, FALSE);
+
+	if (!fts_create_view (db, tables, grouped_columns)) {
 		return FALSE;
 	}
 
-	g_string_append (fts, "tokenize=TrackerTokenizer)");
-	rc = sqlite3_exec(db, fts->str, NULL, 0, NULL);
-	g_string_free (fts, TRUE);
+	query = fts_create_table_query (table_name, "fts_view", tables);
+	rc = sqlite3_exec (db, query, NULL, 0, NULL);
+	g_free (query);
 
 	return (rc == SQLITE_OK);
 }
 
+/* Replaces the index in table_name by the one in tmp_name, this only
+ * becomes visible to readers once the surrounding transaction commits */
+static gboolean
+fts_swap_tables (sqlite3     *db,
+                 const gchar *table_name,
+                 const gchar *tmp_name)
+{
+	return fts_exec (db, "DROP TABLE %s; ALTER TABLE %s RENAME TO %s",
+	                 table_name, tmp_name, table_name);
+}
+
 gboolean
 tracker_fts_alter_table (sqlite3    *db,
 			 gchar      *table_name,
@@ -338,52 +476,590 @@ tracker_fts_alter_table (sqlite3    *db,
 			 GHashTable *grouped_columns)
 {
 	gchar *query, *tmp_name;
-	int rc;
+	gboolean success;
 
 	g_return_val_if_fail (initialized == TRUE, FALSE);
 
 	tmp_name = g_strdup_printf ("%s_TMP", table_name);
+	query = fts_create_table_query (tmp_name, "fts_view", tables);
 
-	query = g_strdup_printf ("DROP VIEW fts_view");
-	rc = sqlite3_prepare_v2 (db, query, -1, NULL, NULL);
+	/* Columns changed, so does the view. The new table is filled
+	 * from it in the ongoing ontology transaction */
+	success = (fts_exec (db, "DROP VIEW IF EXISTS fts_view") &&
+	           fts_create_view (db, tables, grouped_columns) &&
+	           fts_exec (db, "%s", query) &&
+	           fts_exec (db, "INSERT INTO %s(%s) VALUES('rebuild')",
+	                     tmp_name, tmp_name) &&
+	           fts_swap_tables (db, table_name, tmp_name));
 
-	if (!tracker_fts_create_table (db, tmp_name, tables, grouped_columns)) {
-		g_free (tmp_name);
-		g_free (query);
-		return FALSE;
+	g_free (query);
+	g_free (tmp_name);
+
+	return success;
+}
+
+/* Settings affecting the indexed tokens, see tracker_fts_rebuild_table() */
+gchar *
+tracker_fts_get_tokenizer_config (void)
+{
+	return tracker_tokenizer_get_config ();
+}
+
+/* Full-text index rebuilds split the resource IDs in chunks, about this
+ * many per thread so that threads finishing early take over more work
+ */
+#define FTS_REBUILD_CHUNKS_PER_THREAD 8
+
+typedef struct {
+	const gchar *filename;
+	gchar *create_query;
+	gchar *insert_query;
+	gint64 first_id;
+	gint64 chunk_size;
+	gint n_chunks;
+	gint next_chunk; /* atomic */
+} FtsRebuild;
+
+/* Each worker tokenizes its chunks into an fts4 table of an in-memory
+ * database attached to its own connection. That connection only reads
+ * from the main database, but it can't be opened read-only, as the
+ * attached database would be read-only too.
+ */
+typedef struct {
+	FtsRebuild *rebuild;
+	sqlite3 *db;
+	gboolean success;
+} FtsRebuildWorker;
+
+static gpointer
+fts_rebuild_worker (gpointer user_data)
+{
+	FtsRebuildWorker *worker = user_data;
+	FtsRebuild *rebuild = worker->rebuild;
+	sqlite3_stmt *stmt = NULL;
+	gint chunk;
+	gint rc;
+
+	rc = sqlite3_open_v2 (rebuild->filename, &worker->db,
+	                      SQLITE_OPEN_READWRITE | SQLITE_OPEN_NOMUTEX, NULL);
+
+	if (rc == SQLITE_OK && !tracker_tokenizer_initialize (worker->db)) {
+		rc = SQLITE_ERROR;
 	}
 
-	query = g_strdup_printf ("INSERT INTO %s (docid) SELECT docid FROM %s",
-				 tmp_name, table_name);
-	rc = sqlite3_prepare_v2 (db, query, -1, NULL, NULL);
-	g_free (query);
+	if (rc == SQLITE_OK) {
+		rc = sqlite3_exec (worker->db, "ATTACH ':memory:' AS part", NULL, 0, NULL);
+	}
+
+	if (rc == SQLITE_OK) {
+		rc = sqlite3_exec (worker->db, rebuild->create_query, NULL, 0, NULL);
+	}
+
+	if (rc == SQLITE_OK) {
+		rc = sqlite3_prepare_v2 (worker->db, rebuild->insert_query, -1, &stmt, NULL);
+	}
+
+	/* All chunks are read from the same snapshot */
+	if (rc == SQLITE_OK) {
+		rc = sqlite3_exec (worker->db, "BEGIN", NULL, 0, NULL);
+	}
+
+	while (rc == SQLITE_OK &&
+	       (chunk = g_atomic_int_add (&rebuild->next_chunk, 1)) < rebuild->n_chunks) {
+		gint64 first = rebuild->first_id + chunk * rebuild->chunk_size;
+
+		sqlite3_bind_int64 (stmt, 1, first);
+		sqlite3_bind_int64 (stmt, 2, first + rebuild->chunk_size - 1);
+
+		rc = sqlite3_step (stmt);
+		if (rc == SQLITE_DONE) {
+			rc = SQLITE_OK;
+		}
+
+		sqlite3_reset (stmt);
+	}
+
+	sqlite3_finalize (stmt);
+
+	if (rc == SQLITE_OK) {
+		rc = sqlite3_exec (worker->db, "COMMIT", NULL, 0, NULL);
+	}
+
+	/* Merge everything into a single segment, still in parallel */
+	if (rc == SQLITE_OK) {
+		rc = sqlite3_exec (worker->db, "INSERT INTO part.fts(fts) VALUES('optimize')",
+		                   NULL, 0, NULL);
+	}
 
 	if (rc != SQLITE_OK) {
-		g_free (tmp_name);
+		g_warning ("Could not build full-text index segment: %s",
+		           worker->db ? sqlite3_errmsg (worker->db) : sqlite3_errstr (rc));
+	}
+
+	worker->success = (rc == SQLITE_OK);
+
+	return NULL;
+}
+
+static gint
+fts_get_varint (const guchar *data,
+                gint          len,
+                guint64      *value)
+{
+	gint i;
+
+	*value = 0;
+
+	for (i = 0; i < len && i < 10; i++) {
+		*value |= (guint64) (data[i] & 0x7f) << (7 * i);
+
+		if ((data[i] & 0x80) == 0) {
+			return i + 1;
+		}
+	}
+
+	return 0;
+}
+
+static gint
+fts_put_varint (guchar  *data,
+                guint64  value)
+{
+	gint i = 0;
+
+	do {
+		data[i++] = (value & 0x7f) | 0x80;
+		value >>= 7;
+	} while (value != 0);
+
+	data[i - 1] &= 0x7f;
+
+	return i;
+}
+
+/* Segment b-tree nodes start with their height, interior nodes are
+ * followed by the blockid of their left-most child, which is moved by
+ * offset. Returns a newly allocated node, or NULL if it is corrupt.
+ */
+static guchar *
+fts_move_node (const guchar *node,
+               gint          len,
+               gint64        offset,
+               gint         *new_len)
+{
+	guint64 height, child;
+	guchar *new_node;
+	gint n, m;
+
+	n = fts_get_varint (node, len, &height);
+	if (n == 0) {
+		return NULL;
+	}
+
+	new_node = g_malloc (len + 10);
+
+	if (height == 0) {
+		memcpy (new_node, node, len);
+		*new_len = len;
+		return new_node;
+	}
+
+	m = fts_get_varint (node + n, len - n, &child);
+	if (m == 0) {
+		g_free (new_node);
+		return NULL;
+	}
+
+	*new_len = fts_put_varint (new_node, height);
+	*new_len += fts_put_varint (new_node + *new_len, child + offset);
+	memcpy (new_node + *new_len, node + n + m, len - n - m);
+	*new_len += len - n - m;
+
+	return new_node;
+}
+
+static gboolean
+fts_copy_node (sqlite3_stmt  *stmt,
+               gint           column,
+               sqlite3_value *node,
+               gint64         offset)
+{
+	guchar *new_node;
+	gint len;
+
+	new_node = fts_move_node (sqlite3_value_blob (node),
+	                          sqlite3_value_bytes (node),
+	                          offset, &len);
+	if (!new_node) {
+		g_warning ("Corrupt full-text index segment");
 		return FALSE;
 	}
 
-	query = g_strdup_printf ("INSERT INTO %s(%s) VALUES('rebuild')",
-				 tmp_name, tmp_name);
-	rc = sqlite3_prepare_v2 (db, query, -1, NULL, NULL);
-	g_free (query);
+	sqlite3_bind_blob (stmt, column, new_node, len, g_free);
+
+	return TRUE;
+}
+
+/* Copies the whole index of a worker into table_name, which is filled
+ * in a single transaction. Block IDs are moved past next_block, and
+ * the document and token counts are added to doctotal.
+ */
+static gboolean
+fts_copy_index (sqlite3     *db,
+                const gchar *table_name,
+                sqlite3     *part,
+                gint64      *next_block,
+                GArray      *doctotal)
+{
+	sqlite3_stmt *read = NULL, *write = NULL;
+	gint64 offset = 0;
+	gchar *query;
+	gint rc;
+
+	/* Blocks */
+	rc = sqlite3_prepare_v2 (part, "SELECT min(blockid), max(blockid) FROM part.fts_segments",
+	                         -1, &read, NULL);
+
+	if (rc == SQLITE_OK && sqlite3_step (read) == SQLITE_ROW) {
+		offset = *next_block - sqlite3_column_int64 (read, 0);
+		*next_block = sqlite3_column_int64 (read, 1) + offset + 1;
+	}
+
+	sqlite3_finalize (read);
+
+	if (rc == SQLITE_OK) {
+		rc = sqlite3_prepare_v2 (part, "SELECT blockid, block FROM part.fts_segments",
+		                         -1, &read, NULL);
+	}
+
+	if (rc == SQLITE_OK) {
+		query = g_strdup_printf ("INSERT INTO %s_segments (blockid, block) VALUES (?, ?)",
+		                         table_name);
+		rc = sqlite3_prepare_v2 (db, query, -1, &write, NULL);
+		g_free (query);
+	}
+
+	while (rc == SQLITE_OK && (rc = sqlite3_step (read)) == SQLITE_ROW) {
+		sqlite3_bind_int64 (write, 1, sqlite3_column_int64 (read, 0) + offset);
+
+		if (!fts_copy_node (write, 2, sqlite3_column_value (read, 1), offset)) {
+			rc = SQLITE_CORRUPT;
+			break;
+		}
+
+		rc = sqlite3_step (write);
+		if (rc == SQLITE_DONE) {
+			rc = SQLITE_OK;
+		}
+
+		sqlite3_reset (write);
+	}
+
+	if (rc == SQLITE_DONE) {
+		rc = SQLITE_OK;
+	}
+
+	sqlite3_finalize (read);
+	sqlite3_finalize (write);
+	read = write = NULL;
+
+	/* Segments, levels stay the same but idx must not clash with
+	 * segments copied before */
+	if (rc == SQLITE_OK) {
+		rc = sqlite3_prepare_v2 (part,
+		                         "SELECT level, start_block, leaves_end_block, end_block, root "
+		                         "FROM part.fts_segdir",
+		                         -1, &read, NULL);
+	}
+
+	if (rc == SQLITE_OK) {
+		query = g_strdup_printf ("INSERT INTO %s_segdir "
+		                         "(level, idx, start_block, leaves_end_block, end_block, root) "
+		                         "SELECT ?1, COALESCE (max (idx) + 1, 0), ?2, ?3, ?4, ?5 "
+		                         "FROM %s_segdir WHERE level = ?1",
+		                         table_name, table_name);
+		rc = sqlite3_prepare_v2 (db, query, -1, &write, NULL);
+		g_free (query);
+	}
+
+	while (rc == SQLITE_OK && (rc = sqlite3_step (read)) == SQLITE_ROW) {
+		gint64 start_block, leaves_end_block;
+
+		start_block = sqlite3_column_int64 (read, 1);
+		leaves_end_block = sqlite3_column_int64 (read, 2);
+
+		sqlite3_bind_int64 (write, 1, sqlite3_column_int64 (read, 0));
+
+		if (start_block == 0) {
+			/* The whole segment is in the root node */
+			sqlite3_bind_int64 (write, 2, 0);
+			sqlite3_bind_int64 (write, 3, 0);
+			sqlite3_bind_value (write, 4, sqlite3_column_value (read, 3));
+		} else {
+			sqlite3_bind_int64 (write, 2, start_block + offset);
+			sqlite3_bind_int64 (write, 3, leaves_end_block + offset);
+
+			if (sqlite3_column_type (read, 3) == SQLITE_TEXT) {
+				gchar **end_block;
+				gchar *value;
+
+				/* "end_block size" as written by newer SQLite */
+				end_block = g_strsplit ((const gchar *) sqlite3_column_text (read, 3), " ", 2);
+				value = g_strdup_printf ("%" G_GINT64_FORMAT " %s",
+				                         g_ascii_strtoll (end_block[0], NULL, 10) + offset,
+				                         end_block[1] ? end_block[1] : "0");
+				sqlite3_bind_text (write, 4, value, -1, g_free);
+				g_strfreev (end_block);
+			} else {
+				sqlite3_bind_int64 (write, 4, sqlite3_column_int64 (read, 3) + offset);
+			}
+		}
+
+		if (!fts_copy_node (write, 5, sqlite3_column_value (read, 4), offset)) {
+			rc = SQLITE_CORRUPT;
+			break;
+		}
+
+		rc = sqlite3_step (write);
+		if (rc == SQLITE_DONE) {
+			rc = SQLITE_OK;
+		}
+
+		sqlite3_reset (write);
+	}
+
+	if (rc == SQLITE_DONE) {
+		rc = SQLITE_OK;
+	}
+
+	sqlite3_finalize (read);
+	sqlite3_finalize (write);
+	read = write = NULL;
+
+	/* Document sizes, document IDs are unique across workers */
+	if (rc == SQLITE_OK) {
+		rc = sqlite3_prepare_v2 (part, "SELECT docid, size FROM part.fts_docsize",
+		                         -1, &read, NULL);
+	}
+
+	if (rc == SQLITE_OK) {
+		query = g_strdup_printf ("INSERT INTO %s_docsize (docid, size) VALUES (?, ?)",
+		                         table_name);
+		rc = sqlite3_prepare_v2 (db, query, -1, &write, NULL);
+		g_free (query);
+	}
+
+	while (rc == SQLITE_OK && (rc = sqlite3_step (read)) == SQLITE_ROW) {
+		sqlite3_bind_value (write, 1, sqlite3_column_value (read, 0));
+		sqlite3_bind_value (write, 2, sqlite3_column_value (read, 1));
+
+		rc = sqlite3_step (write);
+		if (rc == SQLITE_DONE) {
+			rc = SQLITE_OK;
+		}
+
+		sqlite3_reset (write);
+	}
+
+	if (rc == SQLITE_DONE) {
+		rc = SQLITE_OK;
+	}
+
+	sqlite3_finalize (read);
+	sqlite3_finalize (write);
+	read = NULL;
+
+	/* Number of documents, followed by the number of tokens per column */
+	if (rc == SQLITE_OK) {
+		rc = sqlite3_prepare_v2 (part, "SELECT value FROM part.fts_stat WHERE id = 0",
+		                         -1, &read, NULL);
+	}
+
+	if (rc == SQLITE_OK && sqlite3_step (read) == SQLITE_ROW) {
+		const guchar *value = sqlite3_column_blob (read, 0);
+		gint len = sqlite3_column_bytes (read, 0);
+		guint i = 0;
+		gint n;
+
+		while (len > 0) {
+			guint64 count;
+
+			n = fts_get_varint (value, len, &count);
+			if (n == 0) {
+				break;
+			}
+
+			if (i == doctotal->len) {
+				g_array_set_size (doctotal, i + 1);
+			}
+
+			g_array_index (doctotal, guint64, i) += count;
+			value += n;
+			len -= n;
+			i++;
+		}
+	}
+
+	sqlite3_finalize (read);
 
 	if (rc != SQLITE_OK) {
-		g_free (tmp_name);
-		return FALSE;
+		g_warning ("Could not copy full-text index segment: %s",
+		           sqlite3_errstr (rc));
 	}
 
-	query = g_strdup_printf ("ALTER TABLE %s RENAME TO %s",
-				 tmp_name, table_name);
-	rc = sqlite3_prepare_v2 (db, query, -1, NULL, NULL);
+	return (rc == SQLITE_OK);
+}
+
+static gboolean
+fts_write_doctotal (sqlite3     *db,
+                    const gchar *table_name,
+                    GArray      *doctotal)
+{
+	sqlite3_stmt *stmt;
+	guchar *value;
+	gchar *query;
+	gint len = 0;
+	guint i;
+	gint rc;
+
+	value = g_malloc (10 * MAX (doctotal->len, 1));
+
+	for (i = 0; i < doctotal->len; i++) {
+		len += fts_put_varint (value + len, g_array_index (doctotal, guint64, i));
+	}
+
+	query = g_strdup_printf ("INSERT OR REPLACE INTO %s_stat (id, value) VALUES (0, ?)",
+	                         table_name);
+	rc = sqlite3_prepare_v2 (db, query, -1, &stmt, NULL);
 	g_free (query);
-	g_free (tmp_name);
 
+	if (rc == SQLITE_OK) {
+		sqlite3_bind_blob (stmt, 1, value, len, g_free);
+		value = NULL;
 
-	if (rc != SQLITE_OK) {
-		g_free (tmp_name);
+		rc = sqlite3_step (stmt);
+		if (rc == SQLITE_DONE) {
+			rc = SQLITE_OK;
+		}
+	}
+
+	sqlite3_finalize (stmt);
+	g_free (value);
+
+	return (rc == SQLITE_OK);
+}
+
+/* Rebuilds the whole full-text index, e.g. after the tokenizer settings
+ * changed. The resource IDs are split in chunks that n_threads threads
+ * tokenize into in-memory indexes, which are then copied into the shadow
+ * tables of a new fts4 table. It replaces the old table in a single
+ * transaction, the old index serves queries until then.
+ *
+ * Worker threads read the committed contents of the database file through
+ * their own connections, so this must run outside of any write transaction.
+ */
+gboolean
+tracker_fts_rebuild_table (sqlite3     *db,
+                           const gchar *filename,
+                           gchar       *table_name,
+                           GHashTable  *tables,
+                           GHashTable  *grouped_columns,
+                           gint         n_threads)
+{
+	FtsRebuild rebuild = { 0 };
+	FtsRebuildWorker *workers;
+	GThread **threads;
+	GString *str;
+	GArray *doctotal;
+	sqlite3_stmt *stmt;
+	gchar *query, *tmp_name;
+	gint64 min_id = 0, max_id = 0;
+	gint64 next_block = 1;
+	gboolean success = TRUE;
+	gboolean savepoint;
+	gint i;
+
+	g_return_val_if_fail (initialized == TRUE, FALSE);
+	g_return_val_if_fail (n_threads > 0, FALSE);
+
+	rebuild.filename = filename;
+
+	if (sqlite3_prepare_v2 (db, "SELECT min(ID), max(ID) FROM Resource",
+	                        -1, &stmt, NULL) != SQLITE_OK) {
 		return FALSE;
 	}
 
-	return TRUE;
+	if (sqlite3_step (stmt) == SQLITE_ROW) {
+		min_id = sqlite3_column_int64 (stmt, 0);
+		max_id = sqlite3_column_int64 (stmt, 1);
+	}
+
+	sqlite3_finalize (stmt);
+
+	rebuild.first_id = min_id;
+	rebuild.chunk_size = (max_id - min_id) / (n_threads * FTS_REBUILD_CHUNKS_PER_THREAD) + 1;
+	rebuild.n_chunks = (max_id - min_id) / rebuild.chunk_size + 1;
+
+	rebuild.create_query = fts_create_table_query ("part.fts", "", tables);
+
+	/* Resources without any text are left out, as in incremental updates */
+	str = g_string_new ("INSERT INTO part.fts (docid");
+	fts_append_columns (str, tables, ", \"%s\"");
+	g_string_append (str, ") ");
+	fts_append_content_query (str, tables, grouped_columns);
+	g_string_append (str, "WHERE Resource.ID BETWEEN ?1 AND ?2 GROUP BY Resource.ID HAVING ");
+	fts_append_columns (str, tables, "\"%s\" IS NOT NULL OR ");
+	g_string_append (str, "0");
+	rebuild.insert_query = g_string_free (str, FALSE);
+
+	workers = g_new0 (FtsRebuildWorker, n_threads);
+	threads = g_new0 (GThread *, n_threads);
+
+	for (i = 0; i < n_threads; i++) {
+		workers[i].rebuild = &rebuild;
+		threads[i] = g_thread_new ("fts-rebuild", fts_rebuild_worker, &workers[i]);
+	}
+
+	for (i = 0; i < n_threads; i++) {
+		g_thread_join (threads[i]);
+		success &= workers[i].success;
+	}
+
+	tmp_name = g_strdup_printf ("%s_TMP", table_name);
+	query = fts_create_table_query (tmp_name, "fts_view", tables);
+	doctotal = g_array_new (FALSE, TRUE, sizeof (guint64));
+
+	savepoint = success && fts_exec (db, "SAVEPOINT fts_rebuild");
+	success = (savepoint &&
+	           fts_exec (db, "DROP TABLE IF EXISTS %s", tmp_name) &&
+	           fts_exec (db, "%s", query));
+
+	for (i = 0; success && i < n_threads; i++) {
+		success = fts_copy_index (db, tmp_name, workers[i].db,
+		                          &next_block, doctotal);
+	}
+
+	success = (success &&
+	           fts_write_doctotal (db, tmp_name, doctotal) &&
+	           fts_swap_tables (db, table_name, tmp_name));
+
+	if (success) {
+		success = fts_exec (db, "RELEASE fts_rebuild");
+	} else if (savepoint) {
+		fts_exec (db, "ROLLBACK TO fts_rebuild; RELEASE fts_rebuild");
+	}
+
+	for (i = 0; i < n_threads; i++) {
+		sqlite3_close (workers[i].db);
+	}
+
+	g_array_unref (doctotal);
+	g_free (query);
+	g_free (tmp_name);
+	g_free (threads);
+	g_free (workers);
+	g_free (rebuild.create_query);
+	g_free (rebuild.insert_query);
+
+	return success;
 }
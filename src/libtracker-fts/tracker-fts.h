@@ -40,6 +40,13 @@ gboolean    tracker_fts_alter_table      (sqlite3    *db,
                                           gchar      *table_name,
                                           GHashTable *tables,
                                           GHashTable *grouped_columns);
+gboolean    tracker_fts_rebuild_table    (sqlite3    *db,
+                                          const gchar *filename,
+                                          gchar      *table_name,
+                                          GHashTable *tables,
+                                          GHashTable *grouped_columns,
+                                          gint        n_threads);
+gchar *     tracker_fts_get_tokenizer_config (void);
 
 
 G_END_DECLS
@@ -0,0 +1,502 @@
+/*
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ * Boston, MA  02110-1301, USA.
+ */
+
+#include "config.h"
+
+#include <string.h>
+
+#include <glib/gstdio.h>
+
+#include "tracker-crawl-state.h"
+
+/* Snapshot of the modification time each indexed file had in the
+ * store, so crawling doesn't need to query the store to find out
+ * what changed while the miner wasn't running. Files are keyed by
+ * a 64 bit hash of their URI, only directories keep their IRI, as
+ * it's needed for their children.
+ *
+ * The file is a header, the records sorted by hash and the IRI
+ * strings, it's mapped read-only and looked up through binary
+ * search. Changes are kept aside until the file is rewritten.
+ */
+
+#define CRAWL_STATE_MAGIC   "TRKCRAWL"
+#define CRAWL_STATE_VERSION 1
+
+#define NO_IRI G_MAXUINT32
+
+/* Write the pending changes out once there's this many of them,
+ * this keeps memory use bounded while indexing for the first time.
+ */
+#define MAX_CHANGES 65536
+
+typedef struct {
+	gchar   magic[8];
+	guint32 version;
+	guint32 n_records;
+	guint32 strings_size;
+	guint32 reserved;
+} CrawlStateHeader;
+
+typedef struct {
+	guint64 hash;
+	guint64 mtime;
+	guint32 iri;
+	guint32 reserved;
+} CrawlStateRecord;
+
+typedef struct {
+	guint64 hash;
+	guint64 mtime;
+	gchar *iri;
+	gboolean removed;
+} CrawlStateChange;
+
+struct _TrackerCrawlState {
+	gchar *filename;
+
+	GMappedFile *mapped;
+	const CrawlStateRecord *records;
+	guint n_records;
+	const gchar *strings;
+	gsize strings_size;
+
+	/* guint64 hash -> CrawlStateChange */
+	GHashTable *changes;
+};
+
+static guint64
+crawl_state_hash (GFile *file)
+{
+	guint64 hash = G_GUINT64_CONSTANT (14695981039346656037);
+	const guchar *p;
+	gchar *uri;
+
+	/* FNV-1a */
+	uri = g_file_get_uri (file);
+
+	for (p = (const guchar *) uri; *p; p++) {
+		hash ^= *p;
+		hash *= G_GUINT64_CONSTANT (1099511628211);
+	}
+
+	g_free (uri);
+
+	return hash;
+}
+
+static void
+crawl_state_change_free (CrawlStateChange *change)
+{
+	g_free (change->iri);
+	g_slice_free (CrawlStateChange, change);
+}
+
+static void
+crawl_state_unload (TrackerCrawlState *state)
+{
+	if (state->mapped) {
+		g_mapped_file_unref (state->mapped);
+		state->mapped = NULL;
+	}
+
+	state->records = NULL;
+	state->n_records = 0;
+	state->strings = NULL;
+	state->strings_size = 0;
+}
+
+static void
+crawl_state_load (TrackerCrawlState *state)
+{
+	const CrawlStateHeader *header;
+	const gchar *contents;
+	GError *error = NULL;
+	gsize size, records_size;
+
+	state->mapped = g_mapped_file_new (state->filename, FALSE, &error);
+
+	if (!state->mapped) {
+		if (!g_error_matches (error, G_FILE_ERROR, G_FILE_ERROR_NOENT)) {
+			g_message ("Could not load crawl state from '%s': %s",
+			           state->filename, error->message);
+		}
+
+		g_error_free (error);
+		return;
+	}
+
+	contents = g_mapped_file_get_contents (state->mapped);
+	size = g_mapped_file_get_length (state->mapped);
+
+	if (size < sizeof (CrawlStateHeader)) {
+		goto invalid;
+	}
+
+	header = (const CrawlStateHeader *) contents;
+
+	if (memcmp (header->magic, CRAWL_STATE_MAGIC, sizeof (header->magic)) != 0 ||
+	    header->version != CRAWL_STATE_VERSION) {
+		goto invalid;
+	}
+
+	size -= sizeof (CrawlStateHeader);
+	records_size = (gsize) header->n_records * sizeof (CrawlStateRecord);
+
+	if (size < records_size ||
+	    size - records_size != header->strings_size) {
+		goto invalid;
+	}
+
+	state->records = (const CrawlStateRecord *) (contents + sizeof (CrawlStateHeader));
+	state->n_records = header->n_records;
+	state->strings = contents + sizeof (CrawlStateHeader) + records_size;
+	state->strings_size = header->strings_size;
+
+	if (state->strings_size > 0 &&
+	    state->strings[state->strings_size - 1] != '\0') {
+		goto invalid;
+	}
+
+	g_debug ("Loaded crawl state from '%s', %u files",
+	         state->filename, state->n_records);
+	return;
+
+invalid:
+	g_message ("Ignoring invalid crawl state in '%s'", state->filename);
+	crawl_state_unload (state);
+}
+
+TrackerCrawlState *
+tracker_crawl_state_new (const gchar *filename)
+{
+	TrackerCrawlState *state;
+
+	g_return_val_if_fail (filename != NULL, NULL);
+
+	state = g_slice_new0 (TrackerCrawlState);
+	state->filename = g_strdup (filename);
+	state->changes = g_hash_table_new_full (g_int64_hash, g_int64_equal, NULL,
+	                                        (GDestroyNotify) crawl_state_change_free);
+	crawl_state_load (state);
+
+	return state;
+}
+
+void
+tracker_crawl_state_free (TrackerCrawlState *state)
+{
+	g_return_if_fail (state != NULL);
+
+	crawl_state_unload (state);
+	g_hash_table_unref (state->changes);
+	g_free (state->filename);
+	g_slice_free (TrackerCrawlState, state);
+}
+
+static const CrawlStateRecord *
+crawl_state_find_record (TrackerCrawlState *state,
+                         guint64            hash)
+{
+	guint lo = 0, hi = state->n_records;
+
+	while (lo < hi) {
+		guint mid = lo + (hi - lo) / 2;
+
+		if (state->records[mid].hash < hash) {
+			lo = mid + 1;
+		} else if (state->records[mid].hash > hash) {
+			hi = mid;
+		} else {
+			return &state->records[mid];
+		}
+	}
+
+	return NULL;
+}
+
+static gboolean
+crawl_state_lookup_hash (TrackerCrawlState  *state,
+                         guint64             hash,
+                         guint64            *mtime,
+                         const gchar       **iri)
+{
+	const CrawlStateRecord *record;
+	CrawlStateChange *change;
+
+	change = g_hash_table_lookup (state->changes, &hash);
+
+	if (change) {
+		if (change->removed) {
+			return FALSE;
+		}
+
+		if (mtime) {
+			*mtime = change->mtime;
+		}
+
+		if (iri) {
+			*iri = change->iri;
+		}
+
+		return TRUE;
+	}
+
+	record = crawl_state_find_record (state, hash);
+
+	if (!record) {
+		return FALSE;
+	}
+
+	if (mtime) {
+		*mtime = record->mtime;
+	}
+
+	if (iri) {
+		if (record->iri < state->strings_size) {
+			*iri = &state->strings[record->iri];
+		} else {
+			*iri = NULL;
+		}
+	}
+
+	return TRUE;
+}
+
+/* Returns whether @file was in the store with @mtime when the
+ * snapshot was last updated, the returned IRI is only valid until
+ * the state is next modified.
+ */
+gboolean
+tracker_crawl_state_lookup (TrackerCrawlState  *state,
+                            GFile              *file,
+                            guint64            *mtime,
+                            const gchar       **iri)
+{
+	g_return_val_if_fail (state != NULL, FALSE);
+	g_return_val_if_fail (G_IS_FILE (file), FALSE);
+
+	return crawl_state_lookup_hash (state, crawl_state_hash (file),
+	                                mtime, iri);
+}
+
+static void
+crawl_state_add_change (TrackerCrawlState *state,
+                        guint64            hash,
+                        guint64            mtime,
+                        const gchar       *iri,
+                        gboolean           removed)
+{
+	CrawlStateChange *change;
+
+	change = g_slice_new0 (CrawlStateChange);
+	change->hash = hash;
+	change->mtime = mtime;
+	change->iri = g_strdup (iri);
+	change->removed = removed;
+
+	g_hash_table_replace (state->changes, &change->hash, change);
+
+	if (g_hash_table_size (state->changes) >= MAX_CHANGES) {
+		GError *error = NULL;
+
+		if (!tracker_crawl_state_save (state, &error)) {
+			g_message ("Could not save crawl state: %s", error->message);
+			g_error_free (error);
+		}
+	}
+}
+
+void
+tracker_crawl_state_set (TrackerCrawlState *state,
+                         GFile             *file,
+                         guint64            mtime,
+                         const gchar       *iri)
+{
+	const gchar *cur_iri;
+	guint64 hash, cur_mtime;
+
+	g_return_if_fail (state != NULL);
+	g_return_if_fail (G_IS_FILE (file));
+
+	hash = crawl_state_hash (file);
+
+	if (crawl_state_lookup_hash (state, hash, &cur_mtime, &cur_iri) &&
+	    cur_mtime == mtime && g_strcmp0 (cur_iri, iri) == 0) {
+		/* Nothing changed */
+		return;
+	}
+
+	crawl_state_add_change (state, hash, mtime, iri, FALSE);
+}
+
+void
+tracker_crawl_state_remove (TrackerCrawlState *state,
+                            GFile             *file)
+{
+	guint64 hash;
+
+	g_return_if_fail (state != NULL);
+	g_return_if_fail (G_IS_FILE (file));
+
+	hash = crawl_state_hash (file);
+
+	if (!crawl_state_lookup_hash (state, hash, NULL, NULL)) {
+		return;
+	}
+
+	crawl_state_add_change (state, hash, 0, NULL, TRUE);
+}
+
+static gint
+crawl_state_record_compare (gconstpointer a,
+                            gconstpointer b)
+{
+	const CrawlStateRecord *ra = a, *rb = b;
+
+	if (ra->hash < rb->hash) {
+		return -1;
+	} else if (ra->hash > rb->hash) {
+		return 1;
+	}
+
+	return 0;
+}
+
+static void
+crawl_state_append_record (GArray      *records,
+                           GString     *strings,
+                           guint64      hash,
+                           guint64      mtime,
+                           const gchar *iri)
+{
+	CrawlStateRecord record = { 0 };
+
+	record.hash = hash;
+	record.mtime = mtime;
+	record.iri = NO_IRI;
+
+	if (iri) {
+		record.iri = strings->len;
+		g_string_append_len (strings, iri, strlen (iri) + 1);
+	}
+
+	g_array_append_val (records, record);
+}
+
+/* Writes the snapshot with all changes merged in, the file is
+ * replaced atomically.
+ */
+gboolean
+tracker_crawl_state_save (TrackerCrawlState  *state,
+                          GError            **error)
+{
+	CrawlStateHeader header = { { 0 } };
+	CrawlStateChange *change;
+	GHashTableIter iter;
+	GArray *records;
+	GString *strings, *contents;
+	gchar *dirname;
+	gboolean retval;
+	guint i;
+
+	g_return_val_if_fail (state != NULL, FALSE);
+
+	if (g_hash_table_size (state->changes) == 0) {
+		return TRUE;
+	}
+
+	records = g_array_sized_new (FALSE, FALSE, sizeof (CrawlStateRecord),
+	                             state->n_records + g_hash_table_size (state->changes));
+	strings = g_string_new (NULL);
+
+	for (i = 0; i < state->n_records; i++) {
+		const CrawlStateRecord *record = &state->records[i];
+		const gchar *iri = NULL;
+
+		if (g_hash_table_contains (state->changes, &record->hash)) {
+			continue;
+		}
+
+		if (record->iri < state->strings_size) {
+			iri = &state->strings[record->iri];
+		}
+
+		crawl_state_append_record (records, strings,
+		                           record->hash, record->mtime, iri);
+	}
+
+	g_hash_table_iter_init (&iter, state->changes);
+
+	while (g_hash_table_iter_next (&iter, NULL, (gpointer *) &change)) {
+		if (change->removed) {
+			continue;
+		}
+
+		crawl_state_append_record (records, strings,
+		                           change->hash, change->mtime, change->iri);
+	}
+
+	if (strings->len >= NO_IRI) {
+		g_set_error (error, G_FILE_ERROR, G_FILE_ERROR_FBIG,
+		             "Crawl state is too large");
+		g_array_unref (records);
+		g_string_free (strings, TRUE);
+		return FALSE;
+	}
+
+	g_array_sort (records, crawl_state_record_compare);
+
+	memcpy (header.magic, CRAWL_STATE_MAGIC, sizeof (header.magic));
+	header.version = CRAWL_STATE_VERSION;
+	header.n_records = records->len;
+	header.strings_size = strings->len;
+
+	contents = g_string_sized_new (sizeof (CrawlStateHeader) +
+	                               records->len * sizeof (CrawlStateRecord) +
+	                               strings->len);
+	g_string_append_len (contents, (const gchar *) &header, sizeof (header));
+	g_string_append_len (contents, records->data,
+	                     records->len * sizeof (CrawlStateRecord));
+	g_string_append_len (contents, strings->str, strings->len);
+
+	g_array_unref (records);
+	g_string_free (strings, TRUE);
+
+	dirname = g_path_get_dirname (state->filename);
+	g_mkdir_with_parents (dirname, 0700);
+	g_free (dirname);
+
+	/* Unmap before replacing, so the old contents go away */
+	crawl_state_unload (state);
+
+	retval = g_file_set_contents (state->filename,
+	                              contents->str, contents->len,
+	                              error);
+	g_string_free (contents, TRUE);
+
+	if (retval) {
+		g_hash_table_remove_all (state->changes);
+	}
+
+	/* On failure, the changes are still around, and applied on
+	 * top of whatever the file now contains.
+	 */
+	crawl_state_load (state);
+
+	return retval;
+}
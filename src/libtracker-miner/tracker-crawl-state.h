@@ -0,0 +1,50 @@
+/*
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ * Boston, MA  02110-1301, USA.
+ */
+
+#ifndef __LIBTRACKER_MINER_CRAWL_STATE_H__
+#define __LIBTRACKER_MINER_CRAWL_STATE_H__
+
+#if !defined (__LIBTRACKER_MINER_H_INSIDE__) && !defined (TRACKER_COMPILATION)
+#error "Only <libtracker-miner/tracker-miner.h> can be included directly."
+#endif
+
+#include <gio/gio.h>
+
+G_BEGIN_DECLS
+
+typedef struct _TrackerCrawlState TrackerCrawlState;
+
+TrackerCrawlState *tracker_crawl_state_new    (const gchar        *filename);
+void               tracker_crawl_state_free   (TrackerCrawlState  *state);
+
+gboolean           tracker_crawl_state_lookup (TrackerCrawlState  *state,
+                                               GFile              *file,
+                                               guint64            *mtime,
+                                               const gchar       **iri);
+void               tracker_crawl_state_set    (TrackerCrawlState  *state,
+                                               GFile              *file,
+                                               guint64             mtime,
+                                               const gchar        *iri);
+void               tracker_crawl_state_remove (TrackerCrawlState  *state,
+                                               GFile              *file);
+
+gboolean           tracker_crawl_state_save   (TrackerCrawlState  *state,
+                                               GError            **error);
+
+G_END_DECLS
+
+#endif /* __LIBTRACKER_MINER_CRAWL_STATE_H__ */
@@ -20,6 +20,7 @@
 #include "config.h"
 
 #include "tracker-crawler.h"
+#include "tracker-dir-scanner.h"
 #include "tracker-file-data-provider.h"
 #include "tracker-miner-enums.h"
 #include "tracker-miner-enum-types.h"
@@ -61,6 +62,7 @@ struct DirectoryChildData {
 struct DirectoryProcessingData {
 	GNode *node;
 	GSList *children;
+	TrackerDirScan *scan;
 	guint was_inspected : 1;
 	guint ignored_by_content : 1;
 };
@@ -98,6 +100,10 @@ struct TrackerCrawlerPrivate {
 
 	gchar          *file_attributes;
 
+	/* Threaded directory reads for local files */
+	TrackerDirScanner *scanner;
+	GCancellable   *scan_cancellable;
+
 	/* Statistics */
 	GTimer         *timer;
 
@@ -145,6 +151,12 @@ static void     data_provider_begin      (TrackerCrawler          *crawler,
 					  DirectoryProcessingData *dir_data);
 static void     data_provider_end        (TrackerCrawler          *crawler,
                                           DirectoryRootInfo       *info);
+static void     directory_scan_push      (TrackerCrawler          *crawler,
+                                          DirectoryProcessingData *dir_data);
+static void     directory_scan_finish    (TrackerCrawler          *crawler,
+                                          DirectoryRootInfo       *info,
+                                          DirectoryProcessingData *dir_data);
+static gboolean directory_scan_ready_cb  (gpointer                 user_data);
 static void     directory_root_info_free (DirectoryRootInfo *info);
 
 
@@ -308,9 +320,18 @@ crawler_finalize (GObject *object)
 
 	g_list_free (priv->cancellables);
 
+	if (priv->scan_cancellable) {
+		g_cancellable_cancel (priv->scan_cancellable);
+		g_object_unref (priv->scan_cancellable);
+	}
+
 	g_queue_foreach (priv->directories, (GFunc) directory_root_info_free, NULL);
 	g_queue_free (priv->directories);
 
+	if (priv->scanner) {
+		tracker_dir_scanner_free (priv->scanner);
+	}
+
 	g_free (priv->file_attributes);
 
 	if (priv->data_provider) {
@@ -454,6 +475,10 @@ directory_processing_data_free (DirectoryProcessingData *data)
 	g_slist_foreach (data->children, (GFunc) directory_child_data_free, NULL);
 	g_slist_free (data->children);
 
+	if (data->scan) {
+		tracker_dir_scan_unref (data->scan);
+	}
+
 	g_slice_free (DirectoryProcessingData, data);
 }
 
@@ -617,18 +642,34 @@ process_func (gpointer data)
 		iterate = (info->max_depth >= 0) ? depth < info->max_depth : TRUE;
 
 		/* One directory inside the tree hierarchy is being inspected */
-		if (!dir_data->was_inspected) {
+		if (!dir_data->was_inspected &&
+		    dir_data->scan && priv->is_running && iterate &&
+		    !tracker_dir_scan_is_done (dir_data->scan)) {
+			/* The scanner threads are still reading the directory,
+			 * stop this idle function until they're done with it.
+			 */
+			tracker_dir_scan_set_ready_func (dir_data->scan,
+			                                 directory_scan_ready_cb,
+			                                 g_object_ref (crawler),
+			                                 g_object_unref);
+			stop_idle = TRUE;
+		} else if (!dir_data->was_inspected) {
 			dir_data->was_inspected = TRUE;
 
 			/* Crawler may have been already stopped while we were waiting for the
 			 *  check_directory return value, and thus we should check if it's
 			 *  running before going on with the iteration */
 			if (priv->is_running && iterate) {
-				/* Directory contents haven't been inspected yet,
-				 * stop this idle function while it's being iterated
-				 */
-				data_provider_begin (crawler, info, dir_data);
-				stop_idle = TRUE;
+				if (dir_data->scan) {
+					/* Contents were read ahead of time */
+					directory_scan_finish (crawler, info, dir_data);
+				} else {
+					/* Directory contents haven't been inspected yet,
+					 * stop this idle function while it's being iterated
+					 */
+					data_provider_begin (crawler, info, dir_data);
+					stop_idle = TRUE;
+				}
 			}
 		} else if (dir_data->was_inspected &&
 			   !dir_data->ignored_by_content &&
@@ -660,6 +701,13 @@ process_func (gpointer data)
 				DirectoryProcessingData *child_dir_data;
 
 				child_dir_data = directory_processing_data_new (child_node);
+
+				if (dir_data->scan &&
+				    (info->max_depth < 0 || depth + 1 < info->max_depth)) {
+					/* Have the child read while the queue gets to it */
+					directory_scan_push (crawler, child_dir_data);
+				}
+
 				g_queue_push_tail (info->directory_processing_queue, child_dir_data);
 			}
 
@@ -1026,6 +1074,18 @@ data_provider_begin_cb (GObject      *object,
 	                               dpd);
 }
 
+static gchar *
+crawler_get_attributes (TrackerCrawler *crawler)
+{
+	if (crawler->priv->file_attributes) {
+		return g_strconcat (FILE_ATTRIBUTES ",",
+		                    crawler->priv->file_attributes,
+		                    NULL);
+	} else {
+		return g_strdup (FILE_ATTRIBUTES);
+	}
+}
+
 static void
 data_provider_begin (TrackerCrawler          *crawler,
                      DirectoryRootInfo       *info,
@@ -1042,13 +1102,7 @@ data_provider_begin (TrackerCrawler          *crawler,
 	dpd = data_provider_data_new (crawler, info, dir_data);
 	info->dpd = dpd;
 
-	if (crawler->priv->file_attributes) {
-		attrs = g_strconcat (FILE_ATTRIBUTES ",",
-		                     crawler->priv->file_attributes,
-		                     NULL);
-	} else {
-		attrs = g_strdup (FILE_ATTRIBUTES);
-	}
+	attrs = crawler_get_attributes (crawler);
 
 	tracker_data_provider_begin_async (crawler->priv->data_provider,
 	                                   dpd->dir_file,
@@ -1061,6 +1115,127 @@ data_provider_begin (TrackerCrawler          *crawler,
 	g_free (attrs);
 }
 
+static gboolean
+directory_scan_ready_cb (gpointer user_data)
+{
+	TrackerCrawler *crawler = user_data;
+
+	if (crawler->priv->is_running) {
+		process_func_start (crawler);
+	}
+
+	return FALSE;
+}
+
+static void
+directory_scan_push (TrackerCrawler          *crawler,
+                     DirectoryProcessingData *dir_data)
+{
+	gchar *attrs;
+
+	attrs = crawler_get_attributes (crawler);
+	dir_data->scan = tracker_dir_scanner_push (crawler->priv->scanner,
+	                                           G_FILE (dir_data->node->data),
+	                                           attrs,
+	                                           crawler->priv->scan_cancellable);
+	g_free (attrs);
+}
+
+static void
+directory_scan_finish (TrackerCrawler          *crawler,
+                       DirectoryRootInfo       *info,
+                       DirectoryProcessingData *dir_data)
+{
+	DataProviderData *dpd;
+	GError *error = NULL;
+	GSList *files;
+
+	files = tracker_dir_scan_steal_infos (dir_data->scan, &error);
+
+	if (error) {
+		if (!g_error_matches (error, G_IO_ERROR, G_IO_ERROR_CANCELLED)) {
+			gchar *uri;
+
+			uri = g_file_get_uri (G_FILE (dir_data->node->data));
+			g_warning ("Could not enumerate container / directory '%s', %s",
+			           uri, error->message);
+			g_free (uri);
+		}
+
+		g_error_free (error);
+		return;
+	}
+
+	/* Handle the results just like those of a data provider */
+	dpd = data_provider_data_new (crawler, info, dir_data);
+	dpd->files = files;
+
+	data_provider_data_add (dpd);
+	data_provider_data_process (dpd);
+
+	data_provider_data_free (dpd);
+}
+
+static gboolean
+crawler_use_scanner (TrackerCrawler        *crawler,
+                     GFile                 *file,
+                     TrackerDirectoryFlags  flags)
+{
+	TrackerCrawlerPrivate *priv;
+	gboolean supported;
+	gchar *attrs;
+
+	priv = crawler->priv;
+
+	/* Other data providers may not even be backed by directories */
+	if (!TRACKER_IS_FILE_DATA_PROVIDER (priv->data_provider) ||
+	    (flags & TRACKER_DIRECTORY_FLAG_NO_STAT) != 0 ||
+	    !g_file_is_native (file)) {
+		return FALSE;
+	}
+
+	attrs = crawler_get_attributes (crawler);
+	supported = tracker_dir_scanner_supports (attrs);
+	g_free (attrs);
+
+	if (!supported) {
+		return FALSE;
+	}
+
+	if (!priv->scanner) {
+		const gchar *env;
+		guint n_threads = 0;
+
+		/* TRACKER_CRAWLER_THREADS=0 goes back to GFileEnumerator */
+		env = g_getenv ("TRACKER_CRAWLER_THREADS");
+
+		if (env) {
+			gint64 value;
+
+			value = g_ascii_strtoll (env, NULL, 10);
+
+			if (value == 0) {
+				return FALSE;
+			} else if (value > 0) {
+				n_threads = (guint) MIN (value, G_MAXUINT);
+			}
+		}
+
+		priv->scanner = tracker_dir_scanner_new (n_threads);
+		tracker_dir_scanner_set_throttle (priv->scanner, priv->throttle);
+		tracker_dir_scanner_set_paused (priv->scanner, priv->is_paused);
+
+		g_debug ("Crawler reading local directories from %u threads",
+		         tracker_dir_scanner_get_n_threads (priv->scanner));
+	}
+
+	if (!priv->scan_cancellable) {
+		priv->scan_cancellable = g_cancellable_new ();
+	}
+
+	return TRUE;
+}
+
 gboolean
 tracker_crawler_start (TrackerCrawler        *crawler,
                        GFile                 *file,
@@ -1117,6 +1292,11 @@ tracker_crawler_start (TrackerCrawler        *crawler,
 		return FALSE;
 	}
 
+	if (max_depth != 0 && crawler_use_scanner (crawler, file, flags)) {
+		directory_scan_push (crawler,
+		                     g_queue_peek_head (info->directory_processing_queue));
+	}
+
 	g_queue_push_tail (priv->directories, info);
 	process_func_start (crawler);
 
@@ -1140,6 +1320,14 @@ tracker_crawler_stop (TrackerCrawler *crawler)
 	priv->is_running = FALSE;
 	g_list_foreach (priv->cancellables, (GFunc) g_cancellable_cancel, NULL);
 
+	if (priv->scan_cancellable) {
+		/* Scans already queued bail out, the next start
+		 * gets a fresh cancellable.
+		 */
+		g_cancellable_cancel (priv->scan_cancellable);
+		g_clear_object (&priv->scan_cancellable);
+	}
+
 	process_func_stop (crawler);
 
 	if (priv->timer) {
@@ -1166,6 +1354,10 @@ tracker_crawler_pause (TrackerCrawler *crawler)
 
 	crawler->priv->is_paused = TRUE;
 
+	if (crawler->priv->scanner) {
+		tracker_dir_scanner_set_paused (crawler->priv->scanner, TRUE);
+	}
+
 	if (crawler->priv->is_running) {
 		g_timer_stop (crawler->priv->timer);
 		process_func_stop (crawler);
@@ -1182,6 +1374,10 @@ tracker_crawler_resume (TrackerCrawler *crawler)
 
 	crawler->priv->is_paused = FALSE;
 
+	if (crawler->priv->scanner) {
+		tracker_dir_scanner_set_paused (crawler->priv->scanner, FALSE);
+	}
+
 	if (crawler->priv->is_running) {
 		g_timer_continue (crawler->priv->timer);
 		process_func_start (crawler);
@@ -1200,6 +1396,11 @@ tracker_crawler_set_throttle (TrackerCrawler *crawler,
 	throttle = CLAMP (throttle, 0, 1);
 	crawler->priv->throttle = throttle;
 
+	/* Fewer threads reading directories the more we're throttled */
+	if (crawler->priv->scanner) {
+		tracker_dir_scanner_set_throttle (crawler->priv->scanner, throttle);
+	}
+
 	/* Update timeouts */
 	if (crawler->priv->idle_id != 0) {
 		guint interval, idle_id;
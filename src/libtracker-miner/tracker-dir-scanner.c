@@ -0,0 +1,731 @@
+/*
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ * Boston, MA  02110-1301, USA.
+ */
+
+#include "config.h"
+
+#include <dirent.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+#include <unistd.h>
+
+#include "tracker-dir-scanner.h"
+
+/* Reads directories on local file systems from a pool of threads,
+ * each entry is stat()ed right after it's read, so a GFileInfo with
+ * all the requested attributes is available in a single pass, and
+ * network file systems get to batch the attribute fetches with the
+ * directory listing.
+ *
+ * Only attributes that can be filled in from struct stat (and the
+ * content type) are supported, callers are expected to fall back to
+ * GFileEnumerator for anything else.
+ */
+
+#define DIR_SCANNER_MAX_THREADS 16
+
+/* Same sniffing length GIO uses for local files */
+#define SNIFF_BUFFER_SIZE       4096
+
+typedef enum {
+	SCAN_DISPLAY_NAME      = 1 << 0,
+	SCAN_IS_SYMLINK        = 1 << 1,
+	SCAN_SIZE              = 1 << 2,
+	SCAN_ALLOCATED_SIZE    = 1 << 3,
+	SCAN_CONTENT_TYPE      = 1 << 4,
+	SCAN_FAST_CONTENT_TYPE = 1 << 5,
+	SCAN_TIME_MODIFIED     = 1 << 6,
+	SCAN_TIME_ACCESS       = 1 << 7,
+	SCAN_TIME_CHANGED      = 1 << 8,
+	SCAN_UNIX_DEVICE       = 1 << 9,
+	SCAN_UNIX_INODE        = 1 << 10,
+	SCAN_UNIX_MODE         = 1 << 11,
+	SCAN_UNIX_NLINK        = 1 << 12,
+	SCAN_UNIX_UID          = 1 << 13,
+	SCAN_UNIX_GID          = 1 << 14
+} ScanAttributes;
+
+static const struct {
+	const gchar *name;
+	ScanAttributes flag;
+} supported_attributes[] = {
+	/* Name and type are always filled in */
+	{ G_FILE_ATTRIBUTE_STANDARD_NAME, 0 },
+	{ G_FILE_ATTRIBUTE_STANDARD_TYPE, 0 },
+	{ G_FILE_ATTRIBUTE_STANDARD_DISPLAY_NAME, SCAN_DISPLAY_NAME },
+	{ G_FILE_ATTRIBUTE_STANDARD_IS_SYMLINK, SCAN_IS_SYMLINK },
+	{ G_FILE_ATTRIBUTE_STANDARD_SIZE, SCAN_SIZE },
+	{ G_FILE_ATTRIBUTE_STANDARD_ALLOCATED_SIZE, SCAN_ALLOCATED_SIZE },
+	{ G_FILE_ATTRIBUTE_STANDARD_CONTENT_TYPE, SCAN_CONTENT_TYPE },
+	{ G_FILE_ATTRIBUTE_STANDARD_FAST_CONTENT_TYPE, SCAN_FAST_CONTENT_TYPE },
+	{ G_FILE_ATTRIBUTE_TIME_MODIFIED, SCAN_TIME_MODIFIED },
+	{ G_FILE_ATTRIBUTE_TIME_ACCESS, SCAN_TIME_ACCESS },
+	{ G_FILE_ATTRIBUTE_TIME_CHANGED, SCAN_TIME_CHANGED },
+	{ G_FILE_ATTRIBUTE_UNIX_DEVICE, SCAN_UNIX_DEVICE },
+	{ G_FILE_ATTRIBUTE_UNIX_INODE, SCAN_UNIX_INODE },
+	{ G_FILE_ATTRIBUTE_UNIX_MODE, SCAN_UNIX_MODE },
+	{ G_FILE_ATTRIBUTE_UNIX_NLINK, SCAN_UNIX_NLINK },
+	{ G_FILE_ATTRIBUTE_UNIX_UID, SCAN_UNIX_UID },
+	{ G_FILE_ATTRIBUTE_UNIX_GID, SCAN_UNIX_GID }
+};
+
+struct _TrackerDirScanner {
+	GThreadPool *pool;
+	guint n_threads;
+	gdouble throttle;
+	gboolean paused;
+};
+
+struct _TrackerDirScan {
+	volatile gint ref_count;
+	guint attributes;
+
+	GFile *directory;
+	GCancellable *cancellable;
+
+	GMutex mutex;
+	gboolean done;
+	GSList *infos;
+	GError *error;
+
+	GMainContext *context;
+	GSourceFunc ready_func;
+	gpointer ready_data;
+	GDestroyNotify ready_destroy;
+};
+
+static gboolean
+dir_scanner_parse_attributes (const gchar *attributes,
+                              guint       *flags_out)
+{
+	gboolean supported = TRUE;
+	gchar **attrs;
+	guint flags = 0;
+	gint i;
+
+	attrs = g_strsplit (attributes, ",", -1);
+
+	for (i = 0; attrs[i] && supported; i++) {
+		const gchar *attr;
+		guint j;
+
+		attr = g_strstrip (attrs[i]);
+
+		if (*attr == '\0') {
+			continue;
+		}
+
+		/* Wildcards and unknown attributes are not supported */
+		supported = FALSE;
+
+		for (j = 0; j < G_N_ELEMENTS (supported_attributes); j++) {
+			if (strcmp (attr, supported_attributes[j].name) == 0) {
+				flags |= supported_attributes[j].flag;
+				supported = TRUE;
+				break;
+			}
+		}
+	}
+
+	g_strfreev (attrs);
+
+	if (flags_out) {
+		*flags_out = flags;
+	}
+
+	return supported;
+}
+
+static gchar *
+dir_scanner_get_content_type (gint          dir_fd,
+                              const gchar  *name,
+                              struct stat  *st,
+                              gboolean      fast)
+{
+	gchar *content_type;
+	gboolean uncertain;
+
+	/* Mirrors what GIO does for local files */
+	if (S_ISLNK (st->st_mode)) {
+		return g_content_type_from_mime_type ("inode/symlink");
+	} else if (S_ISDIR (st->st_mode)) {
+		return g_content_type_from_mime_type ("inode/directory");
+	} else if (S_ISCHR (st->st_mode)) {
+		return g_content_type_from_mime_type ("inode/chardevice");
+	} else if (S_ISBLK (st->st_mode)) {
+		return g_content_type_from_mime_type ("inode/blockdevice");
+	} else if (S_ISFIFO (st->st_mode)) {
+		return g_content_type_from_mime_type ("inode/fifo");
+	} else if (S_ISSOCK (st->st_mode)) {
+		return g_content_type_from_mime_type ("inode/socket");
+	} else if (S_ISREG (st->st_mode) && st->st_size == 0) {
+		return g_content_type_from_mime_type ("application/x-zerosize");
+	}
+
+	content_type = g_content_type_guess (name, NULL, 0, &uncertain);
+
+	if (!fast && uncertain && S_ISREG (st->st_mode)) {
+		guchar buffer[SNIFF_BUFFER_SIZE];
+		gssize len;
+		gint fd;
+
+#ifdef O_NOATIME
+		fd = openat (dir_fd, name, O_RDONLY | O_NOFOLLOW | O_CLOEXEC | O_NOATIME);
+
+		if (fd < 0 && errno == EPERM)
+#endif
+			fd = openat (dir_fd, name, O_RDONLY | O_NOFOLLOW | O_CLOEXEC);
+
+		if (fd >= 0) {
+			len = read (fd, buffer, sizeof (buffer));
+			close (fd);
+
+			if (len >= 0) {
+				g_free (content_type);
+				content_type = g_content_type_guess (name, buffer, len, NULL);
+			}
+		}
+	}
+
+	return content_type;
+}
+
+static GFileInfo *
+dir_scanner_file_info_new (guint         attributes,
+                           gint          dir_fd,
+                           const gchar  *name,
+                           struct stat  *st)
+{
+	GFileInfo *info;
+	GFileType file_type;
+
+	info = g_file_info_new ();
+	g_file_info_set_name (info, name);
+
+	if (S_ISREG (st->st_mode)) {
+		file_type = G_FILE_TYPE_REGULAR;
+	} else if (S_ISDIR (st->st_mode)) {
+		file_type = G_FILE_TYPE_DIRECTORY;
+	} else if (S_ISLNK (st->st_mode)) {
+		file_type = G_FILE_TYPE_SYMBOLIC_LINK;
+	} else {
+		file_type = G_FILE_TYPE_SPECIAL;
+	}
+
+	g_file_info_set_file_type (info, file_type);
+
+	if (attributes & SCAN_DISPLAY_NAME) {
+		gchar *display_name;
+
+		display_name = g_filename_display_name (name);
+
+		if (!g_utf8_validate (name, -1, NULL)) {
+			gchar *tmp;
+
+			tmp = display_name;
+			display_name = g_strconcat (tmp, " (invalid encoding)", NULL);
+			g_free (tmp);
+		}
+
+		g_file_info_set_display_name (info, display_name);
+		g_free (display_name);
+	}
+
+	if (attributes & SCAN_IS_SYMLINK) {
+		g_file_info_set_is_symlink (info, S_ISLNK (st->st_mode));
+	}
+
+	if (attributes & SCAN_SIZE) {
+		g_file_info_set_size (info, st->st_size);
+	}
+
+	if (attributes & SCAN_ALLOCATED_SIZE) {
+		g_file_info_set_attribute_uint64 (info,
+		                                  G_FILE_ATTRIBUTE_STANDARD_ALLOCATED_SIZE,
+		                                  (guint64) st->st_blocks * 512);
+	}
+
+	if (attributes & (SCAN_CONTENT_TYPE | SCAN_FAST_CONTENT_TYPE)) {
+		gchar *content_type;
+
+		content_type = dir_scanner_get_content_type (dir_fd, name, st,
+		                                             (attributes & SCAN_CONTENT_TYPE) == 0);
+
+		if (attributes & SCAN_CONTENT_TYPE) {
+			g_file_info_set_content_type (info, content_type);
+		}
+
+		if (attributes & SCAN_FAST_CONTENT_TYPE) {
+			g_file_info_set_attribute_string (info,
+			                                  G_FILE_ATTRIBUTE_STANDARD_FAST_CONTENT_TYPE,
+			                                  content_type);
+		}
+
+		g_free (content_type);
+	}
+
+	if (attributes & SCAN_TIME_MODIFIED) {
+		g_file_info_set_attribute_uint64 (info, G_FILE_ATTRIBUTE_TIME_MODIFIED,
+		                                  st->st_mtime);
+	}
+
+	if (attributes & SCAN_TIME_ACCESS) {
+		g_file_info_set_attribute_uint64 (info, G_FILE_ATTRIBUTE_TIME_ACCESS,
+		                                  st->st_atime);
+	}
+
+	if (attributes & SCAN_TIME_CHANGED) {
+		g_file_info_set_attribute_uint64 (info, G_FILE_ATTRIBUTE_TIME_CHANGED,
+		                                  st->st_ctime);
+	}
+
+	if (attributes & SCAN_UNIX_DEVICE) {
+		g_file_info_set_attribute_uint32 (info, G_FILE_ATTRIBUTE_UNIX_DEVICE,
+		                                  st->st_dev);
+	}
+
+	if (attributes & SCAN_UNIX_INODE) {
+		g_file_info_set_attribute_uint64 (info, G_FILE_ATTRIBUTE_UNIX_INODE,
+		                                  st->st_ino);
+	}
+
+	if (attributes & SCAN_UNIX_MODE) {
+		g_file_info_set_attribute_uint32 (info, G_FILE_ATTRIBUTE_UNIX_MODE,
+		                                  st->st_mode);
+	}
+
+	if (attributes & SCAN_UNIX_NLINK) {
+		g_file_info_set_attribute_uint32 (info, G_FILE_ATTRIBUTE_UNIX_NLINK,
+		                                  st->st_nlink);
+	}
+
+	if (attributes & SCAN_UNIX_UID) {
+		g_file_info_set_attribute_uint32 (info, G_FILE_ATTRIBUTE_UNIX_UID,
+		                                  st->st_uid);
+	}
+
+	if (attributes & SCAN_UNIX_GID) {
+		g_file_info_set_attribute_uint32 (info, G_FILE_ATTRIBUTE_UNIX_GID,
+		                                  st->st_gid);
+	}
+
+	return info;
+}
+
+static GSList *
+dir_scan_read (TrackerDirScan  *scan,
+               GError         **error)
+{
+	struct dirent *entry;
+	GSList *infos = NULL;
+	gchar *path;
+	DIR *dir;
+	gint fd, saved_errno;
+
+	path = g_file_get_path (scan->directory);
+
+	fd = open (path, O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+	dir = (fd >= 0) ? fdopendir (fd) : NULL;
+
+	if (!dir) {
+		gchar *display_name;
+
+		saved_errno = errno;
+
+		if (fd >= 0) {
+			close (fd);
+		}
+
+		display_name = g_filename_display_name (path);
+		g_set_error (error, G_IO_ERROR,
+		             g_io_error_from_errno (saved_errno),
+		             "Could not open directory '%s': %s",
+		             display_name, g_strerror (saved_errno));
+		g_free (display_name);
+		g_free (path);
+
+		return NULL;
+	}
+
+	while (TRUE) {
+		struct stat st;
+
+		if (g_cancellable_set_error_if_cancelled (scan->cancellable, error)) {
+			break;
+		}
+
+		errno = 0;
+		entry = readdir (dir);
+
+		if (!entry) {
+			saved_errno = errno;
+
+			if (saved_errno != 0) {
+				gchar *display_name;
+
+				display_name = g_filename_display_name (path);
+				g_set_error (error, G_IO_ERROR,
+				             g_io_error_from_errno (saved_errno),
+				             "Could not read directory '%s': %s",
+				             display_name, g_strerror (saved_errno));
+				g_free (display_name);
+			}
+
+			break;
+		}
+
+		if (strcmp (entry->d_name, ".") == 0 ||
+		    strcmp (entry->d_name, "..") == 0) {
+			continue;
+		}
+
+		/* Entries vanishing or otherwise failing to stat are
+		 * skipped, there is nothing we could index about them.
+		 */
+		if (fstatat (fd, entry->d_name, &st, AT_SYMLINK_NOFOLLOW) != 0) {
+			continue;
+		}
+
+		infos = g_slist_prepend (infos,
+		                         dir_scanner_file_info_new (scan->attributes,
+		                                                    fd,
+		                                                    entry->d_name,
+		                                                    &st));
+	}
+
+	/* Also closes fd */
+	closedir (dir);
+	g_free (path);
+
+	if (error && *error) {
+		g_slist_free_full (infos, g_object_unref);
+		return NULL;
+	}
+
+	return infos;
+}
+
+static void
+dir_scan_dispatch_ready (TrackerDirScan *scan,
+                         GSourceFunc     func,
+                         gpointer        user_data,
+                         GDestroyNotify  destroy)
+{
+	GSource *source;
+
+	/* Always through an idle, so the callback runs on the
+	 * scan owner's thread and never from within a worker.
+	 */
+	source = g_idle_source_new ();
+	g_source_set_priority (source, G_PRIORITY_DEFAULT);
+	g_source_set_callback (source, func, user_data, destroy);
+	g_source_attach (source, scan->context);
+	g_source_unref (source);
+}
+
+static void
+dir_scanner_thread_func (gpointer data,
+                         gpointer user_data)
+{
+	TrackerDirScan *scan = data;
+	GSourceFunc func;
+	gpointer func_data;
+	GDestroyNotify destroy;
+	GError *error = NULL;
+	GSList *infos;
+
+	infos = dir_scan_read (scan, &error);
+
+	g_mutex_lock (&scan->mutex);
+	scan->infos = infos;
+	scan->error = error;
+	scan->done = TRUE;
+
+	func = scan->ready_func;
+	func_data = scan->ready_data;
+	destroy = scan->ready_destroy;
+	scan->ready_func = NULL;
+	scan->ready_data = NULL;
+	scan->ready_destroy = NULL;
+	g_mutex_unlock (&scan->mutex);
+
+	if (func) {
+		dir_scan_dispatch_ready (scan, func, func_data, destroy);
+	}
+
+	tracker_dir_scan_unref (scan);
+}
+
+static void
+dir_scanner_update_max_threads (TrackerDirScanner *scanner)
+{
+	gint max_threads;
+
+	if (scanner->paused) {
+		/* Queued scans stay there until resumed */
+		max_threads = 0;
+	} else {
+		max_threads = (gint) (scanner->n_threads * (1.0 - scanner->throttle) + 0.5);
+		max_threads = MAX (max_threads, 1);
+	}
+
+	g_thread_pool_set_max_threads (scanner->pool, max_threads, NULL);
+}
+
+gboolean
+tracker_dir_scanner_supports (const gchar *attributes)
+{
+	g_return_val_if_fail (attributes != NULL, FALSE);
+
+	return dir_scanner_parse_attributes (attributes, NULL);
+}
+
+TrackerDirScanner *
+tracker_dir_scanner_new (guint n_threads)
+{
+	TrackerDirScanner *scanner;
+
+	if (n_threads == 0) {
+		/* Mostly waiting on I/O, so go past the number of CPUs */
+		n_threads = CLAMP (g_get_num_processors () * 2, 2, DIR_SCANNER_MAX_THREADS);
+	}
+
+	scanner = g_slice_new0 (TrackerDirScanner);
+	scanner->n_threads = MIN (n_threads, DIR_SCANNER_MAX_THREADS);
+	scanner->pool = g_thread_pool_new (dir_scanner_thread_func, scanner,
+	                                   scanner->n_threads, FALSE, NULL);
+
+	return scanner;
+}
+
+void
+tracker_dir_scanner_free (TrackerDirScanner *scanner)
+{
+	g_return_if_fail (scanner != NULL);
+
+	/* Pending scans must run to release their references,
+	 * they'll be quick if their cancellable was triggered.
+	 */
+	scanner->paused = FALSE;
+	dir_scanner_update_max_threads (scanner);
+	g_thread_pool_free (scanner->pool, FALSE, TRUE);
+
+	g_slice_free (TrackerDirScanner, scanner);
+}
+
+void
+tracker_dir_scanner_set_throttle (TrackerDirScanner *scanner,
+                                  gdouble            throttle)
+{
+	g_return_if_fail (scanner != NULL);
+
+	scanner->throttle = CLAMP (throttle, 0, 1);
+	dir_scanner_update_max_threads (scanner);
+}
+
+void
+tracker_dir_scanner_set_paused (TrackerDirScanner *scanner,
+                                gboolean           paused)
+{
+	g_return_if_fail (scanner != NULL);
+
+	scanner->paused = (paused != FALSE);
+	dir_scanner_update_max_threads (scanner);
+}
+
+guint
+tracker_dir_scanner_get_n_threads (TrackerDirScanner *scanner)
+{
+	g_return_val_if_fail (scanner != NULL, 0);
+
+	return (guint) MAX (g_thread_pool_get_max_threads (scanner->pool), 0);
+}
+
+/*
+ * tracker_dir_scanner_push:
+ *
+ * Queues @directory to be read, filling in @attributes for each
+ * of its children. The returned #TrackerDirScan can be checked for
+ * completion, or a callback set on it to be called on the
+ * thread-default main context of the caller.
+ */
+TrackerDirScan *
+tracker_dir_scanner_push (TrackerDirScanner *scanner,
+                          GFile             *directory,
+                          const gchar       *attributes,
+                          GCancellable      *cancellable)
+{
+	TrackerDirScan *scan;
+	guint flags;
+
+	g_return_val_if_fail (scanner != NULL, NULL);
+	g_return_val_if_fail (G_IS_FILE (directory), NULL);
+	g_return_val_if_fail (attributes != NULL, NULL);
+
+	if (!dir_scanner_parse_attributes (attributes, &flags)) {
+		g_critical ("Attributes '%s' can't be read by the directory scanner",
+		            attributes);
+		return NULL;
+	}
+
+	scan = g_slice_new0 (TrackerDirScan);
+	scan->ref_count = 1;
+	scan->attributes = flags;
+	scan->directory = g_object_ref (directory);
+	scan->cancellable = cancellable ? g_object_ref (cancellable) : NULL;
+	scan->context = g_main_context_ref_thread_default ();
+	g_mutex_init (&scan->mutex);
+
+	/* The pool keeps its own reference until the scan is done */
+	g_thread_pool_push (scanner->pool, tracker_dir_scan_ref (scan), NULL);
+
+	return scan;
+}
+
+TrackerDirScan *
+tracker_dir_scan_ref (TrackerDirScan *scan)
+{
+	g_return_val_if_fail (scan != NULL, NULL);
+
+	g_atomic_int_inc (&scan->ref_count);
+
+	return scan;
+}
+
+void
+tracker_dir_scan_unref (TrackerDirScan *scan)
+{
+	g_return_if_fail (scan != NULL);
+
+	if (!g_atomic_int_dec_and_test (&scan->ref_count)) {
+		return;
+	}
+
+	if (scan->ready_destroy) {
+		scan->ready_destroy (scan->ready_data);
+	}
+
+	g_slist_free_full (scan->infos, g_object_unref);
+	g_clear_error (&scan->error);
+
+	g_object_unref (scan->directory);
+
+	if (scan->cancellable) {
+		g_object_unref (scan->cancellable);
+	}
+
+	g_main_context_unref (scan->context);
+	g_mutex_clear (&scan->mutex);
+
+	g_slice_free (TrackerDirScan, scan);
+}
+
+gboolean
+tracker_dir_scan_is_done (TrackerDirScan *scan)
+{
+	gboolean done;
+
+	g_return_val_if_fail (scan != NULL, FALSE);
+
+	g_mutex_lock (&scan->mutex);
+	done = scan->done;
+	g_mutex_unlock (&scan->mutex);
+
+	return done;
+}
+
+/*
+ * tracker_dir_scan_set_ready_func:
+ *
+ * Sets @func to be called once @scan is done, replacing any
+ * previously set function. If the scan is already done, @func
+ * is dispatched right away.
+ */
+void
+tracker_dir_scan_set_ready_func (TrackerDirScan *scan,
+                                 GSourceFunc     func,
+                                 gpointer        user_data,
+                                 GDestroyNotify  destroy)
+{
+	GDestroyNotify old_destroy;
+	gpointer old_data;
+	gboolean done;
+
+	g_return_if_fail (scan != NULL);
+	g_return_if_fail (func != NULL);
+
+	g_mutex_lock (&scan->mutex);
+	old_destroy = scan->ready_destroy;
+	old_data = scan->ready_data;
+	done = scan->done;
+
+	if (done) {
+		scan->ready_func = NULL;
+		scan->ready_data = NULL;
+		scan->ready_destroy = NULL;
+	} else {
+		scan->ready_func = func;
+		scan->ready_data = user_data;
+		scan->ready_destroy = destroy;
+	}
+	g_mutex_unlock (&scan->mutex);
+
+	if (old_destroy) {
+		old_destroy (old_data);
+	}
+
+	if (done) {
+		dir_scan_dispatch_ready (scan, func, user_data, destroy);
+	}
+}
+
+/*
+ * tracker_dir_scan_steal_infos:
+ *
+ * Returns the #GFileInfo list for the directory contents, in no
+ * particular order. @scan must be done.
+ */
+GSList *
+tracker_dir_scan_steal_infos (TrackerDirScan  *scan,
+                              GError         **error)
+{
+	GSList *infos;
+
+	g_return_val_if_fail (scan != NULL, NULL);
+
+	g_mutex_lock (&scan->mutex);
+
+	if (!scan->done) {
+		g_mutex_unlock (&scan->mutex);
+		g_critical ("Directory scan results requested before the scan was done");
+		return NULL;
+	}
+
+	infos = scan->infos;
+	scan->infos = NULL;
+
+	if (scan->error) {
+		g_propagate_error (error, scan->error);
+		scan->error = NULL;
+	}
+
+	g_mutex_unlock (&scan->mutex);
+
+	return infos;
+}
@@ -0,0 +1,59 @@
+/*
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ * Boston, MA  02110-1301, USA.
+ */
+
+#ifndef __LIBTRACKER_MINER_DIR_SCANNER_H__
+#define __LIBTRACKER_MINER_DIR_SCANNER_H__
+
+#if !defined (__LIBTRACKER_MINER_H_INSIDE__) && !defined (TRACKER_COMPILATION)
+#error "Only <libtracker-miner/tracker-miner.h> can be included directly."
+#endif
+
+#include <gio/gio.h>
+
+G_BEGIN_DECLS
+
+typedef struct _TrackerDirScanner TrackerDirScanner;
+typedef struct _TrackerDirScan    TrackerDirScan;
+
+gboolean           tracker_dir_scanner_supports       (const gchar        *attributes);
+
+TrackerDirScanner *tracker_dir_scanner_new            (guint               n_threads);
+void               tracker_dir_scanner_free           (TrackerDirScanner  *scanner);
+void               tracker_dir_scanner_set_throttle   (TrackerDirScanner  *scanner,
+                                                       gdouble             throttle);
+void               tracker_dir_scanner_set_paused     (TrackerDirScanner  *scanner,
+                                                       gboolean            paused);
+guint              tracker_dir_scanner_get_n_threads  (TrackerDirScanner  *scanner);
+
+TrackerDirScan    *tracker_dir_scanner_push           (TrackerDirScanner  *scanner,
+                                                       GFile              *directory,
+                                                       const gchar        *attributes,
+                                                       GCancellable       *cancellable);
+
+TrackerDirScan    *tracker_dir_scan_ref               (TrackerDirScan     *scan);
+void               tracker_dir_scan_unref             (TrackerDirScan     *scan);
+gboolean           tracker_dir_scan_is_done           (TrackerDirScan     *scan);
+void               tracker_dir_scan_set_ready_func    (TrackerDirScan     *scan,
+                                                       GSourceFunc         func,
+                                                       gpointer            user_data,
+                                                       GDestroyNotify      destroy);
+GSList            *tracker_dir_scan_steal_infos       (TrackerDirScan     *scan,
+                                                       GError            **error);
+
+G_END_DECLS
+
+#endif /* __LIBTRACKER_MINER_DIR_SCANNER_H__ */
@@ -0,0 +1,565 @@
+/*
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ * Boston, MA  02110-1301, USA.
+ */
+
+#include "config.h"
+
+#include "tracker-fanotify.h"
+
+#ifdef HAVE_FANOTIFY
+
+#include <errno.h>
+#include <fcntl.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/fanotify.h>
+#include <sys/statfs.h>
+
+#include <glib-unix.h>
+
+/* A single fanotify group with one mark per filesystem replaces
+ * the per-directory inotify watches. Monitored directories are
+ * only known in user space, by their file handle, so events for
+ * the rest of the filesystem are dropped without further syscalls.
+ *
+ * FAN_MODIFY is not requested, it fires on every write() across
+ * the whole filesystem, and TrackerMonitor only acts on the
+ * CHANGES_DONE_HINT emitted for FAN_CLOSE_WRITE anyway.
+ */
+#define FANOTIFY_EVENT_MASK (FAN_CREATE | FAN_DELETE | FAN_CLOSE_WRITE | \
+                             FAN_ATTRIB | FAN_ONDIR)
+#define FANOTIFY_MOVE_MASK  (FAN_MOVED_FROM | FAN_MOVED_TO)
+
+#define TRACKER_TYPE_FANOTIFY_MONITOR (tracker_fanotify_monitor_get_type ())
+#define TRACKER_FANOTIFY_MONITOR(o)   (G_TYPE_CHECK_INSTANCE_CAST ((o), TRACKER_TYPE_FANOTIFY_MONITOR, TrackerFanotifyMonitor))
+
+typedef struct _TrackerFanotifyMonitor TrackerFanotifyMonitor;
+typedef struct _TrackerFanotifyMonitorClass TrackerFanotifyMonitorClass;
+typedef struct _EventTarget EventTarget;
+
+struct _TrackerFanotify {
+	gint fd;
+	guint watch_id;
+	guint64 mask;
+
+	/* fsid -> errno from marking it, 0 if marked */
+	GHashTable *filesystems;
+
+	/* directory handle -> TrackerFanotifyMonitor */
+	GHashTable *monitors;
+};
+
+struct _TrackerFanotifyMonitor {
+	GFileMonitor parent_instance;
+	TrackerFanotify *fanotify;
+	GFile *directory;
+	GBytes *handle;
+};
+
+struct _TrackerFanotifyMonitorClass {
+	GFileMonitorClass parent_class;
+};
+
+struct _EventTarget {
+	TrackerFanotifyMonitor *monitor;
+	const gchar *name;
+};
+
+GType tracker_fanotify_monitor_get_type (void) G_GNUC_CONST;
+
+G_DEFINE_TYPE (TrackerFanotifyMonitor, tracker_fanotify_monitor, G_TYPE_FILE_MONITOR)
+
+static gboolean
+tracker_fanotify_monitor_cancel (GFileMonitor *file_monitor)
+{
+	TrackerFanotifyMonitor *monitor;
+	TrackerFanotify *fanotify;
+
+	monitor = TRACKER_FANOTIFY_MONITOR (file_monitor);
+	fanotify = monitor->fanotify;
+
+	/* A newer monitor for the same directory may have taken over */
+	if (fanotify &&
+	    g_hash_table_lookup (fanotify->monitors, monitor->handle) == monitor) {
+		g_hash_table_remove (fanotify->monitors, monitor->handle);
+	}
+
+	monitor->fanotify = NULL;
+
+	return TRUE;
+}
+
+static void
+tracker_fanotify_monitor_finalize (GObject *object)
+{
+	TrackerFanotifyMonitor *monitor;
+
+	monitor = TRACKER_FANOTIFY_MONITOR (object);
+
+	g_object_unref (monitor->directory);
+	g_bytes_unref (monitor->handle);
+
+	G_OBJECT_CLASS (tracker_fanotify_monitor_parent_class)->finalize (object);
+}
+
+static void
+tracker_fanotify_monitor_class_init (TrackerFanotifyMonitorClass *klass)
+{
+	GObjectClass *object_class = G_OBJECT_CLASS (klass);
+	GFileMonitorClass *monitor_class = G_FILE_MONITOR_CLASS (klass);
+
+	object_class->finalize = tracker_fanotify_monitor_finalize;
+	monitor_class->cancel = tracker_fanotify_monitor_cancel;
+}
+
+static void
+tracker_fanotify_monitor_init (TrackerFanotifyMonitor *monitor)
+{
+}
+
+static GBytes *
+handle_key_new (gconstpointer             fsid,
+                const struct file_handle *handle)
+{
+	guchar *data;
+	gsize len;
+
+	/* fsid, handle type and handle bytes, which is what
+	 * fanotify reports for the directory of each event.
+	 */
+	len = sizeof (guint64) + sizeof (handle->handle_type) + handle->handle_bytes;
+	data = g_malloc (len);
+
+	memcpy (data, fsid, sizeof (guint64));
+	memcpy (data + sizeof (guint64),
+	        &handle->handle_type, sizeof (handle->handle_type));
+	memcpy (data + sizeof (guint64) + sizeof (handle->handle_type),
+	        handle->f_handle, handle->handle_bytes);
+
+	return g_bytes_new_take (data, len);
+}
+
+static gint
+fanotify_add_filesystem (TrackerFanotify *fanotify,
+                         const gchar     *path,
+                         guint64          fsid)
+{
+	gpointer value;
+	gint error = 0;
+
+	if (g_hash_table_lookup_extended (fanotify->filesystems, &fsid,
+	                                  NULL, &value)) {
+		return GPOINTER_TO_INT (value);
+	}
+
+	if (fanotify_mark (fanotify->fd,
+	                   FAN_MARK_ADD | FAN_MARK_FILESYSTEM,
+	                   fanotify->mask, AT_FDCWD, path) < 0) {
+		error = errno;
+	} else {
+		g_debug ("Added fanotify mark for the filesystem of '%s'", path);
+	}
+
+	/* Failures are remembered too, so directories on
+	 * the same filesystem fail early.
+	 */
+	g_hash_table_insert (fanotify->filesystems,
+	                     g_memdup (&fsid, sizeof (fsid)),
+	                     GINT_TO_POINTER (error));
+
+	return error;
+}
+
+static gint
+get_filesystem_id (const gchar *path,
+                   guint64     *fsid)
+{
+	struct statfs buf;
+
+	G_STATIC_ASSERT (sizeof (buf.f_fsid) == sizeof (guint64));
+
+	if (statfs (path, &buf) < 0) {
+		return errno;
+	}
+
+	memcpy (fsid, &buf.f_fsid, sizeof (guint64));
+
+	return 0;
+}
+
+static void
+event_target_lookup (TrackerFanotify                *fanotify,
+                     struct fanotify_event_info_fid *fid,
+                     EventTarget                    *target)
+{
+	struct file_handle *handle;
+	GBytes *key;
+
+	handle = (struct file_handle *) fid->handle;
+	key = handle_key_new (&fid->fsid, handle);
+
+	target->monitor = g_hash_table_lookup (fanotify->monitors, key);
+	target->name = (const gchar *) handle->f_handle + handle->handle_bytes;
+
+	g_bytes_unref (key);
+
+	/* Events on a directory with no parent information */
+	if (target->name[0] == '\0' || strcmp (target->name, ".") == 0) {
+		target->monitor = NULL;
+	}
+}
+
+static void
+event_target_emit (EventTarget       *target,
+                   GFile             *other_file,
+                   GFileMonitorEvent  event_type)
+{
+	GFile *file;
+
+	file = g_file_get_child (target->monitor->directory, target->name);
+	g_file_monitor_emit_event (G_FILE_MONITOR (target->monitor),
+	                           file, other_file, event_type);
+	g_object_unref (file);
+}
+
+static void
+fanotify_handle_rename (EventTarget *from,
+                        EventTarget *to)
+{
+	/* Same as paired inotify moves: moves between monitored
+	 * directories are reported on the source, moves from or
+	 * to unmonitored places are deletions and creations.
+	 */
+	if (from->monitor && to->monitor) {
+		GFile *other_file;
+
+		other_file = g_file_get_child (to->monitor->directory, to->name);
+		event_target_emit (from, other_file, G_FILE_MONITOR_EVENT_MOVED);
+		g_object_unref (other_file);
+	} else if (from->monitor) {
+		event_target_emit (from, NULL, G_FILE_MONITOR_EVENT_DELETED);
+	} else if (to->monitor) {
+		event_target_emit (to, NULL, G_FILE_MONITOR_EVENT_CREATED);
+	}
+}
+
+static void
+fanotify_handle_event (TrackerFanotify                *fanotify,
+                       struct fanotify_event_metadata *metadata)
+{
+	EventTarget target = { NULL, NULL };
+	EventTarget from = { NULL, NULL };
+	EventTarget to = { NULL, NULL };
+	guint64 mask;
+	gchar *ptr, *end;
+
+	mask = metadata->mask;
+
+	if (mask & FAN_Q_OVERFLOW) {
+		g_warning ("Too many fanotify events, some changes were lost");
+		return;
+	}
+
+	ptr = (gchar *) metadata + metadata->metadata_len;
+	end = (gchar *) metadata + metadata->event_len;
+
+	while (ptr + sizeof (struct fanotify_event_info_header) <= end) {
+		struct fanotify_event_info_header *header;
+
+		header = (struct fanotify_event_info_header *) ptr;
+
+		if (header->len == 0 || ptr + header->len > end) {
+			break;
+		}
+
+		switch (header->info_type) {
+		case FAN_EVENT_INFO_TYPE_DFID_NAME:
+			event_target_lookup (fanotify, (gpointer) header, &target);
+			break;
+#ifdef FAN_RENAME
+		case FAN_EVENT_INFO_TYPE_OLD_DFID_NAME:
+			event_target_lookup (fanotify, (gpointer) header, &from);
+			break;
+		case FAN_EVENT_INFO_TYPE_NEW_DFID_NAME:
+			event_target_lookup (fanotify, (gpointer) header, &to);
+			break;
+#endif /* FAN_RENAME */
+		default:
+			break;
+		}
+
+		ptr += header->len;
+	}
+
+#ifdef FAN_RENAME
+	if (mask & FAN_RENAME) {
+		fanotify_handle_rename (&from, &to);
+	}
+#endif /* FAN_RENAME */
+
+	if (!target.monitor) {
+		return;
+	}
+
+	/* Events on the same file may be merged, emit them
+	 * in the order they most likely happened.
+	 */
+	if (mask & (FAN_CREATE | FAN_MOVED_TO)) {
+		event_target_emit (&target, NULL, G_FILE_MONITOR_EVENT_CREATED);
+	}
+
+	if (mask & FAN_ATTRIB) {
+		event_target_emit (&target, NULL, G_FILE_MONITOR_EVENT_ATTRIBUTE_CHANGED);
+	}
+
+	if (mask & FAN_CLOSE_WRITE) {
+		event_target_emit (&target, NULL, G_FILE_MONITOR_EVENT_CHANGES_DONE_HINT);
+	}
+
+	if (mask & (FAN_DELETE | FAN_MOVED_FROM)) {
+		event_target_emit (&target, NULL, G_FILE_MONITOR_EVENT_DELETED);
+	}
+}
+
+static gboolean
+fanotify_read_cb (gint          fd,
+                  GIOCondition  condition,
+                  gpointer      user_data)
+{
+	TrackerFanotify *fanotify = user_data;
+	guint64 buffer[4096];
+	gssize len;
+
+	while ((len = read (fd, buffer, sizeof (buffer))) > 0) {
+		struct fanotify_event_metadata *metadata;
+
+		metadata = (struct fanotify_event_metadata *) buffer;
+
+		while (FAN_EVENT_OK (metadata, len)) {
+			if (metadata->vers != FANOTIFY_METADATA_VERSION) {
+				g_critical ("Unexpected fanotify metadata version %d, "
+				            "no more changes will be received",
+				            metadata->vers);
+				fanotify->watch_id = 0;
+				return G_SOURCE_REMOVE;
+			}
+
+			fanotify_handle_event (fanotify, metadata);
+			metadata = FAN_EVENT_NEXT (metadata, len);
+		}
+	}
+
+	if (len < 0 && errno != EAGAIN && errno != EINTR) {
+		g_warning ("Could not read fanotify events: %s",
+		           g_strerror (errno));
+	}
+
+	return G_SOURCE_CONTINUE;
+}
+
+TrackerFanotify *
+tracker_fanotify_new (GError **error)
+{
+	TrackerFanotify *fanotify;
+	const gchar *home;
+	guint64 fsid;
+	gint fd, mark_error;
+
+	fd = fanotify_init (FAN_CLASS_NOTIF | FAN_CLOEXEC | FAN_NONBLOCK |
+	                    FAN_REPORT_DFID_NAME,
+	                    O_RDONLY | O_LARGEFILE);
+
+	if (fd < 0) {
+		gint saved_errno = errno;
+
+		g_set_error (error,
+		             G_IO_ERROR,
+		             g_io_error_from_errno (saved_errno),
+		             "Could not initialize fanotify: %s",
+		             g_strerror (saved_errno));
+		return NULL;
+	}
+
+	fanotify = g_slice_new0 (TrackerFanotify);
+	fanotify->fd = fd;
+	fanotify->filesystems = g_hash_table_new_full (g_int64_hash,
+	                                               g_int64_equal,
+	                                               g_free, NULL);
+	fanotify->monitors = g_hash_table_new (g_bytes_hash, g_bytes_equal);
+
+#ifdef FAN_RENAME
+	fanotify->mask = FANOTIFY_EVENT_MASK | FAN_RENAME;
+#else
+	fanotify->mask = FANOTIFY_EVENT_MASK | FANOTIFY_MOVE_MASK;
+#endif /* FAN_RENAME */
+
+	/* Filesystem marks need CAP_SYS_ADMIN, check early so
+	 * the caller can fall back to other monitors.
+	 */
+	home = g_get_home_dir ();
+	mark_error = get_filesystem_id (home, &fsid);
+
+	if (mark_error == 0) {
+		mark_error = fanotify_add_filesystem (fanotify, home, fsid);
+
+#ifdef FAN_RENAME
+		if (mark_error == EINVAL) {
+			/* Kernel older than 5.17, moves come unpaired */
+			g_hash_table_remove (fanotify->filesystems, &fsid);
+			fanotify->mask = FANOTIFY_EVENT_MASK | FANOTIFY_MOVE_MASK;
+			mark_error = fanotify_add_filesystem (fanotify, home, fsid);
+		}
+#endif /* FAN_RENAME */
+	}
+
+	if (mark_error != 0) {
+		g_set_error (error,
+		             G_IO_ERROR,
+		             g_io_error_from_errno (mark_error),
+		             "Could not add fanotify mark for '%s': %s",
+		             home, g_strerror (mark_error));
+		tracker_fanotify_free (fanotify);
+		return NULL;
+	}
+
+	fanotify->watch_id = g_unix_fd_add (fd, G_IO_IN,
+	                                    fanotify_read_cb,
+	                                    fanotify);
+
+	return fanotify;
+}
+
+void
+tracker_fanotify_free (TrackerFanotify *fanotify)
+{
+	GHashTableIter iter;
+	gpointer value;
+
+	g_return_if_fail (fanotify != NULL);
+
+	/* Monitors still alive become inert */
+	g_hash_table_iter_init (&iter, fanotify->monitors);
+
+	while (g_hash_table_iter_next (&iter, NULL, &value)) {
+		TRACKER_FANOTIFY_MONITOR (value)->fanotify = NULL;
+	}
+
+	if (fanotify->watch_id) {
+		g_source_remove (fanotify->watch_id);
+	}
+
+	/* Closing the group drops all marks */
+	close (fanotify->fd);
+
+	g_hash_table_unref (fanotify->monitors);
+	g_hash_table_unref (fanotify->filesystems);
+	g_slice_free (TrackerFanotify, fanotify);
+}
+
+GFileMonitor *
+tracker_fanotify_monitor_directory (TrackerFanotify  *fanotify,
+                                    GFile            *directory,
+                                    GError          **error)
+{
+	TrackerFanotifyMonitor *monitor;
+	struct file_handle *handle;
+	gint mount_id, saved_errno;
+	guint64 fsid;
+	gchar *path;
+
+	g_return_val_if_fail (fanotify != NULL, NULL);
+	g_return_val_if_fail (G_IS_FILE (directory), NULL);
+
+	path = g_file_get_path (directory);
+
+	if (!path) {
+		g_set_error_literal (error,
+		                     G_IO_ERROR,
+		                     G_IO_ERROR_NOT_SUPPORTED,
+		                     "Only local directories can be monitored with fanotify");
+		return NULL;
+	}
+
+	handle = g_malloc (sizeof (struct file_handle) + MAX_HANDLE_SZ);
+	handle->handle_bytes = MAX_HANDLE_SZ;
+
+	if (name_to_handle_at (AT_FDCWD, path, handle, &mount_id, 0) < 0) {
+		saved_errno = errno;
+	} else {
+		saved_errno = get_filesystem_id (path, &fsid);
+	}
+
+	if (saved_errno == 0) {
+		saved_errno = fanotify_add_filesystem (fanotify, path, fsid);
+	}
+
+	if (saved_errno != 0) {
+		g_set_error (error,
+		             G_IO_ERROR,
+		             g_io_error_from_errno (saved_errno),
+		             "Could not monitor '%s' with fanotify: %s",
+		             path, g_strerror (saved_errno));
+		g_free (handle);
+		g_free (path);
+		return NULL;
+	}
+
+	monitor = g_object_new (TRACKER_TYPE_FANOTIFY_MONITOR, NULL);
+	monitor->fanotify = fanotify;
+	monitor->directory = g_object_ref (directory);
+	monitor->handle = handle_key_new (&fsid, handle);
+
+	/* The latest monitor takes over if the directory was
+	 * already monitored from another path (i.e. it was moved)
+	 */
+	g_hash_table_replace (fanotify->monitors, monitor->handle, monitor);
+
+	g_free (handle);
+	g_free (path);
+
+	return G_FILE_MONITOR (monitor);
+}
+
+#else /* HAVE_FANOTIFY */
+
+TrackerFanotify *
+tracker_fanotify_new (GError **error)
+{
+	g_set_error_literal (error,
+	                     G_IO_ERROR,
+	                     G_IO_ERROR_NOT_SUPPORTED,
+	                     "Built without fanotify support");
+	return NULL;
+}
+
+void
+tracker_fanotify_free (TrackerFanotify *fanotify)
+{
+}
+
+GFileMonitor *
+tracker_fanotify_monitor_directory (TrackerFanotify  *fanotify,
+                                    GFile            *directory,
+                                    GError          **error)
+{
+	g_set_error_literal (error,
+	                     G_IO_ERROR,
+	                     G_IO_ERROR_NOT_SUPPORTED,
+	                     "Built without fanotify support");
+	return NULL;
+}
+
+#endif /* HAVE_FANOTIFY */
@@ -26,15 +26,25 @@
 
 #include "tracker-file-notifier.h"
 #include "tracker-file-system.h"
+#include "tracker-file-data-provider.h"
+#include "tracker-crawl-state.h"
 #include "tracker-crawler.h"
 #include "tracker-monitor.h"
 
 static GQuark quark_property_iri = 0;
 static GQuark quark_property_store_mtime = 0;
 static GQuark quark_property_filesystem_mtime = 0;
+static GQuark quark_file_info = 0;
 
 #define MAX_DEPTH 1
 
+/* Crawled infos kept until ::process-file, past that many queued files
+ * ::process-file implementations query the file themselves.
+ */
+#define MAX_RETAINED_FILE_INFOS 5000
+
+static guint n_retained_file_infos = 0;
+
 enum {
 	PROP_0,
 	PROP_INDEXING_TREE,
@@ -64,6 +74,8 @@ typedef struct {
 	guint directories_ignored;
 	guint files_found;
 	guint files_ignored;
+	guint files_from_crawl_state;
+	guint crawl_state_valid : 1;
 } RootData;
 
 typedef struct {
@@ -77,6 +89,9 @@ typedef struct {
 	TrackerMonitor *monitor;
 	TrackerDataProvider *data_provider;
 
+	/* Store info known from previous runs */
+	TrackerCrawlState *crawl_state;
+
 	GTimer *timer;
 
 	/* List of pending directory
@@ -98,6 +113,7 @@ typedef struct {
 
 typedef struct {
 	TrackerFileNotifier *notifier;
+	GPtrArray *files;
 	gint max_depth;
 } SparqlStartData;
 
@@ -158,6 +174,7 @@ root_data_new (TrackerFileNotifier *notifier,
                GFile               *file,
                guint                flags)
 {
+	TrackerFileNotifierPrivate *priv = notifier->priv;
 	RootData *data;
 
 	data = g_new0 (RootData, 1);
@@ -167,6 +184,15 @@ root_data_new (TrackerFileNotifier *notifier,
 	data->updated_dirs = g_ptr_array_new ();
 	data->flags = flags;
 
+	/* Directory mtimes only tell reliably about added and
+	 * removed contents on local file systems.
+	 */
+	data->crawl_state_valid =
+		(priv->crawl_state != NULL &&
+		 g_file_is_native (file) &&
+		 (!priv->data_provider ||
+		  TRACKER_IS_FILE_DATA_PROVIDER (priv->data_provider)));
+
 	g_queue_push_tail (data->pending_dirs, g_object_ref (file));
 
 	return data;
@@ -182,6 +208,18 @@ root_data_free (RootData *data)
 	g_free (data);
 }
 
+static void
+crawl_state_save (TrackerFileNotifier *notifier)
+{
+	TrackerFileNotifierPrivate *priv = notifier->priv;
+	GError *error = NULL;
+
+	if (!tracker_crawl_state_save (priv->crawl_state, &error)) {
+		g_warning ("Could not save crawl state: %s", error->message);
+		g_error_free (error);
+	}
+}
+
 /* Crawler signal handlers */
 static gboolean
 crawler_check_file_cb (TrackerCrawler *crawler,
@@ -327,6 +365,24 @@ file_notifier_traverse_tree_foreach (GFile    *file,
 		}
 	}
 
+	if (store_mtime && disk_mtime && *disk_mtime == *store_mtime) {
+		/* Unchanged, nothing will ask for the crawled info */
+		g_object_set_qdata (G_OBJECT (file), quark_file_info, NULL);
+
+		if (priv->crawl_state) {
+			const gchar *iri = NULL;
+
+			/* Only directories' IRIs are needed, for their children */
+			if (file_type == G_FILE_TYPE_DIRECTORY) {
+				iri = tracker_file_system_get_property (priv->file_system, file,
+				                                        quark_property_iri);
+			}
+
+			tracker_crawl_state_set (priv->crawl_state, file,
+			                         *store_mtime, iri);
+		}
+	}
+
 	return FALSE;
 }
 
@@ -376,6 +432,13 @@ file_notifier_traverse_tree (TrackerFileNotifier *notifier, gint max_depth)
 	}
 }
 
+static void
+retained_file_info_free (GFileInfo *file_info)
+{
+	n_retained_file_infos--;
+	g_object_unref (file_info);
+}
+
 static gboolean
 file_notifier_add_node_foreach (GNode    *node,
                                 gpointer  user_data)
@@ -422,7 +485,22 @@ file_notifier_add_node_foreach (GNode    *node,
 		tracker_file_system_set_property (priv->file_system, canonical,
 		                                  quark_property_filesystem_mtime,
 		                                  time_ptr);
-		g_object_unref (file_info);
+
+		if (file_type != G_FILE_TYPE_DIRECTORY &&
+		    n_retained_file_infos < MAX_RETAINED_FILE_INFOS) {
+			/* Keep it for ::process-file, this goes away with
+			 * the file unless it's queued for processing.
+			 */
+			g_object_set_qdata_full (G_OBJECT (canonical),
+			                         quark_file_info,
+			                         file_info,
+			                         (GDestroyNotify) retained_file_info_free);
+			n_retained_file_infos++;
+		} else {
+			/* nor one from an earlier crawl */
+			g_object_set_qdata (G_OBJECT (canonical), quark_file_info, NULL);
+			g_object_unref (file_info);
+		}
 
 		if (file_type == G_FILE_TYPE_DIRECTORY && depth == MAX_DEPTH + 1) {
 			/* If the max crawling depth is reached,
@@ -649,6 +727,11 @@ finish_current_directory (TrackerFileNotifier *notifier)
 		        priv->current_index_root->files_found,
 		        priv->current_index_root->files_ignored);
 
+		if (priv->current_index_root->files_from_crawl_state > 0) {
+			g_info ("  Checked %d files against the crawl state",
+			        priv->current_index_root->files_from_crawl_state);
+		}
+
 		root_data_free (priv->current_index_root);
 		priv->current_index_root = NULL;
 
@@ -726,6 +809,129 @@ sparql_contents_query_start (TrackerFileNotifier  *notifier,
 	g_free (sparql);
 }
 
+/* Checks the crawled files against the store info, and looks up
+ * the contents of updated directories in the store to find out
+ * about deleted files.
+ */
+static void
+file_notifier_check_current_directory (TrackerFileNotifier *notifier,
+                                       gint                 max_depth)
+{
+	TrackerFileNotifierPrivate *priv = notifier->priv;
+
+	file_notifier_traverse_tree (notifier, max_depth);
+
+	if (priv->current_index_root->updated_dirs->len > 0) {
+		/* Updated directories have been found, check for deleted contents in those */
+		sparql_contents_query_start (notifier,
+		                             (GFile**) priv->current_index_root->updated_dirs->pdata,
+		                             priv->current_index_root->updated_dirs->len);
+		g_ptr_array_set_size (priv->current_index_root->updated_dirs, 0);
+	} else {
+		finish_current_directory (notifier);
+	}
+}
+
+/* Files in the crawl state must be in the store as the state says,
+ * the crawl state is left unused for the rest of the current root
+ * if it doesn't match, e.g. if the store was reset.
+ */
+static void
+crawl_state_validate (TrackerFileNotifier *notifier,
+                      GPtrArray           *files)
+{
+	TrackerFileNotifierPrivate *priv = notifier->priv;
+	guint i;
+
+	for (i = 0; i < files->len; i++) {
+		GFile *file = g_ptr_array_index (files, i);
+		const gchar *iri, *store_iri;
+		guint64 mtime, *store_mtime;
+
+		if (!tracker_crawl_state_lookup (priv->crawl_state, file,
+		                                 &mtime, &iri)) {
+			continue;
+		}
+
+		store_mtime = tracker_file_system_get_property (priv->file_system, file,
+		                                                quark_property_store_mtime);
+		store_iri = tracker_file_system_get_property (priv->file_system, file,
+		                                              quark_property_iri);
+
+		if (!store_mtime || *store_mtime != mtime ||
+		    (iri && g_strcmp0 (iri, store_iri) != 0)) {
+			gchar *uri;
+
+			uri = g_file_get_uri (priv->current_index_root->root);
+			g_info ("Crawl state doesn't match the store for '%s', "
+			        "querying the store for all its contents", uri);
+			g_free (uri);
+
+			priv->current_index_root->crawl_state_valid = FALSE;
+			return;
+		}
+	}
+}
+
+/* If @directory is unchanged since it was last crawled, nothing was
+ * added to, removed from or renamed within it, so the store info for
+ * its contents is known from the crawl state. Only files not found
+ * there, or modified since, are left in @files to query the store.
+ */
+static void
+crawl_state_fill_store_info (TrackerFileNotifier *notifier,
+                             GFile               *directory,
+                             GPtrArray           *files)
+{
+	TrackerFileNotifierPrivate *priv = notifier->priv;
+	guint64 mtime, *store_mtime, *disk_mtime;
+	const gchar *iri;
+	guint i = 0;
+
+	if (!priv->current_index_root->crawl_state_valid) {
+		return;
+	}
+
+	store_mtime = tracker_file_system_get_property (priv->file_system, directory,
+	                                                quark_property_store_mtime);
+	disk_mtime = tracker_file_system_get_property (priv->file_system, directory,
+	                                               quark_property_filesystem_mtime);
+
+	if (!store_mtime || !disk_mtime || *store_mtime != *disk_mtime ||
+	    !tracker_crawl_state_lookup (priv->crawl_state, directory, &mtime, NULL) ||
+	    mtime != *disk_mtime) {
+		return;
+	}
+
+	while (i < files->len) {
+		GFile *file = g_ptr_array_index (files, i);
+
+		disk_mtime = tracker_file_system_get_property (priv->file_system, file,
+		                                               quark_property_filesystem_mtime);
+
+		if (!disk_mtime ||
+		    !tracker_crawl_state_lookup (priv->crawl_state, file, &mtime, &iri) ||
+		    mtime != *disk_mtime ||
+		    (!iri && tracker_file_system_get_file_type (priv->file_system, file) == G_FILE_TYPE_DIRECTORY)) {
+			i++;
+			continue;
+		}
+
+		if (iri) {
+			tracker_file_system_set_property (priv->file_system, file,
+			                                  quark_property_iri,
+			                                  g_strdup (iri));
+		}
+
+		tracker_file_system_set_property (priv->file_system, file,
+		                                  quark_property_store_mtime,
+		                                  g_memdup (&mtime, sizeof (guint64)));
+
+		priv->current_index_root->files_from_crawl_state++;
+		g_ptr_array_remove_index_fast (files, i);
+	}
+}
+
 /* Query for file information, used on all elements found during crawling */
 static void
 sparql_files_query_cb (GObject      *object,
@@ -749,20 +955,20 @@ sparql_files_query_cb (GObject      *object,
 	} else if (cursor) {
 		sparql_files_query_populate (notifier, cursor, TRUE);
 		g_object_unref (cursor);
-	}
-
-	file_notifier_traverse_tree (notifier, data->max_depth);
 
-	if (priv->current_index_root->updated_dirs->len > 0) {
-		/* Updated directories have been found, check for deleted contents in those */
-		sparql_contents_query_start (notifier,
-		                             (GFile**) priv->current_index_root->updated_dirs->pdata,
-		                             priv->current_index_root->updated_dirs->len);
-		g_ptr_array_set_size (priv->current_index_root->updated_dirs, 0);
-	} else {
-		finish_current_directory (notifier);
+		/* Contents of the root are always queried, check the
+		 * crawl state against those before relying on it.
+		 */
+		if (priv->current_index_root->crawl_state_valid &&
+		    g_queue_peek_head (priv->current_index_root->pending_dirs) ==
+		    priv->current_index_root->root) {
+			crawl_state_validate (notifier, data->files);
+		}
 	}
 
+	file_notifier_check_current_directory (notifier, data->max_depth);
+
+	g_ptr_array_unref (data->files);
 	g_free (data);
 }
 
@@ -793,8 +999,7 @@ sparql_files_compose_query (GFile **files,
 
 static void
 sparql_files_query_start (TrackerFileNotifier  *notifier,
-                          GFile               **files,
-                          guint                 n_files,
+                          GPtrArray            *files,
                           gint                  max_depth)
 {
 	TrackerFileNotifierPrivate *priv;
@@ -802,10 +1007,11 @@ sparql_files_query_start (TrackerFileNotifier  *notifier,
 	SparqlStartData *data = g_new (SparqlStartData, 1);
 
 	data->notifier = notifier;
+	data->files = g_ptr_array_ref (files);
 	data->max_depth = max_depth;
 
 	priv = notifier->priv;
-	sparql = sparql_files_compose_query (files, n_files);
+	sparql = sparql_files_compose_query ((GFile **) files->pdata, files->len);
 	tracker_sparql_connection_query_async (priv->connection,
 	                                       sparql,
 	                                       priv->cancellable,
@@ -898,10 +1104,23 @@ crawler_finished_cb (TrackerCrawler *crawler,
 	    (directory == priv->current_index_root->root ||
 	     tracker_file_system_get_property (priv->file_system,
 	                                       directory, quark_property_iri))) {
-		sparql_files_query_start (notifier,
-                                  (GFile**) priv->current_index_root->query_files->pdata,
-		                          priv->current_index_root->query_files->len, max_depth);
-		g_ptr_array_set_size (priv->current_index_root->query_files, 0);
+		GPtrArray *query_files;
+
+		query_files = priv->current_index_root->query_files;
+		priv->current_index_root->query_files =
+			g_ptr_array_new_with_free_func (g_object_unref);
+
+		if (directory != priv->current_index_root->root) {
+			crawl_state_fill_store_info (notifier, directory, query_files);
+		}
+
+		if (query_files->len > 0) {
+			sparql_files_query_start (notifier, query_files, max_depth);
+		} else {
+			file_notifier_check_current_directory (notifier, max_depth);
+		}
+
+		g_ptr_array_unref (query_files);
 	} else {
 		file_notifier_traverse_tree (notifier, max_depth);
 		finish_current_directory (notifier);
@@ -992,6 +1211,9 @@ monitor_item_created_cb (TrackerMonitor *monitor,
 	canonical = tracker_file_system_get_file (priv->file_system,
 	                                          file, file_type, NULL);
 
+	/* Any info from an earlier crawl is outdated now */
+	g_object_set_qdata (G_OBJECT (canonical), quark_file_info, NULL);
+
 	g_signal_emit (notifier, signals[FILE_CREATED], 0, canonical);
 
 	if (!is_directory) {
@@ -1022,6 +1244,7 @@ monitor_item_updated_cb (TrackerMonitor *monitor,
 	/* Fetch the interned copy */
 	canonical = tracker_file_system_get_file (priv->file_system,
 	                                          file, file_type, NULL);
+	g_object_set_qdata (G_OBJECT (canonical), quark_file_info, NULL);
 	g_signal_emit (notifier, signals[FILE_UPDATED], 0, canonical, FALSE);
 
 	if (!is_directory) {
@@ -1052,6 +1275,7 @@ monitor_item_attribute_updated_cb (TrackerMonitor *monitor,
 	/* Fetch the interned copy */
 	canonical = tracker_file_system_get_file (priv->file_system,
 	                                          file, file_type, NULL);
+	g_object_set_qdata (G_OBJECT (canonical), quark_file_info, NULL);
 	g_signal_emit (notifier, signals[FILE_UPDATED], 0, canonical, TRUE);
 
 	if (!is_directory) {
@@ -1389,6 +1613,11 @@ tracker_file_notifier_finalize (GObject *object)
 	g_list_free (priv->pending_index_roots);
 	g_timer_destroy (priv->timer);
 
+	if (priv->crawl_state) {
+		crawl_state_save (TRACKER_FILE_NOTIFIER (object));
+		tracker_crawl_state_free (priv->crawl_state);
+	}
+
 	G_OBJECT_CLASS (tracker_file_notifier_parent_class)->finalize (object);
 }
 
@@ -1416,9 +1645,19 @@ tracker_file_notifier_constructed (GObject *object)
 
 	/* Set up crawler */
 	priv->crawler = tracker_crawler_new (priv->data_provider);
+	/* Besides what's needed to check mtimes, fetch what
+	 * ::process-file implementations usually ask for, see
+	 * tracker_file_notifier_steal_file_info(). The content type
+	 * is only guessed from the name, most crawled files are
+	 * unchanged and sniffing their contents would be wasted.
+	 */
 	tracker_crawler_set_file_attributes (priv->crawler,
 	                                     G_FILE_ATTRIBUTE_TIME_MODIFIED ","
-	                                     G_FILE_ATTRIBUTE_STANDARD_TYPE);
+	                                     G_FILE_ATTRIBUTE_TIME_ACCESS ","
+	                                     G_FILE_ATTRIBUTE_STANDARD_TYPE ","
+	                                     G_FILE_ATTRIBUTE_STANDARD_SIZE ","
+	                                     G_FILE_ATTRIBUTE_STANDARD_DISPLAY_NAME ","
+	                                     G_FILE_ATTRIBUTE_STANDARD_FAST_CONTENT_TYPE);
 
 	g_signal_connect (priv->crawler, "check-file",
 	                  G_CALLBACK (crawler_check_file_cb),
@@ -1437,6 +1676,47 @@ tracker_file_notifier_constructed (GObject *object)
 	                  object);
 }
 
+/* Whatever is notified is going to change in the store, so
+ * the crawl state can't be relied upon for those files anymore.
+ */
+static void
+tracker_file_notifier_real_file_changed (TrackerFileNotifier *notifier,
+                                         GFile               *file)
+{
+	TrackerFileNotifierPrivate *priv = notifier->priv;
+
+	if (priv->crawl_state) {
+		tracker_crawl_state_remove (priv->crawl_state, file);
+	}
+}
+
+static void
+tracker_file_notifier_real_file_updated (TrackerFileNotifier *notifier,
+                                         GFile               *file,
+                                         gboolean             attributes_only)
+{
+	tracker_file_notifier_real_file_changed (notifier, file);
+}
+
+static void
+tracker_file_notifier_real_file_moved (TrackerFileNotifier *notifier,
+                                       GFile               *from,
+                                       GFile               *to)
+{
+	tracker_file_notifier_real_file_changed (notifier, from);
+	tracker_file_notifier_real_file_changed (notifier, to);
+}
+
+static void
+tracker_file_notifier_real_finished (TrackerFileNotifier *notifier)
+{
+	TrackerFileNotifierPrivate *priv = notifier->priv;
+
+	if (priv->crawl_state) {
+		crawl_state_save (notifier);
+	}
+}
+
 static void
 tracker_file_notifier_class_init (TrackerFileNotifierClass *klass)
 {
@@ -1447,6 +1727,12 @@ tracker_file_notifier_class_init (TrackerFileNotifierClass *klass)
 	object_class->get_property = tracker_file_notifier_get_property;
 	object_class->constructed = tracker_file_notifier_constructed;
 
+	klass->file_created = tracker_file_notifier_real_file_changed;
+	klass->file_updated = tracker_file_notifier_real_file_updated;
+	klass->file_deleted = tracker_file_notifier_real_file_changed;
+	klass->file_moved = tracker_file_notifier_real_file_moved;
+	klass->finished = tracker_file_notifier_real_finished;
+
 	signals[FILE_CREATED] =
 		g_signal_new ("file-created",
 		              G_TYPE_FROM_CLASS (klass),
@@ -1549,6 +1835,8 @@ tracker_file_notifier_class_init (TrackerFileNotifierClass *klass)
 	quark_property_filesystem_mtime = g_quark_from_static_string ("tracker-property-filesystem-mtime");
 	tracker_file_system_register_property (quark_property_filesystem_mtime,
 	                                       g_free);
+
+	quark_file_info = g_quark_from_static_string ("tracker-file-notifier-file-info");
 }
 
 static void
@@ -1705,3 +1993,57 @@ tracker_file_notifier_get_file_iri (TrackerFileNotifier *notifier,
 
 	return iri;
 }
+
+/* Returns (transfer full) the info gathered while crawling @file, if
+ * it's been found to need processing. It's only handed out once.
+ */
+GFileInfo *
+tracker_file_notifier_steal_file_info (TrackerFileNotifier *notifier,
+                                       GFile               *file)
+{
+	GFileInfo *file_info;
+
+	g_return_val_if_fail (TRACKER_IS_FILE_NOTIFIER (notifier), NULL);
+	g_return_val_if_fail (G_IS_FILE (file), NULL);
+
+	file_info = g_object_steal_qdata (G_OBJECT (file), quark_file_info);
+
+	if (file_info) {
+		n_retained_file_infos--;
+	}
+
+	return file_info;
+}
+
+void
+tracker_file_notifier_set_throttle (TrackerFileNotifier *notifier,
+                                    gdouble              throttle)
+{
+	g_return_if_fail (TRACKER_IS_FILE_NOTIFIER (notifier));
+
+	tracker_crawler_set_throttle (notifier->priv->crawler, throttle);
+}
+
+/* Keeps the store info of crawled files in @filename across runs,
+ * so most files don't need querying the store when crawling.
+ */
+void
+tracker_file_notifier_set_crawl_state_file (TrackerFileNotifier *notifier,
+                                            const gchar         *filename)
+{
+	TrackerFileNotifierPrivate *priv;
+
+	g_return_if_fail (TRACKER_IS_FILE_NOTIFIER (notifier));
+
+	priv = notifier->priv;
+
+	if (priv->crawl_state) {
+		crawl_state_save (notifier);
+		tracker_crawl_state_free (priv->crawl_state);
+		priv->crawl_state = NULL;
+	}
+
+	if (filename) {
+		priv->crawl_state = tracker_crawl_state_new (filename);
+	}
+}
@@ -89,6 +89,16 @@ gboolean      tracker_file_notifier_is_active    (TrackerFileNotifier     *notif
 const gchar * tracker_file_notifier_get_file_iri (TrackerFileNotifier     *notifier,
                                                   GFile                   *file,
                                                   gboolean                 force);
+GFileInfo *   tracker_file_notifier_steal_file_info
+                                                 (TrackerFileNotifier     *notifier,
+                                                  GFile                   *file);
+
+void          tracker_file_notifier_set_throttle (TrackerFileNotifier     *notifier,
+                                                  gdouble                  throttle);
+
+void          tracker_file_notifier_set_crawl_state_file
+                                                 (TrackerFileNotifier     *notifier,
+                                                  const gchar             *filename);
 
 G_END_DECLS
 
@@ -26,13 +26,20 @@
 
 typedef struct _TrackerFileSystemPrivate TrackerFileSystemPrivate;
 typedef struct _FileNodeProperty FileNodeProperty;
-typedef struct _FileNodeData FileNodeData;
+typedef struct _FileNode FileNode;
 typedef struct _NodeLookupData NodeLookupData;
+typedef struct _Segment Segment;
+
+/* Directories with more children than this get a hash table
+ * to look up children by name, smaller ones are scanned.
+ */
+#define CHILDREN_INDEX_MIN_SIZE 8
 
 static GHashTable *properties = NULL;
+static GHashTable *segments = NULL;
 
 struct _TrackerFileSystemPrivate {
-	GNode *file_tree;
+	FileNode *file_tree;
 	GFile *root;
 };
 
@@ -41,10 +48,23 @@ struct _FileNodeProperty {
 	gpointer value;
 };
 
-struct _FileNodeData {
+struct _FileNode {
+	FileNode *parent;
+	FileNode *prev;
+	FileNode *next;
+	FileNode *first_child;
+	FileNode *last_child;
+	GHashTable *children_index;
+
+	/* Interned URI segment, or the full URI for the root node */
+	const gchar *name;
+
+	/* NULL for the path components leading to registered files */
 	GFile *file;
-	gchar *uri_prefix;
-	GArray *properties;
+	FileNodeProperty *properties;
+
+	guint n_children;
+	guint n_properties : 8;
 	guint shallow   : 1;
 	guint unowned : 1;
 	guint file_type : 4;
@@ -52,9 +72,16 @@ struct _FileNodeData {
 
 struct _NodeLookupData {
 	TrackerFileSystem *file_system;
-	GNode *node;
+	FileNode *node;
 };
 
+struct _Segment {
+	guint ref_count;
+	gchar str[1];
+};
+
+#define SEGMENT_FROM_STRING(s) ((Segment *) ((s) - G_STRUCT_OFFSET (Segment, str)))
+
 enum {
 	PROP_0,
 	PROP_ROOT,
@@ -81,37 +108,82 @@ G_DEFINE_TYPE (TrackerFileSystem, tracker_file_system, G_TYPE_OBJECT)
  * tracker_file_system_forget_files() is called to delete them if there are
  * references held on them elsewhere, and they will stay until all references
  * are dropped.
+ *
+ * Files are kept in a trie with one node per URI segment, segment names
+ * are interned and shared between all nodes (and file systems) with the
+ * same name. Only registered files have a GFile, the nodes in between
+ * only exist as long as there are registered files below them.
  */
 
+/* Segment interning */
+
+static const gchar *
+segment_lookup (const gchar *str)
+{
+	Segment *segment;
+
+	if (!segments) {
+		return NULL;
+	}
+
+	segment = g_hash_table_lookup (segments, str);
+
+	return segment ? segment->str : NULL;
+}
+
+static const gchar *
+segment_intern (const gchar *str)
+{
+	Segment *segment;
+	gsize len;
+
+	if (!segments) {
+		segments = g_hash_table_new (g_str_hash, g_str_equal);
+	}
+
+	segment = g_hash_table_lookup (segments, str);
+
+	if (segment) {
+		segment->ref_count++;
+		return segment->str;
+	}
+
+	len = strlen (str);
+	segment = g_malloc (G_STRUCT_OFFSET (Segment, str) + len + 1);
+	segment->ref_count = 1;
+	memcpy (segment->str, str, len + 1);
+
+	g_hash_table_insert (segments, segment->str, segment);
+
+	return segment->str;
+}
 
 static void
-file_node_data_free (FileNodeData *data,
-                     GNode        *node)
+segment_release (const gchar *str)
 {
-	guint i;
+	Segment *segment;
 
-	if (data->file) {
-		if (!data->shallow) {
-			g_object_weak_unref (G_OBJECT (data->file),
-			                     file_weak_ref_notify,
-			                     node);
-		}
+	segment = SEGMENT_FROM_STRING (str);
+	g_assert (segment->ref_count > 0);
 
-		if (!data->unowned) {
-			g_object_unref (data->file);
-		}
+	if (--segment->ref_count == 0) {
+		g_hash_table_remove (segments, segment->str);
+		g_free (segment);
 	}
+}
+
+/* File nodes */
 
-	data->file = NULL;
-	g_free (data->uri_prefix);
+static void
+file_node_clear_properties (FileNode *node)
+{
+	guint i;
 
-	for (i = 0; i < data->properties->len; i++) {
+	for (i = 0; i < node->n_properties; i++) {
 		FileNodeProperty *property;
 		GDestroyNotify destroy_notify;
 
-		property = &g_array_index (data->properties,
-		                           FileNodeProperty, i);
-
+		property = &node->properties[i];
 		destroy_notify = g_hash_table_lookup (properties,
 		                                      GUINT_TO_POINTER (property->prop_quark));
 
@@ -120,224 +192,310 @@ file_node_data_free (FileNodeData *data,
 		}
 	}
 
-	g_array_free (data->properties, TRUE);
-	g_slice_free (FileNodeData, data);
+	g_free (node->properties);
+	node->properties = NULL;
+	node->n_properties = 0;
 }
 
-static FileNodeData *
-file_node_data_new (TrackerFileSystem *file_system,
-                    GFile             *file,
-                    GFileType          file_type,
-                    GNode             *node)
+static void
+file_node_remove_lookup_data (FileNode          *node,
+                              TrackerFileSystem *file_system)
 {
-	FileNodeData *data;
-	NodeLookupData lookup_data;
 	GArray *node_data;
+	guint i;
 
-	data = g_slice_new0 (FileNodeData);
-	data->file = g_object_ref (file);
-	data->file_type = file_type;
-	data->properties = g_array_new (FALSE, TRUE, sizeof (FileNodeProperty));
-
-	/* We use weak refs to keep track of files */
-	g_object_weak_ref (G_OBJECT (data->file), file_weak_ref_notify, node);
-
-	node_data = g_object_get_qdata (G_OBJECT (data->file),
+	node_data = g_object_get_qdata (G_OBJECT (node->file),
 	                                quark_file_node);
 
 	if (!node_data) {
-		node_data = g_array_new (FALSE, FALSE, sizeof (NodeLookupData));
-		g_object_set_qdata_full (G_OBJECT (data->file),
-		                         quark_file_node,
-		                         node_data,
-		                         (GDestroyNotify) g_array_unref);
+		return;
 	}
 
-	lookup_data.file_system = file_system;
-	lookup_data.node = node;
-	g_array_append_val (node_data, lookup_data);
+	for (i = 0; i < node_data->len; i++) {
+		NodeLookupData *cur;
 
-	g_assert (node->data == NULL);
-	node->data = data;
+		cur = &g_array_index (node_data, NodeLookupData, i);
 
-	return data;
+		if (cur->file_system == file_system && cur->node == node) {
+			g_array_remove_index_fast (node_data, i);
+			break;
+		}
+	}
 }
 
-static FileNodeData *
-file_node_data_root_new (GFile *root)
+static void
+file_node_free (FileNode          *node,
+                TrackerFileSystem *file_system)
 {
-	FileNodeData *data;
+	g_assert (node->first_child == NULL);
 
-	data = g_slice_new0 (FileNodeData);
-	data->uri_prefix = g_file_get_uri (root);
-	data->file = g_object_ref (root);
-	data->properties = g_array_new (FALSE, TRUE, sizeof (FileNodeProperty));
-	data->file_type = G_FILE_TYPE_DIRECTORY;
-	data->shallow = TRUE;
+	if (node->file) {
+		if (!node->shallow) {
+			g_object_weak_unref (G_OBJECT (node->file),
+			                     file_weak_ref_notify,
+			                     node);
+			file_node_remove_lookup_data (node, file_system);
+		}
 
-	return data;
-}
+		if (!node->unowned) {
+			g_object_unref (node->file);
+		}
 
-static gboolean
-file_node_data_equal_or_child (GNode  *node,
-                               gchar  *uri_prefix,
-                               gchar **uri_remainder)
-{
-	FileNodeData *data;
-	gsize len;
+		node->file = NULL;
+	}
 
-	data = node->data;
-	len = strlen (data->uri_prefix);
-
-	if (strncmp (uri_prefix, data->uri_prefix, len) == 0) {
-		uri_prefix += len;
-
-		if (uri_prefix[0] == '/') {
-			uri_prefix++;
-		} else if (uri_prefix[0] != '\0' &&
-		           (len < 4 ||
-		            strcmp (data->uri_prefix + len - 4, ":///") != 0)) {
-			/* If the first char isn't an uri separator
-			 * nor \0, node represents a similarly named
-			 * file, but not a parent after all.
-			 */
-			return FALSE;
-		}
+	file_node_clear_properties (node);
 
-		if (uri_remainder) {
-			*uri_remainder = uri_prefix;
-		}
+	if (node->children_index) {
+		g_hash_table_unref (node->children_index);
+	}
 
-		return TRUE;
+	if (node->parent) {
+		segment_release (node->name);
 	} else {
-		return FALSE;
+		g_free ((gchar *) node->name);
 	}
+
+	g_slice_free (FileNode, node);
 }
 
-static GNode *
-file_tree_lookup (GNode     *tree,
-                  GFile     *file,
-                  GNode    **parent_node,
-                  gchar    **uri_remainder)
+static FileNode *
+file_node_root_new (GFile *root)
 {
-	GNode *parent, *node_found, *parent_found;
-	FileNodeData *data;
-	gchar *uri, *ptr;
+	FileNode *node;
 
-	uri = ptr = g_file_get_uri (file);
-	node_found = parent_found = NULL;
+	node = g_slice_new0 (FileNode);
+	node->name = g_file_get_uri (root);
+	node->file = g_object_ref (root);
+	node->file_type = G_FILE_TYPE_DIRECTORY;
+	node->shallow = TRUE;
 
-	/* Run through the filesystem tree, comparing chunks of
-	 * uri with the uri prefix in the file nodes, this would
-	 * get us to the closest registered parent, or the file
-	 * itself.
-	 */
+	return node;
+}
 
-	if (parent_node) {
-		*parent_node = NULL;
+static FileNode *
+file_node_lookup_child (FileNode    *node,
+                        const gchar *name)
+{
+	FileNode *child;
+
+	/* Names are interned, so pointer comparisons suffice */
+	if (node->children_index) {
+		return g_hash_table_lookup (node->children_index, name);
 	}
 
-	if (uri_remainder) {
-		*uri_remainder = NULL;
+	for (child = node->first_child; child; child = child->next) {
+		if (child->name == name) {
+			return child;
+		}
 	}
 
-	if (!tree) {
-		return NULL;
+	return NULL;
+}
+
+static FileNode *
+file_node_append_child (FileNode    *node,
+                        const gchar *name)
+{
+	FileNode *child;
+
+	child = g_slice_new0 (FileNode);
+	child->name = name;
+	child->parent = node;
+	child->prev = node->last_child;
+
+	if (node->last_child) {
+		node->last_child->next = child;
+	} else {
+		node->first_child = child;
 	}
 
-	if (!G_NODE_IS_ROOT (tree)) {
-		FileNodeData *parent_data;
-		gchar *parent_uri;
+	node->last_child = child;
+	node->n_children++;
+
+	if (node->children_index) {
+		g_hash_table_insert (node->children_index,
+		                     (gpointer) child->name, child);
+	} else if (node->n_children > CHILDREN_INDEX_MIN_SIZE) {
+		FileNode *cur;
 
-		parent_data = tree->data;
-		parent_uri = g_file_get_uri (parent_data->file);
+		node->children_index = g_hash_table_new (NULL, NULL);
 
-		/* Sanity check */
-		if (!g_str_has_prefix (uri, parent_uri)) {
-			g_free (parent_uri);
-			return NULL;
+		for (cur = node->first_child; cur; cur = cur->next) {
+			g_hash_table_insert (node->children_index,
+			                     (gpointer) cur->name, cur);
 		}
+	}
 
-		ptr += strlen (parent_uri);
+	return child;
+}
 
-		g_assert (ptr[0] == '/');
-		ptr++;
+static void
+file_node_unlink (FileNode *node)
+{
+	FileNode *parent;
 
-		g_free (parent_uri);
+	parent = node->parent;
+
+	if (node->prev) {
+		node->prev->next = node->next;
 	} else {
-		/* First check the root node */
-		if (!file_node_data_equal_or_child (tree, uri, &ptr)) {
-			g_free (uri);
-			return NULL;
+		parent->first_child = node->next;
+	}
+
+	if (node->next) {
+		node->next->prev = node->prev;
+	} else {
+		parent->last_child = node->prev;
+	}
+
+	node->prev = node->next = NULL;
+	parent->n_children--;
+
+	if (parent->children_index) {
+		if (parent->n_children == 0) {
+			g_hash_table_unref (parent->children_index);
+			parent->children_index = NULL;
+		} else {
+			g_hash_table_remove (parent->children_index, node->name);
 		}
+	}
+}
 
-		/* Second check there is no basename and if there isn't,
-		 * then this node MUST be the closest registered node
-		 * we can use for the uri. The difference here is that
-		 * we return tree not NULL.
-		 */
-		else if (ptr[0] == '\0') {
-			g_free (uri);
-			return tree;
-                }
+static void
+file_node_prune (FileNode *node)
+{
+	/* Remove nodes that neither have a file nor lead to one */
+	while (node->parent && !node->file && !node->first_child) {
+		FileNode *parent;
+
+		parent = node->parent;
+		file_node_unlink (node);
+		file_node_free (node, NULL);
+		node = parent;
 	}
+}
 
-	parent = tree;
+static void
+file_node_set_file (FileNode          *node,
+                    TrackerFileSystem *file_system,
+                    GFile             *file,
+                    GFileType          file_type)
+{
+	NodeLookupData lookup_data;
+	GArray *node_data;
 
-	while (parent) {
-		GNode *child, *next = NULL;
-		gchar *ret_ptr;
+	g_assert (node->file == NULL);
 
-		for (child = g_node_first_child (parent);
-		     child != NULL;
-		     child = g_node_next_sibling (child)) {
-			data = child->data;
+	node->file = g_object_ref (file);
+	node->file_type = file_type;
+	node->unowned = FALSE;
 
-			if (data->uri_prefix[0] != ptr[0])
-				continue;
+	/* We use weak refs to keep track of files */
+	g_object_weak_ref (G_OBJECT (node->file), file_weak_ref_notify, node);
 
-			if (file_node_data_equal_or_child (child, ptr, &ret_ptr)) {
-				ptr = ret_ptr;
-				next = child;
-				break;
-			}
-		}
+	node_data = g_object_get_qdata (G_OBJECT (node->file),
+	                                quark_file_node);
 
-		if (next) {
-			if (ptr[0] == '\0') {
-				/* Exact match */
-				node_found = next;
-				parent_found = parent;
-				break;
-			} else {
-				/* Descent down the child */
-				parent = next;
-			}
-		} else {
-			parent_found = parent;
-			break;
-		}
+	if (!node_data) {
+		node_data = g_array_new (FALSE, FALSE, sizeof (NodeLookupData));
+		g_object_set_qdata_full (G_OBJECT (node->file),
+		                         quark_file_node,
+		                         node_data,
+		                         (GDestroyNotify) g_array_unref);
 	}
 
-	if (parent_node) {
-		*parent_node = parent_found;
+	lookup_data.file_system = file_system;
+	lookup_data.node = node;
+	g_array_append_val (node_data, lookup_data);
+}
+
+static void
+file_tree_free (FileNode          *node,
+                TrackerFileSystem *file_system)
+{
+	FileNode *child, *next;
+
+	for (child = node->first_child; child; child = next) {
+		next = child->next;
+		file_tree_free (child, file_system);
 	}
 
-	if (ptr && *ptr && uri_remainder) {
-		*uri_remainder = g_strdup (ptr);
+	node->first_child = node->last_child = NULL;
+	file_node_free (node, file_system);
+}
+
+static gchar *
+uri_get_remainder (const gchar *prefix,
+                   gchar       *uri)
+{
+	gsize len;
+
+	len = strlen (prefix);
+
+	if (strncmp (uri, prefix, len) != 0) {
+		return NULL;
 	}
 
-	g_free (uri);
+	uri += len;
+
+	if (uri[0] == '/') {
+		uri++;
+	} else if (uri[0] != '\0' &&
+	           (len < 4 ||
+	            strcmp (prefix + len - 4, ":///") != 0)) {
+		/* If the first char isn't an uri separator
+		 * nor \0, node represents a similarly named
+		 * file, but not a parent after all.
+		 */
+		return NULL;
+	}
 
-	return node_found;
+	return uri;
 }
 
-static gboolean
-file_tree_free_node_foreach (GNode    *node,
-                             gpointer  user_data)
+static FileNode *
+file_tree_lookup (FileNode *node,
+                  gchar    *path,
+                  gboolean  create)
 {
-	file_node_data_free (node->data, node);
-	return FALSE;
+	/* Walks down the tree one segment at a time, @path is
+	 * modified in place. If @create is TRUE, missing nodes
+	 * are added along the way.
+	 */
+	while (node && path) {
+		const gchar *name;
+		gchar *separator;
+		FileNode *child;
+
+		separator = strchr (path, '/');
+
+		if (separator) {
+			*separator = '\0';
+		}
+
+		if (path[0] != '\0') {
+			if (create) {
+				name = segment_intern (path);
+				child = file_node_lookup_child (node, name);
+
+				if (child) {
+					segment_release (name);
+				} else {
+					child = file_node_append_child (node, name);
+				}
+			} else {
+				name = segment_lookup (path);
+				child = name ? file_node_lookup_child (node, name) : NULL;
+			}
+
+			node = child;
+		}
+
+		path = separator ? separator + 1 : NULL;
+	}
+
+	return node;
 }
 
 /* TrackerFileSystem implementation */
@@ -345,16 +503,13 @@ file_tree_free_node_foreach (GNode    *node,
 static void
 file_system_finalize (GObject *object)
 {
+	TrackerFileSystem *file_system;
 	TrackerFileSystemPrivate *priv;
 
-	priv = TRACKER_FILE_SYSTEM (object)->priv;
+	file_system = TRACKER_FILE_SYSTEM (object);
+	priv = file_system->priv;
 
-	g_node_traverse (priv->file_tree,
-	                 G_POST_ORDER,
-	                 G_TRAVERSE_ALL, -1,
-	                 file_tree_free_node_foreach,
-	                 NULL);
-	g_node_destroy (priv->file_tree);
+	file_tree_free (priv->file_tree, file_system);
 
 	if (priv->root) {
 		g_object_unref (priv->root);
@@ -367,7 +522,6 @@ static void
 file_system_constructed (GObject *object)
 {
 	TrackerFileSystemPrivate *priv;
-	FileNodeData *root_data;
 
 	G_OBJECT_CLASS (tracker_file_system_parent_class)->constructed (object);
 
@@ -377,8 +531,7 @@ file_system_constructed (GObject *object)
 		priv->root = g_file_new_for_uri ("file:///");
 	}
 
-	root_data = file_node_data_root_new (priv->root);
-	priv->file_tree = g_node_new (root_data);
+	priv->file_tree = file_node_root_new (priv->root);
 }
 
 static void
@@ -465,90 +618,72 @@ tracker_file_system_new (GFile *root)
 }
 
 static void
-reparent_child_nodes_to_parent (GNode *node)
+file_weak_ref_notify (gpointer  user_data,
+                      GObject  *prev_location)
 {
-	FileNodeData *node_data;
-	GNode *child, *parent;
-
-	if (!node->parent) {
-		return;
-	}
+	FileNode *node;
 
-	parent = node->parent;
-	node_data = node->data;
-	child = g_node_first_child (node);
+	node = user_data;
 
-	while (child) {
-		FileNodeData *data;
-		gchar *uri_prefix;
-		GNode *cur;
+	g_assert (node->file == (GFile *) prev_location);
 
-		cur = child;
-		data = cur->data;
-		child = g_node_next_sibling (child);
+	/* The node stays in place while there are files below it */
+	node->file = NULL;
+	file_node_clear_properties (node);
+	file_node_prune (node);
+}
 
-		uri_prefix = g_strdup_printf ("%s/%s",
-					      node_data->uri_prefix,
-					      data->uri_prefix);
+static FileNode *
+file_system_lookup_node_data (TrackerFileSystem *file_system,
+                              GFile             *file)
+{
+	GArray *node_data;
+	guint i;
 
-		g_free (data->uri_prefix);
-		data->uri_prefix = uri_prefix;
+	node_data = g_object_get_qdata (G_OBJECT (file), quark_file_node);
 
-		g_node_unlink (cur);
-		g_node_prepend (parent, cur);
+	if (!node_data) {
+		return NULL;
 	}
-}
-
-static void
-file_weak_ref_notify (gpointer  user_data,
-                      GObject  *prev_location)
-{
-	FileNodeData *data;
-	GNode *node;
 
-	node = user_data;
-	data = node->data;
+	for (i = 0; i < node_data->len; i++) {
+		NodeLookupData *cur;
 
-	g_assert (data->file == (GFile *) prev_location);
+		cur = &g_array_index (node_data, NodeLookupData, i);
 
-	data->file = NULL;
-	reparent_child_nodes_to_parent (node);
+		if (cur->file_system == file_system) {
+			return cur->node;
+		}
+	}
 
-	/* Delete node tree here */
-	file_node_data_free (data, NULL);
-	g_node_destroy (node);
+	return NULL;
 }
 
-static GNode *
+static FileNode *
 file_system_get_node (TrackerFileSystem *file_system,
                       GFile             *file)
 {
 	TrackerFileSystemPrivate *priv;
-	GArray *node_data;
-	GNode *node = NULL;
+	FileNode *node;
 
-	node_data = g_object_get_qdata (G_OBJECT (file), quark_file_node);
+	node = file_system_lookup_node_data (file_system, file);
 
-	if (node_data) {
-		NodeLookupData *cur;
-		guint i;
+	if (!node) {
+		gchar *uri, *path;
 
-		for (i = 0; i < node_data->len; i++) {
-			cur = &g_array_index (node_data, NodeLookupData, i);
+		priv = file_system->priv;
+		uri = g_file_get_uri (file);
+		path = uri_get_remainder (priv->file_tree->name, uri);
 
-			if (cur->file_system == file_system) {
-				node = cur->node;
-			}
+		if (path) {
+			node = file_tree_lookup (priv->file_tree, path, FALSE);
 		}
-	}
 
-	if (!node) {
-		priv = file_system->priv;
-		node = file_tree_lookup (priv->file_tree, file,
-		                         NULL, NULL);
+		g_free (uri);
 	}
 
-	return node;
+	/* Nodes without a file are just path components */
+	return (node && node->file) ? node : NULL;
 }
 
 GFile *
@@ -558,85 +693,84 @@ tracker_file_system_get_file (TrackerFileSystem *file_system,
                               GFile             *parent)
 {
 	TrackerFileSystemPrivate *priv;
-	FileNodeData *data;
-	GNode *node, *parent_node;
-	gchar *uri_prefix = NULL;
+	FileNode *node, *parent_node = NULL;
+	gchar *uri, *path = NULL;
 
 	g_return_val_if_fail (G_IS_FILE (file), NULL);
 	g_return_val_if_fail (TRACKER_IS_FILE_SYSTEM (file_system), NULL);
 
 	priv = file_system->priv;
-	node = NULL;
-	parent_node = NULL;
+
+	/* Canonical files point straight to their node */
+	node = file_system_lookup_node_data (file_system, file);
+
+	if (node) {
+		if (node->file_type == G_FILE_TYPE_UNKNOWN) {
+			node->file_type = file_type;
+		}
+
+		return node->file;
+	}
+
+	uri = g_file_get_uri (file);
 
 	if (parent) {
 		parent_node = file_system_get_node (file_system, parent);
-		node = file_tree_lookup (parent_node, file,
-		                         NULL, &uri_prefix);
-	} else {
-		node = file_tree_lookup (priv->file_tree, file,
-		                         &parent_node, &uri_prefix);
 	}
 
-	if (!node) {
-		if (!parent_node) {
-			gchar *uri;
+	if (parent_node) {
+		gchar *parent_uri;
 
-			uri = g_file_get_uri (file);
-			g_warning ("Could not find parent node for URI:'%s'", uri);
-			g_warning ("NOTE: URI theme may be outside scheme expected, for example, expecting 'file://' when given 'http://' prefix.");
-			g_free (uri);
+		parent_uri = g_file_get_uri (parent_node->file);
+		path = uri_get_remainder (parent_uri, uri);
+		g_free (parent_uri);
+	}
 
-			return NULL;
-		}
+	if (!path) {
+		parent_node = priv->file_tree;
+		path = uri_get_remainder (parent_node->name, uri);
+	}
 
-		node = g_node_new (NULL);
+	if (!path) {
+		g_warning ("Could not find parent node for URI:'%s'", uri);
+		g_warning ("NOTE: URI theme may be outside scheme expected, for example, expecting 'file://' when given 'http://' prefix.");
+		g_free (uri);
 
-		/* Parent was found, add file as child */
-		data = file_node_data_new (file_system, file,
-		                           file_type, node);
-		data->uri_prefix = uri_prefix;
+		return NULL;
+	}
 
-		g_node_append (parent_node, node);
-	} else {
-		data = node->data;
-		g_free (uri_prefix);
+	node = file_tree_lookup (parent_node, path, TRUE);
+	g_free (uri);
 
+	if (!node->file) {
+		file_node_set_file (node, file_system, file, file_type);
+	} else if (node->file_type == G_FILE_TYPE_UNKNOWN) {
 		/* Update file type if it was unknown */
-		if (data->file_type == G_FILE_TYPE_UNKNOWN) {
-			data->file_type = file_type;
-		}
+		node->file_type = file_type;
 	}
 
-	return data->file;
+	return node->file;
 }
 
 GFile *
 tracker_file_system_peek_file (TrackerFileSystem *file_system,
                                GFile             *file)
 {
-	GNode *node;
+	FileNode *node;
 
 	g_return_val_if_fail (G_IS_FILE (file), NULL);
 	g_return_val_if_fail (TRACKER_IS_FILE_SYSTEM (file_system), NULL);
 
 	node = file_system_get_node (file_system, file);
 
-	if (node) {
-		FileNodeData *data;
-
-		data = node->data;
-		return data->file;
-	}
-
-	return NULL;
+	return (node) ? node->file : NULL;
 }
 
 GFile *
 tracker_file_system_peek_parent (TrackerFileSystem *file_system,
                                  GFile             *file)
 {
-	GNode *node;
+	FileNode *node;
 
 	g_return_val_if_fail (file != NULL, NULL);
 	g_return_val_if_fail (TRACKER_IS_FILE_SYSTEM (file_system), NULL);
@@ -644,13 +778,16 @@ tracker_file_system_peek_parent (TrackerFileSystem *file_system,
 	node = file_system_get_node (file_system, file);
 
 	if (node) {
-		FileNodeData *parent_data;
-		GNode *parent;
+		FileNode *parent;
 
+		/* Closest registered parent */
 		parent = node->parent;
-		parent_data = parent->data;
 
-		return parent_data->file;
+		while (parent && !parent->file) {
+			parent = parent->parent;
+		}
+
+		return (parent) ? parent->file : NULL;
 	}
 
 	return NULL;
@@ -659,45 +796,103 @@ tracker_file_system_peek_parent (TrackerFileSystem *file_system,
 typedef struct {
 	TrackerFileSystemTraverseFunc func;
 	gpointer user_data;
-	GSList *ignore_children;
+	GTraverseType order;
 } TraverseData;
 
-static gint
-node_is_child_of_ignored (gconstpointer a,
-                          gconstpointer b)
+static void
+file_node_collect_children (FileNode  *node,
+                            GPtrArray *children)
 {
-	if (g_node_is_ancestor ((GNode *) a, (GNode *) b))
-		return 0;
+	FileNode *child;
 
-	return 1;
+	/* Registered children, looking through path components */
+	for (child = node->first_child; child; child = child->next) {
+		if (child->file) {
+			g_ptr_array_add (children, child);
+		} else {
+			file_node_collect_children (child, children);
+		}
+	}
 }
 
-static gboolean
-traverse_filesystem_func (GNode    *node,
-                          gpointer  user_data)
+static void traverse_node (FileNode     *node,
+                           gint          depth,
+                           TraverseData *data);
+
+static void
+traverse_children (FileNode     *node,
+                   gint          depth,
+                   TraverseData *data)
 {
-	TraverseData *data = user_data;
-	FileNodeData *node_data;
-	gboolean retval = FALSE;
+	FileNode *child, *next;
 
-	node_data = node->data;
+	for (child = node->first_child; child; child = next) {
+		next = child->next;
 
-	if (!data->ignore_children ||
-	    !g_slist_find_custom (data->ignore_children,
-	                          node, node_is_child_of_ignored)) {
-		/* This node isn't a child of an
-		 * ignored one, execute callback
-		 */
-		retval = data->func (node_data->file, data->user_data);
+		if (child->file) {
+			traverse_node (child, depth, data);
+		} else {
+			traverse_children (child, depth, data);
+		}
+	}
+}
+
+static void
+traverse_node (FileNode     *node,
+               gint          depth,
+               TraverseData *data)
+{
+	gboolean ignore_children = FALSE;
+
+	if (data->order != G_POST_ORDER) {
+		ignore_children = data->func (node->file, data->user_data);
 	}
 
-	/* Avoid recursing within the children of this node */
-	if (retval) {
-		data->ignore_children = g_slist_prepend (data->ignore_children,
-		                                         node);
+	if (!ignore_children && depth != 1) {
+		traverse_children (node, (depth < 0) ? depth : depth - 1, data);
 	}
 
-	return FALSE;
+	if (data->order == G_POST_ORDER) {
+		data->func (node->file, data->user_data);
+	}
+}
+
+static void
+traverse_level_order (FileNode     *node,
+                      gint          max_depth,
+                      TraverseData *data)
+{
+	GPtrArray *level;
+	gint depth = 1;
+
+	level = g_ptr_array_new ();
+	g_ptr_array_add (level, node);
+
+	while (level->len > 0) {
+		GPtrArray *next_level;
+		guint i;
+
+		next_level = g_ptr_array_new ();
+
+		for (i = 0; i < level->len; i++) {
+			node = g_ptr_array_index (level, i);
+
+			/* Avoid recursing within the children of this node */
+			if (data->func (node->file, data->user_data)) {
+				continue;
+			}
+
+			if (max_depth < 0 || depth < max_depth) {
+				file_node_collect_children (node, next_level);
+			}
+		}
+
+		g_ptr_array_unref (level);
+		level = next_level;
+		depth++;
+	}
+
+	g_ptr_array_unref (level);
 }
 
 void
@@ -710,7 +905,7 @@ tracker_file_system_traverse (TrackerFileSystem             *file_system,
 {
 	TrackerFileSystemPrivate *priv;
 	TraverseData data;
-	GNode *node;
+	FileNode *node;
 
 	g_return_if_fail (TRACKER_IS_FILE_SYSTEM (file_system));
 	g_return_if_fail (func != NULL);
@@ -723,18 +918,22 @@ tracker_file_system_traverse (TrackerFileSystem             *file_system,
 		node = priv->file_tree;
 	}
 
+	if (!node || max_depth == 0) {
+		return;
+	}
+
 	data.func = func;
 	data.user_data = user_data;
-	data.ignore_children = NULL;
-
-	g_node_traverse (node,
-	                 order,
-	                 G_TRAVERSE_ALL,
-	                 max_depth,
-	                 traverse_filesystem_func,
-	                 &data);
+	data.order = order;
 
-	g_slist_free (data.ignore_children);
+	/* G_IN_ORDER has no meaning on a n-ary tree, it is
+	 * handled as G_PRE_ORDER.
+	 */
+	if (order == G_LEVEL_ORDER) {
+		traverse_level_order (node, max_depth, &data);
+	} else {
+		traverse_node (node, max_depth, &data);
+	}
 }
 
 void
@@ -775,16 +974,32 @@ search_property_node (gconstpointer key,
 	return 0;
 }
 
+static FileNodeProperty *
+file_node_find_property (FileNode *node,
+                         GQuark    prop)
+{
+	FileNodeProperty property;
+
+	if (node->n_properties == 0) {
+		return NULL;
+	}
+
+	property.prop_quark = prop;
+
+	return bsearch (&property, node->properties,
+	                node->n_properties, sizeof (FileNodeProperty),
+	                search_property_node);
+}
+
 void
 tracker_file_system_set_property (TrackerFileSystem *file_system,
                                   GFile             *file,
                                   GQuark             prop,
                                   gpointer           prop_data)
 {
-	FileNodeProperty property, *match;
+	FileNodeProperty *match;
 	GDestroyNotify destroy_notify;
-	FileNodeData *data;
-	GNode *node;
+	FileNode *node;
 
 	g_return_if_fail (TRACKER_IS_FILE_SYSTEM (file_system));
 	g_return_if_fail (file != NULL);
@@ -802,12 +1017,7 @@ tracker_file_system_set_property (TrackerFileSystem *file_system,
 	node = file_system_get_node (file_system, file);
 	g_return_if_fail (node != NULL);
 
-	data = node->data;
-
-	property.prop_quark = prop;
-	match = bsearch (&property, data->properties->data,
-	                 data->properties->len, sizeof (FileNodeProperty),
-	                 search_property_node);
+	match = file_node_find_property (node, prop);
 
 	if (match) {
 		if (destroy_notify) {
@@ -816,26 +1026,22 @@ tracker_file_system_set_property (TrackerFileSystem *file_system,
 
 		match->value = prop_data;
 	} else {
-		FileNodeProperty *item;
 		guint i;
 
 		/* No match, insert new element */
-		for (i = 0; i < data->properties->len; i++) {
-			item = &g_array_index (data->properties,
-			                       FileNodeProperty, i);
-
-			if (item->prop_quark > prop) {
+		for (i = 0; i < node->n_properties; i++) {
+			if (node->properties[i].prop_quark > prop) {
 				break;
 			}
 		}
 
-		property.value = prop_data;
-
-		if (i >= data->properties->len) {
-			g_array_append_val (data->properties, property);
-		} else {
-			g_array_insert_val (data->properties, i, property);
-		}
+		node->properties = g_renew (FileNodeProperty, node->properties,
+		                            node->n_properties + 1);
+		memmove (&node->properties[i + 1], &node->properties[i],
+		         (node->n_properties - i) * sizeof (FileNodeProperty));
+		node->properties[i].prop_quark = prop;
+		node->properties[i].value = prop_data;
+		node->n_properties++;
 	}
 }
 
@@ -844,9 +1050,8 @@ tracker_file_system_get_property (TrackerFileSystem *file_system,
                                   GFile             *file,
                                   GQuark             prop)
 {
-	FileNodeData *data;
-	FileNodeProperty property, *match;
-	GNode *node;
+	FileNodeProperty *match;
+	FileNode *node;
 
 	g_return_val_if_fail (TRACKER_IS_FILE_SYSTEM (file_system), NULL);
 	g_return_val_if_fail (file != NULL, NULL);
@@ -855,12 +1060,7 @@ tracker_file_system_get_property (TrackerFileSystem *file_system,
 	node = file_system_get_node (file_system, file);
 	g_return_val_if_fail (node != NULL, NULL);
 
-	data = node->data;
-	property.prop_quark = prop;
-
-	match = bsearch (&property, data->properties->data,
-	                 data->properties->len, sizeof (FileNodeProperty),
-	                 search_property_node);
+	match = file_node_find_property (node, prop);
 
 	return (match) ? match->value : NULL;
 }
@@ -870,10 +1070,9 @@ tracker_file_system_unset_property (TrackerFileSystem *file_system,
                                     GFile             *file,
                                     GQuark             prop)
 {
-	FileNodeData *data;
-	FileNodeProperty property, *match;
+	FileNodeProperty *match;
 	GDestroyNotify destroy_notify = NULL;
-	GNode *node;
+	FileNode *node;
 	guint index;
 
 	g_return_if_fail (TRACKER_IS_FILE_SYSTEM (file_system));
@@ -892,12 +1091,7 @@ tracker_file_system_unset_property (TrackerFileSystem *file_system,
 	node = file_system_get_node (file_system, file);
 	g_return_if_fail (node != NULL);
 
-	data = node->data;
-	property.prop_quark = prop;
-
-	match = bsearch (&property, data->properties->data,
-	                 data->properties->len, sizeof (FileNodeProperty),
-	                 search_property_node);
+	match = file_node_find_property (node, prop);
 
 	if (!match) {
 		return;
@@ -908,47 +1102,53 @@ tracker_file_system_unset_property (TrackerFileSystem *file_system,
 	}
 
 	/* Find out the index from memory positions */
-	index = (guint) ((FileNodeProperty *) match -
-	                 (FileNodeProperty *) data->properties->data);
-	g_assert (index < data->properties->len);
+	index = (guint) (match - node->properties);
+	g_assert (index < node->n_properties);
+
+	node->n_properties--;
+	memmove (&node->properties[index], &node->properties[index + 1],
+	         (node->n_properties - index) * sizeof (FileNodeProperty));
 
-	g_array_remove_index (data->properties, index);
+	if (node->n_properties == 0) {
+		g_free (node->properties);
+		node->properties = NULL;
+	}
 }
 
 typedef struct {
-	TrackerFileSystem *file_system;
 	GList *list;
 	GFileType file_type;
 } ForgetFilesData;
 
-static gboolean
-append_deleted_files (GNode    *node,
-		      gpointer  user_data)
+static void
+append_deleted_files (FileNode        *node,
+                      ForgetFilesData *data)
 {
-	ForgetFilesData *data;
-	FileNodeData *node_data;
-
-	data = user_data;
-	node_data = node->data;
-
-	if (data->file_type == G_FILE_TYPE_UNKNOWN ||
-	    node_data->file_type == data->file_type) {
-		data->list = g_list_prepend (data->list, node_data);
+	FileNode *child;
+
+	if (node->file &&
+	    (data->file_type == G_FILE_TYPE_UNKNOWN ||
+	     node->file_type == data->file_type) &&
+	    (data->file_type != G_FILE_TYPE_REGULAR ||
+	     node->first_child == NULL)) {
+		data->list = g_list_prepend (data->list, node);
 	}
 
-	return FALSE;
+	for (child = node->first_child; child; child = child->next) {
+		append_deleted_files (child, data);
+	}
 }
 
 static void
-forget_file (FileNodeData *node_data)
+forget_file (FileNode *node)
 {
-	if (!node_data->unowned) {
-		node_data->unowned = TRUE;
+	if (!node->unowned) {
+		node->unowned = TRUE;
 
 		/* Weak reference handler will remove the file from the tree and
-		 * clean up node_data if this is the final reference.
+		 * clean up the node if this is the final reference.
 		 */
-		g_object_unref (node_data->file);
+		g_object_unref (node->file);
 	}
 }
 
@@ -957,8 +1157,8 @@ tracker_file_system_forget_files (TrackerFileSystem *file_system,
 				  GFile             *root,
 				  GFileType          file_type)
 {
-	ForgetFilesData data = { file_system, NULL, file_type };
-	GNode *node;
+	ForgetFilesData data = { NULL, file_type };
+	FileNode *node;
 
 	g_return_if_fail (TRACKER_IS_FILE_SYSTEM (file_system));
 	g_return_if_fail (G_IS_FILE (root));
@@ -967,14 +1167,11 @@ tracker_file_system_forget_files (TrackerFileSystem *file_system,
 	g_return_if_fail (node != NULL);
 
 	/* We need to get the files to delete into a list, so
-	 * the node tree isn't modified during traversal.
+	 * the node tree isn't modified during traversal. Nodes
+	 * without files only go away after their last child,
+	 * which comes earlier in the list.
 	 */
-	g_node_traverse (node,
-	                 G_PRE_ORDER,
-	                 (file_type == G_FILE_TYPE_REGULAR) ?
-	                   G_TRAVERSE_LEAVES : G_TRAVERSE_ALL,
-	                 -1, append_deleted_files,
-	                 &data);
+	append_deleted_files (node, &data);
 
 	g_list_foreach (data.list, (GFunc) forget_file, NULL);
 	g_list_free (data.list);
@@ -985,7 +1182,7 @@ tracker_file_system_get_file_type (TrackerFileSystem *file_system,
                                    GFile             *file)
 {
 	GFileType file_type = G_FILE_TYPE_UNKNOWN;
-	GNode *node;
+	FileNode *node;
 
 	g_return_val_if_fail (TRACKER_IS_FILE_SYSTEM (file_system), file_type);
 	g_return_val_if_fail (G_IS_FILE (file), file_type);
@@ -993,10 +1190,7 @@ tracker_file_system_get_file_type (TrackerFileSystem *file_system,
 	node = file_system_get_node (file_system, file);
 
 	if (node) {
-		FileNodeData *node_data;
-
-		node_data = node->data;
-		file_type = node_data->file_type;
+		file_type = node->file_type;
 	}
 
 	return file_type;
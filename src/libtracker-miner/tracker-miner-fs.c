@@ -99,6 +99,13 @@ static gboolean miner_fs_queues_status_trace_timeout_cb (gpointer data);
  */
 #define TRACKER_TASK_PRIORITY G_PRIORITY_DEFAULT_IDLE + 10
 
+/* Maximum number of queued items and time spent handling them in a
+ * single dispatch of the item queue handler, so monitor events and
+ * finished tasks are still dispatched between batches.
+ */
+#define ITEM_QUEUE_BATCH_MAX_ITEMS 64
+#define ITEM_QUEUE_BATCH_MAX_USEC  (5 * G_TIME_SPAN_MILLISECOND)
+
 /**
  * SECTION:tracker-miner-fs
  * @short_description: Abstract base class for filesystem miners
@@ -252,6 +259,12 @@ struct _TrackerMinerFSPrivate {
 	guint total_files_processed;
 	guint total_files_notified;
 	guint total_files_notified_error;
+
+	/* How many queued items were handled, in how many dispatches
+	 * of the item queue handler and how long it took. */
+	guint64 total_items_handled;
+	guint total_item_dispatches;
+	gint64 item_queue_usec;
 };
 
 typedef enum {
@@ -694,6 +707,7 @@ miner_fs_initable_init (GInitable     *initable,
                         GError       **error)
 {
 	TrackerMinerFSPrivate *priv;
+	gchar *name, *basename, *filename;
 	guint limit;
 
 	if (!miner_fs_initable_parent_iface->init (initable, cancellable, error)) {
@@ -742,6 +756,19 @@ miner_fs_initable_init (GInitable     *initable,
 		return FALSE;
 	}
 
+	tracker_file_notifier_set_throttle (priv->file_notifier, priv->throttle);
+
+	/* Keep what's known about the store across runs, so mtime
+	 * checks on startup mostly don't need querying it.
+	 */
+	g_object_get (initable, "name", &name, NULL);
+	basename = g_strdup_printf ("crawl-state-%s.db", name);
+	filename = g_build_filename (g_get_user_cache_dir (), "tracker", basename, NULL);
+	tracker_file_notifier_set_crawl_state_file (priv->file_notifier, filename);
+	g_free (filename);
+	g_free (basename);
+	g_free (name);
+
 	g_signal_connect (priv->file_notifier, "file-created",
 	                  G_CALLBACK (file_notifier_file_created),
 	                  initable);
@@ -1147,6 +1174,18 @@ process_print_stats (TrackerMinerFS *fs)
 		        fs->priv->total_files_processed,
 		        fs->priv->total_files_notified,
 		        fs->priv->total_files_notified_error);
+
+		if (fs->priv->total_item_dispatches > 0) {
+			gdouble seconds_elapsed;
+
+			seconds_elapsed = g_timer_elapsed (fs->priv->timer, NULL);
+			g_info ("Total queue items : %" G_GUINT64_FORMAT " (%.1f/s, %.1f per dispatch, %.1f%% of time in handlers)",
+			        fs->priv->total_items_handled,
+			        seconds_elapsed > 0 ? fs->priv->total_items_handled / seconds_elapsed : 0.0,
+			        (gdouble) fs->priv->total_items_handled / fs->priv->total_item_dispatches,
+			        seconds_elapsed > 0 ? 100 * (fs->priv->item_queue_usec / (gdouble) G_USEC_PER_SEC) / seconds_elapsed : 0.0);
+		}
+
 		g_info ("--------------------------------------------------\n");
 	}
 }
@@ -2381,10 +2420,13 @@ item_queue_get_progress (TrackerMinerFS *fs,
 	return (gdouble) (items_total - items_to_process) / items_total;
 }
 
+/* Returns whether to keep processing, @handled is set if an item
+ * was taken off the queues for good.
+ */
 static gboolean
-item_queue_handlers_cb (gpointer user_data)
+item_queue_handle_next (TrackerMinerFS *fs,
+                        gboolean       *handled)
 {
-	TrackerMinerFS *fs = user_data;
 	GFile *file = NULL;
 	GFile *source_file = NULL;
 	GFile *parent;
@@ -2394,14 +2436,10 @@ item_queue_handlers_cb (gpointer user_data)
 	gboolean keep_processing = TRUE;
 	gint priority = 0;
 
-	if (fs->priv->timer_stopped) {
-		g_timer_start (fs->priv->timer);
-		fs->priv->timer_stopped = FALSE;
-	}
+	*handled = FALSE;
 
 	if (tracker_task_pool_limit_reached (TRACKER_TASK_POOL (fs->priv->sparql_buffer))) {
 		/* Task pool is full, give it a break */
-		fs->priv->item_queues_handler_id = 0;
 		return FALSE;
 	}
 
@@ -2412,8 +2450,6 @@ item_queue_handlers_cb (gpointer user_data)
 		 * the processing pool is cleared before starting with
 		 * the next directories batch.
 		 */
-		fs->priv->item_queues_handler_id = 0;
-
 		/* We should flush the processing pool buffer here, because
 		 * if there was a previous task on the same file we want to
 		 * process now, we want it to get finished before we can go
@@ -2488,10 +2524,21 @@ item_queue_handlers_cb (gpointer user_data)
 
 		if (++info_last >= 5 &&
 		    (gint) (progress_last * 100) != (gint) (progress_now * 100)) {
+			static guint64 items_last = 0;
+			static gdouble seconds_last = 0.0;
 			gchar *str1, *str2;
+			gdouble rate = 0.0;
+
+			if (seconds_elapsed > seconds_last &&
+			    fs->priv->total_items_handled >= items_last) {
+				rate = (fs->priv->total_items_handled - items_last) /
+					(seconds_elapsed - seconds_last);
+			}
 
 			info_last = 0;
 			progress_last = progress_now;
+			items_last = fs->priv->total_items_handled;
+			seconds_last = seconds_elapsed;
 
 			/* Log estimated remaining time */
 			str1 = tracker_seconds_estimate_to_string (extraction_elapsed,
@@ -2500,9 +2547,10 @@ item_queue_handlers_cb (gpointer user_data)
 			                                           items_remaining);
 			str2 = tracker_seconds_to_string (seconds_elapsed, TRUE);
 
-			g_info ("Processed %u/%u, estimated %s left, %s elapsed",
+			g_info ("Processed %u/%u (%.1f items/s), estimated %s left, %s elapsed",
 			        items_processed,
 			        items_processed + items_remaining,
+			        rate,
 			        str1,
 			        str2);
 
@@ -2512,6 +2560,8 @@ item_queue_handlers_cb (gpointer user_data)
 	}
 
 	/* Handle queues */
+	*handled = (queue != QUEUE_NONE);
+
 	switch (queue) {
 	case QUEUE_NONE:
 		if (!tracker_file_notifier_is_active (fs->priv->file_notifier) &&
@@ -2574,6 +2624,7 @@ item_queue_handlers_cb (gpointer user_data)
 			item_reenqueue (fs, item_queue, g_object_ref (parent), priority - 1);
 			item_reenqueue (fs, item_queue, g_object_ref (file), priority);
 
+			*handled = FALSE;
 			keep_processing = TRUE;
 		}
 
@@ -2601,12 +2652,69 @@ item_queue_handlers_cb (gpointer user_data)
 		g_object_unref (source_file);
 	}
 
-	if (!keep_processing) {
+	return keep_processing;
+}
+
+static gboolean
+item_queue_handlers_cb (gpointer user_data)
+{
+	TrackerMinerFS *fs = user_data;
+	gboolean keep_processing, handled;
+	guint handler_id, max_items, n_items = 0, n_handled = 0;
+	gint64 start_time, elapsed;
+
+	if (fs->priv->timer_stopped) {
+		g_timer_start (fs->priv->timer);
+		fs->priv->timer_stopped = FALSE;
+	}
+
+	handler_id = fs->priv->item_queues_handler_id;
+	start_time = g_get_monotonic_time ();
+
+	/* When throttled, the timeout interval is what paces
+	 * processing, so only handle one item per dispatch.
+	 */
+	max_items = (fs->priv->throttle == 0) ? ITEM_QUEUE_BATCH_MAX_ITEMS : 1;
+
+	do {
+		keep_processing = item_queue_handle_next (fs, &handled);
+		n_items++;
+
+		if (handled) {
+			n_handled++;
+		}
+
+		elapsed = g_get_monotonic_time () - start_time;
+
+		/* Processing an item may pause the miner or change
+		 * the throttle, which remove or replace this source.
+		 */
+		if (fs->priv->item_queues_handler_id != handler_id ||
+		    fs->priv->is_paused ||
+		    fs->priv->item_queue_blocker) {
+			break;
+		}
+	} while (keep_processing &&
+	         n_items < max_items &&
+	         elapsed < ITEM_QUEUE_BATCH_MAX_USEC);
+
+	fs->priv->total_items_handled += n_handled;
+	fs->priv->total_item_dispatches++;
+	fs->priv->item_queue_usec += elapsed;
+
+	trace_eq ("Handled %u items in %" G_GINT64_FORMAT " usec", n_handled, elapsed);
+
+	if (fs->priv->item_queues_handler_id != handler_id) {
+		/* Source was removed, and maybe replaced by a new one */
+		return FALSE;
+	}
+
+	if (!keep_processing || fs->priv->is_paused) {
 		fs->priv->item_queues_handler_id = 0;
 		return FALSE;
-	} else {
-		return TRUE;
 	}
+
+	return TRUE;
 }
 
 static guint
@@ -3748,6 +3856,10 @@ tracker_miner_fs_set_throttle (TrackerMinerFS *fs,
 
 	fs->priv->throttle = throttle;
 
+	if (fs->priv->file_notifier) {
+		tracker_file_notifier_set_throttle (fs->priv->file_notifier, throttle);
+	}
+
 	/* Update timeouts */
 	if (fs->priv->item_queues_handler_id != 0) {
 		g_source_remove (fs->priv->item_queues_handler_id);
@@ -3837,6 +3949,41 @@ tracker_miner_fs_get_urn (TrackerMinerFS *fs,
 	}
 }
 
+/**
+ * tracker_miner_fs_get_file_info:
+ * @fs: a #TrackerMinerFS
+ * @file: a #GFile obtained in #TrackerMinerFS::process-file
+ *
+ * If @file was found while crawling, this function returns the
+ * #GFileInfo gathered at that time, so #TrackerMinerFS
+ * implementations can avoid querying it again. Besides the file
+ * type and modification time, it contains the %G_FILE_ATTRIBUTE_TIME_ACCESS,
+ * %G_FILE_ATTRIBUTE_STANDARD_SIZE, %G_FILE_ATTRIBUTE_STANDARD_DISPLAY_NAME
+ * and %G_FILE_ATTRIBUTE_STANDARD_FAST_CONTENT_TYPE attributes if the
+ * data provider could fetch them. The content type is not sniffed
+ * while crawling, %G_FILE_ATTRIBUTE_STANDARD_CONTENT_TYPE needs to
+ * be queried if the file contents should be checked.
+ *
+ * The information is only handed out once, %NULL is returned for
+ * files that weren't crawled (e.g. those notified by monitors), for
+ * directories, and for files queued while many others were already
+ * waiting to be processed.
+ *
+ * Returns: (transfer full) (nullable): a #GFileInfo, or %NULL.
+ *
+ * Since: 1.4
+ **/
+GFileInfo *
+tracker_miner_fs_get_file_info (TrackerMinerFS *fs,
+                                GFile          *file)
+{
+	g_return_val_if_fail (TRACKER_IS_MINER_FS (fs), NULL);
+	g_return_val_if_fail (G_IS_FILE (file), NULL);
+
+	return tracker_file_notifier_steal_file_info (fs->priv->file_notifier,
+	                                              file);
+}
+
 /**
  * tracker_miner_fs_query_urn:
  * @fs: a #TrackerMinerFS
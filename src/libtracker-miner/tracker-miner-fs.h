@@ -196,6 +196,10 @@ const gchar          *tracker_miner_fs_get_parent_urn        (TrackerMinerFS  *f
 gchar                *tracker_miner_fs_query_urn             (TrackerMinerFS  *fs,
                                                               GFile           *file);
 
+/* Crawled information */
+GFileInfo            *tracker_miner_fs_get_file_info         (TrackerMinerFS  *fs,
+                                                              GFile           *file);
+
 
 /* Progress */
 gboolean              tracker_miner_fs_has_items_to_process  (TrackerMinerFS  *fs);
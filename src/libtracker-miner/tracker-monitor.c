@@ -31,6 +31,7 @@
 #endif
 
 #include "tracker-monitor.h"
+#include "tracker-fanotify.h"
 
 #define TRACKER_MONITOR_GET_PRIVATE(obj) (G_TYPE_INSTANCE_GET_PRIVATE ((obj), TRACKER_TYPE_MONITOR, TrackerMonitorPrivate))
 
@@ -70,9 +71,14 @@ struct TrackerMonitorPrivate {
 
 	GType          monitor_backend;
 
+	/* Used instead of GIO directory monitors if available */
+	TrackerFanotify *fanotify;
+
+	/* With fanotify, only applies to GIO monitors it falls back to */
 	guint          monitor_limit;
 	gboolean       monitor_limit_warned;
 	guint          monitors_ignored;
+	guint          n_gio_fallbacks;
 
 	/* For FAM, the _CHANGES_DONE event is not signalled, so we
 	 * have to just use the _CHANGED event instead.
@@ -127,8 +133,10 @@ static void           tracker_monitor_get_property (GObject        *object,
                                                     GParamSpec     *pspec);
 static guint          get_kqueue_limit             (void);
 static guint          get_inotify_limit            (void);
+static void           monitor_limit_reached        (TrackerMonitor *monitor);
 static GFileMonitor * directory_monitor_new        (TrackerMonitor *monitor,
-                                                    GFile          *file);
+                                                    GFile          *file,
+                                                    gboolean       *limit_reached);
 static void           directory_monitor_cancel     (GFileMonitor     *dir_monitor);
 
 
@@ -267,7 +275,7 @@ tracker_monitor_init (TrackerMonitor *object)
 
 	if (error) {
 		g_critical ("Could not create sample directory monitor: %s", error->message);
-		g_error_free (error);
+		g_clear_error (&error);
 
 		/* Guessing limit... */
 		priv->monitor_limit = 100;
@@ -348,7 +356,26 @@ tracker_monitor_init (TrackerMonitor *object)
 	}
 
 	g_object_unref (file);
-	g_message ("Monitor limit is %d", priv->monitor_limit);
+
+	/* fanotify needs a single mark for each filesystem, watched
+	 * directories are only tracked in user space so the limit only
+	 * applies to the GIO monitors used for directories it can't
+	 * watch. It requires CAP_SYS_ADMIN though, without it we just
+	 * keep using the GIO monitors.
+	 */
+	if (g_getenv ("TRACKER_DISABLE_FANOTIFY") == NULL) {
+		priv->fanotify = tracker_fanotify_new (&error);
+	}
+
+	if (priv->fanotify) {
+		g_message ("Monitor backend is fanotify, directories it "
+		           "can't watch fall back to GIO monitors");
+	} else if (error) {
+		g_debug ("Not using fanotify: %s", error->message);
+		g_clear_error (&error);
+	}
+
+	g_message ("Monitor limit is %u", priv->monitor_limit);
 }
 
 static void
@@ -372,6 +399,10 @@ tracker_monitor_finalize (GObject *object)
 	g_hash_table_unref (priv->pre_delete);
 	g_hash_table_unref (priv->monitors);
 
+	if (priv->fanotify) {
+		tracker_fanotify_free (priv->fanotify);
+	}
+
 	G_OBJECT_CLASS (tracker_monitor_parent_class)->finalize (object);
 }
 
@@ -1383,17 +1414,72 @@ monitor_event_cb (GFileMonitor      *file_monitor,
 	g_free (other_file_uri);
 }
 
+static void
+monitor_limit_reached (TrackerMonitor *monitor)
+{
+	monitor->priv->monitors_ignored++;
+
+	if (!monitor->priv->monitor_limit_warned) {
+		g_warning ("The maximum number of monitors to set (%d) "
+		           "has been reached, not adding any new ones",
+		           monitor->priv->monitor_limit);
+		monitor->priv->monitor_limit_warned = TRUE;
+	}
+}
+
+static void
+gio_fallback_finalized (gpointer  data,
+                        GObject  *where_the_object_was)
+{
+	TrackerMonitor *monitor = data;
+
+	monitor->priv->n_gio_fallbacks--;
+}
+
+/* Returns NULL if the directory can't be monitored, @limit_reached
+ * tells whether that is due to the monitor limit.
+ */
 static GFileMonitor *
 directory_monitor_new (TrackerMonitor *monitor,
-                       GFile          *file)
+                       GFile          *file,
+                       gboolean       *limit_reached)
 {
-	GFileMonitor *file_monitor;
+	GFileMonitor *file_monitor = NULL;
+	gboolean gio_fallback = FALSE;
 	GError *error = NULL;
 
-	file_monitor = g_file_monitor_directory (file,
-	                                         G_FILE_MONITOR_SEND_MOVED | G_FILE_MONITOR_WATCH_MOUNTS,
-	                                         NULL,
-	                                         &error);
+	if (limit_reached) {
+		*limit_reached = FALSE;
+	}
+
+	if (monitor->priv->fanotify) {
+		file_monitor = tracker_fanotify_monitor_directory (monitor->priv->fanotify,
+		                                                   file,
+		                                                   &error);
+
+		if (!file_monitor) {
+			g_debug ("%s, using a GIO monitor instead", error->message);
+			g_clear_error (&error);
+
+			if (monitor->priv->n_gio_fallbacks >= monitor->priv->monitor_limit) {
+				if (limit_reached) {
+					*limit_reached = TRUE;
+				}
+
+				monitor_limit_reached (monitor);
+				return NULL;
+			}
+
+			gio_fallback = TRUE;
+		}
+	}
+
+	if (!file_monitor) {
+		file_monitor = g_file_monitor_directory (file,
+		                                         G_FILE_MONITOR_SEND_MOVED | G_FILE_MONITOR_WATCH_MOUNTS,
+		                                         NULL,
+		                                         &error);
+	}
 
 	if (error) {
 		gchar *uri;
@@ -1408,6 +1494,16 @@ directory_monitor_new (TrackerMonitor *monitor,
 		return NULL;
 	}
 
+	if (gio_fallback) {
+		/* Each of these takes an inotify watch, count them
+		 * for as long as they are alive.
+		 */
+		monitor->priv->n_gio_fallbacks++;
+		g_object_weak_ref (G_OBJECT (file_monitor),
+		                   gio_fallback_finalized,
+		                   monitor);
+	}
+
 	g_signal_connect (file_monitor, "changed",
 	                  G_CALLBACK (monitor_event_cb),
 	                  monitor);
@@ -1492,7 +1588,7 @@ tracker_monitor_set_enabled (TrackerMonitor *monitor,
 		if (enabled) {
 			GFileMonitor *dir_monitor;
 
-			dir_monitor = directory_monitor_new (monitor, file);
+			dir_monitor = directory_monitor_new (monitor, file, NULL);
 			g_hash_table_replace (monitor->priv->monitors,
 			                      g_object_ref (file), dir_monitor);
 		} else {
@@ -1510,6 +1606,7 @@ tracker_monitor_add (TrackerMonitor *monitor,
                      GFile          *file)
 {
 	GFileMonitor *dir_monitor = NULL;
+	gboolean limit_reached;
 	gchar *uri;
 
 	g_return_val_if_fail (TRACKER_IS_MONITOR (monitor), FALSE);
@@ -1519,17 +1616,12 @@ tracker_monitor_add (TrackerMonitor *monitor,
 		return TRUE;
 	}
 
-	/* Cap the number of monitors */
-	if (g_hash_table_size (monitor->priv->monitors) >= monitor->priv->monitor_limit) {
-		monitor->priv->monitors_ignored++;
-
-		if (!monitor->priv->monitor_limit_warned) {
-			g_warning ("The maximum number of monitors to set (%d) "
-			           "has been reached, not adding any new ones",
-			           monitor->priv->monitor_limit);
-			monitor->priv->monitor_limit_warned = TRUE;
-		}
-
+	/* Cap the number of monitors, with fanotify only the GIO
+	 * monitors it falls back to are capped, when creating them.
+	 */
+	if (!monitor->priv->fanotify &&
+	    g_hash_table_size (monitor->priv->monitors) >= monitor->priv->monitor_limit) {
+		monitor_limit_reached (monitor);
 		return FALSE;
 	}
 
@@ -1541,11 +1633,14 @@ tracker_monitor_add (TrackerMonitor *monitor,
 		 *
 		 * Also, we assume ALL paths passed are directories.
 		 */
-		dir_monitor = directory_monitor_new (monitor, file);
+		dir_monitor = directory_monitor_new (monitor, file, &limit_reached);
 
 		if (!dir_monitor) {
-			g_warning ("Could not add monitor for path:'%s'",
-			           uri);
+			if (!limit_reached) {
+				g_warning ("Could not add monitor for path:'%s'",
+				           uri);
+			}
+
 			g_free (uri);
 			return FALSE;
 		}
@@ -109,6 +109,24 @@ class Tracker.Sparql.Backend : Connection {
 		}
 	}
 
+	public override Cursor query_continue (string sparql, string? continuation, Cancellable? cancellable = null) throws Sparql.Error, IOError, DBusError {
+		debug ("%s(): '%s'", Log.METHOD, sparql);
+		if (direct != null) {
+			return direct.query_continue (sparql, continuation, cancellable);
+		} else {
+			return bus.query_continue (sparql, continuation, cancellable);
+		}
+	}
+
+	public async override Cursor query_continue_async (string sparql, string? continuation, Cancellable? cancellable = null) throws Sparql.Error, IOError, DBusError {
+		debug ("%s(): '%s'", Log.METHOD, sparql);
+		if (direct != null) {
+			return yield direct.query_continue_async (sparql, continuation, cancellable);
+		} else {
+			return yield bus.query_continue_async (sparql, continuation, cancellable);
+		}
+	}
+
 	public override void update (string sparql, int priority = GLib.Priority.DEFAULT, Cancellable? cancellable = null) throws Sparql.Error, IOError, DBusError {
 		debug ("%s(priority:%d): '%s'", Log.METHOD, priority, sparql);
 		if (bus == null) {
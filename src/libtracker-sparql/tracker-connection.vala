@@ -262,6 +262,70 @@ public abstract class Tracker.Sparql.Connection : Object {
 	 */
 	public async abstract Cursor query_async (string sparql, Cancellable? cancellable = null) throws Sparql.Error, GLib.Error, GLib.IOError, DBusError;
 
+	/**
+	 * tracker_sparql_connection_query_continue:
+	 * @self: a #TrackerSparqlConnection
+	 * @sparql: string containing the SPARQL query
+	 * @continuation: (allow-none): a continuation from a previous result
+	 * of @sparql, or %NULL to start from the first row
+	 * @cancellable: a #GCancellable used to cancel the operation
+	 * @error: #GError for error reporting.
+	 *
+	 * Executes a SPARQL query like tracker_sparql_connection_query(), the
+	 * returned cursor provides a continuation for every row with
+	 * tracker_sparql_cursor_get_continuation(). Passing it back here with
+	 * the same @sparql returns the rows after that row, so results can be
+	 * paged through without OFFSET, which needs to skip all previous rows
+	 * again for every page. The LIMIT of @sparql applies to every page.
+	 *
+	 * The API call is completely synchronous, so it may block.
+	 *
+	 * Returns: a #TrackerSparqlCursor if results were found, #NULL otherwise.
+	 * On error, #NULL is returned and the @error is set accordingly, this is
+	 * #TRACKER_SPARQL_ERROR_UNSUPPORTED if the query can not be continued.
+	 * Call g_object_unref() on the returned cursor when no longer needed.
+	 *
+	 * Since: 1.4
+	 */
+	public virtual Cursor query_continue (string sparql, string? continuation, Cancellable? cancellable = null) throws Sparql.Error, GLib.Error, GLib.IOError, DBusError {
+		throw new Sparql.Error.UNSUPPORTED ("Interface 'query_continue' not implemented");
+	}
+
+	/**
+	 * tracker_sparql_connection_query_continue_finish:
+	 * @self: a #TrackerSparqlConnection
+	 * @_res_: a #GAsyncResult with the result of the operation
+	 * @error: #GError for error reporting.
+	 *
+	 * Finishes the asynchronous SPARQL query operation.
+	 *
+	 * Returns: a #TrackerSparqlCursor if results were found, #NULL otherwise.
+	 * On error, #NULL is returned and the @error is set accordingly.
+	 * Call g_object_unref() on the returned cursor when no longer needed.
+	 *
+	 * Since: 1.4
+	 */
+
+	/**
+	 * tracker_sparql_connection_query_continue_async:
+	 * @self: a #TrackerSparqlConnection
+	 * @sparql: string containing the SPARQL query
+	 * @continuation: (allow-none): a continuation from a previous result
+	 * of @sparql, or %NULL to start from the first row
+	 * @cancellable: a #GCancellable used to cancel the operation
+	 * @_callback_: user-defined #GAsyncReadyCallback to be called when
+	 *              asynchronous operation is finished.
+	 * @_user_data_: user-defined data to be passed to @_callback_
+	 *
+	 * Executes asynchronously a SPARQL query that can be continued, see
+	 * tracker_sparql_connection_query_continue().
+	 *
+	 * Since: 1.4
+	 */
+	public async virtual Cursor query_continue_async (string sparql, string? continuation, Cancellable? cancellable = null) throws Sparql.Error, GLib.Error, GLib.IOError, DBusError {
+		throw new Sparql.Error.UNSUPPORTED ("Interface 'query_continue_async' not implemented");
+	}
+
 	/**
 	 * tracker_sparql_connection_update:
 	 * @self: a #TrackerSparqlConnection
@@ -217,6 +217,27 @@ public abstract class Tracker.Sparql.Cursor : Object {
 	public virtual void close () {
 	}
 
+	/**
+	 * tracker_sparql_cursor_get_continuation:
+	 * @self: a #TrackerSparqlCursor
+	 *
+	 * Retrieves a token for the current row that can be passed to
+	 * tracker_sparql_connection_query_continue() to get the rows that
+	 * follow it, without the cost of skipping rows with OFFSET.
+	 *
+	 * Only cursors returned by tracker_sparql_connection_query_continue()
+	 * for queries with ORDER BY, and without DISTINCT, GROUP BY or full
+	 * text search, provide continuations.
+	 *
+	 * Returns: a newly allocated string, or %NULL if the query can not be
+	 * continued. Free with g_free().
+	 *
+	 * Since: 1.4
+	 */
+	public virtual string? get_continuation () {
+		return null;
+	}
+
 	/**
 	 * tracker_sparql_cursor_get_integer:
 	 * @self: a #TrackerSparqlCursor
@@ -60,6 +60,8 @@ struct ProcessFileData {
 	GCancellable *cancellable;
 	GFile *file;
 	gchar *mime_type;
+	/* crawled info, waiting for the content type */
+	GFileInfo *file_info;
 };
 
 struct TrackerMinerFilesPrivate {
@@ -2006,6 +2008,11 @@ process_file_data_free (ProcessFileData *data)
 	g_object_unref (data->cancellable);
 	g_object_unref (data->file);
 	g_free (data->mime_type);
+
+	if (data->file_info) {
+		g_object_unref (data->file_info);
+	}
+
 	g_slice_free (ProcessFileData, data);
 }
 
@@ -2095,38 +2102,22 @@ sparql_builder_finish (ProcessFileData *data,
 }
 
 static void
-process_file_cb (GObject      *object,
-                 GAsyncResult *result,
-                 gpointer      user_data)
+process_file_info (ProcessFileData *data,
+                   GFileInfo       *file_info)
 {
 	TrackerMinerFilesPrivate *priv;
 	TrackerSparqlBuilder *sparql;
-	ProcessFileData *data;
 	const gchar *mime_type, *urn, *parent_urn;
-	GFileInfo *file_info;
 	guint64 time_;
 	GFile *file;
 	gchar *uri;
-	GError *error = NULL;
 	gboolean is_iri;
 	gboolean is_directory;
 
-	data = user_data;
-	file = G_FILE (object);
+	file = data->file;
 	sparql = data->sparql;
-	file_info = g_file_query_info_finish (file, result, &error);
 	priv = TRACKER_MINER_FILES (data->miner)->private;
 
-	if (error) {
-		/* Something bad happened, notify about the error */
-		tracker_miner_fs_file_notify (TRACKER_MINER_FS (data->miner), file, error);
-		priv->extraction_queue = g_list_remove (priv->extraction_queue, data);
-		process_file_data_free (data);
-		g_error_free (error);
-
-		return;
-	}
-
 	uri = g_file_get_uri (file);
 	mime_type = g_file_info_get_content_type (file_info);
 	urn = miner_files_get_file_urn (TRACKER_MINER_FILES (data->miner), file, &is_iri);
@@ -2198,10 +2189,59 @@ process_file_cb (GObject      *object,
 	priv->extraction_queue = g_list_remove (priv->extraction_queue, data);
 	process_file_data_free (data);
 
-	g_object_unref (file_info);
 	g_free (uri);
 }
 
+static void
+process_file_cb (GObject      *object,
+                 GAsyncResult *result,
+                 gpointer      user_data)
+{
+	TrackerMinerFilesPrivate *priv;
+	ProcessFileData *data;
+	GFileInfo *file_info;
+	GFile *file;
+	GError *error = NULL;
+
+	data = user_data;
+	file = G_FILE (object);
+	file_info = g_file_query_info_finish (file, result, &error);
+	priv = TRACKER_MINER_FILES (data->miner)->private;
+
+	if (error) {
+		/* Something bad happened, notify about the error */
+		tracker_miner_fs_file_notify (TRACKER_MINER_FS (data->miner), file, error);
+		priv->extraction_queue = g_list_remove (priv->extraction_queue, data);
+		process_file_data_free (data);
+		g_error_free (error);
+
+		return;
+	}
+
+	if (data->file_info) {
+		/* only the content type was queried */
+		g_file_info_set_content_type (data->file_info,
+		                              g_file_info_get_content_type (file_info));
+		g_object_unref (file_info);
+		file_info = data->file_info;
+		data->file_info = NULL;
+	}
+
+	process_file_info (data, file_info);
+	g_object_unref (file_info);
+}
+
+static gboolean
+file_info_is_complete (GFileInfo *file_info)
+{
+	/* Everything process_file_info() needs, but the content type */
+	return (g_file_info_has_attribute (file_info, G_FILE_ATTRIBUTE_STANDARD_TYPE) &&
+	        g_file_info_has_attribute (file_info, G_FILE_ATTRIBUTE_STANDARD_DISPLAY_NAME) &&
+	        g_file_info_has_attribute (file_info, G_FILE_ATTRIBUTE_STANDARD_SIZE) &&
+	        g_file_info_has_attribute (file_info, G_FILE_ATTRIBUTE_TIME_MODIFIED) &&
+	        g_file_info_has_attribute (file_info, G_FILE_ATTRIBUTE_TIME_ACCESS));
+}
+
 static gboolean
 miner_files_process_file (TrackerMinerFS       *fs,
                           GFile                *file,
@@ -2210,6 +2250,7 @@ miner_files_process_file (TrackerMinerFS       *fs,
 {
 	TrackerMinerFilesPrivate *priv;
 	ProcessFileData *data;
+	GFileInfo *file_info;
 	const gchar *attrs;
 
 	data = g_slice_new0 (ProcessFileData);
@@ -2221,12 +2262,31 @@ miner_files_process_file (TrackerMinerFS       *fs,
 	priv = TRACKER_MINER_FILES (fs)->private;
 	priv->extraction_queue = g_list_prepend (priv->extraction_queue, data);
 
-	attrs = G_FILE_ATTRIBUTE_STANDARD_TYPE ","
-		G_FILE_ATTRIBUTE_STANDARD_CONTENT_TYPE ","
-		G_FILE_ATTRIBUTE_STANDARD_DISPLAY_NAME ","
-		G_FILE_ATTRIBUTE_STANDARD_SIZE ","
-		G_FILE_ATTRIBUTE_TIME_MODIFIED ","
-		G_FILE_ATTRIBUTE_TIME_ACCESS;
+	/* Files found while crawling come with the rest of what we need */
+	file_info = tracker_miner_fs_get_file_info (fs, file);
+
+	if (file_info && file_info_is_complete (file_info)) {
+		if (g_file_info_has_attribute (file_info, G_FILE_ATTRIBUTE_STANDARD_CONTENT_TYPE)) {
+			process_file_info (data, file_info);
+			g_object_unref (file_info);
+
+			return TRUE;
+		}
+
+		/* The crawler only guesses it from the file name,
+		 * contents are sniffed for the files we process */
+		data->file_info = file_info;
+		attrs = G_FILE_ATTRIBUTE_STANDARD_CONTENT_TYPE;
+	} else {
+		g_clear_object (&file_info);
+
+		attrs = G_FILE_ATTRIBUTE_STANDARD_TYPE ","
+			G_FILE_ATTRIBUTE_STANDARD_CONTENT_TYPE ","
+			G_FILE_ATTRIBUTE_STANDARD_DISPLAY_NAME ","
+			G_FILE_ATTRIBUTE_STANDARD_SIZE ","
+			G_FILE_ATTRIBUTE_TIME_MODIFIED ","
+			G_FILE_ATTRIBUTE_TIME_ACCESS;
+	}
 
 	g_file_query_info_async (file,
 	                         attrs,
@@ -218,6 +218,9 @@ public class Tracker.Query {
 	public uint limit { get; set; }
 	public string query { get; private set; }
 
+	// continuation of the row before offset, if known
+	public string? continuation { get; set; }
+
 	public GenericArray<string> tags { get; set; }
 
 	private static Sparql.Connection connection;
@@ -392,12 +395,23 @@ public class Tracker.Query {
 			query += " ORDER BY " + sort_clauses[query_type];
 		}
 
-		query += " OFFSET %u LIMIT %u".printf (offset, limit);
+		if (continuation != null) {
+			// the store resumes after the previous row instead of
+			// skipping all rows up to offset again
+			query += " LIMIT %u".printf (limit);
+		} else {
+			query += " OFFSET %u LIMIT %u".printf (offset, limit);
+		}
 
 		debug ("Running query: '%s'", query);
 
 		try {
-			cursor = yield connection.query_async (query, null);
+			try {
+				cursor = yield connection.query_continue_async (query, continuation, null);
+			} catch (Sparql.Error.UNSUPPORTED e) {
+				// older store, only OFFSET is available
+				cursor = yield connection.query_async (query, null);
+			}
 		} catch (GLib.Error e) {
 			warning ("Could not run Sparql query: %s", e.message);
 		}
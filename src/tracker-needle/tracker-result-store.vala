@@ -31,6 +31,8 @@ public class Tracker.ResultStore : Gtk.TreeModel, GLib.Object {
 		public Tracker.Query.Type type;
 		public QueryData *query;
 		public ResultNode [] results;
+		// continuation of the last row before each block of 100 rows
+		public string [] continuations;
 		public Gdk.Pixbuf pixbuf;
 		public int count;
 	}
@@ -97,6 +99,7 @@ public class Tracker.ResultStore : Gtk.TreeModel, GLib.Object {
 			query.tags = search_tags;
 			query.limit = limit;
 			query.offset = op.offset;
+			query.continuation = op.node.continuations[op.offset / 100];
 
 			cursor = yield query.perform_async (op.node.query.type, op.node.query.match, op.node.query.args, cancellable);
 
@@ -122,6 +125,11 @@ public class Tracker.ResultStore : Gtk.TreeModel, GLib.Object {
 						break;
 					}
 
+					if (i == op.offset + 99 && i / 100 + 1 < op.node.continuations.length) {
+						// lets the next block resume after this row
+						op.node.continuations[i / 100 + 1] = cursor.get_continuation ();
+					}
+
 					result = &op.node.results[i];
 
 					for (j = 0; j < n_columns; j++) {
@@ -245,6 +253,7 @@ public class Tracker.ResultStore : Gtk.TreeModel, GLib.Object {
 			cat.type = query_data.type;
 			cat.query = query_data;
 			cat.results.resize ((int) count);
+			cat.continuations = new string[count / 100 + 1];
 			categories.add (cat);
 
 			iter = TreeIter ();
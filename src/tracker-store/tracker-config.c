@@ -53,6 +53,7 @@ enum {
 	PROP_0,
 	PROP_VERBOSITY,
 	PROP_GRAPHUPDATED_DELAY,
+	PROP_AGGREGATE_VIEWS,
 };
 
 G_DEFINE_TYPE (TrackerConfig, tracker_config, G_TYPE_SETTINGS);
@@ -86,6 +87,14 @@ tracker_config_class_init (TrackerConfigClass *klass)
 	                                                    GRAPHUPDATED_DELAY_DEFAULT,
 	                                                    G_PARAM_READWRITE));
 
+	g_object_class_install_property (object_class,
+	                                 PROP_AGGREGATE_VIEWS,
+	                                 g_param_spec_boxed ("aggregate-views",
+	                                                     "Aggregate views",
+	                                                     "Instance counts kept per property value, as class/property",
+	                                                     G_TYPE_STRV,
+	                                                     G_PARAM_READWRITE));
+
 }
 
 static void
@@ -105,6 +114,11 @@ config_set_property (GObject      *object,
 		                                       g_value_get_int (value));
 		break;
 
+	case PROP_AGGREGATE_VIEWS:
+		tracker_config_set_aggregate_views (TRACKER_CONFIG (object),
+		                                    g_value_get_boxed (value));
+		break;
+
 	case PROP_VERBOSITY:
 		tracker_config_set_verbosity (TRACKER_CONFIG (object),
 		                              g_value_get_enum (value));
@@ -126,6 +140,10 @@ config_get_property (GObject    *object,
 		g_value_set_int (value, tracker_config_get_graphupdated_delay (TRACKER_CONFIG (object)));
 		break;
 
+	case PROP_AGGREGATE_VIEWS:
+		g_value_take_boxed (value, tracker_config_get_aggregate_views (TRACKER_CONFIG (object)));
+		break;
+
 		/* General */
 	case PROP_VERBOSITY:
 		g_value_set_enum (value, tracker_config_get_verbosity (TRACKER_CONFIG (object)));
@@ -179,6 +197,7 @@ config_constructed (GObject *object)
 	 */
 	g_settings_bind (settings, "verbosity", object, "verbosity", G_SETTINGS_BIND_GET | G_SETTINGS_BIND_GET_NO_CHANGES);
 	g_settings_bind (settings, "graphupdated-delay", object, "graphupdated-delay", G_SETTINGS_BIND_GET);
+	g_settings_bind (settings, "aggregate-views", object, "aggregate-views", G_SETTINGS_BIND_GET);
 }
 
 TrackerConfig *
@@ -259,3 +278,21 @@ tracker_config_set_graphupdated_delay (TrackerConfig *config,
 	g_settings_set_int(G_SETTINGS (config), "graphupdated-delay", value);
 	g_object_notify (G_OBJECT (config), "graphupdated-delay");
 }
+
+gchar **
+tracker_config_get_aggregate_views (TrackerConfig *config)
+{
+	g_return_val_if_fail (TRACKER_IS_CONFIG (config), NULL);
+
+	return g_settings_get_strv (G_SETTINGS (config), "aggregate-views");
+}
+
+void
+tracker_config_set_aggregate_views (TrackerConfig       *config,
+                                    const gchar * const *value)
+{
+	g_return_if_fail (TRACKER_IS_CONFIG (config));
+
+	g_settings_set_strv (G_SETTINGS (config), "aggregate-views", value);
+	g_object_notify (G_OBJECT (config), "aggregate-views");
+}
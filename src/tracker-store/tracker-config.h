@@ -56,6 +56,11 @@ gint           tracker_config_get_graphupdated_delay               (TrackerConfi
 void           tracker_config_set_graphupdated_delay               (TrackerConfig *config,
                                                                     gint           value);
 
+gchar        **tracker_config_get_aggregate_views                  (TrackerConfig *config);
+
+void           tracker_config_set_aggregate_views                  (TrackerConfig       *config,
+                                                                    const gchar * const *value);
+
 G_END_DECLS
 
 #endif /* __TRACKER_STORE_CONFIG_H__ */
@@ -60,6 +60,7 @@ License which can be viewed at:
 		message ("Store options:");
 		message ("  Readonly mode  ........................  %s", readonly_mode ? "yes" : "no");
 		message ("  GraphUpdated Delay ....................  %d", config.graphupdated_delay);
+		message ("  Aggregate views .......................  %s", string.joinv (", ", config.aggregate_views));
 	}
 
 	static void do_shutdown () {
@@ -108,6 +109,10 @@ License which can be viewed at:
 	static void initialize_signal_handler () {
 		Unix.signal_add (Posix.SIGTERM, () => signal_handler (Posix.SIGTERM));
 		Unix.signal_add (Posix.SIGINT, () => signal_handler (Posix.SIGINT));
+
+		/* Clients close the result pipe to cancel queries, the write
+		 * fails with EPIPE and the query is stopped */
+		Posix.signal (Posix.SIGPIPE, Posix.SIG_IGN);
 	}
 
 	static void initialize_priority () {
@@ -259,6 +264,8 @@ License which can be viewed at:
 
 		bool is_first_time_index;
 
+		Tracker.Data.aggregates_set_definitions (config.aggregate_views);
+
 		try {
 			Tracker.Data.Manager.init (flags,
 			                           null,
@@ -284,6 +291,17 @@ License which can be viewed at:
 			Tracker.Writeback.init (get_writeback_predicates);
 			Tracker.Store.resume ();
 
+			if (DBManager.fts_config_changed ()) {
+				Tracker.Store.queue_fts_rebuild.begin ((o, res) => {
+					try {
+						Tracker.Store.queue_fts_rebuild.end (res);
+						message ("Full-text index rebuilt");
+					} catch (Error e) {
+						warning ("Could not rebuild full-text index: %s", e.message);
+					}
+				});
+			}
+
 			message ("Waiting for D-Bus requests...");
 		}
 
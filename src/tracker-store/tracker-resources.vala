@@ -66,8 +66,10 @@ public class Tracker.Resources : Object {
 		var request = DBusRequest.begin (sender, "Resources.Load (uri: '%s')", uri);
 		try {
 			var file = File.new_for_uri (uri);
+			var notifier = (Status) (Tracker.DBus.get_object (typeof (Status)));
+			var busy_callback = notifier.get_callback ();
 
-			yield Tracker.Store.queue_turtle_import (file, sender);
+			yield Tracker.Store.queue_turtle_import (file, sender, busy_callback);
 
 			request.end ();
 		} catch (DBInterfaceError.NO_SPACE ie) {
@@ -105,6 +107,8 @@ public class Tracker.Resources : Object {
 
 					builder.close ();
 				}
+
+				return true;
 			}, sender);
 
 			var result = builder.end ();
@@ -24,57 +24,348 @@ public class Tracker.Steroids : Object {
 
 	public const int BUFFER_SIZE = 65536;
 
-	public async string[] query (BusName sender, string query, UnixOutputStream output_stream) throws Error {
-		var request = DBusRequest.begin (sender, "Steroids.Query");
-		request.debug ("query: %s", query);
-		try {
-			string[] variable_names = null;
+	/* Streamed results send their first rows early */
+	const int FIRST_BATCH_SIZE = 4096;
+
+	/* Result formats for QueryWithFormat. The legacy format is what Query
+	 * writes, one row after the other with every value as a string:
+	 *
+	 * row = [4 bytes number of columns, columns x 4 bytes value type,
+	 *        columns x 4 bytes offset, NUL-terminated strings]
+	 *
+	 * The binary format is only preceded by a header once per result and
+	 * keeps integers and doubles in their native representation. Rows are
+	 * padded to 8 bytes so that the client can read values in place:
+	 *
+	 * header = [4 bytes magic, 4 bytes format, 4 bytes number of columns,
+	 *           4 bytes padding]
+	 * batch  = [4 bytes number of rows, 4 bytes size of rows, rows]
+	 * row    = [4 bytes row size, columns x 1 byte value type, padding,
+	 *           columns x 8 bytes value, NUL-terminated strings, padding]
+	 *
+	 * Values are an int64 for integers, a double for doubles, nothing for
+	 * unbound values and [4 bytes string offset, 4 bytes string length]
+	 * otherwise. A batch without rows ends the result. Everything is in
+	 * host byte order, see Tracker.Bus.FDCursor for the reader.
+	 *
+	 * The stream format uses the same rows but puts the variable names
+	 * into the header, so clients can read rows before the reply with
+	 * the variable names arrives at the end of the query:
+	 *
+	 * header = [4 bytes magic, 4 bytes format, 4 bytes number of columns,
+	 *           4 bytes size of names, NUL-terminated names, padding]
+	 *
+	 * QueryContinue answers with the continuation format, the stream
+	 * format with one more string column at the end of every row that
+	 * is not counted in the header and holds the continuation of the
+	 * row, unbound if the query can not be continued.
+	 */
+	public const int RESULT_FORMAT_LEGACY = 1;
+	public const int RESULT_FORMAT_BINARY = 2;
+	public const int RESULT_FORMAT_STREAM = 3;
+	public const int RESULT_FORMAT_CONTINUATION = 4;
+	public const uint32 RESULT_MAGIC = 0x52545254;
+
+	/* Writes binary results without blocking on the client. Batches the
+	 * pipe does not take yet are kept until it does, once too much is
+	 * pending the query gets suspended instead of holding a query thread.
+	 */
+	class BinaryResultWriter {
+		const int BATCH_HEADER_SIZE = 8;
+
+		UnixOutputStream stream;
+		int n_columns;
+		// columns in rows, one more with continuations
+		int row_columns;
+		uint8[] buffer;
+		size_t length;
+		size_t batch_start;
+		size_t batch_size;
+		uint32 n_rows;
+
+		Queue<Bytes> pending;
+		size_t pending_offset;
+		size_t pending_size;
+		bool finished;
+
+		public BinaryResultWriter (UnixOutputStream stream, int format, string[] variable_names) {
+			this.stream = stream;
+			this.n_columns = variable_names.length;
+			row_columns = format == RESULT_FORMAT_CONTINUATION ? n_columns + 1 : n_columns;
+			buffer = new uint8[BUFFER_SIZE];
+			pending = new Queue<Bytes> ();
+
+			// the result header goes out together with the first batch
+			set_uint32 (0, RESULT_MAGIC);
+			set_uint32 (4, format);
+			set_uint32 (8, (uint32) n_columns);
+			set_uint32 (12, 0);
+			length = 16;
+			batch_size = BUFFER_SIZE;
+
+			if (format >= RESULT_FORMAT_STREAM) {
+				foreach (unowned string name in variable_names) {
+					reserve (name.length + 1);
+					Memory.copy (&buffer[length], name, name.length);
+					length += name.length;
+					buffer[length++] = 0;
+				}
 
-			yield Tracker.Store.sparql_query (query, Tracker.Store.Priority.HIGH, cursor => {
-				var data_output_stream = new DataOutputStream (new BufferedOutputStream.sized (output_stream, BUFFER_SIZE));
-				data_output_stream.set_byte_order (DataStreamByteOrder.HOST_ENDIAN);
+				pad ();
+				set_uint32 (12, (uint32) (length - 16));
+				batch_size = FIRST_BATCH_SIZE;
+			}
 
-				int n_columns = cursor.n_columns;
+			batch_start = length;
+			length = batch_start + BATCH_HEADER_SIZE;
+
+			int flags = Posix.fcntl (stream.fd, Posix.F_GETFL);
+			Posix.fcntl (stream.fd, Posix.F_SETFL, flags | Posix.O_NONBLOCK);
+		}
+
+		void reserve (size_t size) {
+			size_t new_size = buffer.length;
+
+			while (length + size > new_size) {
+				new_size *= 2;
+			}
+
+			if (new_size != buffer.length) {
+				buffer.resize ((int) new_size);
+			}
+		}
+
+		inline void set_uint32 (size_t offset, uint32 v) {
+			Memory.copy (&buffer[offset], &v, sizeof (uint32));
+		}
+
+		void pad () {
+			size_t padded = (length + 7) & ~((size_t) 7);
+
+			reserve (padded - length);
+			while (length < padded) {
+				buffer[length++] = 0;
+			}
+		}
+
+		void write_string (size_t strings_start, size_t value_offset, string? str, long str_length) {
+			if (str == null) {
+				str = "";
+				str_length = 0;
+			}
 
-				int[] column_sizes = new int[n_columns];
-				int[] column_offsets = new int[n_columns];
-				string[] column_data = new string[n_columns];
+			set_uint32 (value_offset, (uint32) (length - strings_start));
+			set_uint32 (value_offset + 4, (uint32) str_length);
 
-				variable_names = new string[n_columns];
-				for (int i = 0; i < n_columns; i++) {
-					variable_names[i] = cursor.get_variable_name (i);
+			reserve (str_length + 1);
+			Memory.copy (&buffer[length], str, str_length);
+			length += str_length;
+			buffer[length++] = 0;
+		}
+
+		void write_row (Sparql.Cursor cursor) {
+			size_t row_start = length;
+			size_t values_start = row_start + ((4 + row_columns + 7) & ~7);
+			size_t strings_start = values_start + 8 * row_columns;
+
+			reserve (strings_start - row_start);
+			Memory.set (&buffer[row_start], 0, strings_start - row_start);
+			length = strings_start;
+
+			for (int i = 0; i < n_columns; i++) {
+				Sparql.ValueType type = cursor.get_value_type (i);
+				size_t value_offset = values_start + 8 * i;
+
+				buffer[row_start + 4 + i] = (uint8) type;
+
+				switch (type) {
+				case Sparql.ValueType.UNBOUND:
+					break;
+				case Sparql.ValueType.INTEGER:
+					int64 integer = cursor.get_integer (i);
+					Memory.copy (&buffer[value_offset], &integer, sizeof (int64));
+					break;
+				case Sparql.ValueType.DOUBLE:
+					double number = cursor.get_double (i);
+					Memory.copy (&buffer[value_offset], &number, sizeof (double));
+					break;
+				default:
+					long str_length;
+					unowned string str = cursor.get_string (i, out str_length);
+					write_string (strings_start, value_offset, str, str_length);
+					break;
+				}
+			}
+
+			if (row_columns > n_columns) {
+				string? continuation = cursor.get_continuation ();
+
+				if (continuation != null) {
+					buffer[row_start + 4 + n_columns] = (uint8) Sparql.ValueType.STRING;
+					write_string (strings_start, values_start + 8 * n_columns, continuation, continuation.length);
 				}
+			}
 
-				while (cursor.next ()) {
-					int last_offset = -1;
+			pad ();
+			set_uint32 (row_start, (uint32) (length - row_start));
+			n_rows++;
+		}
 
-					for (int i = 0; i < n_columns ; i++) {
-						unowned string str = cursor.get_string (i);
+		void queue_batch () {
+			set_uint32 (batch_start, n_rows);
+			set_uint32 (batch_start + 4, (uint32) (length - batch_start - BATCH_HEADER_SIZE));
 
-						column_sizes[i] = str != null ? str.length : 0;
-						column_data[i]  = str;
+			buffer.resize ((int) length);
+			pending_size += length;
+			pending.push_tail (new Bytes.take ((owned) buffer));
 
-						last_offset += column_sizes[i] + 1;
-						column_offsets[i] = last_offset;
-					}
+			buffer = new uint8[BUFFER_SIZE];
+			batch_size = BUFFER_SIZE;
+			n_rows = 0;
+			batch_start = 0;
+			length = BATCH_HEADER_SIZE;
+		}
+
+		bool send_pending () throws Error {
+			while (pending.length > 0) {
+				unowned uint8[] data = pending.peek_head ().get_data ();
+				ssize_t written;
+
+				try {
+					written = stream.write (data[pending_offset:data.length]);
+				} catch (IOError.WOULD_BLOCK e) {
+					// pipe is full
+					return false;
+				}
+
+				pending_offset += (size_t) written;
+				pending_size -= (size_t) written;
+
+				if (pending_offset == data.length) {
+					pending.pop_head ();
+					pending_offset = 0;
+				}
+			}
+
+			return true;
+		}
+
+		/* Returns false when the client needs to read before writing
+		 * can go on, and true once the whole result has been written.
+		 */
+		public bool write (Sparql.Cursor cursor, size_t max_pending_size) throws Error {
+			send_pending ();
+
+			while (!finished) {
+				if (pending_size >= max_pending_size) {
+					return false;
+				}
 
-					data_output_stream.put_int32 (n_columns);
+				if (cursor.next ()) {
+					write_row (cursor);
 
-					for (int i = 0; i < n_columns ; i++) {
-						/* Cast from enum to int */
-						data_output_stream.put_int32 ((int) cursor.get_value_type (i));
+					if (length < batch_size) {
+						continue;
 					}
 
-					for (int i = 0; i < n_columns ; i++) {
-						data_output_stream.put_int32 (column_offsets[i]);
+					queue_batch ();
+				} else {
+					if (n_rows > 0) {
+						queue_batch ();
 					}
 
-					for (int i = 0; i < n_columns ; i++) {
-						data_output_stream.put_string (column_data[i] != null ? column_data[i] : "");
-						data_output_stream.put_byte (0);
+					/* empty batch marks the end of the result */
+					queue_batch ();
+					finished = true;
+				}
+
+				send_pending ();
+			}
+
+			if (!send_pending ()) {
+				return false;
+			}
+
+			stream.close ();
+
+			return true;
+		}
+	}
+
+	static void write_legacy_result (Sparql.Cursor cursor, OutputStream output_stream) throws Error {
+		var data_output_stream = new DataOutputStream (new BufferedOutputStream.sized (output_stream, BUFFER_SIZE));
+		data_output_stream.set_byte_order (DataStreamByteOrder.HOST_ENDIAN);
+
+		int n_columns = cursor.n_columns;
+
+		int[] column_sizes = new int[n_columns];
+		int[] column_offsets = new int[n_columns];
+		string[] column_data = new string[n_columns];
+
+		while (cursor.next ()) {
+			int last_offset = -1;
+
+			for (int i = 0; i < n_columns ; i++) {
+				unowned string str = cursor.get_string (i);
+
+				column_sizes[i] = str != null ? str.length : 0;
+				column_data[i]  = str;
+
+				last_offset += column_sizes[i] + 1;
+				column_offsets[i] = last_offset;
+			}
+
+			data_output_stream.put_int32 (n_columns);
+
+			for (int i = 0; i < n_columns ; i++) {
+				/* Cast from enum to int */
+				data_output_stream.put_int32 ((int) cursor.get_value_type (i));
+			}
+
+			for (int i = 0; i < n_columns ; i++) {
+				data_output_stream.put_int32 (column_offsets[i]);
+			}
+
+			for (int i = 0; i < n_columns ; i++) {
+				data_output_stream.put_string (column_data[i] != null ? column_data[i] : "");
+				data_output_stream.put_byte (0);
+			}
+		}
+	}
+
+	async string[] query_internal (BusName sender, string method, string query, string? continuation, int format, UnixOutputStream output_stream) throws Error {
+		var request = DBusRequest.begin (sender, method);
+		request.debug ("query: %s", query);
+		if (continuation != null) {
+			request.debug ("continuation: %s", continuation);
+		}
+		try {
+			string[] variable_names = null;
+			BinaryResultWriter writer = null;
+
+			yield Tracker.Store.sparql_query (query, Tracker.Store.Priority.HIGH, cursor => {
+				int n_columns = cursor.n_columns;
+
+				if (variable_names == null) {
+					variable_names = new string[n_columns];
+					for (int i = 0; i < n_columns; i++) {
+						variable_names[i] = cursor.get_variable_name (i);
 					}
 				}
-			}, sender);
+
+				if (format < RESULT_FORMAT_BINARY) {
+					write_legacy_result (cursor, output_stream);
+					return true;
+				}
+
+				// called again with the same cursor after a suspension
+				if (writer == null) {
+					writer = new BinaryResultWriter (output_stream, format, variable_names);
+				}
+
+				return writer.write (cursor, Tracker.Store.get_max_cursor_buffer_size ());
+			}, sender, format >= RESULT_FORMAT_BINARY ? output_stream : null,
+			format == RESULT_FORMAT_CONTINUATION, continuation);
 
 			request.end ();
 
@@ -89,6 +380,22 @@ public class Tracker.Steroids : Object {
 		}
 	}
 
+	public async string[] query (BusName sender, string query, UnixOutputStream output_stream) throws Error {
+		return yield query_internal (sender, "Steroids.Query", query, null, RESULT_FORMAT_LEGACY, output_stream);
+	}
+
+	/* Formats newer than the ones known here are answered with the newest
+	 * known format, the header tells the client what it got */
+	public async string[] query_with_format (BusName sender, string query, int format, UnixOutputStream output_stream) throws Error {
+		return yield query_internal (sender, "Steroids.QueryWithFormat", query, null, int.min (format, RESULT_FORMAT_STREAM), output_stream);
+	}
+
+	/* Pass an empty continuation for the first rows of the query, and
+	 * the continuation of a row to get the rows after it */
+	public async string[] query_continue (BusName sender, string query, string continuation, UnixOutputStream output_stream) throws Error {
+		return yield query_internal (sender, "Steroids.QueryContinue", query, continuation != "" ? continuation : null, RESULT_FORMAT_CONTINUATION, output_stream);
+	}
+
 	async Variant? update_internal (BusName sender, Tracker.Store.Priority priority, bool blank, UnixInputStream input_stream) throws Error {
 		var request = DBusRequest.begin (sender,
 			"Steroids.%sUpdate%s",
@@ -20,22 +20,124 @@
  */
 
 public class Tracker.Store {
-	const int MAX_CONCURRENT_QUERIES = 2;
+	const int DEFAULT_MAX_CONCURRENT_QUERIES = 2;
+
+	/* Every query thread opens its own SQLite connection with its own
+	 * page and statement caches, so keep the number of concurrent WAL
+	 * readers bounded no matter how many cores there are.
+	 */
+	const int MAX_CONCURRENT_QUERIES_LIMIT = 16;
+
+	const int MAX_QUEUED_QUERIES = 1000;
+
+	/* Number of high priority queries that may be scheduled in a row
+	 * while lower priority queries are waiting.
+	 */
+	const int MAX_PRIORITY_BURST = 4;
+
+	/* Maximum number of queued updates merged into a single
+	 * transaction by the update thread.
+	 */
+	const int MAX_UPDATE_GROUP_SIZE = 32;
 
 	const int MAX_TASK_TIME = 30;
 
+	/* Seconds a suspended query may wait for its client to read
+	 * results before it is aborted.
+	 */
+	const int MAX_CURSOR_IDLE_TIME = 60;
+
+	/* Bytes of results a streaming query may buffer for a slow client
+	 * before its cursor gets suspended.
+	 */
+	const int MAX_CURSOR_BUFFER_SIZE = 1024 * 1024;
+
+	/* WAL size in pages from which it is checkpointed when the store is
+	 * idle, in the background while updates go on, and blocking updates
+	 * as a last resort.
+	 */
+	const int WAL_IDLE_CHECKPOINT_PAGES = 100;
+	const int WAL_ASYNC_CHECKPOINT_PAGES = 1000;
+	const int WAL_SYNC_CHECKPOINT_PAGES = 10000;
+
+	/* Milliseconds without updates before the idle checkpoint runs */
+	const int WAL_IDLE_CHECKPOINT_DELAY = 1000;
+
+	/* Pages of full-text index segments merged per step while the store
+	 * is idle, and milliseconds without updates before merging starts.
+	 */
+	const int FTS_MERGE_PAGES = 256;
+	const int FTS_MERGE_IDLE_DELAY = 5000;
+
+	/* Turtle files from this size on are imported in bulk load mode */
+	const int64 BULK_LOAD_MIN_SIZE = 64 * 1024 * 1024;
+
 	static Queue<Task> query_queues[3 /* TRACKER_STORE_N_PRIORITIES */];
 	static Queue<Task> update_queues[3 /* TRACKER_STORE_N_PRIORITIES */];
+	static int max_concurrent_queries;
+	static int max_client_queries;
+	static int max_queued_queries;
+	static int priority_burst;
+	static int max_update_group_size;
 	static int n_queries_running;
 	static bool update_running;
 	static ThreadPool<Task> update_pool;
 	static ThreadPool<Task> query_pool;
-	static ThreadPool<bool> checkpoint_pool;
+	static ThreadPool<CheckpointTask> checkpoint_pool;
 	static GenericArray<Task> running_tasks;
+	static GenericArray<QueryTask> suspended_tasks;
 	static int max_task_time;
+	static int max_cursor_idle_time;
+	static int max_cursor_buffer_size;
+	static int64 bulk_load_min_size;
+	static int fts_merge_pages;
 	static bool active;
 	static SourceFunc active_callback;
 
+	/* Query scheduler statistics, only accessed from the main thread,
+	 * times are in microseconds.
+	 */
+	static uint64 n_queries_done;
+	static uint64 n_queries_rejected;
+	static int64 query_wait_time;
+	static int64 query_wait_time_max;
+	static int64 query_exec_time;
+	static int64 query_exec_time_max;
+	static uint64 n_update_groups;
+	static uint64 n_updates_grouped;
+	static uint64 n_update_groups_failed;
+	static uint64 n_queries_suspended;
+	static uint64 n_queries_timed_out;
+	static uint64 n_suspended_queries_dropped;
+
+	/* Checkpoint scheduler state and statistics, only accessed from
+	 * the main thread unless noted otherwise.
+	 */
+	static int wal_pages; /* atomic, set from the update thread */
+	static int wal_pages_last;
+	static int64 wal_pages_time;
+	static double wal_growth_rate; /* pages per second */
+	static uint idle_checkpoint_id;
+	static int n_incomplete_checkpoints;
+	static uint64 n_checkpoints;
+	static uint64 n_checkpoints_blocking;
+	static int64 checkpoint_time;
+	static int64 checkpoint_time_max;
+	static int64 checkpoint_time_last;
+	static int64 update_stall_time;
+	static int64 update_stall_time_max;
+
+	/* Idle full-text index merging, only accessed from the main thread */
+	static uint idle_fts_merge_id;
+	static bool fts_merge_needed;
+	static uint64 n_fts_merges;
+	static int64 fts_merge_time;
+	static int64 fts_rebuild_time;
+
+	/* Only accessed from the update thread */
+	static int64 pending_stall_time;
+	static int n_pending_stalls;
+
 	public enum Priority {
 		HIGH,
 		LOW,
@@ -43,32 +145,81 @@ public class Tracker.Store {
 		N_PRIORITIES
 	}
 
+	enum CheckpointMode {
+		PASSIVE,
+		FULL,
+		RESTART
+	}
+
+	const string[] checkpoint_modes = { "PASSIVE", "FULL", "RESTART" };
+
 	enum TaskType {
 		QUERY,
 		UPDATE,
 		UPDATE_BLANK,
+		UPDATE_GROUP,
 		TURTLE,
+		FTS_MERGE,
+		FTS_REBUILD,
 	}
 
-	public delegate void SparqlQueryInThread (DBCursor cursor) throws Error;
+	/* Returns false to suspend the query until the output stream passed
+	 * to sparql_query() becomes writable, it is called again with the
+	 * same cursor then.
+	 */
+	public delegate bool SparqlQueryInThread (DBCursor cursor) throws Error;
 
 	abstract class Task {
 		public TaskType type;
 		public string client_id;
 		public Error error;
 		public SourceFunc callback;
+		public int64 queued_time;
+		public int64 start_time;
+
+		/* Blocking checkpoints done while running an update */
+		public int64 checkpoint_stall;
+		public int n_checkpoint_stalls;
+	}
+
+	class CheckpointTask {
+		public CheckpointMode mode;
+		public bool idle;
+		public bool complete;
+		public int64 duration;
 	}
 
 	class QueryTask : Task {
 		public string query;
+		public Priority priority;
 		public Cancellable cancellable;
 		public uint watchdog_id;
 		public unowned SparqlQueryInThread in_thread;
+		public UnixOutputStream output_stream;
+		// the cursor provides continuations, resume after this one
+		public bool continuable;
+		public string? continuation;
+
+		/* Kept while the query is suspended, the connection is
+		 * detached from the query thread so that the cursor can be
+		 * resumed in any other thread.
+		 */
+		public DBCursor cursor;
+		public DBInterface iface;
+		public bool suspended;
+		public uint resume_id;
+		public uint idle_timeout_id;
 
 		~QueryTask () {
 			if (watchdog_id > 0) {
 				Source.remove (watchdog_id);
 			}
+			if (resume_id > 0) {
+				Source.remove (resume_id);
+			}
+			if (idle_timeout_id > 0) {
+				Source.remove (idle_timeout_id);
+			}
 		}
 	}
 
@@ -78,8 +229,86 @@ public class Tracker.Store {
 		public Priority priority;
 	}
 
+	class UpdateGroupTask : Task {
+		public GenericArray<UpdateTask> tasks;
+		public Priority priority;
+		public bool split;
+	}
+
 	class TurtleTask : Task {
 		public string path;
+		public unowned BusyCallback busy_callback;
+	}
+
+	class FtsMergeTask : Task {
+		public bool more;
+		public int64 duration;
+	}
+
+	class FtsRebuildTask : Task {
+		public int64 duration;
+	}
+
+	static int get_client_running_queries (string client_id) {
+		int n = 0;
+
+		for (int i = 0; i < running_tasks.length; i++) {
+			if (running_tasks[i].client_id == client_id) {
+				n++;
+			}
+		}
+
+		return n;
+	}
+
+	static Task? pop_query_task () {
+		Task? task;
+
+		task = pop_query_task_limited (true);
+
+		if (task == null) {
+			/* only clients that got their share are waiting,
+			 * don't leave query threads idle */
+			task = pop_query_task_limited (false);
+		}
+
+		return task;
+	}
+
+	static Task? pop_query_task_limited (bool limit_clients) {
+		int first = Priority.HIGH;
+
+		if (priority_burst >= MAX_PRIORITY_BURST) {
+			/* give lower priority queries a chance */
+			first = Priority.LOW;
+		}
+
+		for (int n = 0; n < Priority.N_PRIORITIES; n++) {
+			int i = (first + n) % Priority.N_PRIORITIES;
+			unowned Queue<Task> queue = query_queues[i];
+
+			for (uint j = 0; j < queue.length; j++) {
+				unowned Task task = queue.peek_nth (j);
+
+				if (limit_clients &&
+				    get_client_running_queries (task.client_id) >= max_client_queries) {
+					/* client already got its share of query threads */
+					continue;
+				}
+
+				if (i == Priority.HIGH) {
+					if (priority_burst < MAX_PRIORITY_BURST) {
+						priority_burst++;
+					}
+				} else {
+					priority_burst = 0;
+				}
+
+				return queue.pop_nth (j);
+			}
+		}
+
+		return null;
 	}
 
 	static void sched () {
@@ -89,20 +318,16 @@ public class Tracker.Store {
 			return;
 		}
 
-		while (n_queries_running < MAX_CONCURRENT_QUERIES) {
-			for (int i = 0; i < Priority.N_PRIORITIES; i++) {
-				task = query_queues[i].pop_head ();
-				if (task != null) {
-					break;
-				}
-			}
+		while (n_queries_running < max_concurrent_queries) {
+			task = pop_query_task ();
 			if (task == null) {
-				/* no pending query */
+				/* no pending query that can be scheduled */
 				break;
 			}
+			task.start_time = get_monotonic_time ();
 			running_tasks.add (task);
 
-			if (max_task_time != 0) {
+			if (max_task_time != 0 && ((QueryTask) task).watchdog_id == 0) {
 				var query_task = (QueryTask) task;
 				query_task.watchdog_id = Timeout.add_seconds (max_task_time, () => {
 					query_task.cancellable.cancel ();
@@ -126,6 +351,10 @@ public class Tracker.Store {
 					break;
 				}
 			}
+			if (task != null && max_update_group_size > 1 &&
+			    (task.type == TaskType.UPDATE || task.type == TaskType.UPDATE_BLANK)) {
+				task = group_update_tasks ((UpdateTask) task);
+			}
 			if (task != null) {
 				update_running = true;
 				try {
@@ -137,17 +366,55 @@ public class Tracker.Store {
 		}
 	}
 
+	static Task group_update_tasks (UpdateTask first) {
+		unowned Queue<Task> queue = update_queues[first.priority];
+		UpdateGroupTask group_task = null;
+
+		while (queue.length > 0) {
+			unowned Task next = queue.peek_head ();
+
+			if (next.type != TaskType.UPDATE && next.type != TaskType.UPDATE_BLANK) {
+				break;
+			}
+
+			if (group_task == null) {
+				group_task = new UpdateGroupTask ();
+				group_task.type = TaskType.UPDATE_GROUP;
+				group_task.priority = first.priority;
+				group_task.tasks = new GenericArray<UpdateTask> ();
+				group_task.tasks.add (first);
+			} else if (group_task.tasks.length >= max_update_group_size) {
+				break;
+			}
+
+			group_task.tasks.add ((UpdateTask) queue.pop_head ());
+		}
+
+		if (group_task == null) {
+			/* nothing to merge with */
+			return first;
+		}
+
+		return group_task;
+	}
+
+	static Tracker.Data.CommitType update_commit_type (Priority priority) {
+		if (priority == Priority.HIGH) {
+			return Tracker.Data.CommitType.REGULAR;
+		} else if (update_queues[Priority.LOW].get_length () > 0) {
+			return Tracker.Data.CommitType.BATCH;
+		} else {
+			return Tracker.Data.CommitType.BATCH_LAST;
+		}
+	}
+
 	static Tracker.Data.CommitType commit_type (Task task) {
 		switch (task.type) {
 			case TaskType.UPDATE:
 			case TaskType.UPDATE_BLANK:
-				if (((UpdateTask) task).priority == Priority.HIGH) {
-					return Tracker.Data.CommitType.REGULAR;
-				} else if (update_queues[Priority.LOW].get_length () > 0) {
-					return Tracker.Data.CommitType.BATCH;
-				} else {
-					return Tracker.Data.CommitType.BATCH_LAST;
-				}
+				return update_commit_type (((UpdateTask) task).priority);
+			case TaskType.UPDATE_GROUP:
+				return update_commit_type (((UpdateGroupTask) task).priority);
 			case TaskType.TURTLE:
 				if (update_queues[Priority.TURTLE].get_length () > 0) {
 					return Tracker.Data.CommitType.BATCH;
@@ -161,7 +428,9 @@ public class Tracker.Store {
 	}
 
 	static bool task_finish_cb (Task task) {
-		if (task.type == TaskType.QUERY) {
+		if (task.type == TaskType.QUERY && ((QueryTask) task).suspended) {
+			suspend_query ((QueryTask) task);
+		} else if (task.type == TaskType.QUERY) {
 			var query_task = (QueryTask) task;
 
 			if (task.error == null) {
@@ -175,6 +444,8 @@ public class Tracker.Store {
 			task.callback ();
 			task.error = null;
 
+			account_query (task);
+
 			running_tasks.remove (task);
 			n_queries_running--;
 		} else if (task.type == TaskType.UPDATE || task.type == TaskType.UPDATE_BLANK) {
@@ -185,6 +456,35 @@ public class Tracker.Store {
 			task.callback ();
 			task.error = null;
 
+			update_running = false;
+		} else if (task.type == TaskType.UPDATE_GROUP) {
+			var group_task = (UpdateGroupTask) task;
+			bool notify = false;
+
+			n_update_groups++;
+			n_updates_grouped += (uint64) group_task.tasks.length;
+			if (group_task.split) {
+				n_update_groups_failed++;
+			}
+
+			for (int i = 0; i < group_task.tasks.length; i++) {
+				if (group_task.tasks[i].error == null) {
+					notify = true;
+					break;
+				}
+			}
+
+			if (notify) {
+				Tracker.Data.notify_transaction (commit_type (task));
+			}
+
+			for (int i = 0; i < group_task.tasks.length; i++) {
+				unowned UpdateTask update_task = group_task.tasks[i];
+
+				update_task.callback ();
+				update_task.error = null;
+			}
+
 			update_running = false;
 		} else if (task.type == TaskType.TURTLE) {
 			if (task.error == null) {
@@ -195,6 +495,37 @@ public class Tracker.Store {
 			task.error = null;
 
 			update_running = false;
+		} else if (task.type == TaskType.FTS_MERGE) {
+			var merge_task = (FtsMergeTask) task;
+
+			n_fts_merges++;
+			fts_merge_time += merge_task.duration;
+
+			if (task.error != null) {
+				warning ("Could not merge full-text index: %s", task.error.message);
+			}
+
+			fts_merge_needed = task.error == null && merge_task.more;
+			update_running = false;
+		} else if (task.type == TaskType.FTS_REBUILD) {
+			fts_rebuild_time += ((FtsRebuildTask) task).duration;
+
+			task.callback ();
+			task.error = null;
+
+			update_running = false;
+		}
+
+		if (task.type != TaskType.QUERY) {
+			sched_checkpoint (task);
+		}
+
+		if (task.type == TaskType.FTS_MERGE) {
+			// go on right away unless updates came in meanwhile
+			sched_fts_merge (0);
+		} else if (task.type != TaskType.QUERY) {
+			fts_merge_needed = true;
+			sched_fts_merge (FTS_MERGE_IDLE_DELAY);
 		}
 
 		if (n_queries_running == 0 && !update_running && active_callback != null) {
@@ -206,14 +537,188 @@ public class Tracker.Store {
 		return false;
 	}
 
+	static void suspend_query (QueryTask task) {
+		/* give the query thread to someone else until the client
+		 * has read enough of the results */
+		running_tasks.remove (task);
+		n_queries_running--;
+		n_queries_suspended++;
+
+		if (task.watchdog_id > 0) {
+			Source.remove (task.watchdog_id);
+			task.watchdog_id = 0;
+		}
+
+		suspended_tasks.add (task);
+
+		if (!active) {
+			/* pause() is waiting for running queries, it must
+			 * not leave a read transaction open behind */
+			abort_suspended_query (task, new Sparql.Error.INTERNAL ("Store is being paused"));
+			return;
+		}
+
+		/* every suspended query keeps its own connection open,
+		 * park no more of them than there are query threads */
+		if (suspended_tasks.length > max_concurrent_queries) {
+			QueryTask oldest = suspended_tasks[0];
+			n_suspended_queries_dropped++;
+			abort_suspended_query (oldest, new DBusError.LIMITS_EXCEEDED ("Too many suspended queries, client did not read query results in time"));
+		}
+
+		var channel = new IOChannel.unix_new (task.output_stream.fd);
+		task.resume_id = channel.add_watch (IOCondition.OUT | IOCondition.ERR | IOCondition.HUP, (source, condition) => {
+			task.resume_id = 0;
+			resume_query (task);
+			return false;
+		});
+
+		if (max_cursor_idle_time > 0) {
+			task.idle_timeout_id = Timeout.add_seconds (max_cursor_idle_time, () => {
+				task.idle_timeout_id = 0;
+				n_queries_timed_out++;
+				abort_suspended_query (task, new IOError.TIMED_OUT ("Client did not read query results in time"));
+				return false;
+			});
+		}
+	}
+
+	static void resume_query (QueryTask task) {
+		if (task.idle_timeout_id > 0) {
+			Source.remove (task.idle_timeout_id);
+			task.idle_timeout_id = 0;
+		}
+
+		suspended_tasks.remove (task);
+		task.suspended = false;
+
+		/* it was running before, don't make it wait behind new queries */
+		query_queues[task.priority].push_head (task);
+
+		sched ();
+	}
+
+	static void abort_suspended_query (QueryTask task, Error error) {
+		if (task.resume_id > 0) {
+			Source.remove (task.resume_id);
+			task.resume_id = 0;
+		}
+
+		if (task.idle_timeout_id > 0) {
+			Source.remove (task.idle_timeout_id);
+			task.idle_timeout_id = 0;
+		}
+
+		/* nobody else uses the detached connection, the cursor can
+		 * be dropped in this thread */
+		task.cursor = null;
+		task.iface = null;
+		task.suspended = false;
+
+		suspended_tasks.remove (task);
+
+		task.error = error;
+		task.callback ();
+		task.error = null;
+
+		account_query (task);
+	}
+
+	static void account_query (Task task) {
+		int64 wait_time = task.start_time - task.queued_time;
+		int64 exec_time = get_monotonic_time () - task.start_time;
+
+		n_queries_done++;
+		query_wait_time += wait_time;
+		query_exec_time += exec_time;
+
+		if (wait_time > query_wait_time_max) {
+			query_wait_time_max = wait_time;
+		}
+
+		if (exec_time > query_exec_time_max) {
+			query_exec_time_max = exec_time;
+		}
+	}
+
+	static void update_group_in_thread (UpdateGroupTask group_task) {
+		bool failed = false;
+
+		try {
+			Tracker.Data.begin_transaction ();
+		} catch (Error e) {
+			for (int i = 0; i < group_task.tasks.length; i++) {
+				group_task.tasks[i].error = e;
+			}
+			return;
+		}
+
+		try {
+			for (int i = 0; i < group_task.tasks.length; i++) {
+				unowned UpdateTask update_task = group_task.tasks[i];
+
+				var query = new Sparql.Query.update (update_task.query);
+				update_task.blank_nodes = query.execute_update (update_task.type == TaskType.UPDATE_BLANK);
+			}
+		} catch (Error e) {
+			Tracker.Data.rollback_transaction ();
+			failed = true;
+		}
+
+		if (!failed) {
+			try {
+				Tracker.Data.commit_transaction ();
+			} catch (Error e) {
+				/* the transaction is gone either way, no point in retrying */
+				for (int i = 0; i < group_task.tasks.length; i++) {
+					group_task.tasks[i].error = e;
+				}
+			}
+			return;
+		}
+
+		/* One of the updates failed, so the whole group was rolled
+		 * back. Run them again in their own transactions so the
+		 * error is reported to the right client only.
+		 */
+		group_task.split = true;
+
+		for (int i = 0; i < group_task.tasks.length; i++) {
+			unowned UpdateTask update_task = group_task.tasks[i];
+
+			update_task.blank_nodes = null;
+
+			try {
+				if (update_task.type == TaskType.UPDATE_BLANK) {
+					update_task.blank_nodes = Tracker.Data.update_sparql_blank (update_task.query);
+				} else {
+					Tracker.Data.update_sparql (update_task.query);
+				}
+			} catch (Error e) {
+				update_task.error = e;
+			}
+		}
+	}
+
 	static void pool_dispatch_cb (owned Task task) {
 		try {
 			if (task.type == TaskType.QUERY) {
 				var query_task = (QueryTask) task;
 
-				var cursor = Tracker.Data.query_sparql_cursor (query_task.query);
+				if (query_task.cursor == null) {
+					if (query_task.continuable) {
+						query_task.cursor = Tracker.Data.query_sparql_cursor_continue (query_task.query, query_task.continuation);
+					} else {
+						query_task.cursor = Tracker.Data.query_sparql_cursor (query_task.query);
+					}
+				}
 
-				query_task.in_thread (cursor);
+				if (!query_task.in_thread (query_task.cursor)) {
+					if (query_task.iface == null) {
+						query_task.iface = DBManager.detach_db_interface ();
+					}
+					query_task.suspended = true;
+				}
 			} else {
 				var iface = DBManager.get_db_interface ();
 				iface.sqlite_wal_hook (wal_hook);
@@ -226,40 +731,108 @@ public class Tracker.Store {
 					var update_task = (UpdateTask) task;
 
 					update_task.blank_nodes = Tracker.Data.update_sparql_blank (update_task.query);
+				} else if (task.type == TaskType.UPDATE_GROUP) {
+					update_group_in_thread ((UpdateGroupTask) task);
 				} else if (task.type == TaskType.TURTLE) {
 					var turtle_task = (TurtleTask) task;
 
 					var file = File.new_for_path (turtle_task.path);
+					var info = file.query_info (FileAttribute.STANDARD_SIZE, FileQueryInfoFlags.NONE);
 
 					Tracker.Events.freeze ();
 					try {
-						Tracker.Data.load_turtle_file (file);
+						if (bulk_load_min_size > 0 && info.get_size () >= bulk_load_min_size) {
+							Tracker.Data.load_turtle_file_bulk (file, (status, progress) => {
+								turtle_progress (turtle_task, status, progress);
+							}, "Importing");
+						} else {
+							Tracker.Data.load_turtle_file (file);
+						}
 					} finally {
 						Tracker.Events.reset_pending ();
 					}
+				} else if (task.type == TaskType.FTS_MERGE) {
+					var merge_task = (FtsMergeTask) task;
+
+					int64 start = get_monotonic_time ();
+					merge_task.more = Tracker.Data.fts_merge (fts_merge_pages);
+					merge_task.duration = get_monotonic_time () - start;
+				} else if (task.type == TaskType.FTS_REBUILD) {
+					var rebuild_task = (FtsRebuildTask) task;
+
+					int64 start = get_monotonic_time ();
+					Tracker.Data.Manager.rebuild_fts ();
+					rebuild_task.duration = get_monotonic_time () - start;
 				}
 			}
 		} catch (Error e) {
 			task.error = e;
 		}
 
+		if (task.type != TaskType.QUERY) {
+			task.checkpoint_stall = pending_stall_time;
+			task.n_checkpoint_stalls = n_pending_stalls;
+			pending_stall_time = 0;
+			n_pending_stalls = 0;
+		}
+
+		if (task.type == TaskType.QUERY && !((QueryTask) task).suspended) {
+			var query_task = (QueryTask) task;
+
+			// the cursor goes first, it still uses the connection
+			query_task.cursor = null;
+			query_task.iface = null;
+		}
+
 		Idle.add (() => {
 			task_finish_cb (task);
 			return false;
 		});
 	}
 
-	public static void wal_checkpoint () {
+	static void turtle_progress (TurtleTask task, string status, double progress) {
+		// run in update thread, the notifier belongs to the main loop
+
+		if (task.busy_callback == null) {
+			return;
+		}
+
+		string status_copy = status;
+
+		Idle.add (() => {
+			task.busy_callback (status_copy, progress);
+			return false;
+		});
+	}
+
+	/* Returns whether all of the WAL made it into the database, it does
+	 * not while readers still use older snapshots.
+	 */
+	static bool run_checkpoint (CheckpointMode mode) {
 		try {
-			debug ("Checkpointing database...");
+			debug ("Checkpointing database (%s)...", checkpoint_modes[mode]);
 			var iface = DBManager.get_db_interface ();
-			iface.execute_query ("PRAGMA wal_checkpoint");
+			var stmt = iface.create_statement (DBStatementCacheType.NONE, "PRAGMA wal_checkpoint(%s)", checkpoint_modes[mode]);
+			var cursor = stmt.start_cursor ();
+			bool complete = true;
+
+			// busy, frames in WAL, frames checkpointed
+			if (cursor.next ()) {
+				complete = cursor.get_integer (0) == 0 && cursor.get_integer (1) <= cursor.get_integer (2);
+			}
+
 			debug ("Checkpointing complete...");
+			return complete;
 		} catch (Error e) {
 			warning (e.message);
+			return false;
 		}
 	}
 
+	public static void wal_checkpoint () {
+		run_checkpoint (CheckpointMode.PASSIVE);
+	}
+
 	static int checkpointing;
 
 	static void wal_hook (int n_pages) {
@@ -267,28 +840,179 @@ public class Tracker.Store {
 
 		debug ("WAL: %d pages", n_pages);
 
-		if (n_pages >= 10000) {
+		AtomicInt.set (ref wal_pages, n_pages);
+
+		/* background checkpoints are scheduled from the main loop,
+		 * only get in the way of updates if those did not keep up */
+		if (n_pages >= WAL_SYNC_CHECKPOINT_PAGES &&
+		    AtomicInt.compare_and_exchange (ref checkpointing, 0, 1)) {
 			// do immediate checkpointing (blocking updates)
 			// to prevent excessive wal file growth
-			wal_checkpoint ();
-		} else if (n_pages >= 1000) {
-			if (AtomicInt.compare_and_exchange (ref checkpointing, 0, 1)) {
-				// initiate asynchronous checkpointing (not blocking updates)
-				try {
-					checkpoint_pool.push (true);
-				} catch (Error e) {
-					warning (e.message);
-					AtomicInt.set (ref checkpointing, 0);
-				}
-			}
+			int64 start = get_monotonic_time ();
+			run_checkpoint (CheckpointMode.PASSIVE);
+			pending_stall_time += get_monotonic_time () - start;
+			n_pending_stalls++;
+			AtomicInt.set (ref checkpointing, 0);
 		}
 	}
 
-	static void checkpoint_dispatch_cb (bool task) {
+	static void checkpoint_dispatch_cb (owned CheckpointTask task) {
 		// run in checkpoint thread
 
-		wal_checkpoint ();
+		/* idle checkpoints give way to any other I/O, the others must
+		 * finish before updates run into the blocking limit */
+		Tracker.ioprio_set_thread_idle (task.idle);
+
+		int64 start = get_monotonic_time ();
+		task.complete = run_checkpoint (task.mode);
+		task.duration = get_monotonic_time () - start;
+
 		AtomicInt.set (ref checkpointing, 0);
+
+		Idle.add (() => {
+			checkpoint_finish_cb (task);
+			return false;
+		});
+	}
+
+	static void checkpoint_finish_cb (CheckpointTask task) {
+		n_checkpoints++;
+		checkpoint_time += task.duration;
+		checkpoint_time_max = int64.max (checkpoint_time_max, task.duration);
+		checkpoint_time_last = task.duration;
+
+		if (task.complete) {
+			n_incomplete_checkpoints = 0;
+		} else {
+			n_incomplete_checkpoints++;
+		}
+	}
+
+	static void push_checkpoint (bool idle) {
+		if (!AtomicInt.compare_and_exchange (ref checkpointing, 0, 1)) {
+			return;
+		}
+
+		var task = new CheckpointTask ();
+		task.idle = idle;
+		task.mode = CheckpointMode.PASSIVE;
+
+		/* Passive checkpoints can't get past frames that readers still
+		 * use, the stronger modes wait for readers and block updates
+		 * meanwhile, so only use them while no query runs.
+		 */
+		if (n_queries_running == 0 && suspended_tasks.length == 0) {
+			if (idle) {
+				// let the next update start over with an empty WAL
+				task.mode = CheckpointMode.RESTART;
+			} else if (n_incomplete_checkpoints >= 2) {
+				task.mode = CheckpointMode.FULL;
+			}
+		}
+
+		try {
+			checkpoint_pool.add (task);
+		} catch (Error e) {
+			warning (e.message);
+			AtomicInt.set (ref checkpointing, 0);
+		}
+	}
+
+	static void sched_checkpoint (Task task) {
+		int n_pages = AtomicInt.get (ref wal_pages);
+		int64 now = get_monotonic_time ();
+
+		if (task.n_checkpoint_stalls > 0) {
+			n_checkpoints_blocking += task.n_checkpoint_stalls;
+			update_stall_time += task.checkpoint_stall;
+			update_stall_time_max = int64.max (update_stall_time_max, task.checkpoint_stall);
+		}
+
+		if (wal_pages_time > 0 && now > wal_pages_time) {
+			// the WAL starts over after a complete checkpoint
+			int growth = n_pages >= wal_pages_last ? n_pages - wal_pages_last : n_pages;
+			double rate = growth * 1000000.0 / (now - wal_pages_time);
+
+			wal_growth_rate = 0.75 * wal_growth_rate + 0.25 * rate;
+		}
+
+		wal_pages_last = n_pages;
+		wal_pages_time = now;
+
+		if (idle_checkpoint_id != 0) {
+			// the store is not idle yet
+			Source.remove (idle_checkpoint_id);
+			idle_checkpoint_id = 0;
+		}
+
+		if (n_pages < WAL_IDLE_CHECKPOINT_PAGES) {
+			return;
+		}
+
+		/* Start early enough for the checkpoint to finish before the
+		 * WAL grows into the limit where updates get blocked.
+		 */
+		double lead = 2 * wal_growth_rate * checkpoint_time_last / 1000000.0;
+		double threshold = double.min (WAL_ASYNC_CHECKPOINT_PAGES, WAL_SYNC_CHECKPOINT_PAGES - lead);
+
+		if (n_pages >= threshold) {
+			push_checkpoint (false);
+			return;
+		}
+
+		idle_checkpoint_id = Timeout.add (WAL_IDLE_CHECKPOINT_DELAY, () => {
+			idle_checkpoint_id = 0;
+
+			if (active && !update_running) {
+				push_checkpoint (true);
+			}
+
+			return false;
+		});
+	}
+
+	/* Updates add full-text index segments, which are merged in small
+	 * steps once no updates came in for a while, so that neither
+	 * updates nor queries have to wait for large merges.
+	 */
+	static void sched_fts_merge (uint delay) {
+		if (idle_fts_merge_id != 0) {
+			// the store is not idle yet
+			Source.remove (idle_fts_merge_id);
+			idle_fts_merge_id = 0;
+		}
+
+		if (fts_merge_pages <= 0 || !fts_merge_needed) {
+			return;
+		}
+
+		idle_fts_merge_id = Timeout.add (delay, () => {
+			idle_fts_merge_id = 0;
+
+			if (!active || update_running) {
+				return false;
+			}
+
+			for (int i = 0; i < Priority.N_PRIORITIES; i++) {
+				if (update_queues[i].length > 0) {
+					return false;
+				}
+			}
+
+			var task = new FtsMergeTask ();
+			task.type = TaskType.FTS_MERGE;
+			task.queued_time = get_monotonic_time ();
+
+			update_running = true;
+			try {
+				update_pool.add (task);
+			} catch (Error e) {
+				warning (e.message);
+				update_running = false;
+			}
+
+			return false;
+		});
 	}
 
 	public static void init () {
@@ -299,7 +1023,68 @@ public class Tracker.Store {
 			max_task_time = MAX_TASK_TIME;
 		}
 
+		string max_queries_env = Environment.get_variable ("TRACKER_STORE_MAX_CONCURRENT_QUERIES");
+		if (max_queries_env != null) {
+			max_concurrent_queries = int.parse (max_queries_env);
+		} else {
+			/* WAL readers don't block each other, follow the core count */
+			max_concurrent_queries = int.max (DEFAULT_MAX_CONCURRENT_QUERIES, (int) get_num_processors ());
+		}
+		max_concurrent_queries = max_concurrent_queries.clamp (1, MAX_CONCURRENT_QUERIES_LIMIT);
+
+		/* A single client may not take more than half of the query
+		 * threads while others are waiting, so they can still get
+		 * through.
+		 */
+		max_client_queries = int.max (1, max_concurrent_queries / 2);
+
+		string max_queued_env = Environment.get_variable ("TRACKER_STORE_MAX_QUEUED_QUERIES");
+		if (max_queued_env != null) {
+			max_queued_queries = int.parse (max_queued_env);
+		} else {
+			max_queued_queries = MAX_QUEUED_QUERIES;
+		}
+
+		string max_cursor_idle_env = Environment.get_variable ("TRACKER_STORE_MAX_CURSOR_IDLE_TIME");
+		if (max_cursor_idle_env != null) {
+			max_cursor_idle_time = int.parse (max_cursor_idle_env);
+		} else {
+			max_cursor_idle_time = MAX_CURSOR_IDLE_TIME;
+		}
+
+		string max_cursor_buffer_env = Environment.get_variable ("TRACKER_STORE_MAX_CURSOR_BUFFER_SIZE");
+		if (max_cursor_buffer_env != null) {
+			max_cursor_buffer_size = int.parse (max_cursor_buffer_env);
+		} else {
+			max_cursor_buffer_size = MAX_CURSOR_BUFFER_SIZE;
+		}
+
+		string bulk_load_env = Environment.get_variable ("TRACKER_STORE_BULK_LOAD_MIN_SIZE");
+		if (bulk_load_env != null) {
+			bulk_load_min_size = int64.parse (bulk_load_env);
+		} else {
+			bulk_load_min_size = BULK_LOAD_MIN_SIZE;
+		}
+
+		string fts_merge_env = Environment.get_variable ("TRACKER_STORE_FTS_MERGE_PAGES");
+		if (fts_merge_env != null) {
+			fts_merge_pages = int.parse (fts_merge_env);
+		} else {
+			fts_merge_pages = FTS_MERGE_PAGES;
+		}
+
+		string max_group_env = Environment.get_variable ("TRACKER_STORE_MAX_UPDATE_GROUP_SIZE");
+		if (max_group_env != null) {
+			max_update_group_size = int.parse (max_group_env);
+		} else {
+			max_update_group_size = MAX_UPDATE_GROUP_SIZE;
+		}
+
+		debug ("Query scheduler: %d threads, %d per client, %d queued per priority",
+		       max_concurrent_queries, max_client_queries, max_queued_queries);
+
 		running_tasks = new GenericArray<Task> ();
+		suspended_tasks = new GenericArray<QueryTask> ();
 
 		for (int i = 0; i < Priority.N_PRIORITIES; i++) {
 			query_queues[i] = new Queue<Task> ();
@@ -308,8 +1093,8 @@ public class Tracker.Store {
 
 		try {
 			update_pool = new ThreadPool<Task>.with_owned_data (pool_dispatch_cb, 1, true);
-			query_pool = new ThreadPool<Task>.with_owned_data (pool_dispatch_cb, MAX_CONCURRENT_QUERIES, true);
-			checkpoint_pool = new ThreadPool<bool>.with_owned_data (checkpoint_dispatch_cb, 1, true);
+			query_pool = new ThreadPool<Task>.with_owned_data (pool_dispatch_cb, max_concurrent_queries, true);
+			checkpoint_pool = new ThreadPool<CheckpointTask>.with_owned_data (checkpoint_dispatch_cb, 1, true);
 		} catch (Error e) {
 			warning (e.message);
 		}
@@ -322,6 +1107,16 @@ public class Tracker.Store {
 	}
 
 	public static void shutdown () {
+		if (idle_checkpoint_id != 0) {
+			Source.remove (idle_checkpoint_id);
+			idle_checkpoint_id = 0;
+		}
+
+		if (idle_fts_merge_id != 0) {
+			Source.remove (idle_fts_merge_id);
+			idle_fts_merge_id = 0;
+		}
+
 		query_pool = null;
 		update_pool = null;
 		checkpoint_pool = null;
@@ -332,14 +1127,31 @@ public class Tracker.Store {
 		}
 	}
 
-	public static async void sparql_query (string sparql, Priority priority, SparqlQueryInThread in_thread, string client_id) throws Error {
+	public static int get_max_cursor_buffer_size () {
+		return max_cursor_buffer_size;
+	}
+
+	/* Queries passing an output stream may suspend themselves while the
+	 * client is not reading, see SparqlQueryInThread.
+	 */
+	public static async void sparql_query (string sparql, Priority priority, SparqlQueryInThread in_thread, string client_id, UnixOutputStream? output_stream = null, bool continuable = false, string? continuation = null) throws Error {
+		if (max_queued_queries > 0 && query_queues[priority].length >= max_queued_queries) {
+			n_queries_rejected++;
+			throw new DBusError.LIMITS_EXCEEDED ("Too many pending queries, try again later");
+		}
+
 		var task = new QueryTask ();
 		task.type = TaskType.QUERY;
 		task.query = sparql;
+		task.priority = priority;
 		task.cancellable = new Cancellable ();
 		task.in_thread = in_thread;
+		task.output_stream = output_stream;
+		task.continuable = continuable;
+		task.continuation = continuation;
 		task.callback = sparql_query.callback;
 		task.client_id = client_id;
+		task.queued_time = get_monotonic_time ();
 
 		query_queues[priority].push_tail (task);
 
@@ -392,10 +1204,14 @@ public class Tracker.Store {
 		return task.blank_nodes;
 	}
 
-	public static async void queue_turtle_import (File file, string client_id) throws Error {
+	/* Progress of bulk loads is reported through busy_callback, it
+	 * must stay valid until the import finished.
+	 */
+	public static async void queue_turtle_import (File file, string client_id, BusyCallback? busy_callback = null) throws Error {
 		var task = new TurtleTask ();
 		task.type = TaskType.TURTLE;
 		task.path = file.get_path ();
+		task.busy_callback = busy_callback;
 		task.callback = queue_turtle_import.callback;
 		task.client_id = client_id;
 
@@ -410,6 +1226,25 @@ public class Tracker.Store {
 		}
 	}
 
+	/* Updates wait while the full-text index is rebuilt, queries go on
+	 * using the old index until the new one replaces it.
+	 */
+	public static async void queue_fts_rebuild () throws Error {
+		var task = new FtsRebuildTask ();
+		task.type = TaskType.FTS_REBUILD;
+		task.callback = queue_fts_rebuild.callback;
+
+		update_queues[Priority.LOW].push_tail (task);
+
+		sched ();
+
+		yield;
+
+		if (task.error != null) {
+			throw task.error;
+		}
+	}
+
 	public uint get_queue_size () {
 		uint result = 0;
 
@@ -420,6 +1255,75 @@ public class Tracker.Store {
 		return result;
 	}
 
+	public static Variant get_statistics () {
+		uint queued_queries = 0;
+
+		for (int i = 0; i < Priority.N_PRIORITIES; i++) {
+			queued_queries += query_queues[i].get_length ();
+		}
+
+		uint64 resource_cache_hits, resource_cache_misses;
+		uint resource_cache_size;
+
+		Tracker.Data.query_resource_cache_get_stats (out resource_cache_hits, out resource_cache_misses, out resource_cache_size);
+
+		uint64 plan_cache_hits, plan_cache_misses;
+		int64 plan_cache_saved_time;
+		uint plan_cache_size;
+
+		Sparql.Query.get_plan_cache_stats (out plan_cache_hits, out plan_cache_misses, out plan_cache_saved_time, out plan_cache_size);
+
+		uint64 fts_indexed, fts_coalesced;
+		int64 fts_index_time;
+
+		Tracker.Data.get_fts_stats (out fts_indexed, out fts_coalesced, out fts_index_time);
+
+		var builder = new VariantBuilder ((VariantType) "a{sv}");
+
+		builder.add ("{sv}", "max-concurrent-queries", new Variant.int32 (max_concurrent_queries));
+		builder.add ("{sv}", "max-client-queries", new Variant.int32 (max_client_queries));
+		builder.add ("{sv}", "max-queued-queries", new Variant.int32 (max_queued_queries));
+		builder.add ("{sv}", "queries-running", new Variant.int32 (n_queries_running));
+		builder.add ("{sv}", "queries-queued", new Variant.uint32 (queued_queries));
+		builder.add ("{sv}", "queries-done", new Variant.uint64 (n_queries_done));
+		builder.add ("{sv}", "queries-rejected", new Variant.uint64 (n_queries_rejected));
+		builder.add ("{sv}", "query-wait-time", new Variant.int64 (query_wait_time));
+		builder.add ("{sv}", "query-wait-time-max", new Variant.int64 (query_wait_time_max));
+		builder.add ("{sv}", "query-exec-time", new Variant.int64 (query_exec_time));
+		builder.add ("{sv}", "query-exec-time-max", new Variant.int64 (query_exec_time_max));
+		builder.add ("{sv}", "update-groups", new Variant.uint64 (n_update_groups));
+		builder.add ("{sv}", "updates-grouped", new Variant.uint64 (n_updates_grouped));
+		builder.add ("{sv}", "update-groups-failed", new Variant.uint64 (n_update_groups_failed));
+		builder.add ("{sv}", "queries-suspended", new Variant.uint32 (suspended_tasks.length));
+		builder.add ("{sv}", "query-suspensions", new Variant.uint64 (n_queries_suspended));
+		builder.add ("{sv}", "queries-timed-out", new Variant.uint64 (n_queries_timed_out));
+		builder.add ("{sv}", "suspended-queries-dropped", new Variant.uint64 (n_suspended_queries_dropped));
+		builder.add ("{sv}", "wal-pages", new Variant.int32 (AtomicInt.get (ref wal_pages)));
+		builder.add ("{sv}", "wal-growth-rate", new Variant.double (wal_growth_rate));
+		builder.add ("{sv}", "checkpoints", new Variant.uint64 (n_checkpoints));
+		builder.add ("{sv}", "checkpoints-incomplete", new Variant.int32 (n_incomplete_checkpoints));
+		builder.add ("{sv}", "checkpoint-time", new Variant.int64 (checkpoint_time));
+		builder.add ("{sv}", "checkpoint-time-max", new Variant.int64 (checkpoint_time_max));
+		builder.add ("{sv}", "checkpoints-blocking", new Variant.uint64 (n_checkpoints_blocking));
+		builder.add ("{sv}", "update-stall-time", new Variant.int64 (update_stall_time));
+		builder.add ("{sv}", "update-stall-time-max", new Variant.int64 (update_stall_time_max));
+		builder.add ("{sv}", "resource-cache-size", new Variant.uint32 (resource_cache_size));
+		builder.add ("{sv}", "resource-cache-hits", new Variant.uint64 (resource_cache_hits));
+		builder.add ("{sv}", "resource-cache-misses", new Variant.uint64 (resource_cache_misses));
+		builder.add ("{sv}", "query-plan-cache-size", new Variant.uint32 (plan_cache_size));
+		builder.add ("{sv}", "query-plan-cache-hits", new Variant.uint64 (plan_cache_hits));
+		builder.add ("{sv}", "query-plan-cache-misses", new Variant.uint64 (plan_cache_misses));
+		builder.add ("{sv}", "query-plan-time-saved", new Variant.int64 (plan_cache_saved_time));
+		builder.add ("{sv}", "fts-resources-indexed", new Variant.uint64 (fts_indexed));
+		builder.add ("{sv}", "fts-updates-coalesced", new Variant.uint64 (fts_coalesced));
+		builder.add ("{sv}", "fts-index-time", new Variant.int64 (fts_index_time));
+		builder.add ("{sv}", "fts-merges", new Variant.uint64 (n_fts_merges));
+		builder.add ("{sv}", "fts-merge-time", new Variant.int64 (fts_merge_time));
+		builder.add ("{sv}", "fts-rebuild-time", new Variant.int64 (fts_rebuild_time));
+
+		return builder.end ();
+	}
+
 	public static void unreg_batches (string client_id) {
 		unowned List<Task> list, cur;
 		unowned Queue<Task> queue;
@@ -431,6 +1335,13 @@ public class Tracker.Store {
 			}
 		}
 
+		for (int i = suspended_tasks.length - 1; i >= 0; i--) {
+			QueryTask task = suspended_tasks[i];
+			if (task.client_id == client_id) {
+				abort_suspended_query (task, new DBusError.FAILED ("Client disappeared"));
+			}
+		}
+
 		for (int i = 0; i < Priority.N_PRIORITIES; i++) {
 			queue = query_queues[i];
 			list = queue.head;
@@ -469,6 +1380,13 @@ public class Tracker.Store {
 	public static async void pause () {
 		Tracker.Store.active = false;
 
+		/* suspended cursors keep a read transaction open on their own
+		 * connection, don't let them outlive a pause */
+		while (suspended_tasks.length > 0) {
+			QueryTask task = suspended_tasks[0];
+			abort_suspended_query (task, new Sparql.Error.INTERNAL ("Store is being paused"));
+		}
+
 		if (n_queries_running > 0 || update_running) {
 			active_callback = pause.callback;
 			yield;
@@ -479,7 +1397,7 @@ public class Tracker.Store {
 			// this will wait for checkpointing to finish
 			checkpoint_pool = null;
 			try {
-				checkpoint_pool = new ThreadPool<bool> (checkpoint_dispatch_cb, 1, true);
+				checkpoint_pool = new ThreadPool<CheckpointTask>.with_owned_data (checkpoint_dispatch_cb, 1, true);
 			} catch (Error e) {
 				warning (e.message);
 			}
@@ -33,10 +33,12 @@
 
 #define SQL_OPTIONS_ENABLED()	  \
 	(file || \
-	 query)
+	 query || \
+	 explain)
 
 static gchar *file;
 static gchar *query;
+static gchar *explain;
 
 static GOptionEntry entries[] = {
 	{ "file", 'f', 0, G_OPTION_ARG_FILENAME, &file,
@@ -47,6 +49,10 @@ static GOptionEntry entries[] = {
 	  "SQL query",
 	  "SQL",
 	},
+	{ "explain", 'e', 0, G_OPTION_ARG_STRING, &explain,
+	  "Show the join order, SQL and query plan used for a SPARQL query without running it",
+	  "SPARQL",
+	},
 	{ NULL }
 };
 
@@ -85,15 +91,11 @@ sql_by_file (void)
 	return EXIT_SUCCESS;
 }
 
-static int
-sql_by_query (void)
+static gboolean
+sql_init_data_manager (void)
 {
-	TrackerDBInterface *iface;
-	TrackerDBStatement *stmt;
-	TrackerDBCursor *cursor = NULL;
 	GError *error = NULL;
 	gboolean first_time = FALSE;
-	gint n_rows = 0;
 
 	if (!tracker_data_manager_init (0,
 	                                NULL,
@@ -110,6 +112,22 @@ sql_by_query (void)
 		            _("Failed to initialize data manager"),
 		            error->message);
 		g_error_free (error);
+		return FALSE;
+	}
+
+	return TRUE;
+}
+
+static int
+sql_by_query (void)
+{
+	TrackerDBInterface *iface;
+	TrackerDBStatement *stmt;
+	TrackerDBCursor *cursor = NULL;
+	GError *error = NULL;
+	gint n_rows = 0;
+
+	if (!sql_init_data_manager ()) {
 		return EXIT_FAILURE;
 	}
 
@@ -173,6 +191,33 @@ sql_by_query (void)
 	return EXIT_SUCCESS;
 }
 
+static int
+sql_explain (void)
+{
+	GError *error = NULL;
+	gchar *result;
+
+	if (!sql_init_data_manager ()) {
+		return EXIT_FAILURE;
+	}
+
+	result = tracker_data_query_explain (explain, &error);
+
+	if (error) {
+		g_printerr ("%s: %s\n",
+		            _("Could not explain query"),
+		            error->message);
+		g_error_free (error);
+
+		return EXIT_FAILURE;
+	}
+
+	g_print ("%s", result);
+	g_free (result);
+
+	return EXIT_SUCCESS;
+}
+
 static int
 sql_run (void)
 {
@@ -180,6 +225,10 @@ sql_run (void)
 		return sql_by_file ();
 	}
 
+	if (explain) {
+		return sql_explain ();
+	}
+
 	if (query) {
 		return sql_by_query ();
 	}
@@ -235,6 +284,8 @@ tracker_sql (int argc, const char **argv)
 
 	if (file && query) {
 		failed = _("File and query can not be used together");
+	} else if (explain && (file || query)) {
+		failed = _("Explain can not be used together with file or query");
 	} else {
 		failed = NULL;
 	}
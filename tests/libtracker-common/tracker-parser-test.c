@@ -268,6 +268,148 @@ stop_word_check (TrackerParserTestFixture *fixture,
 	g_assert_cmpuint (stop_word, == , testdata->is_expected_stop_word);
 }
 
+/* -------------- ASCII TOKENIZER TESTS ----------------- */
+
+/* Returns all words starting in the first length bytes, with their
+ * positions, offsets and stop word flags */
+static gchar *
+parse_words (TrackerParserTestFixture *fixture,
+             const gchar              *str,
+             gint                      length,
+             gboolean                  ignore_numbers)
+{
+	GString *result;
+	const gchar *word;
+	gint position;
+	gint byte_offset_start;
+	gint byte_offset_end;
+	gboolean stop_word;
+	gint word_length;
+
+	tracker_parser_reset (fixture->parser,
+	                      str,
+	                      strlen (str),
+	                      fixture->max_word_length,
+	                      fixture->enable_stemmer,
+	                      fixture->enable_unaccent,
+	                      fixture->ignore_stop_words,
+	                      fixture->ignore_reserved_words,
+	                      ignore_numbers);
+
+	result = g_string_new (NULL);
+
+	while ((word = tracker_parser_next (fixture->parser,
+	                                    &position,
+	                                    &byte_offset_start,
+	                                    &byte_offset_end,
+	                                    &stop_word,
+	                                    &word_length)) != NULL) {
+		if (byte_offset_start >= length) {
+			break;
+		}
+
+		g_string_append_printf (result, "%s:%d:%d-%d:%d ",
+		                        word, position,
+		                        byte_offset_start, byte_offset_end,
+		                        stop_word);
+	}
+
+	return g_string_free (result, FALSE);
+}
+
+/* Plain ASCII text is tokenized without ICU, a trailing non-ASCII
+ * word makes the parser take the ICU path for the same text */
+static void
+ascii_tokenizer_check (TrackerParserTestFixture *fixture,
+                       gconstpointer             data)
+{
+	const gchar *str = data;
+	gchar *non_ascii;
+	gchar *expected;
+	gchar *words;
+
+	non_ascii = g_strconcat (str, " \xc3\xa9cole", NULL);
+
+	expected = parse_words (fixture, non_ascii, strlen (str), FALSE);
+	words = parse_words (fixture, str, strlen (str), FALSE);
+	g_assert_cmpstr (words, ==, expected);
+	g_free (words);
+	g_free (expected);
+
+	expected = parse_words (fixture, non_ascii, strlen (str), TRUE);
+	words = parse_words (fixture, str, strlen (str), TRUE);
+	g_assert_cmpstr (words, ==, expected);
+	g_free (words);
+	g_free (expected);
+
+	g_free (non_ascii);
+}
+
+static void
+test_tokenizer_throughput (TrackerParserTestFixture *fixture,
+                           gconstpointer             data)
+{
+	const gchar *line = "2015-06-02 10:21:07 INFO tracker_miner_fs_set_throttle: "
+		"Crawling /home/user/src/project/main.c (size=12345, mime='text/x-csrc') "
+		"while (!done && i < n_items) { items[i++] = g_strdup (name); }\n";
+	GString *text;
+	gchar *non_ascii;
+	gdouble ascii_rate, icu_rate, elapsed;
+	gint position;
+	gint byte_offset_start;
+	gint byte_offset_end;
+	gboolean stop_word;
+	gint word_length;
+	gint n_words;
+
+	if (!g_test_perf ()) {
+		return;
+	}
+
+	text = g_string_new (NULL);
+	while (text->len < 4 * 1024 * 1024) {
+		g_string_append (text, line);
+	}
+
+	/* A single non-ASCII word sends the whole text through ICU */
+	non_ascii = g_strconcat (text->str, "\xc3\xa9cole", NULL);
+
+	g_test_timer_start ();
+	tracker_parser_reset (fixture->parser, text->str, text->len,
+	                      fixture->max_word_length, fixture->enable_stemmer,
+	                      fixture->enable_unaccent, fixture->ignore_stop_words,
+	                      fixture->ignore_reserved_words, fixture->ignore_numbers);
+	n_words = 0;
+	while (tracker_parser_next (fixture->parser, &position, &byte_offset_start,
+	                            &byte_offset_end, &stop_word, &word_length)) {
+		n_words++;
+	}
+	elapsed = g_test_timer_elapsed ();
+	ascii_rate = text->len / elapsed / (1024 * 1024);
+
+	g_test_timer_start ();
+	tracker_parser_reset (fixture->parser, non_ascii, strlen (non_ascii),
+	                      fixture->max_word_length, fixture->enable_stemmer,
+	                      fixture->enable_unaccent, fixture->ignore_stop_words,
+	                      fixture->ignore_reserved_words, fixture->ignore_numbers);
+	while (tracker_parser_next (fixture->parser, &position, &byte_offset_start,
+	                            &byte_offset_end, &stop_word, &word_length)) {
+		n_words--;
+	}
+	elapsed = g_test_timer_elapsed ();
+	icu_rate = strlen (non_ascii) / elapsed / (1024 * 1024);
+
+	/* Only the trailing word differs */
+	g_assert_cmpint (n_words, ==, -1);
+
+	g_test_message ("ICU tokenizer: %.1f MB/s", icu_rate);
+	g_test_maximized_result (ascii_rate, "ASCII tokenizer: %.1f MB/s, %.1fx faster",
+	                         ascii_rate, ascii_rate / icu_rate);
+
+	g_free (non_ascii);
+	g_string_free (text, TRUE);
+}
+
 /* -------------- LIST OF TESTS ----------------- */
 
 /* Normalization-related tests (unaccenting) */
@@ -348,6 +490,20 @@ static const TestDataStopWord test_data_stop_words[] = {
 	{ NULL,    FALSE, FALSE }
 };
 
+/* ASCII tokenizer tests, compared against the ICU tokenizer */
+static const gchar *test_data_ascii[] = {
+	"The quick (\"brown\") fox can't jump 32.3 feet, right?",
+	"filename.TXT .hidden.txt noextension. e.g. U.S.A.",
+	"1,000,000 1;2 3'4 5,a b'6 x'y'z 'quoted' trailing' 7,",
+	"__init__ foo_bar _ a_'b 1_2 snake_case_123 CamelCase",
+	"std::vector<int> http://example.com/path?a=1&b=2 10:21:07",
+	"if (!done && i < n_items) { items[i++] = g_strdup (name); }",
+	"tabs\tand\nnewlines\r\nand  spaces\x01control",
+	"Supercalifragilisticexpialidocious Pneumonoultramicroscopicsilicovolcanoconiosis "
+	"an_identifier_that_is_way_longer_than_the_maximum_word_length_allowed",
+	NULL
+};
+
 int
 main (int argc, char **argv)
 {
@@ -446,5 +602,26 @@ main (int argc, char **argv)
 		g_free (testpath);
 	}
 
+	/* Add ASCII tokenizer checks */
+	for (i = 0; test_data_ascii[i] != NULL; i++) {
+		gchar *testpath;
+
+		testpath = g_strdup_printf ("/libtracker-fts/parser/ascii_%d", i);
+		g_test_add (testpath,
+		            TrackerParserTestFixture,
+		            test_data_ascii[i],
+		            test_common_setup,
+		            ascii_tokenizer_check,
+		            test_common_teardown);
+		g_free (testpath);
+	}
+
+	g_test_add ("/libtracker-fts/parser/throughput",
+	            TrackerParserTestFixture,
+	            NULL,
+	            test_common_setup,
+	            test_tokenizer_throughput,
+	            test_common_teardown);
+
 	return g_test_run ();
 }
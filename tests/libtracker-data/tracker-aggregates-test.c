@@ -0,0 +1,243 @@
+/*
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ * Boston, MA  02110-1301, USA.
+ */
+
+#include "config.h"
+
+#include <string.h>
+
+#include <glib.h>
+#include <gio/gio.h>
+
+#include <libtracker-data/tracker-data-aggregates.h>
+#include <libtracker-data/tracker-data-manager.h>
+#include <libtracker-data/tracker-data-query.h>
+#include <libtracker-data/tracker-data-update.h>
+#include <libtracker-data/tracker-data.h>
+
+#include "tracker-data-test-common.h"
+
+#define MIME_TYPE_QUERY "SELECT ?m COUNT(?d) WHERE { ?d a nfo:Document ; nie:mimeType ?m } GROUP BY ?m ORDER BY ?m"
+/* the FILTER keeps the query from matching the view */
+#define MIME_TYPE_SCAN_QUERY "SELECT ?m COUNT(?d) WHERE { ?d a nfo:Document . ?d nie:mimeType ?m FILTER (BOUND (?m)) } GROUP BY ?m ORDER BY ?m"
+
+#define KEYWORD_QUERY "SELECT ?k (COUNT(?d) AS ?c) WHERE { ?d nie:keyword ?k ; a nfo:Document } GROUP BY ?k ORDER BY DESC(?c) ?k"
+#define KEYWORD_SCAN_QUERY "SELECT ?k (COUNT(?d) AS ?c) WHERE { ?d nie:keyword ?k ; a nfo:Document FILTER (BOUND (?k)) } GROUP BY ?k ORDER BY DESC(?c) ?k"
+
+static void
+init_data_manager (TrackerDBManagerFlags flags)
+{
+	const gchar *definitions[] = { "nfo:Document/nie:mimeType", "nfo:Document/nie:keyword", NULL };
+
+	tracker_data_aggregates_set_definitions (definitions);
+	test_data_init_data_manager (flags);
+}
+
+static void
+update (const gchar *update)
+{
+	GError *error = NULL;
+
+	tracker_data_update_sparql (update, &error);
+	g_assert_no_error (error);
+}
+
+/* Returns all rows as "value=count", separated by spaces */
+static gchar *
+query_counts (const gchar *query)
+{
+	TrackerDBCursor *cursor;
+	GError *error = NULL;
+	GString *result;
+
+	cursor = tracker_data_query_sparql_cursor (query, &error);
+	g_assert_no_error (error);
+
+	result = g_string_new (NULL);
+
+	while (tracker_db_cursor_iter_next (cursor, NULL, &error)) {
+		if (result->len > 0) {
+			g_string_append_c (result, ' ');
+		}
+		g_string_append_printf (result, "%s=%s",
+		                        tracker_db_cursor_get_string (cursor, 0, NULL),
+		                        tracker_db_cursor_get_string (cursor, 1, NULL));
+	}
+
+	g_assert_no_error (error);
+	g_object_unref (cursor);
+
+	return g_string_free (result, FALSE);
+}
+
+static void
+assert_uses_view (const gchar *query,
+                  gboolean     uses_view)
+{
+	GError *error = NULL;
+	gchar *explain;
+
+	explain = tracker_data_query_explain (query, &error);
+	g_assert_no_error (error);
+	g_assert_cmpint (strstr (explain, "\"Aggregate/") != NULL, ==, uses_view);
+	g_free (explain);
+}
+
+/* The view must give the same result as scanning the class */
+static void
+assert_counts (const gchar *query,
+               const gchar *scan_query,
+               const gchar *expected)
+{
+	gchar *result, *scan_result;
+
+	result = query_counts (query);
+	scan_result = query_counts (scan_query);
+
+	g_assert_cmpstr (scan_result, ==, expected);
+	g_assert_cmpstr (result, ==, expected);
+
+	g_free (result);
+	g_free (scan_result);
+}
+
+static void
+test_aggregates_query (TestInfo      *info,
+                       gconstpointer  context)
+{
+	init_data_manager (TRACKER_DB_MANAGER_FORCE_REINDEX);
+
+	update ("INSERT { <urn:d:1> a nfo:Document ; nie:mimeType 'text/plain' ; nie:keyword 'a', 'b' . "
+	        "         <urn:d:2> a nfo:Document ; nie:mimeType 'text/plain' ; nie:keyword 'b' . "
+	        "         <urn:d:3> a nfo:Document ; nie:mimeType 'image/png' . "
+	        "         <urn:i:1> a nie:InformationElement ; nie:mimeType 'image/png' ; nie:keyword 'a' }");
+
+	assert_uses_view (MIME_TYPE_QUERY, TRUE);
+	assert_uses_view (KEYWORD_QUERY, TRUE);
+	assert_uses_view (MIME_TYPE_SCAN_QUERY, FALSE);
+	assert_uses_view ("SELECT ?m COUNT(?d) WHERE { ?d a nfo:Document ; nie:mimeType ?m } GROUP BY ?m LIMIT 1", TRUE);
+	assert_uses_view ("SELECT ?m COUNT(DISTINCT ?m) WHERE { ?d a nfo:Document ; nie:mimeType ?m } GROUP BY ?m", FALSE);
+	assert_uses_view ("SELECT ?m COUNT(?d) WHERE { ?d a nfo:Image ; nie:mimeType ?m } GROUP BY ?m", FALSE);
+
+	assert_counts (MIME_TYPE_QUERY, MIME_TYPE_SCAN_QUERY, "image/png=1 text/plain=2");
+	assert_counts (KEYWORD_QUERY, KEYWORD_SCAN_QUERY, "b=2 a=1");
+	assert_counts ("SELECT ?m COUNT(?d) WHERE { ?d a nfo:Document ; nie:mimeType ?m } GROUP BY ?m ORDER BY ?m LIMIT 1 OFFSET 1",
+	               "SELECT ?m COUNT(?d) WHERE { ?d a nfo:Document ; nie:mimeType ?m FILTER (BOUND (?m)) } GROUP BY ?m ORDER BY ?m LIMIT 1 OFFSET 1",
+	               "text/plain=2");
+
+	tracker_data_manager_shutdown ();
+}
+
+static void
+test_aggregates_update (TestInfo      *info,
+                        gconstpointer  context)
+{
+	GError *error = NULL;
+
+	init_data_manager (TRACKER_DB_MANAGER_FORCE_REINDEX);
+
+	update ("INSERT { <urn:d:1> a nfo:Document ; nie:mimeType 'text/plain' ; nie:keyword 'a', 'b' . "
+	        "         <urn:d:2> a nfo:Document ; nie:mimeType 'text/plain' ; nie:keyword 'b' . "
+	        "         <urn:d:3> a nfo:Document ; nie:mimeType 'image/png' }");
+
+	/* changed value */
+	update ("DELETE { <urn:d:1> nie:mimeType ?m } WHERE { <urn:d:1> nie:mimeType ?m } "
+	        "INSERT { <urn:d:1> nie:mimeType 'image/png' ; nie:keyword 'c' }");
+	assert_counts (MIME_TYPE_QUERY, MIME_TYPE_SCAN_QUERY, "image/png=2 text/plain=1");
+	assert_counts (KEYWORD_QUERY, KEYWORD_SCAN_QUERY, "b=2 a=1 c=1");
+
+	/* deleted resource */
+	update ("DELETE { <urn:d:2> a rdfs:Resource }");
+	assert_counts (MIME_TYPE_QUERY, MIME_TYPE_SCAN_QUERY, "image/png=2");
+	assert_counts (KEYWORD_QUERY, KEYWORD_SCAN_QUERY, "a=1 b=1 c=1");
+
+	/* class removed, class added to a resource with values */
+	update ("DELETE { <urn:d:3> a nfo:Document }");
+	update ("INSERT { <urn:i:1> a nie:InformationElement ; nie:mimeType 'text/html' ; nie:keyword 'a' }");
+	assert_counts (MIME_TYPE_QUERY, MIME_TYPE_SCAN_QUERY, "image/png=1");
+	update ("INSERT { <urn:i:1> a nfo:Document }");
+	assert_counts (MIME_TYPE_QUERY, MIME_TYPE_SCAN_QUERY, "image/png=1 text/html=1");
+	assert_counts (KEYWORD_QUERY, KEYWORD_SCAN_QUERY, "a=2 b=1 c=1");
+
+	/* failed updates are rolled back */
+	tracker_data_update_sparql ("INSERT { <urn:d:1> nie:keyword 'd' . <urn:d:4> a nfo:Document ; nie:mimeType 'text/plain', 'text/html' }", &error);
+	g_assert (error != NULL);
+	g_clear_error (&error);
+	assert_counts (MIME_TYPE_QUERY, MIME_TYPE_SCAN_QUERY, "image/png=1 text/html=1");
+	assert_counts (KEYWORD_QUERY, KEYWORD_SCAN_QUERY, "a=2 b=1 c=1");
+
+	/* views are kept in the database */
+	tracker_data_manager_shutdown ();
+	init_data_manager (0);
+	assert_uses_view (MIME_TYPE_QUERY, TRUE);
+	assert_counts (MIME_TYPE_QUERY, MIME_TYPE_SCAN_QUERY, "image/png=1 text/html=1");
+	tracker_data_manager_shutdown ();
+
+	/* and found by read-only connections */
+	tracker_data_aggregates_set_definitions (NULL);
+	test_data_init_data_manager (TRACKER_DB_MANAGER_READONLY);
+	assert_uses_view (KEYWORD_QUERY, TRUE);
+	assert_counts (KEYWORD_QUERY, KEYWORD_SCAN_QUERY, "a=2 b=1 c=1");
+
+	tracker_data_manager_shutdown ();
+}
+
+static void
+test_aggregates_bulk_load (TestInfo      *info,
+                           gconstpointer  context)
+{
+	GError *error = NULL;
+	gchar *path;
+	GFile *file;
+
+	init_data_manager (TRACKER_DB_MANAGER_FORCE_REINDEX);
+
+	update ("INSERT { <urn:d:1> a nfo:Document ; nie:mimeType 'text/plain' ; nie:keyword 'a' }");
+
+	path = g_build_filename (test_data_get_location (), "bulk.ttl", NULL);
+	g_file_set_contents (path,
+	                     "@prefix nie: <http://www.semanticdesktop.org/ontologies/2007/01/19/nie#> .\n"
+	                     "@prefix nfo: <http://www.semanticdesktop.org/ontologies/2007/03/22/nfo#> .\n"
+	                     "<urn:d:2> a nfo:Document ; nie:mimeType \"text/plain\" ; nie:keyword \"a\", \"b\" .\n"
+	                     "<urn:d:3> a nfo:Document ; nie:mimeType \"image/png\" .\n",
+	                     -1, &error);
+	g_assert_no_error (error);
+
+	/* statement callbacks don't run for bulk loads */
+	file = g_file_new_for_path (path);
+	tracker_data_load_turtle_file_bulk (file, NULL, NULL, NULL, &error);
+	g_assert_no_error (error);
+	g_object_unref (file);
+	g_free (path);
+
+	assert_uses_view (MIME_TYPE_QUERY, TRUE);
+	assert_counts (MIME_TYPE_QUERY, MIME_TYPE_SCAN_QUERY, "image/png=1 text/plain=2");
+	assert_counts (KEYWORD_QUERY, KEYWORD_SCAN_QUERY, "a=2 b=1");
+
+	tracker_data_manager_shutdown ();
+}
+
+int
+main (int argc, char **argv)
+{
+	test_data_init (&argc, &argv);
+
+	g_test_add ("/libtracker-data/aggregates/query", TestInfo, NULL, test_data_setup, test_aggregates_query, test_data_teardown);
+	g_test_add ("/libtracker-data/aggregates/update", TestInfo, NULL, test_data_setup, test_aggregates_update, test_data_teardown);
+	g_test_add ("/libtracker-data/aggregates/bulk-load", TestInfo, NULL, test_data_setup, test_aggregates_bulk_load, test_data_teardown);
+
+	return test_data_run ();
+}
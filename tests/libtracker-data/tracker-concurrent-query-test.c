@@ -0,0 +1,169 @@
+/*
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ * Boston, MA  02110-1301, USA.
+ */
+
+#include "config.h"
+
+#include <glib.h>
+#include <gio/gio.h>
+
+#include <libtracker-data/tracker-data-manager.h>
+#include <libtracker-data/tracker-data-query.h>
+#include <libtracker-data/tracker-data-update.h>
+#include <libtracker-data/tracker-data.h>
+
+#include "tracker-data-test-common.h"
+
+#define N_RESOURCES 1000
+#define N_QUERIES 200
+
+/* Creates the database and reopens it read-only, as libtracker-direct does */
+static void
+init_readonly_data_manager (void)
+{
+	GError *error = NULL;
+	GString *update;
+	gint i;
+
+	test_data_init_data_manager (TRACKER_DB_MANAGER_FORCE_REINDEX);
+
+	update = g_string_new ("INSERT {");
+	for (i = 0; i < N_RESOURCES; i++) {
+		g_string_append_printf (update,
+		                        " <urn:test:%d> a nie:InformationElement ; nie:title 'title %d' .",
+		                        i, i % 10);
+	}
+	g_string_append (update, " }");
+
+	tracker_data_update_sparql (update->str, &error);
+	g_assert_no_error (error);
+	g_string_free (update, TRUE);
+
+	tracker_data_manager_shutdown ();
+
+	test_data_init_data_manager (TRACKER_DB_MANAGER_READONLY);
+}
+
+static gpointer
+query_thread (gpointer data)
+{
+	gint n_queries = GPOINTER_TO_INT (data);
+	gint i;
+
+	for (i = 0; i < n_queries; i++) {
+		TrackerDBCursor *cursor;
+		GError *error = NULL;
+		gchar *query;
+		gint n_rows = 0;
+
+		query = g_strdup_printf ("SELECT ?s WHERE { ?s nie:title 'title %d' }", i % 10);
+		cursor = tracker_data_query_sparql_cursor (query, &error);
+		g_assert_no_error (error);
+		g_free (query);
+
+		while (tracker_db_cursor_iter_next (cursor, NULL, &error)) {
+			g_assert (g_str_has_prefix (tracker_db_cursor_get_string (cursor, 0, NULL), "urn:test:"));
+			n_rows++;
+		}
+
+		g_assert_no_error (error);
+		g_assert_cmpint (n_rows, ==, N_RESOURCES / 10);
+
+		g_object_unref (cursor);
+	}
+
+	return NULL;
+}
+
+static gdouble
+run_query_threads (gint n_threads,
+                   gint n_queries)
+{
+	GThread **threads;
+	gint i;
+
+	threads = g_new (GThread *, n_threads);
+
+	g_test_timer_start ();
+
+	for (i = 0; i < n_threads; i++) {
+		threads[i] = g_thread_new ("query", query_thread, GINT_TO_POINTER (n_queries));
+	}
+
+	for (i = 0; i < n_threads; i++) {
+		g_thread_join (threads[i]);
+	}
+
+	g_free (threads);
+
+	return g_test_timer_elapsed ();
+}
+
+static void
+test_concurrent_queries (TestInfo      *info,
+                         gconstpointer  context)
+{
+	init_readonly_data_manager ();
+
+	run_query_threads (4, N_QUERIES / 4);
+
+	tracker_data_manager_shutdown ();
+}
+
+static void
+test_concurrent_query_scaling (TestInfo      *info,
+                               gconstpointer  context)
+{
+	gdouble single, elapsed;
+	gint n_threads;
+
+	if (!g_test_perf ()) {
+		return;
+	}
+
+	init_readonly_data_manager ();
+
+	/* warm up page cache and plan cache */
+	run_query_threads (1, N_QUERIES);
+
+	single = run_query_threads (1, N_QUERIES);
+
+	for (n_threads = 2; n_threads <= (gint) g_get_num_processors (); n_threads *= 2) {
+		/* every thread runs the full workload */
+		elapsed = run_query_threads (n_threads, N_QUERIES);
+
+		g_test_message ("%d threads: %.1f queries/s, speedup %.2f",
+		                n_threads,
+		                n_threads * N_QUERIES / elapsed,
+		                n_threads * single / elapsed);
+	}
+
+	g_test_minimized_result (single * 1e6 / N_QUERIES, "single thread query %.1f us",
+	                         single * 1e6 / N_QUERIES);
+
+	tracker_data_manager_shutdown ();
+}
+
+int
+main (int argc, char **argv)
+{
+	test_data_init (&argc, &argv);
+
+	g_test_add ("/libtracker-data/concurrent-query/readonly", TestInfo, NULL, test_data_setup, test_concurrent_queries, test_data_teardown);
+	g_test_add ("/libtracker-data/concurrent-query/scaling", TestInfo, NULL, test_data_setup, test_concurrent_query_scaling, test_data_teardown);
+
+	return test_data_run ();
+}
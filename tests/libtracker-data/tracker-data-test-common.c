@@ -0,0 +1,157 @@
+/*
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ * Boston, MA  02110-1301, USA.
+ */
+
+#include "config.h"
+
+#include <locale.h>
+
+#include <glib/gstdio.h>
+
+#include <libtracker-data/tracker-data-manager.h>
+#include <libtracker-data/tracker-data-query.h>
+
+#include "tracker-data-test-common.h"
+
+static gchar *tests_data_dir = NULL;
+static gchar *xdg_location = NULL;
+
+void
+test_data_init (gint    *argc,
+                gchar ***argv)
+{
+	gchar *current_dir;
+
+	setlocale (LC_COLLATE, "en_US.utf8");
+
+	current_dir = g_get_current_dir ();
+	tests_data_dir = g_build_path (G_DIR_SEPARATOR_S, current_dir, "test-data", NULL);
+	g_free (current_dir);
+
+	g_test_init (argc, argv, NULL);
+}
+
+gint
+test_data_run (void)
+{
+	gint result;
+
+	result = g_test_run ();
+
+	g_remove (tests_data_dir);
+	g_free (tests_data_dir);
+	tests_data_dir = NULL;
+
+	return result;
+}
+
+/* The data directory of the running test */
+const gchar *
+test_data_get_location (void)
+{
+	return xdg_location;
+}
+
+void
+test_data_setup (TestInfo      *info,
+                 gconstpointer  context)
+{
+	/* GLib caches XDG env vars, so all tests share one location */
+	if (!xdg_location) {
+		gchar *basename;
+
+		basename = g_strdup_printf ("%d", g_test_rand_int_range (0, G_MAXINT));
+		xdg_location = g_build_path (G_DIR_SEPARATOR_S, tests_data_dir, basename, NULL);
+		g_free (basename);
+
+		g_assert_true (g_setenv ("XDG_DATA_HOME", xdg_location, TRUE));
+		g_assert_true (g_setenv ("XDG_CACHE_HOME", xdg_location, TRUE));
+		g_assert_true (g_setenv ("TRACKER_DB_ONTOLOGIES_DIR", TOP_SRCDIR "/src/ontologies/", TRUE));
+	}
+}
+
+void
+test_data_teardown (TestInfo      *info,
+                    gconstpointer  context)
+{
+	gchar *cleanup_command;
+
+	cleanup_command = g_strdup_printf ("rm -Rf %s/", xdg_location);
+	g_spawn_command_line_sync (cleanup_command, NULL, NULL, NULL, NULL);
+	g_free (cleanup_command);
+
+	g_free (xdg_location);
+	xdg_location = NULL;
+}
+
+void
+test_data_init_data_manager (TrackerDBManagerFlags flags)
+{
+	GError *error = NULL;
+
+	tracker_db_journal_set_rotating (FALSE, G_MAXSIZE, NULL);
+
+	tracker_data_manager_init (flags,
+	                           NULL,
+	                           NULL,
+	                           FALSE,
+	                           FALSE,
+	                           100,
+	                           100,
+	                           NULL,
+	                           NULL,
+	                           NULL,
+	                           &error);
+
+	g_assert_no_error (error);
+}
+
+/* Returns the first column of all rows, separated by spaces */
+gchar *
+test_data_query_column (const gchar *query)
+{
+	TrackerDBCursor *cursor;
+	GError *error = NULL;
+	GString *result;
+
+	cursor = tracker_data_query_sparql_cursor (query, &error);
+	g_assert_no_error (error);
+
+	result = g_string_new (NULL);
+
+	while (tracker_db_cursor_iter_next (cursor, NULL, &error)) {
+		if (result->len > 0) {
+			g_string_append_c (result, ' ');
+		}
+		g_string_append (result, tracker_db_cursor_get_string (cursor, 0, NULL));
+	}
+
+	g_assert_no_error (error);
+	g_object_unref (cursor);
+
+	return g_string_free (result, FALSE);
+}
+
+void
+test_data_assert_query (const gchar *query,
+                        const gchar *expected)
+{
+	gchar *result;
+
+	result = test_data_query_column (query);
+	g_assert_cmpstr (result, ==, expected);
+	g_free (result);
+}
@@ -0,0 +1,44 @@
+/*
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ * Boston, MA  02110-1301, USA.
+ */
+
+#ifndef __TRACKER_DATA_TEST_COMMON__
+#define __TRACKER_DATA_TEST_COMMON__
+
+#include <glib.h>
+
+#include <libtracker-data/tracker-data.h>
+
+typedef struct {
+	void *user_data;
+} TestInfo;
+
+void         test_data_init               (gint                    *argc,
+                                           gchar                 ***argv);
+gint         test_data_run                (void);
+const gchar *test_data_get_location       (void);
+
+void         test_data_setup              (TestInfo                *info,
+                                           gconstpointer            context);
+void         test_data_teardown           (TestInfo                *info,
+                                           gconstpointer            context);
+
+void         test_data_init_data_manager  (TrackerDBManagerFlags    flags);
+gchar       *test_data_query_column       (const gchar             *query);
+void         test_data_assert_query       (const gchar             *query,
+                                           const gchar             *expected);
+
+#endif
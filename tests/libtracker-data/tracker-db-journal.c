@@ -19,6 +19,8 @@
 
 #include "config.h"
 
+#include <stdio.h>
+
 #include <glib/gstdio.h>
 
 #include <libtracker-data/tracker-db-journal.h>
@@ -355,6 +357,166 @@ test_read_functions (void)
 	g_free (path);
 }
 
+static void
+test_verify_large_journal (void)
+{
+	GError *error = NULL;
+	gchar *path, *value;
+	gsize damaged_at = 0;
+	gint i, n_transactions = 0;
+	FILE *file;
+
+	/* Big enough for the checksums to be verified in parallel */
+	path = g_build_filename (TOP_BUILDDIR, "tests", "libtracker-db", "tracker-store-large.journal", NULL);
+	g_unlink (path);
+
+	tracker_db_journal_set_rotating (FALSE, G_MAXSIZE, NULL);
+	tracker_db_journal_init (path, FALSE, &error);
+	g_assert_no_error (error);
+
+	value = g_strnfill (500, 'x');
+
+	for (i = 0; i < 20000; i++) {
+		if (i == 15000) {
+			damaged_at = tracker_db_journal_get_size ();
+		}
+
+		tracker_db_journal_start_transaction (time (NULL));
+		tracker_db_journal_append_insert_statement (0, i + 1, 2, value);
+		tracker_db_journal_commit_db_transaction (&error);
+		g_assert_no_error (error);
+	}
+
+	g_free (value);
+
+	tracker_db_journal_shutdown (&error);
+	g_assert_no_error (error);
+
+	/* Damage the value of one transaction in the middle */
+	file = g_fopen (path, "r+b");
+	g_assert (file != NULL);
+	g_assert_cmpint (fseek (file, damaged_at + 100, SEEK_SET), ==, 0);
+	g_assert_cmpint (fputc ('y', file), !=, EOF);
+	fclose (file);
+
+	tracker_db_journal_reader_init (path, &error);
+	g_assert_no_error (error);
+
+	while (tracker_db_journal_reader_next (&error)) {
+		if (tracker_db_journal_reader_get_type () == TRACKER_DB_JOURNAL_START_TRANSACTION) {
+			n_transactions++;
+		}
+	}
+
+	/* Everything before the damaged transaction is read */
+	g_assert_error (error, TRACKER_DB_JOURNAL_ERROR, TRACKER_DB_JOURNAL_ERROR_DAMAGED_JOURNAL_ENTRY);
+	g_assert_cmpint (n_transactions, ==, 15000);
+	g_clear_error (&error);
+
+	tracker_db_journal_reader_shutdown ();
+
+	g_unlink (path);
+	g_free (path);
+}
+
+static void
+test_rotate_and_read (void)
+{
+	GError *error = NULL;
+	gchar *directory, *path, *chunk, *stale, *value;
+	gint i, n_transactions = 0;
+	GDir *dir;
+	const gchar *f_name;
+
+	directory = g_build_filename (TOP_BUILDDIR, "tests", "libtracker-db", "rotate", NULL);
+	path = g_build_filename (directory, "tracker-store.journal", NULL);
+	chunk = g_strconcat (path, ".1", NULL);
+	stale = g_strconcat (path, ".1.gz.tmp", NULL);
+
+	g_mkdir_with_parents (directory, 0700);
+	dir = g_dir_open (directory, 0, NULL);
+	g_assert (dir != NULL);
+
+	while ((f_name = g_dir_read_name (dir)) != NULL) {
+		gchar *fullpath = g_build_filename (directory, f_name, NULL);
+		g_unlink (fullpath);
+		g_free (fullpath);
+	}
+
+	g_dir_close (dir);
+
+	/* Left behind by compression that got interrupted */
+	g_assert (g_file_set_contents (stale, "incomplete", -1, NULL));
+
+	tracker_db_journal_set_rotating (TRUE, 64 * 1024, NULL);
+	tracker_db_journal_init (path, FALSE, &error);
+	g_assert_no_error (error);
+
+	g_assert (!g_file_test (stale, G_FILE_TEST_EXISTS));
+
+	/* Several chunks worth, each compressed once rotated */
+	for (i = 0; i < 2000; i++) {
+		value = g_strdup_printf ("value %d %0200d", i, i);
+
+		tracker_db_journal_start_transaction (time (NULL));
+		tracker_db_journal_append_insert_statement (0, i + 1, 2, value);
+		tracker_db_journal_commit_db_transaction (&error);
+		g_assert_no_error (error);
+
+		g_free (value);
+	}
+
+	/* Waits for the compression of the last chunk */
+	tracker_db_journal_shutdown (&error);
+	g_assert_no_error (error);
+
+	g_assert (!g_file_test (chunk, G_FILE_TEST_EXISTS));
+	g_free (chunk);
+	chunk = g_strconcat (path, ".1.gz", NULL);
+	g_assert (g_file_test (chunk, G_FILE_TEST_EXISTS));
+
+	tracker_db_journal_reader_init (path, &error);
+	g_assert_no_error (error);
+
+	while (tracker_db_journal_reader_next (&error)) {
+		TrackerDBJournalEntryType type = tracker_db_journal_reader_get_type ();
+
+		if (type == TRACKER_DB_JOURNAL_START_TRANSACTION) {
+			n_transactions++;
+		} else if (type == TRACKER_DB_JOURNAL_INSERT_STATEMENT) {
+			gint g_id, s_id, p_id;
+			const gchar *object;
+
+			tracker_db_journal_reader_get_statement (&g_id, &s_id, &p_id, &object);
+			g_assert_cmpint (s_id, ==, n_transactions);
+
+			value = g_strdup_printf ("value %d %0200d", s_id - 1, s_id - 1);
+			g_assert_cmpstr (object, ==, value);
+			g_free (value);
+		}
+	}
+
+	g_assert_no_error (error);
+	g_assert_cmpint (n_transactions, ==, 2000);
+
+	tracker_db_journal_reader_shutdown ();
+	tracker_db_journal_set_rotating (FALSE, G_MAXSIZE, NULL);
+
+	dir = g_dir_open (directory, 0, NULL);
+	while ((f_name = g_dir_read_name (dir)) != NULL) {
+		gchar *fullpath = g_build_filename (directory, f_name, NULL);
+		g_unlink (fullpath);
+		g_free (fullpath);
+	}
+	g_dir_close (dir);
+	g_rmdir (directory);
+
+	g_free (stale);
+	g_free (chunk);
+	g_free (path);
+	g_free (directory);
+}
+
 #endif /* DISABLE_JOURNAL */
 
 int
@@ -373,6 +535,10 @@ main (int argc, char **argv)
 	                 test_write_functions);
 	g_test_add_func ("/libtracker-db/tracker-db-journal/read-functions",
 	                 test_read_functions);
+	g_test_add_func ("/libtracker-db/tracker-db-journal/verify-large-journal",
+	                 test_verify_large_journal);
+	g_test_add_func ("/libtracker-db/tracker-db-journal/rotate-and-read",
+	                 test_rotate_and_read);
 #endif /* DISABLE_JOURNAL */
 
 	result = g_test_run ();
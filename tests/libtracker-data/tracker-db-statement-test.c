@@ -0,0 +1,209 @@
+/*
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ * Boston, MA  02110-1301, USA.
+ */
+
+#include "config.h"
+
+#include <glib/gstdio.h>
+
+#include <libtracker-common/tracker-locale.h>
+#include <libtracker-data/tracker-db-interface-sqlite.h>
+
+#define N_TABLES 8
+#define N_LOOKUPS 200000
+
+static const gchar *table_names[N_TABLES] = {
+	"nfo:Document", "nfo:FileDataObject", "nie:InformationElement", "nmm:MusicPiece",
+	"nmm:Photo", "nco:Contact", "nmo:Email", "nfo:Folder"
+};
+
+static gchar *db_path;
+
+static TrackerDBInterface *
+create_interface (guint cache_size)
+{
+	TrackerDBInterface *iface;
+	GError *error = NULL;
+	gint i;
+
+	g_unlink (db_path);
+
+	iface = tracker_db_interface_sqlite_new (db_path, &error);
+	g_assert_no_error (error);
+
+	tracker_db_interface_set_max_stmt_cache_size (iface, TRACKER_DB_STATEMENT_CACHE_TYPE_UPDATE, cache_size);
+
+	for (i = 0; i < N_TABLES; i++) {
+		tracker_db_interface_execute_query (iface, &error,
+		                                    "CREATE TABLE \"%s\" (ID INTEGER NOT NULL PRIMARY KEY)",
+		                                    table_names[i]);
+		g_assert_no_error (error);
+	}
+
+	return iface;
+}
+
+static void
+test_keyed_statement_reuse (void)
+{
+	TrackerDBInterface *iface;
+	TrackerDBStatement *stmt1, *stmt2;
+	GError *error = NULL;
+
+	iface = create_interface (100);
+
+	stmt1 = tracker_db_interface_create_keyed_statement (iface, TRACKER_DB_STATEMENT_CACHE_TYPE_UPDATE,
+	                                                     table_names[0], &error,
+	                                                     "DELETE FROM \"%s\" WHERE ID = ?",
+	                                                     table_names[0]);
+	g_assert_no_error (error);
+	g_object_unref (stmt1);
+
+	/* same key, same statement */
+	stmt2 = tracker_db_interface_create_keyed_statement (iface, TRACKER_DB_STATEMENT_CACHE_TYPE_UPDATE,
+	                                                     table_names[0], &error,
+	                                                     "DELETE FROM \"%s\" WHERE ID = ?",
+	                                                     table_names[0]);
+	g_assert_no_error (error);
+	g_assert (stmt1 == stmt2);
+	g_object_unref (stmt2);
+
+	/* regular lookup finds the same statement */
+	stmt2 = tracker_db_interface_create_statement (iface, TRACKER_DB_STATEMENT_CACHE_TYPE_UPDATE, &error,
+	                                               "DELETE FROM \"%s\" WHERE ID = ?",
+	                                               table_names[0]);
+	g_assert_no_error (error);
+	g_assert (stmt1 == stmt2);
+	g_object_unref (stmt2);
+
+	/* different key, different statement */
+	stmt2 = tracker_db_interface_create_keyed_statement (iface, TRACKER_DB_STATEMENT_CACHE_TYPE_UPDATE,
+	                                                     table_names[1], &error,
+	                                                     "DELETE FROM \"%s\" WHERE ID = ?",
+	                                                     table_names[1]);
+	g_assert_no_error (error);
+	g_assert (stmt1 != stmt2);
+	g_object_unref (stmt2);
+
+	g_object_unref (iface);
+}
+
+static void
+test_keyed_statement_eviction (void)
+{
+	TrackerDBInterface *iface;
+	TrackerDBStatement *stmt;
+	GError *error = NULL;
+	gint i, j;
+
+	/* Cache is smaller than the number of statements, entries get
+	 * evicted all the time and must be dropped from the key table too */
+	iface = create_interface (3);
+
+	for (j = 0; j < 10; j++) {
+		for (i = 0; i < N_TABLES; i++) {
+			stmt = tracker_db_interface_create_keyed_statement (iface, TRACKER_DB_STATEMENT_CACHE_TYPE_UPDATE,
+			                                                    table_names[i], &error,
+			                                                    "INSERT INTO \"%s\" (ID) VALUES (?)",
+			                                                    table_names[i]);
+			g_assert_no_error (error);
+
+			tracker_db_statement_bind_int (stmt, 0, j);
+			tracker_db_statement_execute (stmt, &error);
+			g_assert_no_error (error);
+			g_object_unref (stmt);
+		}
+	}
+
+	g_object_unref (iface);
+}
+
+static void
+test_statement_cache_perf (void)
+{
+	TrackerDBInterface *iface;
+	TrackerDBStatement *stmt;
+	GError *error = NULL;
+	gdouble formatted, keyed;
+	gint i;
+
+	if (!g_test_perf ()) {
+		return;
+	}
+
+	iface = create_interface (100);
+
+	g_test_timer_start ();
+
+	for (i = 0; i < N_LOOKUPS; i++) {
+		stmt = tracker_db_interface_create_statement (iface, TRACKER_DB_STATEMENT_CACHE_TYPE_UPDATE, &error,
+		                                              "DELETE FROM \"%s\" WHERE ID = ?",
+		                                              table_names[i % N_TABLES]);
+		g_object_unref (stmt);
+	}
+
+	formatted = g_test_timer_elapsed ();
+
+	g_test_timer_start ();
+
+	for (i = 0; i < N_LOOKUPS; i++) {
+		stmt = tracker_db_interface_create_keyed_statement (iface, TRACKER_DB_STATEMENT_CACHE_TYPE_UPDATE,
+		                                                    table_names[i % N_TABLES], &error,
+		                                                    "DELETE FROM \"%s\" WHERE ID = ?",
+		                                                    table_names[i % N_TABLES]);
+		g_object_unref (stmt);
+	}
+
+	keyed = g_test_timer_elapsed ();
+
+	g_assert_no_error (error);
+
+	g_test_message ("Statement lookup: formatted %.1f ns, keyed %.1f ns",
+	                formatted * 1e9 / N_LOOKUPS,
+	                keyed * 1e9 / N_LOOKUPS);
+	g_test_minimized_result (keyed * 1e9 / N_LOOKUPS, "keyed statement lookup %.1f ns",
+	                         keyed * 1e9 / N_LOOKUPS);
+
+	g_object_unref (iface);
+}
+
+gint
+main (gint argc, gchar **argv)
+{
+	gint result;
+
+	g_test_init (&argc, &argv, NULL);
+
+	tracker_locale_init ();
+
+	db_path = g_build_filename (TOP_BUILDDIR, "tests", "libtracker-data", "statement-test.db", NULL);
+
+	g_test_add_func ("/libtracker-data/db-statement/keyed-reuse",
+	                 test_keyed_statement_reuse);
+	g_test_add_func ("/libtracker-data/db-statement/keyed-eviction",
+	                 test_keyed_statement_eviction);
+	g_test_add_func ("/libtracker-data/db-statement/perf",
+	                 test_statement_cache_perf);
+
+	result = g_test_run ();
+
+	g_unlink (db_path);
+	g_free (db_path);
+
+	tracker_locale_shutdown ();
+
+	return result;
+}
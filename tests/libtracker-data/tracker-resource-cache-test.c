@@ -0,0 +1,107 @@
+/*
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ * Boston, MA  02110-1301, USA.
+ */
+
+#include "config.h"
+
+#include <glib.h>
+#include <gio/gio.h>
+
+#include <libtracker-data/tracker-data-manager.h>
+#include <libtracker-data/tracker-data-query.h>
+#include <libtracker-data/tracker-data-update.h>
+#include <libtracker-data/tracker-data.h>
+
+#include "tracker-data-test-common.h"
+
+static void
+test_cache_hits (TestInfo      *info,
+                 gconstpointer  context)
+{
+	GError *error = NULL;
+	guint64 hits, misses, old_hits;
+	gint id;
+
+	test_data_init_data_manager (TRACKER_DB_MANAGER_FORCE_REINDEX);
+
+	tracker_data_update_sparql ("INSERT { <urn:test:cached> a rdfs:Resource }", &error);
+	g_assert_no_error (error);
+
+	tracker_data_query_resource_cache_get_stats (&old_hits, NULL, NULL);
+
+	/* added to the cache on commit */
+	id = tracker_data_query_resource_id ("urn:test:cached");
+	g_assert_cmpint (id, >, 0);
+	g_assert_cmpint (tracker_data_query_resource_id ("urn:test:cached"), ==, id);
+
+	tracker_data_query_resource_cache_get_stats (&hits, &misses, NULL);
+	g_assert_cmpuint (hits, ==, old_hits + 2);
+
+	/* unknown resources are looked up every time */
+	g_assert_cmpint (tracker_data_query_resource_id ("urn:test:missing"), ==, 0);
+	g_assert_cmpint (tracker_data_query_resource_id ("urn:test:missing"), ==, 0);
+
+	tracker_data_query_resource_cache_get_stats (NULL, &old_hits, NULL);
+	g_assert_cmpuint (old_hits, ==, misses + 2);
+
+	tracker_data_manager_shutdown ();
+}
+
+static void
+test_cache_rollback (TestInfo      *info,
+                     gconstpointer  context)
+{
+	GError *error = NULL;
+	guint size;
+
+	test_data_init_data_manager (TRACKER_DB_MANAGER_FORCE_REINDEX);
+
+	tracker_data_begin_transaction (&error);
+	g_assert_no_error (error);
+
+	tracker_data_insert_statement (NULL, "urn:test:rolled-back",
+	                               "http://www.w3.org/1999/02/22-rdf-syntax-ns#type",
+	                               "http://www.w3.org/2000/01/rdf-schema#Resource",
+	                               &error);
+	g_assert_no_error (error);
+
+	tracker_data_update_buffer_flush (&error);
+	g_assert_no_error (error);
+
+	/* visible within the transaction, but not cached */
+	g_assert_cmpint (tracker_data_query_resource_id ("urn:test:rolled-back"), >, 0);
+
+	tracker_data_rollback_transaction ();
+
+	g_assert_cmpint (tracker_data_query_resource_id ("urn:test:rolled-back"), ==, 0);
+
+	tracker_data_manager_shutdown ();
+
+	/* IDs are per database */
+	tracker_data_query_resource_cache_get_stats (NULL, NULL, &size);
+	g_assert_cmpuint (size, ==, 0);
+}
+
+int
+main (int argc, char **argv)
+{
+	test_data_init (&argc, &argv);
+
+	g_test_add ("/libtracker-data/resource-cache/hits", TestInfo, NULL, test_data_setup, test_cache_hits, test_data_teardown);
+	g_test_add ("/libtracker-data/resource-cache/rollback", TestInfo, NULL, test_data_setup, test_cache_rollback, test_data_teardown);
+
+	return test_data_run ();
+}
@@ -0,0 +1,184 @@
+/*
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ * Boston, MA  02110-1301, USA.
+ */
+
+#include "config.h"
+
+#include <glib.h>
+#include <gio/gio.h>
+
+#include <libtracker-data/tracker-data-manager.h>
+#include <libtracker-data/tracker-data-query.h>
+#include <libtracker-data/tracker-data-update.h>
+#include <libtracker-data/tracker-data.h>
+#include <libtracker-sparql/tracker-sparql.h>
+
+#include "tracker-data-test-common.h"
+
+static void
+init_data_manager (void)
+{
+	GError *error = NULL;
+
+	test_data_init_data_manager (TRACKER_DB_MANAGER_FORCE_REINDEX);
+
+	/* ties and an unbound ORDER BY key */
+	tracker_data_update_sparql ("INSERT { <urn:test:1> a nie:InformationElement ; nie:title 'b' . "
+	                            "         <urn:test:2> a nie:InformationElement ; nie:title 'a' . "
+	                            "         <urn:test:3> a nie:InformationElement ; nie:title 'b' . "
+	                            "         <urn:test:4> a nie:InformationElement ; nie:title 'c' . "
+	                            "         <urn:test:5> a nie:InformationElement . "
+	                            "         <urn:test:6> a nie:InformationElement ; nie:title 'b' }",
+	                            &error);
+	g_assert_no_error (error);
+}
+
+/* Appends the first column of all rows to result, returns the
+ * continuation of the last row */
+static gchar *
+query_page (const gchar *query,
+            const gchar *continuation,
+            GString     *result)
+{
+	TrackerDBCursor *cursor;
+	GError *error = NULL;
+	gchar *last = NULL;
+
+	cursor = tracker_data_query_sparql_cursor_continue (query, continuation, &error);
+	g_assert_no_error (error);
+
+	/* the keys are not part of the result */
+	g_assert_cmpint (tracker_db_cursor_get_n_columns (cursor), ==, 1);
+
+	while (tracker_db_cursor_iter_next (cursor, NULL, &error)) {
+		if (result->len > 0) {
+			g_string_append_c (result, ' ');
+		}
+		g_string_append (result, tracker_db_cursor_get_string (cursor, 0, NULL));
+
+		g_free (last);
+		last = tracker_sparql_cursor_get_continuation (TRACKER_SPARQL_CURSOR (cursor));
+		g_assert (last != NULL);
+	}
+
+	g_assert_no_error (error);
+	g_object_unref (cursor);
+
+	return last;
+}
+
+/* Pages through the query with continuations, the result needs to be
+ * the same as the one of the query without LIMIT */
+static void
+assert_pages (const gchar *query,
+              gint         page_size)
+{
+	GString *expected, *result;
+	gchar *paged_query;
+	gchar *continuation = NULL;
+	gint n_pages = 0;
+
+	expected = g_string_new (NULL);
+	g_free (query_page (query, NULL, expected));
+
+	paged_query = g_strdup_printf ("%s LIMIT %d", query, page_size);
+	result = g_string_new (NULL);
+
+	do {
+		gchar *next;
+
+		next = query_page (paged_query, continuation, result);
+		g_free (continuation);
+		continuation = next;
+		n_pages++;
+	} while (continuation != NULL);
+
+	g_assert_cmpstr (result->str, ==, expected->str);
+	g_assert_cmpint (n_pages, ==, (6 + page_size - 1) / page_size + 1);
+
+	g_string_free (expected, TRUE);
+	g_string_free (result, TRUE);
+	g_free (paged_query);
+}
+
+static void
+test_continuation_pages (TestInfo      *info,
+                         gconstpointer  context)
+{
+	const gchar *query = "SELECT ?s WHERE { ?s a nie:InformationElement OPTIONAL { ?s nie:title ?t } } ORDER BY ?t";
+	GString *result;
+
+	init_data_manager ();
+
+	/* the unbound title sorts first */
+	result = g_string_new (NULL);
+	g_free (query_page (query, NULL, result));
+	g_assert (g_str_has_prefix (result->str, "urn:test:5 urn:test:2 "));
+	g_string_free (result, TRUE);
+
+	assert_pages (query, 1);
+	assert_pages (query, 2);
+	assert_pages (query, 4);
+	assert_pages ("SELECT ?s WHERE { ?s a nie:InformationElement OPTIONAL { ?s nie:title ?t } } ORDER BY DESC(?t)", 1);
+	assert_pages ("SELECT ?s WHERE { ?s a nie:InformationElement OPTIONAL { ?s nie:title ?t } } ORDER BY DESC(?t) ?s", 2);
+	assert_pages ("SELECT ?s WHERE { ?s a nie:InformationElement OPTIONAL { ?s nie:title ?t } } ORDER BY ?t DESC(?s)", 4);
+
+	tracker_data_manager_shutdown ();
+}
+
+static void
+test_continuation_unsupported (TestInfo      *info,
+                               gconstpointer  context)
+{
+	const gchar *query = "SELECT DISTINCT ?t WHERE { ?s nie:title ?t } ORDER BY ?t";
+	TrackerDBCursor *cursor;
+	GError *error = NULL;
+
+	init_data_manager ();
+
+	/* queries that can not be continued just lack continuations */
+	cursor = tracker_data_query_sparql_cursor_continue (query, NULL, &error);
+	g_assert_no_error (error);
+	g_assert (tracker_db_cursor_iter_next (cursor, NULL, &error));
+	g_assert_no_error (error);
+	g_assert (tracker_sparql_cursor_get_continuation (TRACKER_SPARQL_CURSOR (cursor)) == NULL);
+	g_object_unref (cursor);
+
+	cursor = tracker_data_query_sparql_cursor_continue (query, "[<'a'>]", &error);
+	g_assert_error (error, TRACKER_SPARQL_ERROR, TRACKER_SPARQL_ERROR_UNSUPPORTED);
+	g_assert (cursor == NULL);
+	g_clear_error (&error);
+
+	/* continuations of other queries are rejected */
+	cursor = tracker_data_query_sparql_cursor_continue ("SELECT ?s WHERE { ?s nie:title ?t } ORDER BY ?t",
+	                                                    "[<'a'>]", &error);
+	g_assert_error (error, TRACKER_SPARQL_ERROR, TRACKER_SPARQL_ERROR_PARSE);
+	g_assert (cursor == NULL);
+	g_clear_error (&error);
+
+	tracker_data_manager_shutdown ();
+}
+
+int
+main (int argc, char **argv)
+{
+	test_data_init (&argc, &argv);
+
+	g_test_add ("/libtracker-data/sparql-continuation/pages", TestInfo, NULL, test_data_setup, test_continuation_pages, test_data_teardown);
+	g_test_add ("/libtracker-data/sparql-continuation/unsupported", TestInfo, NULL, test_data_setup, test_continuation_unsupported, test_data_teardown);
+
+	return test_data_run ();
+}
@@ -0,0 +1,160 @@
+/*
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ * Boston, MA  02110-1301, USA.
+ */
+
+#include "config.h"
+
+#include <string.h>
+
+#include <glib.h>
+#include <gio/gio.h>
+
+#include <libtracker-data/tracker-data-manager.h>
+#include <libtracker-data/tracker-data-query.h>
+#include <libtracker-data/tracker-data-update.h>
+#include <libtracker-data/tracker-data.h>
+
+#include "tracker-data-test-common.h"
+
+#define N_ELEMENTS 200
+#define N_SONGS 5
+
+static void
+init_data_manager (void)
+{
+	GError *error = NULL;
+	GString *update;
+	gint i;
+
+	test_data_init_data_manager (TRACKER_DB_MANAGER_FORCE_REINDEX);
+
+	update = g_string_new ("INSERT { <urn:test:album> a nmm:MusicAlbum ; nie:title 'album' .");
+	for (i = 0; i < N_ELEMENTS; i++) {
+		g_string_append_printf (update,
+		                        " <urn:test:element%d> a nie:InformationElement ; nie:title 'element %d' .",
+		                        i, i);
+	}
+	for (i = 0; i < N_SONGS; i++) {
+		g_string_append_printf (update,
+		                        " <urn:test:song%d> a nmm:MusicPiece ; nie:title 'song %d' ;"
+		                        " nmm:musicAlbum <urn:test:album> .",
+		                        i, i);
+	}
+	g_string_append (update, " }");
+
+	tracker_data_update_sparql (update->str, &error);
+	g_assert_no_error (error);
+	g_string_free (update, TRUE);
+}
+
+static gchar *
+explain (const gchar *query)
+{
+	GError *error = NULL;
+	gchar *result;
+
+	result = tracker_data_query_explain (query, &error);
+	g_assert_no_error (error);
+
+	return result;
+}
+
+static void
+test_join_order (TestInfo      *info,
+                 gconstpointer  context)
+{
+	const gchar *query;
+	gchar *result, *songs, *album, *titles;
+
+	init_data_manager ();
+
+	/* the album is joined first, then the songs on it,
+	 * the reverse of the order in the query */
+	query = "SELECT ?t WHERE { ?s nie:title ?t . ?s nmm:musicAlbum ?a . ?a nie:title 'album' } ORDER BY ?t";
+
+	result = explain (query);
+	g_assert (g_str_has_prefix (result, "join order: "));
+
+	album = strstr (result, "nmm:MusicAlbum3");
+	songs = strstr (result, "nmm:MusicPiece2");
+	titles = strstr (result, "nie:InformationElement1");
+	g_assert (album != NULL && songs != NULL && titles != NULL);
+	g_assert (album < songs);
+	g_assert (songs < titles);
+
+	g_assert (strstr (result, "query plan: ") != NULL);
+	g_free (result);
+
+	test_data_assert_query (query, "song 0 song 1 song 2 song 3 song 4");
+
+	/* unique subjects come first */
+	result = explain ("SELECT ?t WHERE { ?s nie:title ?t . <urn:test:album> nie:title ?t }");
+	g_assert (g_str_has_prefix (result, "join order: nie:InformationElement2 (~1 rows)"));
+	g_free (result);
+
+	tracker_data_manager_shutdown ();
+}
+
+static void
+test_filter_push_down (TestInfo      *info,
+                       gconstpointer  context)
+{
+	const gchar *query;
+	gchar *result;
+
+	init_data_manager ();
+
+	query = "SELECT ?t ?a WHERE { ?s nie:title ?t . OPTIONAL { ?s nmm:musicAlbum ?a } "
+	        "FILTER (?t > 'song 2') } ORDER BY ?t";
+
+	result = explain (query);
+	g_assert (strstr (result, "pushed down filter: ") != NULL);
+	g_free (result);
+
+	test_data_assert_query (query, "song 3 song 4");
+
+	/* the filter depends on the optional part */
+	query = "SELECT ?t WHERE { ?s nie:title ?t . OPTIONAL { ?s nmm:musicAlbum ?a } "
+	        "FILTER (!BOUND (?a) && ?t > 'element 98') } ORDER BY ?t";
+
+	result = explain (query);
+	g_assert (strstr (result, "pushed down filter: ") == NULL);
+	g_free (result);
+
+	test_data_assert_query (query, "element 99");
+
+	query = "SELECT ?t WHERE { ?s nie:title ?t . OPTIONAL { ?s nmm:musicAlbum ?a } "
+	        "FILTER (?a = <urn:test:album> && ?t > 'song 3') } ORDER BY ?t";
+
+	result = explain (query);
+	g_assert (strstr (result, "pushed down filter: ") == NULL);
+	g_free (result);
+
+	test_data_assert_query (query, "song 4");
+
+	tracker_data_manager_shutdown ();
+}
+
+int
+main (int argc, char **argv)
+{
+	test_data_init (&argc, &argv);
+
+	g_test_add ("/libtracker-data/sparql-join-order/join-order", TestInfo, NULL, test_data_setup, test_join_order, test_data_teardown);
+	g_test_add ("/libtracker-data/sparql-join-order/filter-push-down", TestInfo, NULL, test_data_setup, test_filter_push_down, test_data_teardown);
+
+	return test_data_run ();
+}
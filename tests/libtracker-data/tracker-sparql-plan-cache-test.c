@@ -0,0 +1,116 @@
+/*
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ * Boston, MA  02110-1301, USA.
+ */
+
+#include "config.h"
+
+#include <glib.h>
+#include <gio/gio.h>
+
+#include <libtracker-data/tracker-data-manager.h>
+#include <libtracker-data/tracker-data-query.h>
+#include <libtracker-data/tracker-data-update.h>
+#include <libtracker-data/tracker-data.h>
+#include <libtracker-data/tracker-sparql-query.h>
+
+#include "tracker-data-test-common.h"
+
+static void
+init_data_manager (void)
+{
+	GError *error = NULL;
+
+	test_data_init_data_manager (TRACKER_DB_MANAGER_FORCE_REINDEX);
+
+	tracker_data_update_sparql ("INSERT { <urn:test:a> a nie:InformationElement ; nie:title 'a' . "
+	                            "         <urn:test:b> a nie:InformationElement ; nie:title 'b' . "
+	                            "         <urn:test:c> a nie:InformationElement ; nie:title 'c' }",
+	                            &error);
+	g_assert_no_error (error);
+}
+
+static void
+test_plan_cache_literals (TestInfo      *info,
+                          gconstpointer  context)
+{
+	guint64 hits, misses, old_hits;
+	gint64 saved_time;
+	guint size;
+
+	init_data_manager ();
+
+	test_data_assert_query ("SELECT ?s WHERE { ?s nie:title 'a' }", "urn:test:a");
+
+	tracker_sparql_query_get_plan_cache_stats (&old_hits, &misses, &saved_time, &size);
+
+	/* same shape, values are bound per query */
+	test_data_assert_query ("SELECT ?s WHERE { ?s nie:title 'b' }", "urn:test:b");
+	test_data_assert_query ("SELECT  ?s  WHERE {\n?s nie:title 'c' }", "urn:test:c");
+	test_data_assert_query ("SELECT ?s WHERE { ?s nie:title 'd' }", "");
+	test_data_assert_query ("SELECT ?s WHERE { ?s nie:title ?t FILTER (?t > 'a') } ORDER BY ?t", "urn:test:b urn:test:c");
+	test_data_assert_query ("SELECT ?s WHERE { ?s nie:title ?t FILTER (?t > 'b') } ORDER BY ?t", "urn:test:c");
+
+	tracker_sparql_query_get_plan_cache_stats (&hits, NULL, NULL, NULL);
+	g_assert_cmpuint (hits, ==, old_hits + 4);
+
+	tracker_data_manager_shutdown ();
+
+	tracker_sparql_query_get_plan_cache_stats (NULL, NULL, NULL, &size);
+	g_assert_cmpuint (size, ==, 0);
+}
+
+static void
+test_plan_cache_limit (TestInfo      *info,
+                       gconstpointer  context)
+{
+	init_data_manager ();
+
+	test_data_assert_query ("SELECT ?s WHERE { ?s nie:title ?t } ORDER BY ?t LIMIT 1", "urn:test:a");
+	test_data_assert_query ("SELECT ?s WHERE { ?s nie:title ?t } ORDER BY ?t LIMIT 2", "urn:test:a urn:test:b");
+	test_data_assert_query ("SELECT ?s WHERE { ?s nie:title ?t } ORDER BY ?t LIMIT 1 OFFSET 2", "urn:test:c");
+
+	tracker_data_manager_shutdown ();
+}
+
+static void
+test_plan_cache_inline_literals (TestInfo      *info,
+                                 gconstpointer  context)
+{
+	init_data_manager ();
+
+	/* REGEX patterns are part of the SQL, plans must not be shared */
+	test_data_assert_query ("SELECT ?s WHERE { ?s nie:title ?t FILTER (REGEX (?t, '^a')) }", "urn:test:a");
+	test_data_assert_query ("SELECT ?s WHERE { ?s nie:title ?t FILTER (REGEX (?t, '^b')) }", "urn:test:b");
+	test_data_assert_query ("SELECT ?s WHERE { ?s nie:title ?t FILTER (REGEX (?t, '^a')) }", "urn:test:a");
+
+	/* the same goes for string functions */
+	test_data_assert_query ("SELECT ?s WHERE { ?s nie:title ?t FILTER (fn:starts-with (?t, 'b')) }", "urn:test:b");
+	test_data_assert_query ("SELECT ?s WHERE { ?s nie:title ?t FILTER (fn:starts-with (?t, 'c')) }", "urn:test:c");
+
+	tracker_data_manager_shutdown ();
+}
+
+int
+main (int argc, char **argv)
+{
+	test_data_init (&argc, &argv);
+
+	g_test_add ("/libtracker-data/sparql-plan-cache/literals", TestInfo, NULL, test_data_setup, test_plan_cache_literals, test_data_teardown);
+	g_test_add ("/libtracker-data/sparql-plan-cache/limit", TestInfo, NULL, test_data_setup, test_plan_cache_limit, test_data_teardown);
+	g_test_add ("/libtracker-data/sparql-plan-cache/inline-literals", TestInfo, NULL, test_data_setup, test_plan_cache_inline_literals, test_data_teardown);
+
+	return test_data_run ();
+}
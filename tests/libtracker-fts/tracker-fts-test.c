@@ -40,9 +40,12 @@ const TestInfo tests[] = {
 	{ "fts3ae", 1 },
 	{ "prefix/fts3prefix", 3 },
 	{ "limits/fts3limits", 4 },
+	{ "rank/fts3rank", 2 },
 	{ NULL }
 };
 
+#define N_RANK_DOCUMENTS 100000
+
 static void
 test_sparql_query (gconstpointer test_data)
 {
@@ -168,6 +171,260 @@ test_sparql_query (gconstpointer test_data)
 	tracker_data_manager_shutdown ();
 }
 
+static gchar *
+query_subjects (const gchar *query)
+{
+	TrackerDBCursor *cursor;
+	GError *error = NULL;
+	GString *result;
+
+	cursor = tracker_data_query_sparql_cursor (query, &error);
+	g_assert_no_error (error);
+
+	result = g_string_new (NULL);
+	while (tracker_db_cursor_iter_next (cursor, NULL, &error)) {
+		if (result->len > 0) {
+			g_string_append_c (result, ' ');
+		}
+		g_string_append (result, tracker_db_cursor_get_string (cursor, 0, NULL));
+	}
+
+	g_assert_no_error (error);
+	g_object_unref (cursor);
+
+	return g_string_free (result, FALSE);
+}
+
+static void
+test_pending_updates (void)
+{
+	const gchar *test_schemas[2] = { NULL, NULL };
+	guint64 indexed, coalesced, old_indexed, old_coalesced;
+	GError *error = NULL;
+	gchar *data_prefix, *result;
+
+	data_prefix = g_build_path (G_DIR_SEPARATOR_S, TOP_SRCDIR, "tests", "libtracker-fts", "data", NULL);
+	test_schemas[0] = data_prefix;
+	tracker_db_journal_set_rotating (FALSE, G_MAXSIZE, NULL);
+	tracker_data_manager_init (TRACKER_DB_MANAGER_FORCE_REINDEX,
+	                           test_schemas,
+	                           NULL, FALSE, FALSE,
+	                           100, 100, NULL, NULL, NULL, &error);
+	g_assert_no_error (error);
+
+	tracker_data_get_fts_stats (&old_indexed, &old_coalesced, NULL);
+
+	/* test:1 is flushed twice, but indexed once at commit */
+	tracker_data_update_sparql ("INSERT { test:1 a test:A ; test:p 'first' . "
+	                            "         test:2 a test:A ; test:p 'second' . "
+	                            "         test:1 test:o 'third' }",
+	                            &error);
+	g_assert_no_error (error);
+
+	tracker_data_get_fts_stats (&indexed, &coalesced, NULL);
+	g_assert_cmpuint (indexed, ==, old_indexed + 2);
+	g_assert_cmpuint (coalesced, ==, old_coalesced + 1);
+
+	result = query_subjects ("SELECT ?o WHERE { ?o fts:match 'third' }");
+	g_assert_cmpstr (result, ==, "http://www.example.org/test#1");
+	g_free (result);
+
+	/* text changed again within one transaction */
+	tracker_data_update_sparql ("DELETE { test:2 test:p ?p } WHERE { test:2 test:p ?p } "
+	                            "INSERT { test:2 test:p 'fourth' . "
+	                            "         test:3 a test:A ; test:p 'fifth' } "
+	                            "DELETE { test:3 test:p ?p } WHERE { test:3 test:p ?p } "
+	                            "INSERT { test:3 test:p 'sixth' }",
+	                            &error);
+	g_assert_no_error (error);
+
+	result = query_subjects ("SELECT ?o WHERE { ?o fts:match 'second OR fifth' }");
+	g_assert_cmpstr (result, ==, "");
+	g_free (result);
+
+	result = query_subjects ("SELECT ?o WHERE { ?o fts:match 'fourth OR sixth' } ORDER BY ?o");
+	g_assert_cmpstr (result, ==, "http://www.example.org/test#2 http://www.example.org/test#3");
+	g_free (result);
+
+	g_free (data_prefix);
+
+	tracker_data_manager_shutdown ();
+}
+
+#define N_REBUILD_DOCUMENTS 1000
+
+static void
+test_rebuild (void)
+{
+	const gchar *test_schemas[2] = { NULL, NULL };
+	GError *error = NULL;
+	GString *update;
+	gchar *data_prefix, *result, *ranked;
+	gint i;
+
+	data_prefix = g_build_path (G_DIR_SEPARATOR_S, TOP_SRCDIR, "tests", "libtracker-fts", "data", NULL);
+	test_schemas[0] = data_prefix;
+	tracker_db_journal_set_rotating (FALSE, G_MAXSIZE, NULL);
+	tracker_data_manager_init (TRACKER_DB_MANAGER_FORCE_REINDEX,
+	                           test_schemas,
+	                           NULL, FALSE, FALSE,
+	                           100, 100, NULL, NULL, NULL, &error);
+	g_assert_no_error (error);
+
+	/* resources without text are not indexed */
+	update = g_string_new ("INSERT { test:empty a test:A . ");
+	for (i = 0; i < N_REBUILD_DOCUMENTS; i++) {
+		g_string_append_printf (update,
+		                        "test:%d a test:A ; test:p 'common word%d' ; test:o '%s' . ",
+		                        i, i, i % 10 == 0 ? "tenth common" : "other");
+	}
+	g_string_append (update, "}");
+
+	tracker_data_update_sparql (update->str, &error);
+	g_assert_no_error (error);
+	g_string_free (update, TRUE);
+
+	ranked = query_subjects ("SELECT ?o WHERE { ?o fts:match 'tenth OR word5' } "
+	                         "ORDER BY DESC (fts:rank (?o)) ?o");
+
+	tracker_data_manager_rebuild_fts (&error);
+	g_assert_no_error (error);
+
+	result = query_subjects ("SELECT COUNT (?o) WHERE { ?o fts:match 'common' }");
+	g_assert_cmpstr (result, ==, "1000");
+	g_free (result);
+
+	result = query_subjects ("SELECT ?o WHERE { ?o fts:match 'word123' }");
+	g_assert_cmpstr (result, ==, "http://www.example.org/test#123");
+	g_free (result);
+
+	/* document and token counts made it into the new index */
+	result = query_subjects ("SELECT ?o WHERE { ?o fts:match 'tenth OR word5' } "
+	                         "ORDER BY DESC (fts:rank (?o)) ?o");
+	g_assert_cmpstr (result, ==, ranked);
+	g_free (result);
+	g_free (ranked);
+
+	/* the new index takes further updates */
+	tracker_data_update_sparql ("DELETE { test:123 test:p ?p } WHERE { test:123 test:p ?p } "
+	                            "INSERT { test:123 test:p 'changed' . "
+	                            "         test:new a test:A ; test:p 'common' }",
+	                            &error);
+	g_assert_no_error (error);
+
+	result = query_subjects ("SELECT ?o WHERE { ?o fts:match 'word123 OR changed' }");
+	g_assert_cmpstr (result, ==, "http://www.example.org/test#123");
+	g_free (result);
+
+	result = query_subjects ("SELECT COUNT (?o) WHERE { ?o fts:match 'common' }");
+	g_assert_cmpstr (result, ==, "1000");
+	g_free (result);
+
+	tracker_data_fts_merge (1000, &error);
+	g_assert_no_error (error);
+
+	result = query_subjects ("SELECT COUNT (?o) WHERE { ?o fts:match 'word*' }");
+	g_assert_cmpstr (result, ==, "999");
+	g_free (result);
+
+	g_free (data_prefix);
+
+	tracker_data_manager_shutdown ();
+}
+
+static gdouble
+time_query (const gchar *query,
+            gint        *n_rows)
+{
+	TrackerDBCursor *cursor;
+	GError *error = NULL;
+
+	g_test_timer_start ();
+
+	cursor = tracker_data_query_sparql_cursor (query, &error);
+	g_assert_no_error (error);
+
+	*n_rows = 0;
+	while (tracker_db_cursor_iter_next (cursor, NULL, &error)) {
+		(*n_rows)++;
+	}
+
+	g_assert_no_error (error);
+	g_object_unref (cursor);
+
+	return g_test_timer_elapsed ();
+}
+
+static void
+test_rank_performance (void)
+{
+	const gchar *test_schemas[2] = { NULL, NULL };
+	gdouble ranked, unranked;
+	GError *error = NULL;
+	gchar *data_prefix;
+	GString *update;
+	gint i, n_rows;
+
+	if (!g_test_perf ()) {
+		return;
+	}
+
+	data_prefix = g_build_path (G_DIR_SEPARATOR_S, TOP_SRCDIR, "tests", "libtracker-fts", "data", NULL);
+	test_schemas[0] = data_prefix;
+	tracker_db_journal_set_rotating (FALSE, G_MAXSIZE, NULL);
+	tracker_data_manager_init (TRACKER_DB_MANAGER_FORCE_REINDEX,
+	                           test_schemas,
+	                           NULL, FALSE, FALSE,
+	                           100, 100, NULL, NULL, NULL, &error);
+	g_assert_no_error (error);
+
+	/* generated corpus, every document matches with varying term
+	 * frequencies and lengths */
+	update = g_string_new (NULL);
+
+	for (i = 0; i < N_RANK_DOCUMENTS; i++) {
+		gint j;
+
+		if (update->len == 0) {
+			g_string_append (update, "INSERT {");
+		}
+
+		g_string_append_printf (update, " <test:rank%d> a test:A ; test:p \"", i);
+		for (j = 0; j <= i % 3; j++) {
+			g_string_append (update, "tracker ");
+		}
+		for (j = 0; j < i % 17; j++) {
+			g_string_append_printf (update, "filler%d ", (i + j) % 1000);
+		}
+		g_string_append_printf (update, "\" ; test:o \"word%d tracker\" .", i % 100);
+
+		if ((i + 1) % 1000 == 0) {
+			g_string_append (update, " }");
+			tracker_data_update_sparql (update->str, &error);
+			g_assert_no_error (error);
+			g_string_truncate (update, 0);
+		}
+	}
+
+	g_string_free (update, TRUE);
+
+	unranked = time_query ("SELECT ?o WHERE { ?o fts:match \"tracker\" }", &n_rows);
+	g_assert_cmpint (n_rows, ==, N_RANK_DOCUMENTS);
+
+	ranked = time_query ("SELECT ?o WHERE { ?o fts:match \"tracker\" } ORDER BY DESC (fts:rank(?o))", &n_rows);
+	g_assert_cmpint (n_rows, ==, N_RANK_DOCUMENTS);
+
+	g_test_message ("%d hits: %.3f s unranked, %.3f s ranked",
+	                N_RANK_DOCUMENTS, unranked, ranked);
+	g_test_minimized_result ((ranked - unranked) * 1e9 / N_RANK_DOCUMENTS,
+	                         "fts:rank %.1f ns per hit",
+	                         (ranked - unranked) * 1e9 / N_RANK_DOCUMENTS);
+
+	g_free (data_prefix);
+
+	tracker_data_manager_shutdown ();
+}
+
 int
 main (int argc, char **argv)
 {
@@ -196,6 +453,10 @@ main (int argc, char **argv)
 		g_free (testpath);
 	}
 
+	g_test_add_func ("/libtracker-fts/pending-updates", test_pending_updates);
+	g_test_add_func ("/libtracker-fts/rebuild", test_rebuild);
+	g_test_add_func ("/libtracker-fts/rank/performance", test_rank_performance);
+
 	/* run tests */
 	result = g_test_run ();
 
@@ -0,0 +1,281 @@
+/*
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ * Boston, MA  02110-1301, USA.
+ */
+#include <string.h>
+
+#include <glib.h>
+#include <glib/gstdio.h>
+
+/* NOTE: We're not including tracker-miner.h here because this is private. */
+#include <libtracker-miner/tracker-crawl-state.h>
+
+typedef struct {
+	gchar *dir;
+	gchar *filename;
+} TestCommonContext;
+
+#define test_add(path,fun)	  \
+	g_test_add (path, \
+	            TestCommonContext, \
+	            NULL, \
+	            test_common_context_setup, \
+	            fun, \
+	            test_common_context_teardown)
+
+static void
+test_common_context_setup (TestCommonContext *fixture,
+                           gconstpointer      data)
+{
+	fixture->dir = g_dir_make_tmp ("tracker-crawl-state-test-XXXXXX", NULL);
+	g_assert (fixture->dir != NULL);
+
+	fixture->filename = g_build_filename (fixture->dir, "crawl-state.db", NULL);
+}
+
+static void
+test_common_context_teardown (TestCommonContext *fixture,
+                              gconstpointer      data)
+{
+	g_unlink (fixture->filename);
+	g_rmdir (fixture->dir);
+	g_free (fixture->filename);
+	g_free (fixture->dir);
+}
+
+static void
+assert_entry (TrackerCrawlState *state,
+              const gchar       *path,
+              guint64            expected_mtime,
+              const gchar       *expected_iri)
+{
+	const gchar *iri;
+	guint64 mtime;
+	GFile *file;
+
+	file = g_file_new_for_path (path);
+	g_assert (tracker_crawl_state_lookup (state, file, &mtime, &iri));
+	g_assert_cmpuint (mtime, ==, expected_mtime);
+	g_assert_cmpstr (iri, ==, expected_iri);
+	g_object_unref (file);
+}
+
+static void
+assert_no_entry (TrackerCrawlState *state,
+                 const gchar       *path)
+{
+	GFile *file;
+
+	file = g_file_new_for_path (path);
+	g_assert (!tracker_crawl_state_lookup (state, file, NULL, NULL));
+	g_object_unref (file);
+}
+
+static void
+set_entry (TrackerCrawlState *state,
+           const gchar       *path,
+           guint64            mtime,
+           const gchar       *iri)
+{
+	GFile *file;
+
+	file = g_file_new_for_path (path);
+	tracker_crawl_state_set (state, file, mtime, iri);
+	g_object_unref (file);
+}
+
+static void
+remove_entry (TrackerCrawlState *state,
+              const gchar       *path)
+{
+	GFile *file;
+
+	file = g_file_new_for_path (path);
+	tracker_crawl_state_remove (state, file);
+	g_object_unref (file);
+}
+
+static void
+save (TrackerCrawlState *state)
+{
+	GError *error = NULL;
+
+	g_assert (tracker_crawl_state_save (state, &error));
+	g_assert_no_error (error);
+}
+
+static void
+test_crawl_state_set_remove (TestCommonContext *fixture,
+                             gconstpointer      data)
+{
+	TrackerCrawlState *state;
+
+	state = tracker_crawl_state_new (fixture->filename);
+
+	assert_no_entry (state, "/a");
+
+	set_entry (state, "/a", 100, "urn:uuid:a");
+	set_entry (state, "/a/b", 200, NULL);
+	assert_entry (state, "/a", 100, "urn:uuid:a");
+	assert_entry (state, "/a/b", 200, NULL);
+
+	set_entry (state, "/a/b", 300, NULL);
+	assert_entry (state, "/a/b", 300, NULL);
+
+	remove_entry (state, "/a/b");
+	assert_no_entry (state, "/a/b");
+	assert_entry (state, "/a", 100, "urn:uuid:a");
+
+	tracker_crawl_state_free (state);
+
+	/* Nothing was saved */
+	g_assert (!g_file_test (fixture->filename, G_FILE_TEST_EXISTS));
+}
+
+static void
+test_crawl_state_save_load (TestCommonContext *fixture,
+                            gconstpointer      data)
+{
+	TrackerCrawlState *state;
+
+	state = tracker_crawl_state_new (fixture->filename);
+	set_entry (state, "/a", 100, "urn:uuid:a");
+	set_entry (state, "/a/b", 200, NULL);
+	set_entry (state, "/a/c", 300, "urn:uuid:c");
+	save (state);
+
+	/* Lookups work on the saved file, and on changes on top */
+	assert_entry (state, "/a", 100, "urn:uuid:a");
+	remove_entry (state, "/a/b");
+	set_entry (state, "/a/c", 400, "urn:uuid:c");
+	set_entry (state, "/a/d", 500, NULL);
+	assert_no_entry (state, "/a/b");
+	assert_entry (state, "/a/c", 400, "urn:uuid:c");
+	tracker_crawl_state_free (state);
+
+	/* Unsaved changes are lost */
+	state = tracker_crawl_state_new (fixture->filename);
+	assert_entry (state, "/a", 100, "urn:uuid:a");
+	assert_entry (state, "/a/b", 200, NULL);
+	assert_entry (state, "/a/c", 300, "urn:uuid:c");
+	assert_no_entry (state, "/a/d");
+
+	remove_entry (state, "/a/b");
+	set_entry (state, "/a/c", 400, "urn:uuid:c");
+	set_entry (state, "/a/d", 500, NULL);
+	save (state);
+	tracker_crawl_state_free (state);
+
+	state = tracker_crawl_state_new (fixture->filename);
+	assert_entry (state, "/a", 100, "urn:uuid:a");
+	assert_no_entry (state, "/a/b");
+	assert_entry (state, "/a/c", 400, "urn:uuid:c");
+	assert_entry (state, "/a/d", 500, NULL);
+	tracker_crawl_state_free (state);
+}
+
+static void
+test_crawl_state_many (TestCommonContext *fixture,
+                       gconstpointer      data)
+{
+	TrackerCrawlState *state;
+	gchar path[64], iri[64];
+	guint i;
+
+	/* More than fit in memory before being written out */
+	state = tracker_crawl_state_new (fixture->filename);
+
+	for (i = 0; i < 100000; i++) {
+		g_snprintf (path, sizeof (path), "/dir%u/file%u", i % 100, i);
+		g_snprintf (iri, sizeof (iri), "urn:uuid:%u", i);
+		set_entry (state, path, i, (i % 10 == 0) ? iri : NULL);
+	}
+
+	save (state);
+	tracker_crawl_state_free (state);
+
+	state = tracker_crawl_state_new (fixture->filename);
+
+	for (i = 0; i < 100000; i++) {
+		g_snprintf (path, sizeof (path), "/dir%u/file%u", i % 100, i);
+		g_snprintf (iri, sizeof (iri), "urn:uuid:%u", i);
+		assert_entry (state, path, i, (i % 10 == 0) ? iri : NULL);
+	}
+
+	assert_no_entry (state, "/dir0/file100000");
+	tracker_crawl_state_free (state);
+}
+
+static void
+test_crawl_state_invalid (TestCommonContext *fixture,
+                          gconstpointer      data)
+{
+	TrackerCrawlState *state;
+	GError *error = NULL;
+	gchar *contents;
+	gsize len;
+
+	state = tracker_crawl_state_new (fixture->filename);
+	set_entry (state, "/a", 100, "urn:uuid:a");
+	save (state);
+	tracker_crawl_state_free (state);
+
+	/* Truncated files are ignored altogether */
+	g_file_get_contents (fixture->filename, &contents, &len, &error);
+	g_assert_no_error (error);
+	g_file_set_contents (fixture->filename, contents, len - 1, &error);
+	g_assert_no_error (error);
+	g_free (contents);
+
+	state = tracker_crawl_state_new (fixture->filename);
+	assert_no_entry (state, "/a");
+
+	/* And overwritten on save */
+	set_entry (state, "/b", 200, NULL);
+	save (state);
+	tracker_crawl_state_free (state);
+
+	state = tracker_crawl_state_new (fixture->filename);
+	assert_no_entry (state, "/a");
+	assert_entry (state, "/b", 200, NULL);
+	tracker_crawl_state_free (state);
+
+	/* So are files that are something else */
+	g_file_set_contents (fixture->filename, "garbage", -1, &error);
+	g_assert_no_error (error);
+
+	state = tracker_crawl_state_new (fixture->filename);
+	assert_no_entry (state, "/b");
+	tracker_crawl_state_free (state);
+}
+
+gint
+main (gint argc, gchar **argv)
+{
+	g_test_init (&argc, &argv, NULL);
+
+	g_test_message ("Testing crawl state");
+
+	test_add ("/libtracker-miner/tracker-crawl-state/set-remove",
+	          test_crawl_state_set_remove);
+	test_add ("/libtracker-miner/tracker-crawl-state/save-load",
+	          test_crawl_state_save_load);
+	test_add ("/libtracker-miner/tracker-crawl-state/many",
+	          test_crawl_state_many);
+	test_add ("/libtracker-miner/tracker-crawl-state/invalid",
+	          test_crawl_state_invalid);
+
+	return g_test_run ();
+}
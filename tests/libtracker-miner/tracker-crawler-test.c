@@ -21,8 +21,17 @@
 
 #include <locale.h>
 
+#include <glib/gstdio.h>
+
 #include <libtracker-miner/tracker-crawler.h>
 
+#define FILE_INFO_ATTRIBUTES	  \
+	G_FILE_ATTRIBUTE_TIME_MODIFIED "," \
+	G_FILE_ATTRIBUTE_TIME_ACCESS "," \
+	G_FILE_ATTRIBUTE_STANDARD_SIZE "," \
+	G_FILE_ATTRIBUTE_STANDARD_DISPLAY_NAME "," \
+	G_FILE_ATTRIBUTE_STANDARD_CONTENT_TYPE
+
 typedef struct CrawlerTest CrawlerTest;
 
 struct CrawlerTest {
@@ -321,6 +330,225 @@ test_crawler_crawl_n_signals_non_recursive (void)
 	g_object_unref (file);
 }
 
+static gboolean
+crawler_check_file_info_cb (TrackerCrawler *crawler,
+                            GFile          *file,
+                            gpointer        user_data)
+{
+	CrawlerTest *test = user_data;
+	GFileInfo *info, *expected;
+
+	info = tracker_crawler_get_file_info (crawler, file);
+	g_assert (info != NULL);
+
+	expected = g_file_query_info (file, FILE_INFO_ATTRIBUTES ","
+	                              G_FILE_ATTRIBUTE_STANDARD_TYPE,
+	                              G_FILE_QUERY_INFO_NOFOLLOW_SYMLINKS,
+	                              NULL, NULL);
+	g_assert (expected != NULL);
+
+	g_assert_cmpint (g_file_info_get_file_type (info), ==,
+	                 g_file_info_get_file_type (expected));
+	g_assert_cmpint (g_file_info_get_size (info), ==,
+	                 g_file_info_get_size (expected));
+	g_assert_cmpuint (g_file_info_get_attribute_uint64 (info, G_FILE_ATTRIBUTE_TIME_MODIFIED), ==,
+	                  g_file_info_get_attribute_uint64 (expected, G_FILE_ATTRIBUTE_TIME_MODIFIED));
+	g_assert (g_file_info_has_attribute (info, G_FILE_ATTRIBUTE_TIME_ACCESS));
+	g_assert_cmpstr (g_file_info_get_display_name (info), ==,
+	                 g_file_info_get_display_name (expected));
+	g_assert_cmpstr (g_file_info_get_content_type (info), ==,
+	                 g_file_info_get_content_type (expected));
+
+	test->n_check_file++;
+
+	g_object_unref (expected);
+	g_object_unref (info);
+
+	return TRUE;
+}
+
+static void
+crawl_file_info (const gchar *n_threads)
+{
+	TrackerCrawler *crawler;
+	CrawlerTest test = { 0 };
+	GFile *file;
+
+	g_setenv ("TRACKER_CRAWLER_THREADS", n_threads, TRUE);
+
+	test.main_loop = g_main_loop_new (NULL, FALSE);
+
+	crawler = tracker_crawler_new (NULL);
+	tracker_crawler_set_file_attributes (crawler, FILE_INFO_ATTRIBUTES);
+	g_signal_connect (crawler, "finished",
+			  G_CALLBACK (crawler_finished_cb), &test);
+	g_signal_connect (crawler, "directory-crawled",
+			  G_CALLBACK (crawler_directory_crawled_cb), &test);
+	g_signal_connect (crawler, "check-file",
+			  G_CALLBACK (crawler_check_file_info_cb), &test);
+
+	file = g_file_new_for_path (TEST_DATA_DIR);
+
+	tracker_crawler_start (crawler, file, TRACKER_DIRECTORY_FLAG_NONE, -1);
+
+	g_main_loop_run (test.main_loop);
+
+	g_assert_cmpint (test.interrupted, ==, 0);
+	g_assert_cmpint (test.files_found, ==, 5);
+	g_assert_cmpint (test.n_check_file, ==, 5);
+
+	g_main_loop_unref (test.main_loop);
+	g_object_unref (crawler);
+	g_object_unref (file);
+
+	g_unsetenv ("TRACKER_CRAWLER_THREADS");
+}
+
+static void
+test_crawler_crawl_file_info (void)
+{
+	/* Threaded directory reads */
+	crawl_file_info ("4");
+	/* GFileEnumerator */
+	crawl_file_info ("0");
+}
+
+static void
+populate_tree (const gchar *path,
+               gint         depth,
+               guint       *n_files)
+{
+	gint i;
+
+	for (i = 0; i < 50; i++) {
+		gchar *filename, *name;
+
+		name = g_strdup_printf ("file-%d.txt", i);
+		filename = g_build_filename (path, name, NULL);
+		g_file_set_contents (filename, name, -1, NULL);
+		(*n_files)++;
+		g_free (filename);
+		g_free (name);
+	}
+
+	if (depth == 0) {
+		return;
+	}
+
+	for (i = 0; i < 8; i++) {
+		gchar *dirname, *name;
+
+		name = g_strdup_printf ("dir-%d", i);
+		dirname = g_build_filename (path, name, NULL);
+		g_mkdir (dirname, 0700);
+		populate_tree (dirname, depth - 1, n_files);
+		g_free (dirname);
+		g_free (name);
+	}
+}
+
+static void
+remove_tree (GFile *file)
+{
+	GFileEnumerator *enumerator;
+	GFileInfo *info;
+
+	enumerator = g_file_enumerate_children (file,
+	                                        G_FILE_ATTRIBUTE_STANDARD_NAME ","
+	                                        G_FILE_ATTRIBUTE_STANDARD_TYPE,
+	                                        G_FILE_QUERY_INFO_NOFOLLOW_SYMLINKS,
+	                                        NULL, NULL);
+
+	while (enumerator &&
+	       (info = g_file_enumerator_next_file (enumerator, NULL, NULL)) != NULL) {
+		GFile *child;
+
+		child = g_file_get_child (file, g_file_info_get_name (info));
+
+		if (g_file_info_get_file_type (info) == G_FILE_TYPE_DIRECTORY) {
+			remove_tree (child);
+		} else {
+			g_file_delete (child, NULL, NULL);
+		}
+
+		g_object_unref (child);
+		g_object_unref (info);
+	}
+
+	g_clear_object (&enumerator);
+	g_file_delete (file, NULL, NULL);
+}
+
+static gdouble
+crawl_rate (GFile       *file,
+            const gchar *n_threads,
+            guint        n_files)
+{
+	TrackerCrawler *crawler;
+	CrawlerTest test = { 0 };
+	gdouble elapsed;
+
+	if (n_threads) {
+		g_setenv ("TRACKER_CRAWLER_THREADS", n_threads, TRUE);
+	} else {
+		g_unsetenv ("TRACKER_CRAWLER_THREADS");
+	}
+
+	test.main_loop = g_main_loop_new (NULL, FALSE);
+
+	crawler = tracker_crawler_new (NULL);
+	tracker_crawler_set_file_attributes (crawler, FILE_INFO_ATTRIBUTES);
+	g_signal_connect (crawler, "finished",
+			  G_CALLBACK (crawler_finished_cb), &test);
+	g_signal_connect (crawler, "directory-crawled",
+			  G_CALLBACK (crawler_directory_crawled_cb), &test);
+
+	g_test_timer_start ();
+	tracker_crawler_start (crawler, file, TRACKER_DIRECTORY_FLAG_NONE, -1);
+	g_main_loop_run (test.main_loop);
+	elapsed = g_test_timer_elapsed ();
+
+	g_assert_cmpint (test.files_found, ==, n_files);
+
+	g_main_loop_unref (test.main_loop);
+	g_object_unref (crawler);
+
+	g_unsetenv ("TRACKER_CRAWLER_THREADS");
+
+	return n_files / elapsed;
+}
+
+static void
+test_crawler_crawl_rate (void)
+{
+	gdouble enumerator_rate, scanner_rate;
+	guint n_files = 0;
+	gchar *path;
+	GFile *file;
+
+	if (!g_test_perf ()) {
+		return;
+	}
+
+	path = g_dir_make_tmp ("tracker-crawler-test-XXXXXX", NULL);
+	g_assert (path != NULL);
+
+	/* ~30000 files in ~600 directories */
+	populate_tree (path, 3, &n_files);
+	file = g_file_new_for_path (path);
+
+	enumerator_rate = crawl_rate (file, "0", n_files);
+	scanner_rate = crawl_rate (file, NULL, n_files);
+
+	g_test_message ("GFileEnumerator: %.0f files/s", enumerator_rate);
+	g_test_maximized_result (scanner_rate, "Threaded reads: %.0f files/s, %.1fx faster",
+	                         scanner_rate, scanner_rate / enumerator_rate);
+
+	remove_tree (file);
+	g_object_unref (file);
+	g_free (path);
+}
+
 int
 main (int    argc,
       char **argv)
@@ -346,5 +574,10 @@ main (int    argc,
 	g_test_add_func ("/libtracker-miner/tracker-crawler/crawl-n-signals-non-recursive",
 	                 test_crawler_crawl_n_signals_non_recursive);
 
+	g_test_add_func ("/libtracker-miner/tracker-crawler/crawl-file-info",
+	                 test_crawler_crawl_file_info);
+	g_test_add_func ("/libtracker-miner/tracker-crawler/crawl-rate",
+	                 test_crawler_crawl_rate);
+
 	return g_test_run ();
 }
@@ -231,6 +231,220 @@ test_file_system_properties (TestCommonContext *fixture,
 	g_assert (ret_value == NULL);
 }
 
+static void
+test_file_system_many_children (TestCommonContext *fixture,
+                                gconstpointer      data)
+{
+	GFile *file, *parent, *children[100], *other;
+	gchar *uri;
+	guint i;
+
+	file = g_file_new_for_uri ("file:///aaa");
+	parent = tracker_file_system_get_file (fixture->file_system, file,
+	                                       G_FILE_TYPE_DIRECTORY, NULL);
+	g_object_unref (file);
+
+	for (i = 0; i < G_N_ELEMENTS (children); i++) {
+		uri = g_strdup_printf ("file:///aaa/%u", i);
+		file = g_file_new_for_uri (uri);
+		children[i] = tracker_file_system_get_file (fixture->file_system, file,
+		                                            G_FILE_TYPE_REGULAR, parent);
+		g_assert (children[i] != NULL);
+		g_object_unref (file);
+		g_free (uri);
+	}
+
+	/* Remove some children, so lookups go through a shrunk index */
+	for (i = 0; i < G_N_ELEMENTS (children); i += 2) {
+		g_object_unref (children[i]);
+	}
+
+	for (i = 0; i < G_N_ELEMENTS (children); i++) {
+		uri = g_strdup_printf ("file:///aaa/%u", i);
+		file = g_file_new_for_uri (uri);
+		other = tracker_file_system_peek_file (fixture->file_system, file);
+		g_assert (other == ((i % 2 == 0) ? NULL : children[i]));
+		g_object_unref (file);
+		g_free (uri);
+	}
+}
+
+static gboolean
+traverse_append_uri (GFile    *file,
+                     gpointer  user_data)
+{
+	GString *str = user_data;
+	gchar *uri;
+
+	uri = g_file_get_uri (file);
+
+	if (str->len > 0) {
+		g_string_append_c (str, ' ');
+	}
+
+	g_string_append (str, uri + strlen ("file:///"));
+	g_free (uri);
+
+	return FALSE;
+}
+
+static void
+test_file_system_traverse (TestCommonContext *fixture,
+                           gconstpointer      data)
+{
+	const gchar *uris[] = {
+		"file:///aaa",
+		"file:///aaa/bbb",
+		"file:///aaa/bbb/ccc/ddd",
+		"file:///aaa/eee",
+		"file:///aaa/eee/fff",
+	};
+	GFile *files[G_N_ELEMENTS (uris)], *file;
+	GString *str;
+	guint i;
+
+	for (i = 0; i < G_N_ELEMENTS (uris); i++) {
+		file = g_file_new_for_uri (uris[i]);
+		files[i] = tracker_file_system_get_file (fixture->file_system, file,
+		                                         G_FILE_TYPE_DIRECTORY, NULL);
+		g_object_unref (file);
+	}
+
+	/* "ccc" is just a path component, it's not visited and
+	 * doesn't count towards depth.
+	 */
+	str = g_string_new (NULL);
+	tracker_file_system_traverse (fixture->file_system, files[0],
+	                              G_LEVEL_ORDER, traverse_append_uri,
+	                              -1, str);
+	g_assert_cmpstr (str->str, ==, "aaa aaa/bbb aaa/eee aaa/bbb/ccc/ddd aaa/eee/fff");
+
+	g_string_truncate (str, 0);
+	tracker_file_system_traverse (fixture->file_system, files[0],
+	                              G_PRE_ORDER, traverse_append_uri,
+	                              -1, str);
+	g_assert_cmpstr (str->str, ==, "aaa aaa/bbb aaa/bbb/ccc/ddd aaa/eee aaa/eee/fff");
+
+	g_string_truncate (str, 0);
+	tracker_file_system_traverse (fixture->file_system, files[0],
+	                              G_LEVEL_ORDER, traverse_append_uri,
+	                              2, str);
+	g_assert_cmpstr (str->str, ==, "aaa aaa/bbb aaa/eee");
+
+	g_assert (tracker_file_system_peek_parent (fixture->file_system,
+	                                           files[2]) == files[1]);
+
+	/* Forgetting files leaves no path components behind */
+	tracker_file_system_forget_files (fixture->file_system, files[0],
+	                                  G_FILE_TYPE_UNKNOWN);
+
+	g_string_truncate (str, 0);
+	tracker_file_system_traverse (fixture->file_system, NULL,
+	                              G_PRE_ORDER, traverse_append_uri,
+	                              -1, str);
+	g_assert_cmpstr (str->str, ==, "");
+
+	g_string_free (str, TRUE);
+}
+
+static gsize
+get_resident_memory (void)
+{
+	gchar *contents, **fields;
+	gsize rss = 0;
+
+	/* Only available on Linux */
+	if (!g_file_get_contents ("/proc/self/statm", &contents, NULL, NULL)) {
+		return 0;
+	}
+
+	fields = g_strsplit (contents, " ", -1);
+
+	if (g_strv_length (fields) > 1) {
+		rss = g_ascii_strtoull (fields[1], NULL, 10) * sysconf (_SC_PAGESIZE);
+	}
+
+	g_strfreev (fields);
+	g_free (contents);
+
+	return rss;
+}
+
+static GFile *
+perf_file_new (guint i)
+{
+	gchar *uri;
+	GFile *file;
+
+	/* Spread files over 1000 files per directory */
+	uri = g_strdup_printf ("file:///perf/dir%u/dir%u/file%u",
+	                       i / 1000000, (i / 1000) % 1000, i % 1000);
+	file = g_file_new_for_uri (uri);
+	g_free (uri);
+
+	return file;
+}
+
+static void
+test_file_system_perf (TestCommonContext *fixture,
+                       gconstpointer      data)
+{
+	guint i, n_files = GPOINTER_TO_UINT (data);
+	GFile *file, *parent, *dir = NULL;
+	gsize memory;
+	gdouble elapsed;
+
+	memory = get_resident_memory ();
+	g_test_timer_start ();
+
+	for (i = 0; i < n_files; i++) {
+		file = perf_file_new (i);
+
+		if (i % 1000 == 0) {
+			parent = g_file_get_parent (file);
+			dir = tracker_file_system_get_file (fixture->file_system, parent,
+			                                    G_FILE_TYPE_DIRECTORY, NULL);
+			g_object_unref (parent);
+		}
+
+		tracker_file_system_get_file (fixture->file_system, file,
+		                              G_FILE_TYPE_REGULAR, dir);
+		g_object_unref (file);
+	}
+
+	elapsed = g_test_timer_elapsed ();
+	g_test_maximized_result (n_files / elapsed,
+	                         "Inserted %u files in %.2f seconds",
+	                         n_files, elapsed);
+
+	if (memory > 0) {
+		memory = get_resident_memory () - memory;
+		g_test_minimized_result ((gdouble) memory / n_files,
+		                         "%.1f bytes per file, %" G_GSIZE_FORMAT " MB total",
+		                         (gdouble) memory / n_files,
+		                         memory / (1024 * 1024));
+	}
+
+	g_test_timer_start ();
+
+	for (i = 0; i < n_files; i++) {
+		file = perf_file_new (i);
+		g_assert (tracker_file_system_peek_file (fixture->file_system, file) != NULL);
+		g_object_unref (file);
+	}
+
+	elapsed = g_test_timer_elapsed ();
+	g_test_maximized_result (n_files / elapsed,
+	                         "Looked up %u files in %.2f seconds",
+	                         n_files, elapsed);
+
+	g_test_timer_start ();
+	g_object_unref (fixture->file_system);
+	fixture->file_system = NULL;
+	elapsed = g_test_timer_elapsed ();
+	g_test_message ("Freed %u files in %.2f seconds", n_files, elapsed);
+}
+
 gint
 main (gint    argc,
       gchar **argv)
@@ -249,6 +463,29 @@ main (gint    argc,
 		  test_file_system_reparenting);
 	test_add ("/libtracker-miner/file-system/file-properties",
 	          test_file_system_properties);
+	test_add ("/libtracker-miner/file-system/many-children",
+	          test_file_system_many_children);
+	test_add ("/libtracker-miner/file-system/traverse",
+	          test_file_system_traverse);
+
+	if (g_test_perf ()) {
+		g_test_add ("/libtracker-miner/file-system/perf/1M",
+		            TestCommonContext,
+		            GUINT_TO_POINTER (1000000),
+		            test_common_context_setup,
+		            test_file_system_perf,
+		            test_common_context_teardown);
+
+		/* Needs a few GB of memory */
+		if (g_test_thorough ()) {
+			g_test_add ("/libtracker-miner/file-system/perf/10M",
+			            TestCommonContext,
+			            GUINT_TO_POINTER (10000000),
+			            test_common_context_setup,
+			            test_file_system_perf,
+			            test_common_context_teardown);
+		}
+	}
 
 	return g_test_run ();
 }
@@ -27,6 +27,11 @@
 /* This MUST be larger than TRACKER_STEROIDS_BUFFER_SIZE */
 #define LONG_NAME_SIZE 128 * 1024 * sizeof(char)
 
+/* Enough rows for a streamed result to take several batches */
+#define STREAM_ROWS 2000
+#define STREAM_QUERY "SELECT ?r ?name WHERE { ?r a nmm:Artist ; nmm:artistName ?name . " \
+                     "FILTER (fn:starts-with (?name, \"streamArtist\")) }"
+
 typedef struct {
 	GMainLoop *main_loop;
 	const gchar *query;
@@ -68,6 +73,29 @@ insert_test_data ()
 	g_free (longName);
 }
 
+static void
+insert_stream_test_data ()
+{
+	GError *error = NULL;
+	GString *query;
+	gint i;
+
+	query = g_string_new ("INSERT {");
+
+	for (i = 0; i < STREAM_ROWS; i++) {
+		g_string_append_printf (query,
+		                        " <urn:streamdata%d> a nmm:Artist ; nmm:artistName \"streamArtist%d\" .",
+		                        i, i);
+	}
+
+	g_string_append (query, " }");
+
+	tracker_sparql_connection_update (connection, query->str, 0, NULL, &error);
+	g_assert_no_error (error);
+
+	g_string_free (query, TRUE);
+}
+
 /*
  * I comment that part out because I don't know how anonymous node hashing
  * works, but if we know two SparqlUpdate calls are going to return the same
@@ -269,6 +297,80 @@ test_tracker_sparql_query_iterate_sigpipe ()
 	g_object_unref (cursor);
 }
 
+static gpointer
+iterate_stream_thread (gpointer user_data)
+{
+	TrackerSparqlCursor *cursor = user_data;
+	GError *error = NULL;
+	gint n_rows = 0;
+
+	while (tracker_sparql_cursor_next (cursor, NULL, &error)) {
+		g_assert (g_str_has_prefix (tracker_sparql_cursor_get_string (cursor, 1, NULL), "streamArtist"));
+		n_rows++;
+	}
+
+	g_assert_no_error (error);
+
+	return GINT_TO_POINTER (n_rows);
+}
+
+/* Reads a result that is streamed in several batches, in another thread
+ * than the one that ran the query */
+static void
+test_tracker_sparql_query_iterate_stream ()
+{
+	TrackerSparqlCursor *cursor;
+	GError *error = NULL;
+	GThread *thread;
+	gint n_rows;
+
+	cursor = tracker_sparql_connection_query (connection, STREAM_QUERY, NULL, &error);
+
+	g_assert (cursor);
+	g_assert_no_error (error);
+
+	thread = g_thread_new ("stream-reader", iterate_stream_thread, cursor);
+	n_rows = GPOINTER_TO_INT (g_thread_join (thread));
+
+	g_assert_cmpint (n_rows, ==, STREAM_ROWS);
+
+	g_object_unref (cursor);
+}
+
+/* Closes a streamed result after the first row */
+static void
+test_tracker_sparql_query_iterate_stream_close ()
+{
+	TrackerSparqlCursor *cursor;
+	GError *error = NULL;
+	gint n_rows = 0;
+
+	cursor = tracker_sparql_connection_query (connection, STREAM_QUERY, NULL, &error);
+
+	g_assert (cursor);
+	g_assert_no_error (error);
+
+	g_assert (tracker_sparql_cursor_next (cursor, NULL, &error));
+	g_assert_no_error (error);
+
+	g_object_unref (cursor);
+
+	/* the store gave up on the first query, the next one is complete */
+	cursor = tracker_sparql_connection_query (connection, STREAM_QUERY, NULL, &error);
+
+	g_assert (cursor);
+	g_assert_no_error (error);
+
+	while (tracker_sparql_cursor_next (cursor, NULL, &error)) {
+		n_rows++;
+	}
+
+	g_assert_no_error (error);
+	g_assert_cmpint (n_rows, ==, STREAM_ROWS);
+
+	g_object_unref (cursor);
+}
+
 static void
 test_tracker_sparql_update_fast_small ()
 {
@@ -688,6 +790,7 @@ main (gint argc, gchar **argv)
 	connection = tracker_sparql_connection_get (NULL, NULL);
 
 	insert_test_data ();
+	insert_stream_test_data ();
 
 	g_test_add_func ("/steroids/tracker/tracker_sparql_query_iterate", test_tracker_sparql_query_iterate);
 	g_test_add_func ("/steroids/tracker/tracker_sparql_query_iterate_largerow", test_tracker_sparql_query_iterate_largerow);
@@ -695,6 +798,8 @@ main (gint argc, gchar **argv)
 	g_test_add_func ("/steroids/tracker/tracker_sparql_query_iterate_empty", test_tracker_sparql_query_iterate_empty);
 	g_test_add_func ("/steroids/tracker/tracker_sparql_query_iterate_empty/subprocess", test_tracker_sparql_query_iterate_empty_subprocess);
 	g_test_add_func ("/steroids/tracker/tracker_sparql_query_iterate_sigpipe", test_tracker_sparql_query_iterate_sigpipe);
+	g_test_add_func ("/steroids/tracker/tracker_sparql_query_iterate_stream", test_tracker_sparql_query_iterate_stream);
+	g_test_add_func ("/steroids/tracker/tracker_sparql_query_iterate_stream_close", test_tracker_sparql_query_iterate_stream_close);
 	g_test_add_func ("/steroids/tracker/tracker_sparql_update_fast_small", test_tracker_sparql_update_fast_small);
 	g_test_add_func ("/steroids/tracker/tracker_sparql_update_fast_large", test_tracker_sparql_update_fast_large);
 	g_test_add_func ("/steroids/tracker/tracker_sparql_update_fast_error", test_tracker_sparql_update_fast_error);